@@ -16,21 +16,47 @@
 #include "DownloadQueueSet.h"
 
 #include "MarbleDebug.h"
+#include "MarbleMath.h"
 
 #include "HttpJob.h"
 
+#include <QUrl>
+
 namespace Marble
 {
 
+// Connections per host to start with, as common for web browsers
+static const int initialHostConnections = 6;
+// The host is considered slow when its latency exceeds the lowest one by this factor
+static const qreal slowLatencyFactor = 2.5;
+// Jobs of tiles further away from the center than this many viewport radii are out of view
+static const qreal outOfViewDistance = 1.5;
+// Milliseconds between preemptions while a viewport changes
+static const int preemptInterval = 200;
+// Milliseconds between updates of the priorities while a viewport moves
+static const int prioritizeInterval = 100;
+
 DownloadQueueSet::DownloadQueueSet( QObject * const parent )
     : QObject( parent )
 {
+    m_preemptTimer.setSingleShot( true );
+    m_preemptTimer.setInterval( preemptInterval );
+    connect( &m_preemptTimer, SIGNAL(timeout()), SLOT(preemptJobs()) );
+    m_prioritizeTimer.setSingleShot( true );
+    m_prioritizeTimer.setInterval( prioritizeInterval );
+    connect( &m_prioritizeTimer, SIGNAL(timeout()), SLOT(updatePriorities()) );
 }
 
 DownloadQueueSet::DownloadQueueSet( DownloadPolicy const & policy, QObject * const parent )
     : QObject( parent ),
       m_downloadPolicy( policy )
 {
+    m_preemptTimer.setSingleShot( true );
+    m_preemptTimer.setInterval( preemptInterval );
+    connect( &m_preemptTimer, SIGNAL(timeout()), SLOT(preemptJobs()) );
+    m_prioritizeTimer.setSingleShot( true );
+    m_prioritizeTimer.setInterval( prioritizeInterval );
+    connect( &m_prioritizeTimer, SIGNAL(timeout()), SLOT(updatePriorities()) );
 }
 
 DownloadQueueSet::~DownloadQueueSet()
@@ -75,11 +101,12 @@ bool DownloadQueueSet::canAcceptJob( const QUrl& sourceUrl,
 
 void DownloadQueueSet::addJob( HttpJob * const job )
 {
+    job->setPriority( priority( job ) );
     m_jobs.push( job );
     mDebug() << "addJob: new job queue size:" << m_jobs.count();
     emit jobAdded();
     emit progressChanged( m_activeJobs.size(), m_jobs.count() );
-    activateJobs();
+    preemptJobs();
 }
 
 void DownloadQueueSet::activateJobs()
@@ -87,7 +114,18 @@ void DownloadQueueSet::activateJobs()
     while ( !m_jobs.isEmpty()
             && m_activeJobs.count() < m_downloadPolicy.maximumConnections() )
     {
-        HttpJob * const job = m_jobs.pop();
+        QSet<QString> busyHosts;
+        foreach ( HttpJob * const job, m_activeJobs ) {
+            const QString host = job->sourceUrl().host();
+            if ( activeJobCount( host ) >= hostConnectionLimit( host ) ) {
+                busyHosts.insert( host );
+            }
+        }
+
+        HttpJob * const job = m_jobs.take( busyHosts );
+        if ( !job ) {
+            break;
+        }
         activateJob( job );
     }
 }
@@ -106,7 +144,7 @@ void DownloadQueueSet::purgeJobs()
 {
     // purge all waiting jobs
     while( !m_jobs.isEmpty() ) {
-        HttpJob * const job = m_jobs.pop();
+        HttpJob * const job = m_jobs.take( QSet<QString>() );
         job->deleteLater();
     }
 
@@ -122,10 +160,49 @@ void DownloadQueueSet::purgeJobs()
     emit progressChanged( m_activeJobs.size(), m_jobs.count() );
 }
 
+void DownloadQueueSet::setViewport( const void *map, const GeoDataLatLonBox &viewport, int tileZoomLevel )
+{
+    QHash<const void *, Viewport>::const_iterator const pos = m_viewports.constFind( map );
+    if ( pos != m_viewports.constEnd() && pos->box == viewport && pos->tileZoomLevel == tileZoomLevel ) {
+        return;
+    }
+
+    const bool zoomChanged = pos == m_viewports.constEnd() || pos->tileZoomLevel != tileZoomLevel;
+    const GeoDataCoordinates corner( viewport.west(), viewport.north() );
+    const Viewport entry = { viewport, tileZoomLevel, distanceSphere( viewport.center(), corner ) };
+    m_viewports.insert( map, entry );
+
+    // A new zoom level changes most priorities at once, while a pan only
+    // shifts them a bit per frame. So during a pan the jobs are sorted
+    // again at most once per interval.
+    if ( zoomChanged ) {
+        updatePriorities();
+    } else if ( !m_prioritizeTimer.isActive() ) {
+        m_prioritizeTimer.start();
+    }
+}
+
+void DownloadQueueSet::removeViewport( const void *map )
+{
+    if ( m_viewports.remove( map ) ) {
+        updatePriorities();
+    }
+}
+
+int DownloadQueueSet::hostConnectionLimit( const QString &hostName ) const
+{
+    QHash<QString, HostStatistics>::const_iterator const pos = m_hosts.constFind( hostName );
+    if ( pos == m_hosts.constEnd() ) {
+        return qMin( initialHostConnections, m_downloadPolicy.maximumConnections() );
+    }
+    return pos->connectionLimit;
+}
+
 void DownloadQueueSet::finishJob( HttpJob * job, const QByteArray& data )
 {
     mDebug() << "finishJob: " << job->sourceUrl() << job->destinationFileName();
 
+    updateHostStatistics( job, true );
     deactivateJob( job );
     emit jobRemoved();
     emit jobFinished( data, job->destinationFileName(), job->initiatorId() );
@@ -149,6 +226,7 @@ void DownloadQueueSet::retryOrBlacklistJob( HttpJob * job, const int errorCode )
     Q_ASSERT( errorCode != 0 );
     Q_ASSERT( !m_retryQueue.contains( job ));
 
+    updateHostStatistics( job, false );
     deactivateJob( job );
     emit jobRemoved();
 
@@ -206,6 +284,161 @@ void DownloadQueueSet::deactivateJob( HttpJob * const job )
     emit progressChanged( m_activeJobs.size(), m_jobs.count() );
 }
 
+void DownloadQueueSet::updatePriorities()
+{
+    m_prioritizeTimer.stop();
+
+    foreach ( HttpJob * const job, m_jobs.jobs() ) {
+        job->setPriority( priority( job ) );
+    }
+    m_jobs.updatePriorities();
+    foreach ( HttpJob * const job, m_activeJobs ) {
+        job->setPriority( priority( job ) );
+    }
+
+    // at most one preemption per interval, not one per frame
+    if ( !m_preemptTimer.isActive() ) {
+        m_preemptTimer.start();
+    }
+}
+
+/**
+   Aborts active jobs of tiles which are out of view, if jobs of tiles in
+   view are waiting. The aborted jobs are queued again with their lower
+   priority, so that they are downloaded once the visible tiles are done.
+ */
+void DownloadQueueSet::preemptJobs()
+{
+    activateJobs();
+
+    for ( int preempted = 0; !m_jobs.isEmpty() && preempted < m_downloadPolicy.maximumConnections(); ++preempted ) {
+        HttpJob * const waiting = m_jobs.first();
+        if ( isOutOfView( waiting ) ) {
+            break;
+        }
+
+        // a slot of the same host has to be freed unless the host has slots left
+        const QString host = waiting->sourceUrl().host();
+        const bool hostIsBusy = activeJobCount( host ) >= hostConnectionLimit( host );
+
+        HttpJob * victim = 0;
+        foreach ( HttpJob * const job, m_activeJobs ) {
+            if ( isOutOfView( job ) && ( !hostIsBusy || job->sourceUrl().host() == host )
+                 && ( !victim || job->priority() < victim->priority() ) ) {
+                victim = job;
+            }
+        }
+        if ( !victim || victim->priority() >= waiting->priority() ) {
+            break;
+        }
+
+        mDebug() << "Preempting download of" << victim->destinationFileName();
+        deactivateJob( victim );
+        victim->abort();
+        m_jobs.push( victim );
+        activateJobs();
+    }
+}
+
+/**
+   The priority is highest for tiles in the center of a viewport at its
+   tile zoom level, and it decreases with the distance from the center and
+   with the difference of the zoom levels. The viewport giving the highest
+   priority counts. Bulk downloads come after everything else.
+ */
+int DownloadQueueSet::priority( const HttpJob * const job ) const
+{
+    int result = 0;
+    if ( job->hasTilePosition() ) {
+        bool hasViewport = false;
+        int best = 0;
+        foreach ( const Viewport &viewport, m_viewports ) {
+            if ( viewport.tileZoomLevel < 0 || viewport.radius <= 0 ) {
+                continue;
+            }
+            const qreal distance = distanceSphere( job->tilePosition(), viewport.box.center() ) / viewport.radius;
+            const int priority = -qRound( 100 * qMin<qreal>( distance, 100 ) )
+                                 - 100 * qAbs( job->tileZoomLevel() - viewport.tileZoomLevel );
+            best = hasViewport ? qMax( best, priority ) : priority;
+            hasViewport = true;
+        }
+        result += best;
+    }
+    if ( job->downloadUsage() == DownloadBulk ) {
+        result -= 100000;
+    }
+    return result;
+}
+
+bool DownloadQueueSet::isOutOfView( const HttpJob * const job ) const
+{
+    if ( job->downloadUsage() != DownloadBrowse || !job->hasTilePosition() ) {
+        return false;
+    }
+
+    // out of view only if no viewport shows the tile
+    bool hasViewport = false;
+    foreach ( const Viewport &viewport, m_viewports ) {
+        if ( viewport.tileZoomLevel < 0 || viewport.radius <= 0 ) {
+            continue;
+        }
+        hasViewport = true;
+        if ( qAbs( job->tileZoomLevel() - viewport.tileZoomLevel ) <= 1
+             && distanceSphere( job->tilePosition(), viewport.box.center() ) <= outOfViewDistance * viewport.radius ) {
+            return false;
+        }
+    }
+    return hasViewport;
+}
+
+int DownloadQueueSet::activeJobCount( const QString &hostName ) const
+{
+    int count = 0;
+    foreach ( HttpJob * const job, m_activeJobs ) {
+        if ( job->sourceUrl().host() == hostName ) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void DownloadQueueSet::updateHostStatistics( const HttpJob * const job, bool success )
+{
+    const QString host = job->sourceUrl().host();
+    const int maximum = m_downloadPolicy.maximumConnections();
+    const int minimum = qMin( 2, maximum );
+
+    QHash<QString, HostStatistics>::iterator pos = m_hosts.find( host );
+    if ( pos == m_hosts.end() ) {
+        HostStatistics statistics;
+        statistics.connectionLimit = hostConnectionLimit( host );
+        statistics.averageLatency = -1;
+        statistics.minimumLatency = -1;
+        pos = m_hosts.insert( host, statistics );
+    }
+
+    if ( !success ) {
+        // most likely the host is overloaded
+        pos->connectionLimit = qMax( minimum, pos->connectionLimit / 2 );
+        return;
+    }
+
+    const qreal latency = job->elapsed();
+    if ( pos->averageLatency < 0 ) {
+        pos->averageLatency = latency;
+        pos->minimumLatency = latency;
+        return;
+    }
+    pos->averageLatency = 0.8 * pos->averageLatency + 0.2 * latency;
+    pos->minimumLatency = qMin( pos->minimumLatency, latency );
+
+    if ( pos->averageLatency > slowLatencyFactor * qMax<qreal>( pos->minimumLatency, 1 ) ) {
+        pos->connectionLimit = qMax( minimum, pos->connectionLimit - 1 );
+    } else if ( !m_jobs.isEmpty() ) {
+        pos->connectionLimit = qMin( maximum, pos->connectionLimit + 1 );
+    }
+}
+
 bool DownloadQueueSet::jobIsActive( QString const & destinationFileName ) const
 {
     QList<HttpJob*>::const_iterator pos = m_activeJobs.constBegin();
@@ -243,36 +476,74 @@ bool DownloadQueueSet::jobIsBlackListed( const QUrl& sourceUrl ) const
 }
 
 
-inline bool DownloadQueueSet::JobStack::contains( const QString& destinationFileName ) const
+DownloadQueueSet::JobQueue::JobQueue()
+    : m_sequence( 0 )
+{
+}
+
+inline bool DownloadQueueSet::JobQueue::contains( const QString& destinationFileName ) const
 {
     return m_jobsContent.contains( destinationFileName );
 }
 
-inline int DownloadQueueSet::JobStack::count() const
+inline int DownloadQueueSet::JobQueue::count() const
 {
     return m_jobs.count();
 }
 
-inline bool DownloadQueueSet::JobStack::isEmpty() const
+inline bool DownloadQueueSet::JobQueue::isEmpty() const
 {
     return m_jobs.isEmpty();
 }
 
-inline HttpJob * DownloadQueueSet::JobStack::pop()
+HttpJob * DownloadQueueSet::JobQueue::first() const
 {
-    HttpJob * const job = m_jobs.pop();
-    bool const removed = m_jobsContent.remove( job->destinationFileName() );
-    Q_UNUSED( removed ); // for Q_ASSERT in release mode
-    Q_ASSERT( removed );
-    return job;
+    Q_ASSERT( !m_jobs.isEmpty() );
+    return ( m_jobs.constEnd() - 1 ).value();
 }
 
-inline void DownloadQueueSet::JobStack::push( HttpJob * const job )
+HttpJob * DownloadQueueSet::JobQueue::take( const QSet<QString> &busyHosts )
 {
-    m_jobs.push( job );
-    m_jobsContent.insert( job->destinationFileName() );
+    QMap<Key, HttpJob*>::iterator pos = m_jobs.end();
+    while ( pos != m_jobs.begin() ) {
+        --pos;
+        HttpJob * const job = pos.value();
+        if ( busyHosts.isEmpty() || !busyHosts.contains( job->sourceUrl().host() ) ) {
+            m_jobs.erase( pos );
+            bool const removed = m_jobsContent.remove( job->destinationFileName() );
+            Q_UNUSED( removed ); // for Q_ASSERT in release mode
+            Q_ASSERT( removed );
+            return job;
+        }
+    }
+    return 0;
+}
+
+void DownloadQueueSet::JobQueue::push( HttpJob * const job )
+{
+    const Key key( job->priority(), m_sequence++ );
+    m_jobs.insert( key, job );
+    m_jobsContent.insert( job->destinationFileName(), key );
 }
 
+void DownloadQueueSet::JobQueue::updatePriorities()
+{
+    QMap<Key, HttpJob*> jobs;
+    QMap<Key, HttpJob*>::const_iterator pos = m_jobs.constBegin();
+    QMap<Key, HttpJob*>::const_iterator const end = m_jobs.constEnd();
+    for (; pos != end; ++pos ) {
+        HttpJob * const job = pos.value();
+        const Key key( job->priority(), pos.key().second );
+        jobs.insert( key, job );
+        m_jobsContent[ job->destinationFileName() ] = key;
+    }
+    m_jobs = jobs;
+}
+
+QList<HttpJob*> DownloadQueueSet::JobQueue::jobs() const
+{
+    return m_jobs.values();
+}
 
 }
 
@@ -16,13 +16,17 @@
 #ifndef MARBLE_DOWNLOADQUEUESET_H
 #define MARBLE_DOWNLOADQUEUESET_H
 
+#include <QHash>
 #include <QList>
+#include <QMap>
+#include <QPair>
 #include <QQueue>
 #include <QObject>
 #include <QSet>
-#include <QStack>
+#include <QTimer>
 
 #include "DownloadPolicy.h"
+#include "GeoDataLatLonBox.h"
 
 class QUrl;
 
@@ -38,10 +42,22 @@ class HttpJob;
      the HttpJob is put into the m_jobQueue where it waits for "activation"
      signal jobAdded is emitted
    - Job is activated
-     Job is moved from m_jobQueue to m_activeJobs and signals of the job
-     are connected to slots (local or HttpDownloadManager)
+     The waiting job with the highest priority whose host has a free
+     connection is moved from m_jobQueue to m_activeJobs and signals of
+     the job are connected to slots (local or HttpDownloadManager)
      Job is executed by calling the jobs execute() method
 
+   Every map showing tiles registers its viewport. A job gets the priority
+   of the viewport it is closest to, so maps sharing the model do not push
+   back each other's downloads. Priorities are updated when a viewport
+   changes. Shortly after, active jobs of tiles which are out of view of
+   all viewports are aborted and moved back to m_jobQueue if jobs of
+   visible tiles are waiting.
+
+   The number of connections per host adapts to the measured latency:
+   it grows while the latency stays close to the lowest one seen and
+   shrinks when the host slows down or fails.
+
    now there are different possibilities:
    1) Job emits jobDone (some error occurred, or canceled (kio))
       Job is disconnected
@@ -90,6 +106,24 @@ class DownloadQueueSet: public QObject
     void retryJobs();
     void purgeJobs();
 
+    /**
+     * Sets the visible region @p viewport of @p map, which is displayed with
+     * tiles of @p tileZoomLevel, and updates the priorities of the jobs.
+     * While the viewport is panned, they are updated at most once per
+     * interval.
+     */
+    void setViewport( const void *map, const GeoDataLatLonBox &viewport, int tileZoomLevel );
+
+    /**
+     * Removes the viewport of @p map, e.g. when the map gets destroyed.
+     */
+    void removeViewport( const void *map );
+
+    /**
+     * Returns the number of connections currently allowed to @p hostName.
+     */
+    int hostConnectionLimit( const QString &hostName ) const;
+
  Q_SIGNALS:
     void jobAdded();
     void jobRemoved();
@@ -104,10 +138,16 @@ class DownloadQueueSet: public QObject
     void finishJob( HttpJob * job, const QByteArray& data );
     void redirectJob( HttpJob * job, const QUrl& newSourceUrl );
     void retryOrBlacklistJob( HttpJob * job, const int errorCode );
+    void preemptJobs();
+    void updatePriorities();
 
  private:
     void activateJob( HttpJob * const job );
     void deactivateJob( HttpJob * const job );
+    int priority( const HttpJob * const job ) const;
+    bool isOutOfView( const HttpJob * const job ) const;
+    int activeJobCount( const QString &hostName ) const;
+    void updateHostStatistics( const HttpJob * const job, bool success );
     bool jobIsActive( const QString& destinationFileName ) const;
     bool jobIsQueued( const QString& destinationFileName ) const;
     bool jobIsWaitingForRetry( const QString& destinationFileName ) const;
@@ -116,21 +156,54 @@ class DownloadQueueSet: public QObject
     DownloadPolicy m_downloadPolicy;
 
     /** This is the first stage a job enters, from this queue it will get
-     *  into the activatedJobs container.
+     *  into the activatedJobs container. Jobs of the same priority are
+     *  activated last in, first out.
      */
-    class JobStack
+    class JobQueue
     {
     public:
+        JobQueue();
         bool contains( const QString& destinationFileName ) const;
         int count() const;
         bool isEmpty() const;
-        HttpJob * pop();
+        /// Returns the waiting job with the highest priority
+        HttpJob * first() const;
+        /// Takes the job with the highest priority whose host is not in @p busyHosts
+        HttpJob * take( const QSet<QString> &busyHosts );
         void push( HttpJob * const );
+        /// Sorts the jobs again after their priorities have changed
+        void updatePriorities();
+        QList<HttpJob*> jobs() const;
     private:
-        QStack<HttpJob*> m_jobs;
-        QSet<QString> m_jobsContent;
+        // priority and insertion sequence, the highest key comes first
+        typedef QPair<int, quint64> Key;
+        QMap<Key, HttpJob*> m_jobs;
+        QHash<QString, Key> m_jobsContent;
+        quint64 m_sequence;
+    };
+    JobQueue m_jobs;
+
+    struct HostStatistics
+    {
+        int connectionLimit;
+        // exponential moving average and minimum in ms
+        qreal averageLatency;
+        qreal minimumLatency;
+    };
+    QHash<QString, HostStatistics> m_hosts;
+
+    struct Viewport
+    {
+        GeoDataLatLonBox box;
+        int tileZoomLevel;
+        // half of the diagonal of the box in radians
+        qreal radius;
     };
-    JobStack m_jobs;
+    QHash<const void *, Viewport> m_viewports;
+    // delays preemption while a viewport keeps changing, e.g. during a pan
+    QTimer m_preemptTimer;
+    // delays updating the priorities while a viewport is panned
+    QTimer m_prioritizeTimer;
 
     /// Contains the jobs which are currently being downloaded.
     QList<HttpJob*> m_activeJobs;
@@ -0,0 +1,409 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "FileStorageIndex.h"
+
+#include "MarbleDebug.h"
+#include "MarbleGlobal.h"
+#include "MbTileStorage.h"
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThreadStorage>
+#include <QVariant>
+
+namespace Marble
+{
+
+namespace
+{
+
+// number of changes collected before they are written
+const int MaxPendingChanges = 256;
+
+// stored as 'complete' once the cache has been scanned; raised whenever
+// more files become evictable, so that a cache scanned before is rescanned
+const int ScanVersion = 2;
+
+QAtomicInt connectionCount;
+
+/** The connections of a thread to the cache indexes, removed when the thread finishes */
+class ConnectionPool
+{
+public:
+    ~ConnectionPool()
+    {
+        foreach ( const QString &name, m_connectionNames ) {
+            QSqlDatabase::removeDatabase( name );
+        }
+    }
+
+    /** Returns the connection to @p fileName, which might not be open yet */
+    QSqlDatabase database( const QString &fileName )
+    {
+        QString &name = m_connectionNames[fileName];
+        if ( name.isEmpty() ) {
+            name = QString( "marble-cache-index-%1" ).arg( connectionCount.fetchAndAddRelaxed( 1 ) );
+            QSqlDatabase db = QSqlDatabase::addDatabase( "QSQLITE", name );
+            db.setDatabaseName( fileName );
+            return db;
+        }
+        return QSqlDatabase::database( name, false );
+    }
+
+private:
+    QHash<QString, QString> m_connectionNames;
+};
+
+QThreadStorage<ConnectionPool *> connectionPools;
+
+}
+
+class FileStorageIndexRegistry
+{
+public:
+    ~FileStorageIndexRegistry()
+    {
+        qDeleteAll( m_indexes );
+    }
+
+    FileStorageIndex *index( const QString &dataDirectory )
+    {
+        const QString path = QDir::cleanPath( dataDirectory );
+
+        QMutexLocker locker( &m_mutex );
+        FileStorageIndex *index = m_indexes.value( path, 0 );
+        if ( !index ) {
+            index = new FileStorageIndex( path );
+            m_indexes.insert( path, index );
+        }
+        return index;
+    }
+
+private:
+    QMutex m_mutex;
+    QHash<QString, FileStorageIndex *> m_indexes;
+};
+
+Q_GLOBAL_STATIC( FileStorageIndexRegistry, s_registry )
+
+FileStorageIndex *FileStorageIndex::index( const QString &dataDirectory )
+{
+    return s_registry->index( dataDirectory );
+}
+
+bool FileStorageIndex::isEvictable( const QString &fileName )
+{
+    // We try to be very careful and just delete images, vector tiles
+    // and the binary caches written for the latter
+    const QString suffix = QFileInfo( fileName ).suffix().toLower();
+    if ( suffix != QLatin1String( "jpg" ) &&
+         suffix != QLatin1String( "png" ) &&
+         suffix != QLatin1String( "gif" ) &&
+         suffix != QLatin1String( "svg" ) &&
+         suffix != QLatin1String( "o5m" ) &&
+         suffix != QLatin1String( "mvtc" ) ) {
+        return false;
+    }
+
+    if ( QFileInfo( fileName ).isAbsolute() || !fileName.startsWith( QLatin1String( "maps/" ) ) ) {
+        return false;
+    }
+
+    QString themePath;
+    int zoomLevel, column, row;
+    return MbTileStorage::parseTileFileName( fileName, themePath, zoomLevel, column, row )
+            && zoomLevel > maxBaseTileLevel;
+}
+
+FileStorageIndex::FileStorageIndex( const QString &dataDirectory ) :
+    m_dataDirectory( dataDirectory ),
+    m_opened( false ),
+    m_complete( false ),
+    m_totalSize( 0 )
+{
+}
+
+FileStorageIndex::~FileStorageIndex()
+{
+}
+
+QString FileStorageIndex::dataDirectory() const
+{
+    return m_dataDirectory;
+}
+
+bool FileStorageIndex::isComplete()
+{
+    QMutexLocker locker( &m_mutex );
+    open();
+    return m_complete;
+}
+
+void FileStorageIndex::setComplete()
+{
+    QMutexLocker locker( &m_mutex );
+    if ( !open() ) {
+        return;
+    }
+    writePending();
+
+    QSqlQuery query( database() );
+    query.prepare( "INSERT OR REPLACE INTO info (name, value) VALUES ('complete', ?)" );
+    query.addBindValue( ScanVersion );
+    if ( query.exec() ) {
+        m_complete = true;
+    }
+}
+
+void FileStorageIndex::recordUpdate( const QString &fileName, qint64 size, qint64 accessed )
+{
+    if ( !isEvictable( fileName ) ) {
+        return;
+    }
+
+    PendingChange change;
+    change.size = size;
+    change.accessed = accessed < 0 ? QDateTime::currentMSecsSinceEpoch() : accessed;
+
+    QMutexLocker locker( &m_mutex );
+    m_pending.insert( fileName, change );
+    if ( m_pending.size() >= MaxPendingChanges && open() ) {
+        writePending();
+    }
+}
+
+void FileStorageIndex::recordAccess( const QString &fileName )
+{
+    const qint64 accessed = QDateTime::currentMSecsSinceEpoch();
+
+    QMutexLocker locker( &m_mutex );
+    auto iter = m_pending.find( fileName );
+    if ( iter != m_pending.end() ) {
+        iter->accessed = accessed;
+        return;
+    }
+
+    if ( !isEvictable( fileName ) ) {
+        return;
+    }
+
+    PendingChange change;
+    change.size = -1;
+    change.accessed = accessed;
+    m_pending.insert( fileName, change );
+    if ( m_pending.size() >= MaxPendingChanges && open() ) {
+        writePending();
+    }
+}
+
+qint64 FileStorageIndex::totalSize()
+{
+    QMutexLocker locker( &m_mutex );
+    if ( open() ) {
+        writePending();
+    }
+    return m_totalSize;
+}
+
+QVector<FileStorageIndex::Entry> FileStorageIndex::leastRecentlyUsed( int count )
+{
+    QVector<Entry> result;
+
+    QMutexLocker locker( &m_mutex );
+    if ( !open() ) {
+        return result;
+    }
+    writePending();
+
+    QSqlQuery query( database() );
+    query.setForwardOnly( true );
+    query.prepare( "SELECT file_name, size FROM entries ORDER BY accessed LIMIT ?" );
+    query.addBindValue( count );
+    if ( !query.exec() ) {
+        mDebug() << "Unable to query the cache index:" << query.lastError().text();
+        return result;
+    }
+
+    while ( query.next() ) {
+        Entry entry;
+        entry.fileName = query.value( 0 ).toString();
+        entry.size = query.value( 1 ).toLongLong();
+        result << entry;
+    }
+    return result;
+}
+
+void FileStorageIndex::remove( const QVector<Entry> &entries )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( !open() ) {
+        return;
+    }
+    writePending();
+
+    QSqlDatabase db = database();
+    db.transaction();
+    QSqlQuery query( db );
+    query.prepare( "DELETE FROM entries WHERE file_name=?" );
+    foreach ( const Entry &entry, entries ) {
+        query.addBindValue( entry.fileName );
+        if ( query.exec() && query.numRowsAffected() > 0 ) {
+            m_totalSize -= entry.size;
+        }
+    }
+
+    QSqlQuery sizeQuery( db );
+    sizeQuery.prepare( "INSERT OR REPLACE INTO info (name, value) VALUES ('total_size', ?)" );
+    sizeQuery.addBindValue( m_totalSize );
+    sizeQuery.exec();
+    db.commit();
+}
+
+void FileStorageIndex::clear()
+{
+    QMutexLocker locker( &m_mutex );
+    m_pending.clear();
+    if ( !open() ) {
+        return;
+    }
+
+    QSqlDatabase db = database();
+    db.transaction();
+    QSqlQuery( "DELETE FROM entries", db );
+    QSqlQuery( "INSERT OR REPLACE INTO info (name, value) VALUES ('total_size', 0)", db );
+    db.commit();
+    m_totalSize = 0;
+}
+
+void FileStorageIndex::flush()
+{
+    QMutexLocker locker( &m_mutex );
+    if ( !m_pending.isEmpty() && open() ) {
+        writePending();
+    }
+}
+
+QSqlDatabase FileStorageIndex::database()
+{
+    // Connections must not be shared between threads
+    if ( !connectionPools.hasLocalData() ) {
+        connectionPools.setLocalData( new ConnectionPool );
+    }
+    QSqlDatabase db = connectionPools.localData()->database( m_dataDirectory + QLatin1String( "/cache-index.sqlite" ) );
+    if ( db.isOpen() ) {
+        return db;
+    }
+
+    if ( !db.open() ) {
+        mDebug() << "Unable to open the cache index:" << db.lastError().text();
+    } else {
+        QSqlQuery( "PRAGMA journal_mode=WAL", db );
+        QSqlQuery( "PRAGMA synchronous=NORMAL", db );
+    }
+    return db;
+}
+
+bool FileStorageIndex::open()
+{
+    if ( m_opened ) {
+        return true;
+    }
+
+    if ( !QDir( m_dataDirectory ).exists() && !QDir::root().mkpath( m_dataDirectory ) ) {
+        return false;
+    }
+
+    QSqlDatabase db = database();
+    if ( !db.isOpen() ) {
+        return false;
+    }
+
+    const QStringList statements = QStringList()
+            << "CREATE TABLE IF NOT EXISTS entries (file_name text PRIMARY KEY, size integer, accessed integer)"
+            << "CREATE INDEX IF NOT EXISTS entries_accessed ON entries(accessed)"
+            << "CREATE TABLE IF NOT EXISTS info (name text PRIMARY KEY, value integer)";
+    foreach ( const QString &statement, statements ) {
+        QSqlQuery query( db );
+        if ( !query.exec( statement ) ) {
+            mDebug() << "Unable to create the cache index:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    QSqlQuery query( "SELECT name, value FROM info", db );
+    while ( query.next() ) {
+        const QString name = query.value( 0 ).toString();
+        if ( name == QLatin1String( "total_size" ) ) {
+            m_totalSize = query.value( 1 ).toLongLong();
+        } else if ( name == QLatin1String( "complete" ) ) {
+            m_complete = query.value( 1 ).toInt() >= ScanVersion;
+        }
+    }
+
+    m_opened = true;
+    return true;
+}
+
+void FileStorageIndex::writePending()
+{
+    if ( m_pending.isEmpty() ) {
+        return;
+    }
+
+    QSqlDatabase db = database();
+    db.transaction();
+
+    QSqlQuery sizeQuery( db );
+    sizeQuery.prepare( "SELECT size FROM entries WHERE file_name=?" );
+    QSqlQuery updateQuery( db );
+    updateQuery.prepare( "INSERT OR REPLACE INTO entries (file_name, size, accessed) VALUES (?, ?, ?)" );
+    QSqlQuery accessQuery( db );
+    accessQuery.prepare( "UPDATE entries SET accessed=? WHERE file_name=?" );
+
+    for ( auto iter = m_pending.constBegin(); iter != m_pending.constEnd(); ++iter ) {
+        if ( iter->size < 0 ) {
+            accessQuery.addBindValue( iter->accessed );
+            accessQuery.addBindValue( iter.key() );
+            accessQuery.exec();
+            continue;
+        }
+
+        qint64 oldSize = 0;
+        sizeQuery.addBindValue( iter.key() );
+        if ( sizeQuery.exec() && sizeQuery.next() ) {
+            oldSize = sizeQuery.value( 0 ).toLongLong();
+        }
+        sizeQuery.finish();
+
+        updateQuery.addBindValue( iter.key() );
+        updateQuery.addBindValue( iter->size );
+        updateQuery.addBindValue( iter->accessed );
+        if ( updateQuery.exec() ) {
+            m_totalSize += iter->size - oldSize;
+        }
+    }
+
+    QSqlQuery totalQuery( db );
+    totalQuery.prepare( "INSERT OR REPLACE INTO info (name, value) VALUES ('total_size', ?)" );
+    totalQuery.addBindValue( m_totalSize );
+    totalQuery.exec();
+
+    if ( !db.commit() ) {
+        mDebug() << "Unable to update the cache index:" << db.lastError().text();
+    }
+    m_pending.clear();
+}
+
+}
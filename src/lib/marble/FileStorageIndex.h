@@ -0,0 +1,133 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_FILESTORAGEINDEX_H
+#define MARBLE_FILESTORAGEINDEX_H
+
+#include "marble_export.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+class QSqlDatabase;
+
+namespace Marble
+{
+
+/**
+ * @short Persistent index of the tiles in the download cache.
+ *
+ * The index keeps the size and the time of the last access of every tile
+ * that may be removed to keep the cache within its limit. It lives in the
+ * SQLite database "cache-index.sqlite" of the data directory and is kept
+ * up to date by the storage policies when tiles are downloaded and by
+ * TileLoader when tiles are read. This way FileStorageWatcher neither has
+ * to scan the cache on startup nor to keep a list of all files in memory,
+ * and it finds the least recently used tiles with an indexed query.
+ *
+ * Tiles are identified by their file name relative to the data directory,
+ * no matter whether they are stored as file or in a tile pack.
+ *
+ * Changes are collected in memory and written in batches. All methods are
+ * thread-safe.
+ */
+class MARBLE_EXPORT FileStorageIndex
+{
+public:
+    struct Entry
+    {
+        QString fileName;
+        qint64 size;
+    };
+
+    /**
+     * Returns the shared index of the cache in @p dataDirectory.
+     */
+    static FileStorageIndex *index( const QString &dataDirectory );
+
+    /**
+     * Returns whether the file @p fileName, relative to the data directory,
+     * is a tile that may be removed from the cache. Other files are not
+     * indexed.
+     */
+    static bool isEvictable( const QString &fileName );
+
+    ~FileStorageIndex();
+
+    QString dataDirectory() const;
+
+    /**
+     * Returns false until the files stored before the index existed have
+     * been added and setComplete() has been called.
+     */
+    bool isComplete();
+    void setComplete();
+
+    /**
+     * Records that the tile @p fileName has been stored with @p size bytes
+     * at @p accessed (milliseconds since the epoch), now by default.
+     */
+    void recordUpdate( const QString &fileName, qint64 size, qint64 accessed = -1 );
+
+    /**
+     * Records that the tile @p fileName has been read. Does nothing if it is not indexed.
+     */
+    void recordAccess( const QString &fileName );
+
+    /**
+     * Returns the total size of all indexed tiles in bytes.
+     */
+    qint64 totalSize();
+
+    /**
+     * Returns up to @p count tiles, least recently used first.
+     */
+    QVector<Entry> leastRecentlyUsed( int count );
+
+    /**
+     * Removes the @p entries from the index after their tiles have been deleted.
+     */
+    void remove( const QVector<Entry> &entries );
+
+    void clear();
+
+    /**
+     * Writes the pending changes to the database.
+     */
+    void flush();
+
+private:
+    explicit FileStorageIndex( const QString &dataDirectory );
+    Q_DISABLE_COPY( FileStorageIndex )
+
+    struct PendingChange
+    {
+        // -1 for changes of the access time only
+        qint64 size;
+        qint64 accessed;
+    };
+
+    QSqlDatabase database();
+    bool open();
+    void writePending();
+
+    friend class FileStorageIndexRegistry;
+
+    const QString m_dataDirectory;
+    QMutex m_mutex;
+    bool m_opened;
+    bool m_complete;
+    qint64 m_totalSize;
+    QHash<QString, PendingChange> m_pending;
+};
+
+}
+
+#endif
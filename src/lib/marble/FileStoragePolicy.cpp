@@ -19,6 +19,7 @@
 #include <QFileInfo>
 
 // Marble
+#include "FileStorageIndex.h"
 #include "MarbleDebug.h"
 #include "MarbleGlobal.h"
 #include "MarbleDirs.h"
@@ -80,6 +81,8 @@ bool FileStoragePolicy::updateFile( const QString &fileName, const QByteArray &d
     emit sizeChanged( file.size() - oldSize );
     file.close();
 
+    FileStorageIndex::index( m_dataDirectory )->recordUpdate( fileName, data.size() );
+
     return true;
 }
 
@@ -135,6 +138,9 @@ void FileStoragePolicy::clearCache()
             }
         }
     }
+
+    // All indexed tiles have been removed above
+    FileStorageIndex::index( m_dataDirectory )->clear();
 }
 
 QString FileStoragePolicy::lastErrorMessage() const
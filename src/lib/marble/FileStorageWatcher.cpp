@@ -15,12 +15,16 @@
 #include <QDir>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QSet>
 #include <QTimer>
 
 // Marble
+#include "FileStorageIndex.h"
 #include "MarbleGlobal.h"
 #include "MarbleDebug.h"
 #include "MarbleDirs.h"
+#include "MbTileStorage.h"
+#include "VectorTileCache.h"
 
 using namespace Marble;
 
@@ -34,6 +38,7 @@ static const int softLimitPercent = 5;
 FileStorageWatcherThread::FileStorageWatcherThread( const QString &dataDirectory, QObject *parent )
     : QObject( parent ),
       m_dataDirectory( dataDirectory ),
+      m_index( FileStorageIndex::index( dataDirectory ) ),
       m_deleting( false ),
       m_willQuit( false )
 {
@@ -48,6 +53,7 @@ FileStorageWatcherThread::FileStorageWatcherThread( const QString &dataDirectory
 
 FileStorageWatcherThread::~FileStorageWatcherThread()
 {
+    m_index->flush();
 }
 
 quint64 FileStorageWatcherThread::cacheLimit()
@@ -88,35 +94,30 @@ void FileStorageWatcherThread::prepareQuit()
 
 void FileStorageWatcherThread::getCurrentCacheSize()
 {
-    mDebug() << "FileStorageWatcher: Creating cache size";
-    quint64 dataSize = 0;
-    const QString basePath = m_dataDirectory + QLatin1String("/maps");
-    QDirIterator it( basePath,
-                     QDir::Files | QDir::Writable,
-                     QDirIterator::Subdirectories );
-    
-    const int basePathDepth = basePath.split(QLatin1Char('/')).size();
-    while( it.hasNext() && !m_willQuit ) {
-        it.next();
-        QFileInfo file = it.fileInfo();
-        // We try to be very careful and just delete images
-        // FIXME, when vectortiling I suppose also vector tiles will have
-        // to be deleted
-        QString suffix = file.suffix().toLower();
-        const QStringList path = file.path().split(QLatin1Char('/'));
-
-        // planet/theme/tilelevel should be deeper than 4
-        if ( ( path.size() > basePathDepth + 3 ) &&
-             ( path[basePathDepth + 2].toInt() >= maxBaseTileLevel ) &&
-             ((suffix == QLatin1String("jpg") ||
-               suffix == QLatin1String("png") ||
-               suffix == QLatin1String("gif") ||
-               suffix == QLatin1String("svg")))) {
-            dataSize += file.size();
-            m_filesCache.insert(file.lastModified(), file.absoluteFilePath());
+    // The index is kept up to date while tiles are stored, so the cache
+    // only has to be scanned once for the files stored before it existed
+    if ( !m_index->isComplete() ) {
+        mDebug() << "FileStorageWatcher: Creating cache index";
+        const QDir dataDirectory( m_dataDirectory );
+        QDirIterator it( m_dataDirectory + QLatin1String("/maps"),
+                         QDir::Files | QDir::Writable,
+                         QDirIterator::Subdirectories );
+
+        while( it.hasNext() && !m_willQuit ) {
+            it.next();
+            const QFileInfo file = it.fileInfo();
+            const QString fileName = dataDirectory.relativeFilePath( file.absoluteFilePath() );
+            if ( FileStorageIndex::isEvictable( fileName ) ) {
+                m_index->recordUpdate( fileName, file.size(), file.lastModified().toMSecsSinceEpoch() );
+            }
+        }
+
+        if ( !m_willQuit ) {
+            m_index->setComplete();
         }
     }
-    m_currentCacheSize = dataSize;
+
+    m_currentCacheSize = m_index->totalSize();
 }
 
 void FileStorageWatcherThread::ensureCacheSize()
@@ -138,17 +139,36 @@ void FileStorageWatcherThread::ensureCacheSize()
         // We have not reached our soft limit, yet.
         m_deleting = true;
 
-        QMultiMap<QDateTime, QString>::iterator it= m_filesCache.begin();
-        while ( it != m_filesCache.end() &&
+        const QVector<FileStorageIndex::Entry> entries = m_index->leastRecentlyUsed( maxFilesDelete + 1 );
+        QVector<FileStorageIndex::Entry> deleted;
+        QSet<QString> deletedCaches;
+        QVector<FileStorageIndex::Entry>::const_iterator it = entries.constBegin();
+        while ( it != entries.constEnd() &&
                 keepDeleting() ) {
-            QString filePath = it.value();
-            QFileInfo info( filePath );
-
+            if ( deletedCaches.contains( it->fileName ) ) {
+                ++it;
+                continue;
+            }
             m_filesDeleted++;
-            m_currentCacheSize -= info.size();
-            it = m_filesCache.erase(it);
-            QFile::remove( filePath );
+            m_currentCacheSize -= qMin<quint64>( m_currentCacheSize, qMax<qint64>( 0, it->size ) );
+            removeTile( it->fileName );
+            deleted << *it;
+
+            // The binary cache of a vector tile is useless without the tile
+            const QString cacheFileName = VectorTileCache::cacheFileName( it->fileName );
+            const QFileInfo cacheInfo( m_dataDirectory + QLatin1Char('/') + cacheFileName );
+            const qint64 cacheSize = cacheInfo.exists() ? cacheInfo.size() : 0;
+            if ( cacheInfo.exists() && QFile::remove( cacheInfo.absoluteFilePath() ) ) {
+                m_currentCacheSize -= qMin<quint64>( m_currentCacheSize, cacheSize );
+                FileStorageIndex::Entry entry;
+                entry.fileName = cacheFileName;
+                entry.size = cacheSize;
+                deleted << entry;
+                deletedCaches.insert( cacheFileName );
+            }
+            ++it;
         }
+        m_index->remove( deleted );
 
         // We have deleted enough files.
         // Perhaps there are changes.
@@ -171,6 +191,31 @@ void FileStorageWatcherThread::ensureCacheSize()
     }
 }
 
+void FileStorageWatcherThread::removeTile( const QString &fileName )
+{
+    const QString filePath = m_dataDirectory + QLatin1Char('/') + fileName;
+    if ( QFile::remove( filePath ) ) {
+        return;
+    }
+
+    // Not a file, so it is in the tile pack of its theme. Only images
+    // are stored in tile packs.
+    const QString suffix = QFileInfo( fileName ).suffix().toLower();
+    if ( suffix == QLatin1String( "o5m" ) || suffix == QLatin1String( "mvtc" ) ) {
+        return;
+    }
+
+    QString themePath;
+    int zoomLevel, column, row;
+    if ( MbTileStorage::parseTileFileName( fileName, themePath, zoomLevel, column, row ) ) {
+        const QString packFileName = m_dataDirectory + QLatin1Char('/') + MbTileStorage::packFileName( themePath );
+        MbTileStorage *const storage = MbTileStorage::storage( packFileName );
+        if ( storage ) {
+            storage->removeTile( zoomLevel, column, row );
+        }
+    }
+}
+
 bool FileStorageWatcherThread::keepDeleting() const
 {
     return ( ( m_currentCacheSize > m_cacheSoftLimit ) &&
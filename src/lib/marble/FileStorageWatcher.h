@@ -13,11 +13,11 @@
 
 #include <QThread>
 #include <QMutex>
-#include <QMultiMap>
-#include <QDateTime>
 
 namespace Marble
 {
+
+class FileStorageIndex;
     
 // Lives inside the new Thread
 class FileStorageWatcherThread : public QObject
@@ -73,13 +73,18 @@ class FileStorageWatcherThread : public QObject
     private:
 	Q_DISABLE_COPY( FileStorageWatcherThread )
 	
+	/**
+	 * Deletes the tile @p fileName, which is stored either as file or in a tile pack.
+	 */
+	void removeTile( const QString &fileName );
+
 	/**
 	 * Returns true if it is necessary to delete files.
 	 */
 	bool keepDeleting() const;
 	
 	QString m_dataDirectory;
-    QMultiMap<QDateTime,QString> m_filesCache;
+	FileStorageIndex *m_index;
     quint64 m_cacheLimit;
 	quint64 m_cacheSoftLimit;
     quint64 m_currentCacheSize;
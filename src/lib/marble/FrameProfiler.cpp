@@ -0,0 +1,412 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "FrameProfiler.h"
+
+#include "MarbleDebug.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThreadStorage>
+
+namespace Marble
+{
+
+class FrameProfilerInstance
+{
+public:
+    FrameProfiler profiler;
+};
+
+Q_GLOBAL_STATIC( FrameProfilerInstance, s_instance )
+
+// The state of a thread, deleted together with the thread
+class FrameProfilerThread
+{
+public:
+    FrameProfilerThread();
+    ~FrameProfilerThread();
+
+    static FrameProfilerThread *current();
+
+    // small sequential id, reused once the thread has exited
+    const int id;
+    // nesting level of the recording scopes
+    int depth;
+    // the frames begun and not ended yet in this thread, innermost last
+    QVector<const void *> frames;
+};
+
+static QThreadStorage<FrameProfilerThread *> s_threads;
+
+class Q_DECL_HIDDEN FrameProfiler::Private
+{
+public:
+    Private();
+
+    int acquireThreadId();
+    void releaseThreadId( int id );
+
+    // the frame recording what happens in thread, requires the mutex
+    Frame *currentFrame( const FrameProfilerThread *thread );
+    void record( const Event &event, const FrameProfilerThread *thread );
+
+    static void saveTrace();
+
+    mutable QMutex m_mutex;
+    QAtomicInt m_enabled;
+    QElapsedTimer m_clock;
+    // where the trace gets written when the application exits
+    QString m_traceFile;
+
+    int m_capacity;
+    // ring buffer, m_next is the position of the oldest frame once it is full
+    QVector<Frame> m_frames;
+    int m_next;
+
+    // the frames in progress by map, m_openFrames in the order they began
+    QHash<const void *, Frame> m_current;
+    QVector<const void *> m_openFrames;
+    qint64 m_frameCount;
+
+    int m_threadCount;
+    QVector<int> m_freeThreadIds;
+};
+
+FrameProfilerThread::FrameProfilerThread() :
+    id( FrameProfiler::instance()->d->acquireThreadId() ),
+    depth( 0 )
+{
+}
+
+FrameProfilerThread::~FrameProfilerThread()
+{
+    if ( !s_instance.isDestroyed() ) {
+        FrameProfiler::instance()->d->releaseThreadId( id );
+    }
+}
+
+FrameProfilerThread *FrameProfilerThread::current()
+{
+    if ( !s_threads.hasLocalData() ) {
+        s_threads.setLocalData( new FrameProfilerThread );
+    }
+    return s_threads.localData();
+}
+
+FrameProfiler::Private::Private() :
+    m_enabled( 0 ),
+    m_traceFile( QString::fromLocal8Bit( qgetenv( "MARBLE_FRAME_PROFILE" ) ) ),
+    m_capacity( 120 ),
+    m_next( 0 ),
+    m_frameCount( 0 ),
+    m_threadCount( 0 )
+{
+    m_clock.start();
+    if ( !m_traceFile.isEmpty() ) {
+        m_enabled.store( 1 );
+        qAddPostRoutine( saveTrace );
+    }
+}
+
+int FrameProfiler::Private::acquireThreadId()
+{
+    QMutexLocker locker( &m_mutex );
+    if ( !m_freeThreadIds.isEmpty() ) {
+        return m_freeThreadIds.takeLast();
+    }
+    return ++m_threadCount;
+}
+
+void FrameProfiler::Private::releaseThreadId( int id )
+{
+    QMutexLocker locker( &m_mutex );
+    m_freeThreadIds << id;
+}
+
+FrameProfiler::Frame *FrameProfiler::Private::currentFrame( const FrameProfilerThread *thread )
+{
+    // Threads without a frame of their own, like the tile loaders, report
+    // to the frame begun last
+    const void *map = 0;
+    if ( !thread->frames.isEmpty() ) {
+        map = thread->frames.last();
+    } else if ( !m_openFrames.isEmpty() ) {
+        map = m_openFrames.last();
+    } else {
+        return 0;
+    }
+
+    auto iter = m_current.find( map );
+    return iter != m_current.end() ? &iter.value() : 0;
+}
+
+void FrameProfiler::Private::record( const Event &event, const FrameProfilerThread *thread )
+{
+    QMutexLocker locker( &m_mutex );
+    Frame *const frame = currentFrame( thread );
+    if ( !frame ) {
+        return;
+    }
+
+    frame->events << event;
+    frame->events.last().thread = thread->id;
+}
+
+void FrameProfiler::Private::saveTrace()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+    profiler->saveChromeTrace( profiler->d->m_traceFile );
+}
+
+FrameProfiler::Scope::Scope( const char *name ) :
+    m_literal( name ),
+    m_depth( 0 )
+{
+    enter();
+}
+
+FrameProfiler::Scope::Scope( const QString &name ) :
+    m_literal( 0 ),
+    m_name( name ),
+    m_depth( 0 )
+{
+    enter();
+}
+
+void FrameProfiler::Scope::enter()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+    m_recording = profiler->isEnabled();
+    if ( m_recording ) {
+        m_depth = FrameProfilerThread::current()->depth++;
+    }
+    m_start = profiler->timestamp();
+}
+
+FrameProfiler::Scope::~Scope()
+{
+    if ( !m_recording ) {
+        return;
+    }
+
+    FrameProfiler *const profiler = FrameProfiler::instance();
+    const qint64 end = profiler->timestamp();
+    FrameProfilerThread *const thread = FrameProfilerThread::current();
+    --thread->depth;
+
+    Event event;
+    event.name = m_literal ? QString::fromLatin1( m_literal ) : m_name;
+    event.start = m_start;
+    event.duration = end - m_start;
+    event.depth = m_depth;
+    event.thread = 0;
+    profiler->d->record( event, thread );
+}
+
+qint64 FrameProfiler::Scope::elapsed() const
+{
+    return FrameProfiler::instance()->timestamp() - m_start;
+}
+
+FrameProfiler::FrameProfiler() :
+    d( new Private )
+{
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    delete d;
+}
+
+FrameProfiler *FrameProfiler::instance()
+{
+    return &s_instance->profiler;
+}
+
+bool FrameProfiler::isEnabled() const
+{
+    return d->m_enabled.load();
+}
+
+void FrameProfiler::setEnabled( bool enabled )
+{
+    QMutexLocker locker( &d->m_mutex );
+    d->m_enabled.store( enabled ? 1 : 0 );
+    if ( !enabled ) {
+        d->m_current.clear();
+        d->m_openFrames.clear();
+    }
+}
+
+int FrameProfiler::capacity() const
+{
+    QMutexLocker locker( &d->m_mutex );
+    return d->m_capacity;
+}
+
+void FrameProfiler::setCapacity( int frames )
+{
+    const QVector<Frame> recorded = this->frames();
+
+    QMutexLocker locker( &d->m_mutex );
+    d->m_capacity = qMax( 1, frames );
+    d->m_frames = recorded.mid( qMax( 0, recorded.size() - d->m_capacity ) );
+    d->m_next = d->m_frames.size() % d->m_capacity;
+}
+
+void FrameProfiler::beginFrame( const void *map )
+{
+    if ( !isEnabled() ) {
+        return;
+    }
+
+    FrameProfilerThread *const thread = FrameProfilerThread::current();
+    thread->frames.removeAll( map );
+    thread->frames << map;
+
+    QMutexLocker locker( &d->m_mutex );
+    Frame &frame = d->m_current[map];
+    frame = Frame();
+    frame.number = d->m_frameCount++;
+    frame.start = timestamp();
+    frame.duration = 0;
+    frame.thread = thread->id;
+    d->m_openFrames.removeAll( map );
+    d->m_openFrames << map;
+}
+
+void FrameProfiler::endFrame( const void *map )
+{
+    if ( !isEnabled() ) {
+        return;
+    }
+
+    FrameProfilerThread::current()->frames.removeAll( map );
+
+    QMutexLocker locker( &d->m_mutex );
+    if ( !d->m_current.contains( map ) ) {
+        return;
+    }
+
+    Frame frame = d->m_current.take( map );
+    d->m_openFrames.removeAll( map );
+    frame.duration = timestamp() - frame.start;
+
+    if ( d->m_frames.size() < d->m_capacity ) {
+        d->m_frames << frame;
+    } else {
+        d->m_frames[d->m_next] = frame;
+    }
+    d->m_next = ( d->m_next + 1 ) % d->m_capacity;
+}
+
+void FrameProfiler::addCounter( const char *name, qint64 value )
+{
+    if ( !isEnabled() ) {
+        return;
+    }
+
+    const FrameProfilerThread *const thread = FrameProfilerThread::current();
+
+    QMutexLocker locker( &d->m_mutex );
+    Frame *const frame = d->currentFrame( thread );
+    if ( frame ) {
+        frame->counters[QString::fromLatin1( name )] += value;
+    }
+}
+
+QVector<FrameProfiler::Frame> FrameProfiler::frames() const
+{
+    QMutexLocker locker( &d->m_mutex );
+    if ( d->m_frames.size() < d->m_capacity ) {
+        return d->m_frames;
+    }
+
+    return d->m_frames.mid( d->m_next ) + d->m_frames.mid( 0, d->m_next );
+}
+
+void FrameProfiler::clear()
+{
+    QMutexLocker locker( &d->m_mutex );
+    d->m_frames.clear();
+    d->m_next = 0;
+}
+
+QByteArray FrameProfiler::chromeTrace() const
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    // the trace event format measures time in microseconds
+    QJsonArray traceEvents;
+    foreach ( const Frame &frame, frames() ) {
+        QJsonObject frameEvent;
+        frameEvent["name"] = QString( "Frame %1" ).arg( frame.number );
+        frameEvent["cat"] = QString( "frame" );
+        frameEvent["ph"] = QString( "X" );
+        frameEvent["ts"] = frame.start / 1000.0;
+        frameEvent["dur"] = frame.duration / 1000.0;
+        frameEvent["pid"] = pid;
+        frameEvent["tid"] = frame.thread;
+        traceEvents.append( frameEvent );
+
+        foreach ( const Event &event, frame.events ) {
+            QJsonObject scopeEvent;
+            scopeEvent["name"] = event.name;
+            scopeEvent["cat"] = QString( "scope" );
+            scopeEvent["ph"] = QString( "X" );
+            scopeEvent["ts"] = event.start / 1000.0;
+            scopeEvent["dur"] = event.duration / 1000.0;
+            scopeEvent["pid"] = pid;
+            scopeEvent["tid"] = event.thread;
+            traceEvents.append( scopeEvent );
+        }
+
+        for ( auto iter = frame.counters.constBegin(); iter != frame.counters.constEnd(); ++iter ) {
+            QJsonObject args;
+            args["value"] = iter.value();
+            QJsonObject counterEvent;
+            counterEvent["name"] = iter.key();
+            counterEvent["ph"] = QString( "C" );
+            counterEvent["ts"] = frame.start / 1000.0;
+            counterEvent["pid"] = pid;
+            counterEvent["args"] = args;
+            traceEvents.append( counterEvent );
+        }
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = traceEvents;
+    trace["displayTimeUnit"] = QString( "ns" );
+    return QJsonDocument( trace ).toJson( QJsonDocument::Compact );
+}
+
+bool FrameProfiler::saveChromeTrace( const QString &fileName ) const
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::WriteOnly ) ) {
+        mDebug() << "Unable to write trace file" << fileName;
+        return false;
+    }
+
+    const QByteArray trace = chromeTrace();
+    return file.write( trace ) == trace.size();
+}
+
+qint64 FrameProfiler::timestamp() const
+{
+    return d->m_clock.nsecsElapsed();
+}
+
+}
@@ -0,0 +1,162 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_FRAMEPROFILER_H
+#define MARBLE_FRAMEPROFILER_H
+
+#include "marble_export.h"
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class QByteArray;
+
+namespace Marble
+{
+
+/**
+ * @short Collects timings and counters of the most recently rendered frames.
+ *
+ * LayerManager delimits the frames and measures every layer and render
+ * plugin. Layers can add nested timings with Scope and per-frame counters
+ * with addCounter(). The last capacity() frames are kept in a ring buffer
+ * and can be exported in the Chrome trace event format, which can be
+ * viewed in chrome://tracing.
+ *
+ * The profiler is disabled by default. While disabled, a Scope only
+ * measures its own duration and addCounter() does nothing. It gets enabled
+ * by MarbleMap::setFrameProfilingEnabled() or by setting the environment
+ * variable MARBLE_FRAME_PROFILE to the name of a file, which receives the
+ * Chrome trace when the application exits.
+ *
+ * Every map has a frame of its own. Timings and counters go to the frame
+ * begun last in the same thread, or to the frame begun last at all for
+ * threads which do not render, as long as they end before the frame does.
+ *
+ * All methods are thread-safe.
+ */
+class MARBLE_EXPORT FrameProfiler
+{
+public:
+    struct Event
+    {
+        QString name;
+        /// nanoseconds since the profiler was created
+        qint64 start;
+        /// in nanoseconds
+        qint64 duration;
+        /// nesting level within the thread, 0 for the outermost scope
+        int depth;
+        /// small sequential id of the thread the scope ended in, ids of
+        /// threads which have exited get reused
+        int thread;
+    };
+
+    struct Frame
+    {
+        qint64 number;
+        /// nanoseconds since the profiler was created
+        qint64 start;
+        /// in nanoseconds
+        qint64 duration;
+        int thread;
+        QVector<Event> events;
+        QHash<QString, qint64> counters;
+    };
+
+    /**
+     * @short Measures the time until it gets destroyed.
+     *
+     * Usage:
+     * @code
+     * FrameProfiler::Scope scope( "GeometryLayer: paint" );
+     * @endcode
+     */
+    class MARBLE_EXPORT Scope
+    {
+    public:
+        explicit Scope( const char *name );
+        explicit Scope( const QString &name );
+        ~Scope();
+
+        /**
+         * Returns the nanoseconds since the scope has been entered.
+         */
+        qint64 elapsed() const;
+
+    private:
+        Q_DISABLE_COPY( Scope )
+        void enter();
+
+        const char *const m_literal;
+        QString m_name;
+        qint64 m_start;
+        int m_depth;
+        bool m_recording;
+    };
+
+    static FrameProfiler *instance();
+
+    bool isEnabled() const;
+    void setEnabled( bool enabled );
+
+    /**
+     * Returns the number of frames kept, 120 by default.
+     */
+    int capacity() const;
+    void setCapacity( int frames );
+
+    /**
+     * Begins a frame of @p map, e.g. the LayerManager rendering it.
+     */
+    void beginFrame( const void *map = 0 );
+
+    /**
+     * Ends the frame of @p map and adds it to the recorded frames.
+     */
+    void endFrame( const void *map = 0 );
+
+    /**
+     * Adds @p value to the counter @p name of the current frame.
+     */
+    void addCounter( const char *name, qint64 value = 1 );
+
+    /**
+     * Returns the recorded frames, oldest first.
+     */
+    QVector<Frame> frames() const;
+
+    void clear();
+
+    /**
+     * Returns the recorded frames as JSON in the Chrome trace event format.
+     */
+    QByteArray chromeTrace() const;
+
+    bool saveChromeTrace( const QString &fileName ) const;
+
+    /**
+     * Returns the nanoseconds since the profiler was created.
+     */
+    qint64 timestamp() const;
+
+private:
+    FrameProfiler();
+    ~FrameProfiler();
+    Q_DISABLE_COPY( FrameProfiler )
+
+    friend class FrameProfilerInstance;
+    friend class FrameProfilerThread;
+    class Private;
+    Private *const d;
+};
+
+}
+
+#endif
@@ -36,7 +36,7 @@ using namespace Marble;
 class GenericScanlineTextureMapper::RenderJob : public QRunnable
 {
 public:
-    RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, int yTop, int yBottom );
+    RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, ScanlineJobQueue *jobQueue );
 
     virtual void run();
 
@@ -46,18 +46,16 @@ private:
     QImage *const m_canvasImage;
     const ViewportParams *const m_viewport;
     const MapQuality m_mapQuality;
-    const int m_yTop;
-    const int m_yBottom;
+    ScanlineJobQueue *const m_jobQueue;
 };
 
-GenericScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, int yTop, int yBottom )
+GenericScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, ScanlineJobQueue *jobQueue )
     : m_tileLoader( tileLoader ),
       m_tileLevel( tileLevel ),
       m_canvasImage( canvasImage ),
       m_viewport( viewport ),
       m_mapQuality( mapQuality ),
-      m_yTop( yTop ),
-      m_yBottom( yBottom )
+      m_jobQueue( jobQueue )
 {
 }
 
@@ -95,7 +93,7 @@ void GenericScanlineTextureMapper::mapTexture( GeoPainter *painter,
         mapTexture( viewport, tileZoomLevel, painter->mapQuality() );
 
         if ( texColorizer ) {
-            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality() );
+            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality(), &m_threadPool );
         }
 
         m_repaintNeeded = false;
@@ -126,11 +124,9 @@ void GenericScanlineTextureMapper::mapTexture( const ViewportParams *viewport, i
                                       : yTop + radius + radius - skip;
 
     const int numThreads = m_threadPool.maxThreadCount();
-    const int yStep = qCeil(qreal( yBottom - yTop ) / qreal(numThreads));
+    ScanlineJobQueue jobQueue( yTop, yBottom, numThreads );
     for ( int i = 0; i < numThreads; ++i ) {
-        const int yStart = yTop +  i      * yStep;
-        const int yEnd   = qMin(yBottom, yTop + (i + 1) * yStep);
-        QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality, yStart, yEnd );
+        QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality, &jobQueue );
         m_threadPool.start( job );
     }
 
@@ -166,108 +162,115 @@ void GenericScanlineTextureMapper::RenderJob::run()
     qreal clipRadius = radius * m_viewport->currentProjection()->clippingRadius();
 
 
-    // Paint the map.
-    for ( int y = m_yTop; y < m_yBottom; ++y ) {
+    // Keep pulling chunks of scanlines until the canvas is done, reusing
+    // the context (and its current tile) across chunks.
+    int yStart;
+    int yEnd;
+    while ( m_jobQueue->nextChunk( yStart, yEnd ) ) {
+
+        // Paint the map.
+        for ( int y = yStart; y < yEnd; ++y ) {
+
+            // rx is the radius component in x direction
+            const int rx = (int)sqrt( (qreal)( clipRadius * clipRadius
+                                          - ( ( y - imageHeight / 2 )
+                                              * ( y - imageHeight / 2 ) ) ) );
+
+            // Calculate the actual x-range of the map within the current scanline.
+            //
+            // If the circular border of the earth disk is still visible then xLeft
+            // equals the scanline position of the most left pixel that gets covered
+            // by the earth disk. In terms of math this equals the half image width minus
+            // the radius component on the current scanline in x direction ("rx").
+            //
+            // If the zoom factor is high enough then the whole screen gets covered
+            // by the earth and the border of the earth disk isn't visible anymore.
+            // In that situation xLeft equals zero.
+            // For xRight the situation is similar.
+
+            const int xLeft  = ( imageWidth / 2 - rx > 0 ) ? imageWidth / 2 - rx
+                                                           : 0;
+            const int xRight = ( imageWidth / 2 - rx > 0 ) ? xLeft + rx + rx
+                                                           : imageWidth;
+
+            QRgb * scanLine = (QRgb*)( m_canvasImage->scanLine( y ) ) + xLeft;
+
+            const int xIpLeft  = ( imageWidth / 2 - rx > 0 ) ? n * (int)( xLeft / n + 1 )
+                                                             : 1;
+            const int xIpRight = ( imageWidth / 2 - rx > 0 ) ? n * (int)( xRight / n - 1 )
+                                                             : n * (int)( xRight / n - 1 ) + 1;
+
+            // Decrease pole distortion due to linear approximation ( y-axis )
+            bool crossingPoleArea = false;
+            if ( !globeHidesNorthPole
+                 && northPoleY - ( n * 0.75 ) <= y
+                 && northPoleY + ( n * 0.75 ) >= y )
+            {
+                crossingPoleArea = true;
+            }
 
-        // rx is the radius component in x direction
-        const int rx = (int)sqrt( (qreal)( clipRadius * clipRadius
-                                      - ( ( y - imageHeight / 2 )
-                                          * ( y - imageHeight / 2 ) ) ) );
+            int ncount = 0;
 
-        // Calculate the actual x-range of the map within the current scanline.
-        //
-        // If the circular border of the earth disk is still visible then xLeft
-        // equals the scanline position of the most left pixel that gets covered
-        // by the earth disk. In terms of math this equals the half image width minus
-        // the radius component on the current scanline in x direction ("rx").
-        //
-        // If the zoom factor is high enough then the whole screen gets covered
-        // by the earth and the border of the earth disk isn't visible anymore.
-        // In that situation xLeft equals zero.
-        // For xRight the situation is similar.
 
-        const int xLeft  = ( imageWidth / 2 - rx > 0 ) ? imageWidth / 2 - rx
-                                                       : 0;
-        const int xRight = ( imageWidth / 2 - rx > 0 ) ? xLeft + rx + rx
-                                                       : imageWidth;
-
-        QRgb * scanLine = (QRgb*)( m_canvasImage->scanLine( y ) ) + xLeft;
-
-        const int xIpLeft  = ( imageWidth / 2 - rx > 0 ) ? n * (int)( xLeft / n + 1 )
-                                                         : 1;
-        const int xIpRight = ( imageWidth / 2 - rx > 0 ) ? n * (int)( xRight / n - 1 )
-                                                         : n * (int)( xRight / n - 1 ) + 1;
-
-        // Decrease pole distortion due to linear approximation ( y-axis )
-        bool crossingPoleArea = false;
-        if ( !globeHidesNorthPole
-             && northPoleY - ( n * 0.75 ) <= y
-             && northPoleY + ( n * 0.75 ) >= y )
-        {
-            crossingPoleArea = true;
-        }
+            for ( int x = xLeft; x < xRight; ++x ) {
 
-        int ncount = 0;
+                // Prepare for interpolation
+                const int leftInterval = xIpLeft + ncount * n;
 
+                bool interpolate = false;
 
-        for ( int x = xLeft; x < xRight; ++x ) {
+                if ( x >= xIpLeft && x <= xIpRight ) {
 
-            // Prepare for interpolation
-            const int leftInterval = xIpLeft + ncount * n;
+                    // Decrease pole distortion due to linear approximation ( x-axis )
+                    if ( crossingPoleArea
+                         && northPoleX >= leftInterval + n
+                         && northPoleX < leftInterval + 2 * n
+                         && x < leftInterval + 3 * n )
+                    {
+                        interpolate = false;
+                    }
+                    else {
+                        x += n - 1;
+                        interpolate = !printQuality;
+                        ++ncount;
+                    }
+                }
+                else
+                    interpolate = false;
 
-            bool interpolate = false;
+                qreal lon;
+                qreal lat;
+                m_viewport->geoCoordinates(x,y, lon, lat, GeoDataCoordinates::Radian);
 
-            if ( x >= xIpLeft && x <= xIpRight ) {
+                if ( interpolate ) {
+                    if ( highQuality )
+                        context.pixelValueApproxF( lon, lat, scanLine, n );
+                    else
+                        context.pixelValueApprox( lon, lat, scanLine, n );
 
-                // Decrease pole distortion due to linear approximation ( x-axis )
-                if ( crossingPoleArea
-                     && northPoleX >= leftInterval + n
-                     && northPoleX < leftInterval + 2 * n
-                     && x < leftInterval + 3 * n )
-                {
-                    interpolate = false;
+                    scanLine += ( n - 1 );
                 }
-                else {
-                    x += n - 1;
-                    interpolate = !printQuality;
-                    ++ncount;
-                }
-            }
-            else
-                interpolate = false;
 
-            qreal lon;
-            qreal lat;
-            m_viewport->geoCoordinates(x,y, lon, lat, GeoDataCoordinates::Radian);
-
-            if ( interpolate ) {
-                if ( highQuality )
-                    context.pixelValueApproxF( lon, lat, scanLine, n );
-                else
-                    context.pixelValueApprox( lon, lat, scanLine, n );
+                if ( x < imageWidth ) {
+                    if ( highQuality )
+                        context.pixelValueF( lon, lat, scanLine );
+                    else
+                        context.pixelValue( lon, lat, scanLine );
+                }
 
-                scanLine += ( n - 1 );
+                ++scanLine;
             }
 
-            if ( x < imageWidth ) {
-                if ( highQuality )
-                    context.pixelValueF( lon, lat, scanLine );
-                else
-                    context.pixelValue( lon, lat, scanLine );
-            }
+            // copy scanline to improve performance
+            if ( interlaced && y + 1 < yEnd ) {
 
-            ++scanLine;
-        }
-
-        // copy scanline to improve performance
-        if ( interlaced && y + 1 < m_yBottom ) {
+                const int pixelByteSize = m_canvasImage->bytesPerLine() / imageWidth;
 
-            const int pixelByteSize = m_canvasImage->bytesPerLine() / imageWidth;
-
-            memcpy( m_canvasImage->scanLine( y + 1 ) + xLeft * pixelByteSize,
-                    m_canvasImage->scanLine( y     ) + xLeft * pixelByteSize,
-                    ( xRight - xLeft ) * pixelByteSize );
-            ++y;
+                memcpy( m_canvasImage->scanLine( y + 1 ) + xLeft * pixelByteSize,
+                        m_canvasImage->scanLine( y     ) + xLeft * pixelByteSize,
+                        ( xRight - xLeft ) * pixelByteSize );
+                ++y;
+            }
         }
     }
 }
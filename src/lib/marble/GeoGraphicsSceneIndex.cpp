@@ -0,0 +1,568 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "GeoGraphicsSceneIndex.h"
+
+#include "GeoDataLatLonAltBox.h"
+#include "GeoGraphicsItem.h"
+#include "MarbleDebug.h"
+
+#include <QtAlgorithms>
+#include <qmath.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace Marble
+{
+
+// Fan-out of the tree. Nodes that drop below the minimum get dissolved.
+static const int maxEntries = 16;
+static const int minEntries = 6;
+
+bool GeoGraphicsSceneIndex::Rect::intersects( const Rect &other ) const
+{
+    return west <= other.east && other.west <= east
+        && south <= other.north && other.south <= north;
+}
+
+bool GeoGraphicsSceneIndex::Rect::contains( const Rect &other ) const
+{
+    return west <= other.west && other.east <= east
+        && south <= other.south && other.north <= north;
+}
+
+void GeoGraphicsSceneIndex::Rect::unite( const Rect &other )
+{
+    west = qMin( west, other.west );
+    south = qMin( south, other.south );
+    east = qMax( east, other.east );
+    north = qMax( north, other.north );
+}
+
+qreal GeoGraphicsSceneIndex::Rect::area() const
+{
+    return ( east - west ) * ( north - south );
+}
+
+GeoGraphicsSceneIndex::Node::Node() :
+    minZoomLevel( 0 ),
+    parent( 0 ),
+    leaf( true )
+{
+    rect.west = rect.south = rect.east = rect.north = 0;
+}
+
+GeoGraphicsSceneIndex::Node::~Node()
+{
+    qDeleteAll( children );
+}
+
+void GeoGraphicsSceneIndex::Node::updateBounds()
+{
+    minZoomLevel = std::numeric_limits<int>::max();
+    if ( leaf ) {
+        for ( int i = 0; i < entries.size(); ++i ) {
+            if ( i == 0 ) {
+                rect = entries[i].rect;
+            } else {
+                rect.unite( entries[i].rect );
+            }
+            minZoomLevel = qMin( minZoomLevel, entries[i].minZoomLevel );
+        }
+    } else {
+        for ( int i = 0; i < children.size(); ++i ) {
+            if ( i == 0 ) {
+                rect = children[i]->rect;
+            } else {
+                rect.unite( children[i]->rect );
+            }
+            minZoomLevel = qMin( minZoomLevel, children[i]->minZoomLevel );
+        }
+    }
+}
+
+GeoGraphicsSceneIndex::GeoGraphicsSceneIndex() :
+    m_root( 0 ),
+    m_size( 0 )
+{
+}
+
+GeoGraphicsSceneIndex::~GeoGraphicsSceneIndex()
+{
+    delete m_root;
+}
+
+int GeoGraphicsSceneIndex::split( const GeoDataLatLonBox &box, Rect *rects )
+{
+    Rect rect;
+    box.boundaries( rect.north, rect.south, rect.east, rect.west );
+    return split( rect, rects );
+}
+
+int GeoGraphicsSceneIndex::split( const Rect &box, Rect *rects )
+{
+    if ( box.west <= box.east ) {
+        rects[0] = box;
+        return 1;
+    }
+
+    // Boxes crossing the IDL get split into two separate boxes
+    rects[0] = box;
+    rects[0].east = M_PI;
+    rects[1] = box;
+    rects[1].west = -M_PI;
+    return 2;
+}
+
+bool GeoGraphicsSceneIndex::intersects( const Rect &rect, const Rect *rects, int count )
+{
+    for ( int i = 0; i < count; ++i ) {
+        if ( rect.intersects( rects[i] ) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void GeoGraphicsSceneIndex::insert( GeoGraphicsItem *item )
+{
+    Rect box;
+    item->latLonAltBox().boundaries( box.north, box.south, box.east, box.west );
+    m_boxes.insert( item, box );
+
+    Rect rects[2];
+    const int count = split( box, rects );
+    for ( int i = 0; i < count; ++i ) {
+        Entry entry;
+        entry.rect = rects[i];
+        entry.item = item;
+        entry.minZoomLevel = item->minZoomLevel();
+        entry.secondary = i > 0;
+        entry.primaryWest = box.west;
+        m_pending.append( entry );
+    }
+}
+
+void GeoGraphicsSceneIndex::remove( GeoGraphicsItem *item )
+{
+    QHash<GeoGraphicsItem *, Rect>::iterator box = m_boxes.find( item );
+    if ( box == m_boxes.end() ) {
+        return;
+    }
+
+    Rect rects[2];
+    const int count = split( *box, rects );
+    m_boxes.erase( box );
+
+    flush();
+
+    for ( int i = 0; i < count; ++i ) {
+        Entry entry;
+        entry.rect = rects[i];
+        entry.item = item;
+        Node *leaf = m_root ? findLeaf( m_root, entry ) : 0;
+        if ( !leaf ) {
+            mDebug() << "Item" << item << "is missing in the scene index";
+            continue;
+        }
+
+        for ( int j = 0; j < leaf->entries.size(); ++j ) {
+            if ( leaf->entries[j].item == item && leaf->entries[j].secondary == ( i > 0 ) ) {
+                leaf->entries.remove( j );
+                break;
+            }
+        }
+        --m_size;
+        condenseTree( leaf );
+    }
+}
+
+void GeoGraphicsSceneIndex::clear()
+{
+    delete m_root;
+    m_root = 0;
+    m_size = 0;
+    m_pending.clear();
+    m_boxes.clear();
+}
+
+void GeoGraphicsSceneIndex::items( const GeoDataLatLonBox &box, int zoomLevel, QList<GeoGraphicsItem *> &result )
+{
+    flush();
+
+    if ( !m_root ) {
+        return;
+    }
+
+    Rect rects[2];
+    const int count = split( box, rects );
+    search( m_root, rects, count, zoomLevel, result );
+}
+
+void GeoGraphicsSceneIndex::search( const Node *node, const Rect *rects, int count, int zoomLevel,
+                                    QList<GeoGraphicsItem *> &result ) const
+{
+    if ( node->minZoomLevel > zoomLevel || !intersects( node->rect, rects, count ) ) {
+        return;
+    }
+
+    if ( !node->leaf ) {
+        foreach ( const Node *child, node->children ) {
+            search( child, rects, count, zoomLevel, result );
+        }
+        return;
+    }
+
+    foreach ( const Entry &entry, node->entries ) {
+        if ( entry.minZoomLevel > zoomLevel || !intersects( entry.rect, rects, count ) ) {
+            continue;
+        }
+
+        if ( entry.secondary ) {
+            Rect primary = entry.rect;
+            primary.west = entry.primaryWest;
+            primary.east = M_PI;
+            if ( intersects( primary, rects, count ) ) {
+                continue;
+            }
+        }
+
+        if ( entry.item->visible() ) {
+            result.append( entry.item );
+        }
+    }
+}
+
+void GeoGraphicsSceneIndex::flush()
+{
+    if ( m_pending.isEmpty() ) {
+        return;
+    }
+
+    if ( m_pending.size() > m_size ) {
+        QVector<Entry> entries;
+        entries.reserve( m_size + m_pending.size() );
+        if ( m_root ) {
+            collectEntries( m_root, entries );
+        }
+        entries += m_pending;
+        bulkLoad( entries );
+    } else {
+        foreach ( const Entry &entry, m_pending ) {
+            insertEntry( entry );
+        }
+    }
+
+    m_pending.clear();
+}
+
+template <class T>
+void GeoGraphicsSceneIndex::sortTileRecursive( QVector<T> &items )
+{
+    // Sort by x, then cut into vertical slices of about sqrt( nodes ) nodes
+    // each and sort these by y. Consecutive runs of maxEntries items then
+    // make up nodes that hardly overlap.
+    const int nodeCount = ( items.size() + maxEntries - 1 ) / maxEntries;
+    const int sliceCount = qCeil( qSqrt( nodeCount ) );
+    const int sliceSize = sliceCount * maxEntries;
+
+    std::sort( items.begin(), items.end(), []( const T &a, const T &b ) {
+        return rectOf( a ).centerX() < rectOf( b ).centerX();
+    } );
+
+    for ( int begin = 0; begin < items.size(); begin += sliceSize ) {
+        const int end = qMin( begin + sliceSize, items.size() );
+        std::sort( items.begin() + begin, items.begin() + end, []( const T &a, const T &b ) {
+            return rectOf( a ).centerY() < rectOf( b ).centerY();
+        } );
+    }
+}
+
+void GeoGraphicsSceneIndex::bulkLoad( QVector<Entry> &entries )
+{
+    delete m_root;
+    m_root = 0;
+    m_size = entries.size();
+
+    if ( entries.isEmpty() ) {
+        return;
+    }
+
+    sortTileRecursive( entries );
+
+    QVector<Node *> level;
+    for ( int begin = 0; begin < entries.size(); begin += maxEntries ) {
+        Node *leaf = new Node;
+        leaf->entries = entries.mid( begin, maxEntries );
+        leaf->updateBounds();
+        level.append( leaf );
+    }
+
+    while ( level.size() > 1 ) {
+        sortTileRecursive( level );
+
+        QVector<Node *> parents;
+        for ( int begin = 0; begin < level.size(); begin += maxEntries ) {
+            Node *parent = new Node;
+            parent->leaf = false;
+            parent->children = level.mid( begin, maxEntries );
+            foreach ( Node *child, parent->children ) {
+                child->parent = parent;
+            }
+            parent->updateBounds();
+            parents.append( parent );
+        }
+        level = parents;
+    }
+
+    m_root = level.first();
+}
+
+void GeoGraphicsSceneIndex::insertEntry( const Entry &entry )
+{
+    if ( !m_root ) {
+        m_root = new Node;
+    }
+
+    Node *leaf = chooseLeaf( entry.rect );
+    leaf->entries.append( entry );
+    ++m_size;
+
+    Node *sibling = 0;
+    if ( leaf->entries.size() > maxEntries ) {
+        sibling = new Node;
+        splitGroup( leaf->entries, sibling->entries );
+        sibling->updateBounds();
+    }
+
+    leaf->updateBounds();
+    adjustTree( leaf, sibling );
+}
+
+GeoGraphicsSceneIndex::Node *GeoGraphicsSceneIndex::chooseLeaf( const Rect &rect ) const
+{
+    Node *node = m_root;
+    while ( !node->leaf ) {
+        // Descend into the child that needs the least enlargement
+        Node *best = 0;
+        qreal bestEnlargement = 0;
+        qreal bestArea = 0;
+        foreach ( Node *child, node->children ) {
+            Rect united = child->rect;
+            united.unite( rect );
+            const qreal area = child->rect.area();
+            const qreal enlargement = united.area() - area;
+            if ( !best || enlargement < bestEnlargement
+                 || ( enlargement == bestEnlargement && area < bestArea ) ) {
+                best = child;
+                bestEnlargement = enlargement;
+                bestArea = area;
+            }
+        }
+        node = best;
+    }
+
+    return node;
+}
+
+void GeoGraphicsSceneIndex::adjustTree( Node *node, Node *sibling )
+{
+    while ( node != m_root ) {
+        Node *parent = node->parent;
+        if ( sibling ) {
+            sibling->parent = parent;
+            parent->children.append( sibling );
+            sibling = 0;
+
+            if ( parent->children.size() > maxEntries ) {
+                sibling = new Node;
+                sibling->leaf = false;
+                splitGroup( parent->children, sibling->children );
+                foreach ( Node *child, sibling->children ) {
+                    child->parent = sibling;
+                }
+                sibling->updateBounds();
+            }
+        }
+
+        parent->updateBounds();
+        node = parent;
+    }
+
+    if ( sibling ) {
+        // The root got split, so the tree grows by one level
+        Node *root = new Node;
+        root->leaf = false;
+        root->children << m_root << sibling;
+        m_root->parent = root;
+        sibling->parent = root;
+        root->updateBounds();
+        m_root = root;
+    }
+}
+
+template <class T>
+void GeoGraphicsSceneIndex::splitGroup( QVector<T> &items, QVector<T> &splitOff )
+{
+    // Quadratic split: start with the two items that would waste the
+    // most area if they were in the same group ...
+    int seedA = 0;
+    int seedB = 1;
+    qreal worstWaste = -1;
+    for ( int i = 0; i < items.size(); ++i ) {
+        for ( int j = i + 1; j < items.size(); ++j ) {
+            Rect united = rectOf( items[i] );
+            united.unite( rectOf( items[j] ) );
+            const qreal waste = united.area() - rectOf( items[i] ).area() - rectOf( items[j] ).area();
+            if ( waste > worstWaste ) {
+                worstWaste = waste;
+                seedA = i;
+                seedB = j;
+            }
+        }
+    }
+
+    QVector<T> remaining = items;
+    QVector<T> groupA;
+    QVector<T> &groupB = splitOff;
+    groupA << remaining[seedA];
+    groupB << remaining[seedB];
+    Rect rectA = rectOf( remaining[seedA] );
+    Rect rectB = rectOf( remaining[seedB] );
+    remaining.remove( seedB );
+    remaining.remove( seedA );
+
+    // ... and then assign the item with the biggest preference for one of
+    // the groups until all are assigned or one group needs the rest.
+    while ( !remaining.isEmpty() ) {
+        if ( groupA.size() + remaining.size() == minEntries ) {
+            foreach ( const T &item, remaining ) {
+                groupA << item;
+            }
+            break;
+        }
+        if ( groupB.size() + remaining.size() == minEntries ) {
+            foreach ( const T &item, remaining ) {
+                groupB << item;
+            }
+            break;
+        }
+
+        int next = 0;
+        qreal maxPreference = -1;
+        qreal nextEnlargementA = 0;
+        qreal nextEnlargementB = 0;
+        for ( int i = 0; i < remaining.size(); ++i ) {
+            Rect unitedA = rectA;
+            unitedA.unite( rectOf( remaining[i] ) );
+            Rect unitedB = rectB;
+            unitedB.unite( rectOf( remaining[i] ) );
+            const qreal enlargementA = unitedA.area() - rectA.area();
+            const qreal enlargementB = unitedB.area() - rectB.area();
+            const qreal preference = qAbs( enlargementA - enlargementB );
+            if ( preference > maxPreference ) {
+                maxPreference = preference;
+                next = i;
+                nextEnlargementA = enlargementA;
+                nextEnlargementB = enlargementB;
+            }
+        }
+
+        const bool toA = nextEnlargementA < nextEnlargementB
+                         || ( nextEnlargementA == nextEnlargementB
+                              && ( rectA.area() < rectB.area()
+                                   || ( rectA.area() == rectB.area() && groupA.size() <= groupB.size() ) ) );
+        if ( toA ) {
+            groupA << remaining[next];
+            rectA.unite( rectOf( remaining[next] ) );
+        } else {
+            groupB << remaining[next];
+            rectB.unite( rectOf( remaining[next] ) );
+        }
+        remaining.remove( next );
+    }
+
+    items = groupA;
+}
+
+GeoGraphicsSceneIndex::Node *GeoGraphicsSceneIndex::findLeaf( Node *node, const Entry &entry ) const
+{
+    if ( !node->rect.contains( entry.rect ) ) {
+        return 0;
+    }
+
+    if ( node->leaf ) {
+        foreach ( const Entry &candidate, node->entries ) {
+            if ( candidate.item == entry.item && candidate.rect.contains( entry.rect ) ) {
+                return node;
+            }
+        }
+        return 0;
+    }
+
+    foreach ( Node *child, node->children ) {
+        Node *leaf = findLeaf( child, entry );
+        if ( leaf ) {
+            return leaf;
+        }
+    }
+
+    return 0;
+}
+
+void GeoGraphicsSceneIndex::condenseTree( Node *leaf )
+{
+    // Dissolve nodes that became too small and insert their entries again
+    QVector<Entry> orphans;
+    Node *node = leaf;
+    while ( node != m_root ) {
+        Node *parent = node->parent;
+        if ( node->size() < minEntries ) {
+            parent->children.remove( parent->children.indexOf( node ) );
+            collectEntries( node, orphans );
+            delete node;
+        } else {
+            node->updateBounds();
+        }
+        node = parent;
+    }
+    m_root->updateBounds();
+
+    while ( !m_root->leaf && m_root->children.size() == 1 ) {
+        Node *root = m_root->children.first();
+        m_root->children.clear();
+        delete m_root;
+        m_root = root;
+        m_root->parent = 0;
+    }
+
+    if ( !m_root->leaf && m_root->children.isEmpty() ) {
+        m_root->leaf = true;
+    }
+
+    m_size -= orphans.size();
+    foreach ( const Entry &entry, orphans ) {
+        insertEntry( entry );
+    }
+}
+
+void GeoGraphicsSceneIndex::collectEntries( const Node *node, QVector<Entry> &entries )
+{
+    if ( node->leaf ) {
+        entries += node->entries;
+        return;
+    }
+
+    foreach ( const Node *child, node->children ) {
+        collectEntries( child, entries );
+    }
+}
+
+}
@@ -0,0 +1,137 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_GEOGRAPHICSSCENEINDEX_H
+#define MARBLE_GEOGRAPHICSSCENEINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+namespace Marble
+{
+
+class GeoDataLatLonBox;
+class GeoGraphicsItem;
+
+/**
+ * @short An R-tree over the bounding boxes of the items of a GeoGraphicsScene.
+ *
+ * Every node knows the smallest minimum zoom level within its subtree, so
+ * that items which are not shown at the requested zoom level get skipped
+ * early. Items that cross the date line are stored as two halves.
+ *
+ * Inserted items are collected until the next query. If there are more of
+ * them than the tree already holds (e.g. after loading a big document), the
+ * whole tree gets rebuilt with Sort-Tile-Recursive bulk loading. Otherwise
+ * they are inserted one by one.
+ */
+class GeoGraphicsSceneIndex
+{
+public:
+    GeoGraphicsSceneIndex();
+    ~GeoGraphicsSceneIndex();
+
+    /**
+     * Adds @p item with its current bounding box and minimum zoom level.
+     */
+    void insert( GeoGraphicsItem *item );
+
+    /**
+     * Removes @p item. The item itself does not get deleted.
+     */
+    void remove( GeoGraphicsItem *item );
+
+    /**
+     * Removes all items without deleting them.
+     */
+    void clear();
+
+    /**
+     * Appends the visible items which intersect @p box and whose minimum
+     * zoom level is not greater than @p zoomLevel to @p result.
+     */
+    void items( const GeoDataLatLonBox &box, int zoomLevel, QList<GeoGraphicsItem *> &result );
+
+private:
+    Q_DISABLE_COPY( GeoGraphicsSceneIndex )
+
+    struct Rect
+    {
+        qreal west;
+        qreal south;
+        qreal east;
+        qreal north;
+
+        bool intersects( const Rect &other ) const;
+        bool contains( const Rect &other ) const;
+        void unite( const Rect &other );
+        qreal area() const;
+        qreal centerX() const { return ( west + east ) / 2; }
+        qreal centerY() const { return ( south + north ) / 2; }
+    };
+
+    struct Entry
+    {
+        Rect rect;
+        GeoGraphicsItem *item;
+        int minZoomLevel;
+        // The second half of an item that crosses the date line. It only
+        // gets reported if the first half, which starts at primaryWest and
+        // ends at the date line, does not intersect the query.
+        bool secondary;
+        qreal primaryWest;
+    };
+
+    struct Node
+    {
+        Node();
+        ~Node();
+
+        Rect rect;
+        int minZoomLevel;
+        Node *parent;
+        bool leaf;
+        QVector<Node *> children;
+        QVector<Entry> entries;
+
+        int size() const { return leaf ? entries.size() : children.size(); }
+        void updateBounds();
+    };
+
+    static int split( const GeoDataLatLonBox &box, Rect *rects );
+    static int split( const Rect &box, Rect *rects );
+    static const Rect &rectOf( const Entry &entry ) { return entry.rect; }
+    static const Rect &rectOf( const Node *node ) { return node->rect; }
+    static bool intersects( const Rect &rect, const Rect *rects, int count );
+
+    template <class T>
+    static void splitGroup( QVector<T> &items, QVector<T> &splitOff );
+    template <class T>
+    static void sortTileRecursive( QVector<T> &items );
+
+    void flush();
+    void bulkLoad( QVector<Entry> &entries );
+    void insertEntry( const Entry &entry );
+    Node *chooseLeaf( const Rect &rect ) const;
+    void adjustTree( Node *node, Node *sibling );
+    Node *findLeaf( Node *node, const Entry &entry ) const;
+    void condenseTree( Node *leaf );
+    static void collectEntries( const Node *node, QVector<Entry> &entries );
+    void search( const Node *node, const Rect *rects, int count, int zoomLevel,
+                 QList<GeoGraphicsItem *> &result ) const;
+
+    Node *m_root;
+    int m_size;
+    QVector<Entry> m_pending;
+    QHash<GeoGraphicsItem *, Rect> m_boxes;
+};
+
+}
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "HttpDownloadManager.h"
 
+#include <QHash>
 #include <QList>
 #include <QMap>
 #include <QTimer>
@@ -19,6 +20,7 @@
 
 #include "DownloadPolicy.h"
 #include "DownloadQueueSet.h"
+#include "GeoDataLatLonBox.h"
 #include "HttpJob.h"
 #include "MarbleDebug.h"
 #include "StoragePolicy.h"
@@ -56,6 +58,14 @@ class Q_DECL_HIDDEN HttpDownloadManager::Private
     QNetworkAccessManager m_networkAccessManager;
     bool m_acceptJobs;
 
+    struct Viewport
+    {
+        GeoDataLatLonBox box;
+        int tileZoomLevel;
+    };
+    // the visible regions by map
+    QHash<const void *, Viewport> m_viewports;
+
 };
 
 HttpDownloadManager::Private::Private(HttpDownloadManager *parent, StoragePolicy *policy )
@@ -133,13 +143,60 @@ void HttpDownloadManager::addDownloadPolicy( const DownloadPolicy& policy )
     if ( d->hasDownloadPolicy( policy ))
         return;
     DownloadQueueSet * const queueSet = new DownloadQueueSet( policy, this );
+    QHash<const void *, Private::Viewport>::const_iterator viewport = d->m_viewports.constBegin();
+    for (; viewport != d->m_viewports.constEnd(); ++viewport ) {
+        queueSet->setViewport( viewport.key(), viewport->box, viewport->tileZoomLevel );
+    }
     d->connectQueueSet( queueSet );
     d->m_queueSets.append( QPair<DownloadPolicyKey, DownloadQueueSet *>
                            ( queueSet->downloadPolicy().key(), queueSet ));
 }
 
+void HttpDownloadManager::setViewport( const void *map, const GeoDataLatLonBox &viewport, int tileZoomLevel )
+{
+    QHash<const void *, Private::Viewport>::const_iterator const current = d->m_viewports.constFind( map );
+    if ( current != d->m_viewports.constEnd() && current->box == viewport && current->tileZoomLevel == tileZoomLevel ) {
+        return;
+    }
+
+    const Private::Viewport entry = { viewport, tileZoomLevel };
+    d->m_viewports.insert( map, entry );
+
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::iterator pos = d->m_queueSets.begin();
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::iterator const end = d->m_queueSets.end();
+    for (; pos != end; ++pos ) {
+        pos->second->setViewport( map, viewport, tileZoomLevel );
+    }
+    foreach ( DownloadQueueSet * const queueSet, d->m_defaultQueueSets ) {
+        queueSet->setViewport( map, viewport, tileZoomLevel );
+    }
+}
+
+void HttpDownloadManager::removeViewport( const void *map )
+{
+    if ( !d->m_viewports.remove( map ) ) {
+        return;
+    }
+
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::iterator pos = d->m_queueSets.begin();
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::iterator const end = d->m_queueSets.end();
+    for (; pos != end; ++pos ) {
+        pos->second->removeViewport( map );
+    }
+    foreach ( DownloadQueueSet * const queueSet, d->m_defaultQueueSets ) {
+        queueSet->removeViewport( map );
+    }
+}
+
 void HttpDownloadManager::addJob( const QUrl& sourceUrl, const QString& destFileName,
                                   const QString &id, const DownloadUsage usage )
+{
+    addJob( sourceUrl, destFileName, id, usage, GeoDataCoordinates(), -1 );
+}
+
+void HttpDownloadManager::addJob( const QUrl& sourceUrl, const QString& destFileName,
+                                  const QString &id, const DownloadUsage usage,
+                                  const GeoDataCoordinates &tilePosition, int tileZoomLevel )
 {
     if ( !d->m_acceptJobs ) {
         mDebug() << Q_FUNC_INFO << "Working offline, not adding job";
@@ -151,6 +208,9 @@ void HttpDownloadManager::addJob( const QUrl& sourceUrl, const QString& destFile
         HttpJob * const job = new HttpJob( sourceUrl, destFileName, id, &d->m_networkAccessManager );
         job->setUserAgentPluginId( "QNamNetworkPlugin" );
         job->setDownloadUsage( usage );
+        if ( tileZoomLevel >= 0 ) {
+            job->setTilePosition( tilePosition, tileZoomLevel );
+        }
         mDebug() << "adding job " << sourceUrl;
         queueSet->addJob( job );
     }
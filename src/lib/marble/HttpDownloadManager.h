@@ -29,6 +29,8 @@ namespace Marble
 
 class DownloadPolicy;
 class DownloadQueueSet;
+class GeoDataCoordinates;
+class GeoDataLatLonBox;
 class StoragePolicy;
 
 /**
@@ -66,6 +68,19 @@ class MARBLE_EXPORT HttpDownloadManager : public QObject
     void setDownloadEnabled( const bool enable );
     void addDownloadPolicy( const DownloadPolicy& );
 
+    /**
+     * Sets the visible region @p viewport of @p map, which is displayed with
+     * tiles of @p tileZoomLevel. Waiting tile downloads are ordered by their
+     * distance to the center of the closest viewport, and running downloads
+     * of tiles which are out of view of all maps make room for visible ones.
+     */
+    void setViewport( const void *map, const GeoDataLatLonBox &viewport, int tileZoomLevel );
+
+    /**
+     * Removes the viewport of @p map, which no longer shows tiles.
+     */
+    void removeViewport( const void *map );
+
     static QByteArray userAgent(const QString &platform, const QString &plugin);
 
  public Q_SLOTS:
@@ -76,6 +91,13 @@ class MARBLE_EXPORT HttpDownloadManager : public QObject
     void addJob( const QUrl& sourceUrl, const QString& destFilename, const QString &id,
                  const DownloadUsage usage );
 
+    /**
+     * Adds a new job for the tile with the center @p tilePosition and the
+     * zoom level @p tileZoomLevel.
+     */
+    void addJob( const QUrl& sourceUrl, const QString& destFilename, const QString &id,
+                 const DownloadUsage usage, const GeoDataCoordinates &tilePosition, int tileZoomLevel );
+
 
  Q_SIGNALS:
     void downloadComplete( const QString&, const QString& );
@@ -16,6 +16,7 @@
 #include "MarbleDebug.h"
 #include "HttpDownloadManager.h"
 
+#include <QElapsedTimer>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 
@@ -35,6 +36,10 @@ class Marble::HttpJobPrivate
     QString m_userAgent;
     QNetworkAccessManager *const m_networkAccessManager;
     QNetworkReply *m_networkReply;
+    GeoDataCoordinates m_tilePosition;
+    int m_tileZoomLevel;
+    int m_priority;
+    QElapsedTimer m_timer;
 };
 
 HttpJobPrivate::HttpJobPrivate( const QUrl & sourceUrl, const QString & destFileName,
@@ -48,7 +53,9 @@ HttpJobPrivate::HttpJobPrivate( const QUrl & sourceUrl, const QString & destFile
       // results in valid user agent string
       m_userAgent( "unknown" ),
       m_networkAccessManager( networkAccessManager ),
-      m_networkReply( 0 )
+      m_networkReply( 0 ),
+      m_tileZoomLevel( -1 ),
+      m_priority( 0 )
 {
 }
 
@@ -134,8 +141,58 @@ QByteArray HttpJob::userAgent() const
     }
 }
 
+void HttpJob::setTilePosition( const GeoDataCoordinates &position, int zoomLevel )
+{
+    d->m_tilePosition = position;
+    d->m_tileZoomLevel = zoomLevel;
+}
+
+bool HttpJob::hasTilePosition() const
+{
+    return d->m_tileZoomLevel >= 0;
+}
+
+GeoDataCoordinates HttpJob::tilePosition() const
+{
+    return d->m_tilePosition;
+}
+
+int HttpJob::tileZoomLevel() const
+{
+    return d->m_tileZoomLevel;
+}
+
+int HttpJob::priority() const
+{
+    return d->m_priority;
+}
+
+void HttpJob::setPriority( int priority )
+{
+    d->m_priority = priority;
+}
+
+qint64 HttpJob::elapsed() const
+{
+    return d->m_timer.isValid() ? d->m_timer.elapsed() : 0;
+}
+
+void HttpJob::abort()
+{
+    if ( !d->m_networkReply ) {
+        return;
+    }
+
+    d->m_networkReply->disconnect( this );
+    d->m_networkReply->abort();
+    d->m_networkReply->deleteLater();
+    d->m_networkReply = 0;
+    d->m_timer.invalidate();
+}
+
 void HttpJob::execute()
 {
+    d->m_timer.start();
     QNetworkRequest request( d->m_sourceUrl );
     request.setAttribute( QNetworkRequest::HttpPipeliningAllowedAttribute, true );
     request.setRawHeader( "User-Agent", userAgent() );
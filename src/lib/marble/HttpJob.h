@@ -17,6 +17,7 @@
 #include <QObject>
 #include <QNetworkReply>
 
+#include "GeoDataCoordinates.h"
 #include "MarbleGlobal.h"
 
 #include "marble_export.h"
@@ -56,6 +57,31 @@ class MARBLE_EXPORT HttpJob: public QObject
 
     QByteArray userAgent() const;
 
+    /**
+     * Sets the center and the zoom level of the tile the job downloads.
+     * Jobs of tiles close to the center of the viewport are preferred.
+     */
+    void setTilePosition( const GeoDataCoordinates &position, int zoomLevel );
+    bool hasTilePosition() const;
+    GeoDataCoordinates tilePosition() const;
+    int tileZoomLevel() const;
+
+    /**
+     * Jobs with a higher priority are started first.
+     */
+    int priority() const;
+    void setPriority( int priority );
+
+    /**
+     * Returns the milliseconds since the job has been executed.
+     */
+    qint64 elapsed() const;
+
+    /**
+     * Stops the running download. No signal is emitted, the job can be executed again.
+     */
+    void abort();
+
  Q_SIGNALS:
     /**
      * errorCode contains 0, if there was no error and 1 otherwise
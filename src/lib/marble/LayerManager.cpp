@@ -18,13 +18,12 @@
 #include "MarbleDebug.h"
 #include "AbstractDataPlugin.h"
 #include "AbstractDataPluginItem.h"
+#include "FrameProfiler.h"
 #include "GeoPainter.h"
 #include "RenderPlugin.h"
 #include "LayerInterface.h"
 #include "RenderState.h"
 
-#include <QTime>
-
 namespace Marble
 {
 
@@ -36,6 +35,8 @@ class Q_DECL_HIDDEN LayerManager::Private
 
     void updateVisibility( bool visible, const QString &nameId );
 
+    static QString layerName( const LayerInterface *layer );
+
     LayerManager *const q;
 
     QList<RenderPlugin *> m_renderPlugins;
@@ -66,6 +67,17 @@ void LayerManager::Private::updateVisibility( bool visible, const QString &nameI
 }
 
 
+QString LayerManager::Private::layerName( const LayerInterface *layer )
+{
+    if ( const RenderPlugin *plugin = dynamic_cast<const RenderPlugin *>( layer ) ) {
+        return plugin->nameId();
+    }
+    if ( const QObject *object = dynamic_cast<const QObject *>( layer ) ) {
+        return QString::fromLatin1( object->metaObject()->className() );
+    }
+    return QStringLiteral( "Layer" );
+}
+
 LayerManager::LayerManager(QObject *parent) :
     QObject(parent),
     d(new Private(this))
@@ -123,7 +135,12 @@ QList<AbstractDataPluginItem *> LayerManager::whichItemAt( const QPoint& curpos
 void LayerManager::renderLayers( GeoPainter *painter, ViewportParams *viewport )
 {
     d->m_renderState = RenderState( "Marble" );
-    const QTime totalTime = QTime::currentTime();
+
+    FrameProfiler *const profiler = FrameProfiler::instance();
+    profiler->beginFrame( this );
+    const qint64 frameStart = profiler->timestamp();
+    // the layer names are only looked up if they get recorded
+    const bool profiling = profiler->isEnabled();
 
     QStringList renderPositions;
 
@@ -173,19 +190,22 @@ void LayerManager::renderLayers( GeoPainter *painter, ViewportParams *viewport )
         } );
 
         // render the layers of the current renderPosition
-        QTime timer;
         foreach( auto *layer, layers ) {
-            timer.start();
+            FrameProfiler::Scope scope( profiling ? d->layerName( layer ) : QString() );
             layer->render( painter, viewport, renderPosition, 0 );
             d->m_renderState.addChild( layer->renderState() );
-            traceList.append( QString("%2 ms %3").arg( timer.elapsed(),3 ).arg( layer->runtimeTrace() ) );
+            if ( d->m_showRuntimeTrace ) {
+                traceList.append( QString( "%1 ms %2" ).arg( scope.elapsed() / 1e6, 6, 'f', 2 ).arg( layer->runtimeTrace() ) );
+            }
         }
     }
 
+    const qreal totalElapsed = ( profiler->timestamp() - frameStart ) / 1e6;
+    profiler->endFrame( this );
+
     if ( d->m_showRuntimeTrace ) {
-        const int totalElapsed = totalTime.elapsed();
-        const int fps = 1000.0/totalElapsed;
-        traceList.append( QString( "Total: %1 ms (%2 fps)" ).arg( totalElapsed, 3 ).arg( fps ) );
+        const int fps = totalElapsed > 0 ? 1000.0/totalElapsed : 0;
+        traceList.append( QString( "Total: %1 ms (%2 fps)" ).arg( totalElapsed, 6, 'f', 2 ).arg( fps ) );
 
         painter->save();
         painter->setBackgroundMode( Qt::OpaqueMode );
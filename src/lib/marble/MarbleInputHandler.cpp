@@ -409,7 +409,7 @@ void MarbleDefaultInputHandler::checkReleasedMove(QMouseEvent *event)
 
             if (MarbleInputHandler::d->m_inertialEarthRotation)
             {
-                d->m_kineticSpinning.start();
+                startKineticSpinning();
             }
             else
             {
@@ -538,7 +538,7 @@ void MarbleDefaultInputHandler::handleMouseButtonRelease(QMouseEvent *event)
         d->m_leftPressed = false;
         if (MarbleInputHandler::d->m_inertialEarthRotation)
         {
-            d->m_kineticSpinning.start();
+            startKineticSpinning();
         }
         else
         {
@@ -654,6 +654,19 @@ void MarbleDefaultInputHandler::adjustCursorShape(const QPoint &mousePosition, c
 #endif
 }
 
+void MarbleDefaultInputHandler::startKineticSpinning()
+{
+    d->m_kineticSpinning.start();
+
+    // Load the tiles around the place where the globe stops spinning in the meantime
+    const QPointF finalPosition = d->m_kineticSpinning.finalPosition();
+    if (finalPosition != d->m_kineticSpinning.position())
+    {
+        MarbleAbstractPresenter *marblePresenter = MarbleInputHandler::d->m_marblePresenter;
+        marblePresenter->map()->prefetchTiles(finalPosition.x(), finalPosition.y(), marblePresenter->radius());
+    }
+}
+
 QPoint MarbleDefaultInputHandler::mouseMovedOutside(QMouseEvent *event)
 {   //Returns a 2d vector representing the direction in which the mouse left
     int dirX = 0;
@@ -665,7 +678,7 @@ QPoint MarbleDefaultInputHandler::mouseMovedOutside(QMouseEvent *event)
 
         if (MarbleInputHandler::d->m_inertialEarthRotation)
         {
-            d->m_kineticSpinning.start();
+            startKineticSpinning();
         }
     }
 
@@ -172,6 +172,7 @@ class MARBLE_EXPORT MarbleDefaultInputHandler  : public MarbleInputHandler
     virtual bool acceptMouse();
 
     void notifyPosition(bool isAboveMap, qreal mouseLon, qreal mouseLat);
+    void startKineticSpinning();
     QPoint mouseMovedOutside(QMouseEvent *event);
     void adjustCursorShape(const QPoint& mousePosition, const QPoint& mouseDirection);
 
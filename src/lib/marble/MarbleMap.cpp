@@ -36,6 +36,7 @@
 #include "AbstractFloatItem.h"
 #include "DgmlAuxillaryDictionary.h"
 #include "FileManager.h"
+#include "FrameProfiler.h"
 #include "GeoDataTreeModel.h"
 #include "GeoPainter.h"
 #include "GeoSceneDocument.h"
@@ -54,6 +55,7 @@
 #include "GeoDataFeature.h"
 #include "GeoDataStyle.h"
 #include "GeoDataStyleMap.h"
+#include "HttpDownloadManager.h"
 #include "LayerManager.h"
 #include "MapThemeManager.h"
 #include "MarbleDebug.h"
@@ -137,6 +139,7 @@ public:
     ViewportParams   m_viewport;
     bool             m_showFrameRate;
     bool             m_showDebugPolygons;
+    int              m_prefetchBudget;
     StyleBuilder     m_styleBuilder;
 
     QList<RenderPlugin *> m_renderPlugins;
@@ -163,6 +166,7 @@ MarbleMapPrivate::MarbleMapPrivate( MarbleMap *parent, MarbleModel *model ) :
     m_viewParams(),
     m_showFrameRate( false ),
     m_showDebugPolygons( false ),
+    m_prefetchBudget( 32 ),
     m_styleBuilder(),
     m_layerManager( parent ),
     m_customPaintLayer( parent ),
@@ -183,6 +187,8 @@ MarbleMapPrivate::MarbleMapPrivate( MarbleMap *parent, MarbleModel *model ) :
 
     m_model->bookmarkManager()->setStyleBuilder(&m_styleBuilder);
 
+    QObject::connect( m_model, SIGNAL(themeAboutToChange()),
+                      &m_textureLayer, SLOT(reset()) );
     QObject::connect( m_model, SIGNAL(themeChanged(QString)),
                       parent, SLOT(updateMapTheme()) );
     QObject::connect( m_model->fileManager(), SIGNAL(fileAdded(QString)),
@@ -326,6 +332,8 @@ MarbleMap::~MarbleMap()
 {
     MarbleModel *model = d->m_modelIsOwned ? d->m_model : 0;
 
+    d->m_model->downloadManager()->removeViewport( this );
+
     d->m_layerManager.removeLayer( &d->m_customPaintLayer );
     d->m_layerManager.removeLayer( &d->m_geometryLayer );
     d->m_layerManager.removeLayer(&d->m_floatItemsLayer);
@@ -563,6 +571,24 @@ void MarbleMap::downloadRegion( QVector<TileCoordsPyramid> const & pyramid )
     mDebug() << "MarbleMap::downloadRegion:" << tilesCount << "tiles, " << elapsedMs << "ms";
 }
 
+int MarbleMap::prefetchTiles( qreal lon, qreal lat, int radius )
+{
+    if ( d->m_prefetchBudget <= 0 ) {
+        return 0;
+    }
+
+    const ViewportParams viewport( d->m_viewport.projection(), lon * DEG2RAD, lat * DEG2RAD,
+                                   radius, d->m_viewport.size() );
+
+    // each kind of tiles gets its own budget so that one can't starve the other
+    const int requested = d->m_textureLayer.prefetchTiles( &viewport, d->m_prefetchBudget )
+                        + d->m_vectorTileLayer.prefetchTiles( &viewport, d->m_prefetchBudget );
+
+    mDebug() << "MarbleMap::prefetchTiles:" << requested << "tiles around" << lon << lat << "radius" << radius;
+
+    return requested;
+}
+
 bool MarbleMap::propertyValue( const QString& name ) const
 {
     bool value;
@@ -702,6 +728,11 @@ quint64 MarbleMap::volatileTileCacheLimit() const
     return d->m_textureLayer.volatileCacheLimit();
 }
 
+int MarbleMap::prefetchBudget() const
+{
+    return d->m_prefetchBudget;
+}
+
 
 void MarbleMap::rotateBy( const qreal& deltaLon, const qreal& deltaLat )
 {
@@ -833,6 +864,10 @@ void MarbleMap::paint( GeoPainter &painter, const QRect &dirtyRect )
     QTime t;
     t.start();
 
+    // downloads of the tiles requested while rendering are ordered by their
+    // distance to the center of the view
+    d->m_model->downloadManager()->setViewport( this, d->m_viewport.viewLatLonAltBox(), tileZoomLevel() );
+
     RenderStatus const oldRenderStatus = d->m_renderState.status();
     d->m_layerManager.renderLayers( &painter, &d->m_viewport );
     d->m_renderState = d->m_layerManager.renderState();
@@ -1237,6 +1272,16 @@ bool MarbleMap::showRuntimeTrace() const
     return d->m_layerManager.showRuntimeTrace();
 }
 
+void MarbleMap::setFrameProfilingEnabled( bool enabled )
+{
+    FrameProfiler::instance()->setEnabled( enabled );
+}
+
+bool MarbleMap::frameProfilingEnabled() const
+{
+    return FrameProfiler::instance()->isEnabled();
+}
+
 void MarbleMap::setShowDebugPolygons( bool visible)
 {
     if (visible != d->m_showDebugPolygons) {
@@ -1280,6 +1325,11 @@ void MarbleMap::setVolatileTileCacheLimit( quint64 kilobytes )
     d->m_textureLayer.setVolatileCacheLimit( kilobytes );
 }
 
+void MarbleMap::setPrefetchBudget( int tiles )
+{
+    d->m_prefetchBudget = qMax( 0, tiles );
+}
+
 AngleUnit MarbleMap::defaultAngleUnit() const
 {
     if ( GeoDataCoordinates::defaultNotation() == GeoDataCoordinates::Decimal ) {
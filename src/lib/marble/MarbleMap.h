@@ -364,6 +364,12 @@ class MARBLE_EXPORT MarbleMap : public QObject
      */
     quint64 volatileTileCacheLimit() const;
 
+    /**
+     * @brief  Returns the maximum number of texture tiles and of vector tiles
+     *         requested by a single call of prefetchTiles().
+     */
+    int prefetchBudget() const;
+
     /**
      * @brief Returns a list of all RenderPlugins in the model, this includes float items
      * @return the list of RenderPlugins
@@ -635,6 +641,17 @@ class MARBLE_EXPORT MarbleMap : public QObject
 
     bool showRuntimeTrace() const;
 
+    /**
+     * @brief Set whether the FrameProfiler records the frames of all maps
+     * @param enabled  whether frames get recorded
+     *
+     * Profiling is enabled from the start if the environment variable
+     * MARBLE_FRAME_PROFILE is set.
+     */
+    void setFrameProfilingEnabled( bool enabled );
+
+    bool frameProfilingEnabled() const;
+
     /**
      * @brief Set whether to enter the debug mode for
      * polygon node drawing
@@ -658,6 +675,13 @@ class MARBLE_EXPORT MarbleMap : public QObject
      */
     void setVolatileTileCacheLimit( quint64 kiloBytes );
 
+    /**
+     * @brief  Set the maximum number of texture tiles and of vector tiles
+     *         requested by a single call of prefetchTiles().
+     * @param  tiles The number of tiles, 0 disables prefetching.
+     */
+    void setPrefetchBudget( int tiles );
+
     void setDefaultAngleUnit( AngleUnit angleUnit );
 
     void setDefaultFont( const QFont& font );
@@ -671,6 +695,18 @@ class MARBLE_EXPORT MarbleMap : public QObject
 
     void downloadRegion( QVector<TileCoordsPyramid> const & );
 
+    /**
+     * @brief Requests the texture and vector tiles of an upcoming view ahead of time
+     *
+     * Used by animations to have the tiles of the view they are heading to
+     * loaded by the time they arrive there.
+     * @param lon longitude of the center of the view in degrees
+     * @param lat latitude of the center of the view in degrees
+     * @param radius radius of the planet in the view in pixels
+     * @return the number of requested tiles
+     */
+    int prefetchTiles( qreal lon, qreal lat, int radius );
+
  Q_SIGNALS:
     void tileLevelChanged( int level );
 
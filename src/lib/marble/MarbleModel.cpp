@@ -49,13 +49,14 @@
 
 #include "DgmlAuxillaryDictionary.h"
 #include "MarbleClock.h"
-#include "FileStoragePolicy.h"
 #include "FileStorageWatcher.h"
 #include "PositionTracking.h"
 #include "HttpDownloadManager.h"
 #include "MarbleDirs.h"
+#include "MbTileStoragePolicy.h"
 #include "FileManager.h"
 #include "GeoDataTreeModel.h"
+#include "PlacemarkNameIndex.h"
 #include "PlacemarkPositionProviderPlugin.h"
 #include "Planet.h"
 #include "PlanetFactory.h"
@@ -90,6 +91,7 @@ class MarbleModelPrivate
           m_treeModel(),
           m_descendantProxy(),
           m_placemarkProxyModel(),
+          m_placemarkNameIndex( &m_placemarkProxyModel ),
           m_placemarkSelectionModel( 0 ),
           m_fileManager( &m_treeModel, &m_pluginManager ),
           m_positionTracking( &m_treeModel ),
@@ -158,7 +160,7 @@ class MarbleModelPrivate
     // View and paint stuff
     GeoSceneDocument        *m_mapTheme;
 
-    FileStoragePolicy        m_storagePolicy;
+    MbTileStoragePolicy      m_storagePolicy;
     HttpDownloadManager      m_downloadManager;
 
     // Cache related
@@ -169,6 +171,7 @@ class MarbleModelPrivate
     KDescendantsProxyModel   m_descendantProxy;
     QSortFilterProxyModel    m_placemarkProxyModel;
     QSortFilterProxyModel    m_groundOverlayProxyModel;
+    PlacemarkNameIndex       m_placemarkNameIndex;
 
     // Selection handling
     QItemSelectionModel      m_placemarkSelectionModel;
@@ -300,6 +303,9 @@ void MarbleModel::setMapTheme( GeoSceneDocument *document )
         }
     }
 
+    if ( d->m_mapTheme ) {
+        emit themeAboutToChange();
+    }
     delete d->m_mapTheme;
     d->m_mapTheme = mapTheme;
 
@@ -549,6 +555,11 @@ const QAbstractItemModel *MarbleModel::placemarkModel() const
     return &d->m_placemarkProxyModel;
 }
 
+const PlacemarkNameIndex *MarbleModel::placemarkNameIndex() const
+{
+    return &d->m_placemarkNameIndex;
+}
+
 QAbstractItemModel *MarbleModel::groundOverlayModel()
 {
     return &d->m_groundOverlayProxyModel;
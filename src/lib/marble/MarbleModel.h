@@ -52,6 +52,7 @@ class MarbleModelPrivate;
 class MarbleClock;
 class SunLocator;
 class TileCreator;
+class PlacemarkNameIndex;
 class PluginManager;
 class GeoDataCoordinates;
 class GeoDataDocument;
@@ -121,6 +122,11 @@ class MARBLE_EXPORT MarbleModel : public QObject
     QAbstractItemModel *placemarkModel();
     const QAbstractItemModel *placemarkModel() const;
 
+    /**
+     * @brief Return the index of the names of the placemarks in placemarkModel()
+     */
+    const PlacemarkNameIndex *placemarkNameIndex() const;
+
     QItemSelectionModel *placemarkSelectionModel();
 
     /**
@@ -317,6 +323,15 @@ class MARBLE_EXPORT MarbleModel : public QObject
      */
     void themeChanged( const QString &mapTheme );
 
+    /**
+     * @brief Signal that the current map theme is about to be deleted.
+     *
+     * Anything still using its datasets, e.g. tiles being loaded in the
+     * background, needs to stop before the signal returns.
+     * @see  themeChanged
+     */
+    void themeAboutToChange();
+
     void workOfflineChanged();
 
     /**
@@ -13,6 +13,7 @@
 #include "Quaternion.h"
 #include "MarbleAbstractPresenter.h"
 #include "MarbleDebug.h"
+#include "MarbleMap.h"
 #include "GeoDataLineString.h"
 #include "ViewportParams.h"
 
@@ -102,6 +103,14 @@ public:
             return m_target.range();
         }
     }
+
+    void prefetchTiles( qreal t ) const
+    {
+        qreal lon(0.0), lat(0.0);
+        suggestedPos(t, lon, lat);
+        const int radius = qRound( m_presenter->radiusFromDistance( suggestedRange(t) * METER2KM ) );
+        m_presenter->map()->prefetchTiles( lon * RAD2DEG, lat * RAD2DEG, radius );
+    }
 };
 
 
@@ -169,6 +178,13 @@ void MarblePhysics::flyTo( const GeoDataLookAt &target, FlyToMode mode )
         break;
     }
 
+    // Load the tiles of the target view while flying there. A jump passes
+    // a far view half way which is cheap to have in memory as well.
+    d->prefetchTiles(1.0);
+    if (effectiveMode == Jump) {
+        d->prefetchTiles(0.5);
+    }
+
     d->m_timeline.start();
 }
 
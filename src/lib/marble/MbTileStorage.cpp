@@ -0,0 +1,451 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "MbTileStorage.h"
+
+#include "MarbleDebug.h"
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThreadStorage>
+#include <QVariant>
+
+namespace Marble
+{
+
+namespace
+{
+
+// tiles are read in aligned blocks of BlockSize x BlockSize
+const int BlockSize = 4;
+
+QAtomicInt connectionCount;
+
+/** The connections of a thread to the tile packs, removed when the thread finishes */
+class ConnectionPool
+{
+public:
+    ~ConnectionPool()
+    {
+        foreach ( const QString &name, m_connectionNames ) {
+            QSqlDatabase::removeDatabase( name );
+        }
+    }
+
+    /** Returns the connection to @p fileName, which might not be open yet */
+    QSqlDatabase database( const QString &fileName )
+    {
+        QString &name = m_connectionNames[fileName];
+        if ( name.isEmpty() ) {
+            name = QString( "marble-mbtiles-%1" ).arg( connectionCount.fetchAndAddRelaxed( 1 ) );
+            QSqlDatabase db = QSqlDatabase::addDatabase( "QSQLITE", name );
+            db.setDatabaseName( fileName );
+            return db;
+        }
+        return QSqlDatabase::database( name, false );
+    }
+
+private:
+    QHash<QString, QString> m_connectionNames;
+};
+
+QThreadStorage<ConnectionPool *> connectionPools;
+
+}
+
+class MbTileStorageRegistry
+{
+public:
+    ~MbTileStorageRegistry()
+    {
+        qDeleteAll( m_storages );
+    }
+
+    MbTileStorage *storage( const QString &fileName, bool create )
+    {
+        const QString path = QFileInfo( fileName ).absoluteFilePath();
+
+        QMutexLocker locker( &m_mutex );
+        MbTileStorage *storage = m_storages.value( path, 0 );
+        if ( !storage ) {
+            const bool exists = QFileInfo( path ).exists();
+            if ( !exists && !create ) {
+                return 0;
+            }
+            if ( !exists && !QDir().mkpath( QFileInfo( path ).absolutePath() ) ) {
+                mDebug() << "Unable to create the directory of tile pack" << path;
+                return 0;
+            }
+
+            storage = new MbTileStorage( path );
+            if ( !exists && !storage->createSchema() ) {
+                delete storage;
+                return 0;
+            }
+            m_storages.insert( path, storage );
+        }
+        return storage;
+    }
+
+private:
+    QMutex m_mutex;
+    QHash<QString, MbTileStorage *> m_storages;
+};
+
+Q_GLOBAL_STATIC( MbTileStorageRegistry, s_registry )
+
+MbTileStorage *MbTileStorage::storage( const QString &fileName, bool create )
+{
+    return s_registry->storage( fileName, create );
+}
+
+bool MbTileStorage::parseTileFileName( const QString &tileFileName, QString &themePath,
+                                       int &zoomLevel, int &column, int &row )
+{
+    // <theme>/<zoom level>/<column>/<row>.<suffix> or, for the Marble
+    // storage layout, <theme>/<zoom level>/<row>/<row>_<column>.<suffix>
+    const QStringList components = tileFileName.split( QLatin1Char( '/' ) );
+    const int count = components.size();
+    if ( count < 4 ) {
+        return false;
+    }
+
+    bool ok = false;
+    zoomLevel = components[count - 3].toInt( &ok );
+    if ( !ok ) {
+        return false;
+    }
+    const int directory = components[count - 2].toInt( &ok );
+    if ( !ok ) {
+        return false;
+    }
+
+    const QString baseName = components[count - 1].section( QLatin1Char( '.' ), 0, 0 );
+    const int separator = baseName.indexOf( QLatin1Char( '_' ) );
+    if ( separator < 0 ) {
+        column = directory;
+        row = baseName.toInt( &ok );
+    } else {
+        row = directory;
+        column = baseName.mid( separator + 1 ).toInt( &ok );
+        ok = ok && baseName.left( separator ).toInt() == row;
+    }
+    if ( !ok || zoomLevel < 0 || column < 0 || row < 0 ) {
+        return false;
+    }
+
+    themePath = QStringList( components.mid( 0, count - 3 ) ).join( QLatin1Char( '/' ) );
+    return true;
+}
+
+QString MbTileStorage::packFileName( const QString &themePath )
+{
+    return themePath + QLatin1String( "/tiles.mbtiles" );
+}
+
+MbTileStorage::MbTileStorage( const QString &fileName ) :
+    m_fileName( fileName ),
+    m_hasTimestamps( false ),
+    m_fileModified( QFileInfo( fileName ).lastModified().toMSecsSinceEpoch() ),
+    m_writeCount( 0 ),
+    m_cache( 8 * 1024 * 1024 )
+{
+    if ( QFileInfo( fileName ).exists() ) {
+        // packs written by other tools might not keep track of the time
+        // tiles have been stored
+        QSqlQuery query( "PRAGMA table_info(tiles)", database() );
+        while ( query.next() ) {
+            if ( query.value( 1 ).toString() == QLatin1String( "modified" ) ) {
+                m_hasTimestamps = true;
+            }
+        }
+    }
+}
+
+MbTileStorage::~MbTileStorage()
+{
+}
+
+QString MbTileStorage::fileName() const
+{
+    return m_fileName;
+}
+
+QByteArray MbTileStorage::tileData( int zoomLevel, int column, int row, QDateTime *lastModified )
+{
+    const quint64 key = cacheKey( zoomLevel, column, row );
+
+    CachedTile tile;
+    if ( !cachedTile( key, tile ) ) {
+        tile = readBlock( zoomLevel, column, row );
+    }
+
+    if ( tile.data.isEmpty() ) {
+        return QByteArray();
+    }
+    if ( lastModified ) {
+        *lastModified = QDateTime::fromMSecsSinceEpoch( tile.modified );
+    }
+    return tile.data;
+}
+
+bool MbTileStorage::containsTile( int zoomLevel, int column, int row )
+{
+    return !tileData( zoomLevel, column, row ).isEmpty();
+}
+
+bool MbTileStorage::storeTile( int zoomLevel, int column, int row, const QByteArray &data, qint64 *sizeDelta )
+{
+    QMutexLocker locker( &m_mutex );
+    QSqlDatabase db = database();
+
+    qint64 oldSize = 0;
+    QSqlQuery sizeQuery( db );
+    sizeQuery.prepare( "SELECT length(tile_data) FROM tiles"
+                       " WHERE zoom_level=? AND tile_column=? AND tile_row=?" );
+    sizeQuery.addBindValue( zoomLevel );
+    sizeQuery.addBindValue( column );
+    sizeQuery.addBindValue( row );
+    if ( sizeQuery.exec() && sizeQuery.next() ) {
+        oldSize = sizeQuery.value( 0 ).toLongLong();
+    }
+
+    const qint64 modified = QDateTime::currentMSecsSinceEpoch();
+    QSqlQuery query( db );
+    if ( m_hasTimestamps ) {
+        query.prepare( "INSERT OR REPLACE INTO tiles"
+                       " (zoom_level, tile_column, tile_row, tile_data, modified)"
+                       " VALUES (?, ?, ?, ?, ?)" );
+    } else {
+        query.prepare( "INSERT OR REPLACE INTO tiles"
+                       " (zoom_level, tile_column, tile_row, tile_data)"
+                       " VALUES (?, ?, ?, ?)" );
+    }
+    query.addBindValue( zoomLevel );
+    query.addBindValue( column );
+    query.addBindValue( row );
+    query.addBindValue( data );
+    if ( m_hasTimestamps ) {
+        query.addBindValue( modified );
+    }
+
+    if ( !query.exec() ) {
+        m_errorMessage = m_fileName + QLatin1String( ": " ) + query.lastError().text();
+        mDebug() << "Unable to store tile:" << m_errorMessage;
+        return false;
+    }
+    ++m_writeCount;
+
+    if ( !m_hasTimestamps ) {
+        m_fileModified = modified;
+    }
+
+    CachedTile *tile = new CachedTile;
+    tile->data = data;
+    tile->modified = modified;
+    m_cache.insert( cacheKey( zoomLevel, column, row ), tile, data.size() + 1 );
+
+    if ( sizeDelta ) {
+        *sizeDelta = data.size() - oldSize;
+    }
+    return true;
+}
+
+bool MbTileStorage::removeTile( int zoomLevel, int column, int row )
+{
+    QMutexLocker locker( &m_mutex );
+
+    QSqlQuery query( database() );
+    query.prepare( "DELETE FROM tiles WHERE zoom_level=? AND tile_column=? AND tile_row=?" );
+    query.addBindValue( zoomLevel );
+    query.addBindValue( column );
+    query.addBindValue( row );
+    if ( !query.exec() ) {
+        m_errorMessage = m_fileName + QLatin1String( ": " ) + query.lastError().text();
+        mDebug() << "Unable to remove tile:" << m_errorMessage;
+        return false;
+    }
+    ++m_writeCount;
+
+    m_cache.remove( cacheKey( zoomLevel, column, row ) );
+    return query.numRowsAffected() > 0;
+}
+
+qint64 MbTileStorage::removeTiles( int minimumZoomLevel )
+{
+    QMutexLocker locker( &m_mutex );
+    QSqlDatabase db = database();
+
+    qint64 removed = 0;
+    QSqlQuery sizeQuery( db );
+    sizeQuery.prepare( "SELECT sum(length(tile_data)) FROM tiles WHERE zoom_level>=?" );
+    sizeQuery.addBindValue( minimumZoomLevel );
+    if ( sizeQuery.exec() && sizeQuery.next() ) {
+        removed = sizeQuery.value( 0 ).toLongLong();
+    }
+
+    QSqlQuery query( db );
+    query.prepare( "DELETE FROM tiles WHERE zoom_level>=?" );
+    query.addBindValue( minimumZoomLevel );
+    if ( !query.exec() ) {
+        m_errorMessage = m_fileName + QLatin1String( ": " ) + query.lastError().text();
+        mDebug() << "Unable to remove tiles:" << m_errorMessage;
+        return 0;
+    }
+    ++m_writeCount;
+
+    QSqlQuery( "VACUUM", db );
+    m_cache.clear();
+    return removed;
+}
+
+QString MbTileStorage::lastErrorMessage() const
+{
+    return m_errorMessage;
+}
+
+quint64 MbTileStorage::cacheKey( int zoomLevel, int column, int row )
+{
+    return ( quint64( zoomLevel ) << 58 ) | ( quint64( column ) << 29 ) | quint64( row );
+}
+
+QSqlDatabase MbTileStorage::database()
+{
+    // Connections must not be shared between threads
+    if ( !connectionPools.hasLocalData() ) {
+        connectionPools.setLocalData( new ConnectionPool );
+    }
+    QSqlDatabase db = connectionPools.localData()->database( m_fileName );
+    if ( db.isOpen() ) {
+        return db;
+    }
+
+    if ( !db.open() ) {
+        m_errorMessage = m_fileName + QLatin1String( ": " ) + db.lastError().text();
+        mDebug() << "Unable to open tile pack:" << m_errorMessage;
+    } else {
+        // readers do not block the writer and vice versa
+        QSqlQuery( "PRAGMA journal_mode=WAL", db );
+        QSqlQuery( "PRAGMA synchronous=NORMAL", db );
+    }
+    return db;
+}
+
+bool MbTileStorage::createSchema()
+{
+    QSqlDatabase db = database();
+    const QStringList statements = QStringList()
+            << "PRAGMA application_id = 0x4d504258"
+            << "CREATE TABLE tiles (zoom_level integer, tile_column integer, tile_row integer,"
+               " tile_data blob, modified integer)"
+            << "CREATE UNIQUE INDEX tile_index ON tiles(zoom_level, tile_column, tile_row)"
+            << "CREATE TABLE metadata (name text, value text)"
+            << "INSERT INTO metadata (name, value) VALUES ('name', 'Marble tile cache')"
+            << "INSERT INTO metadata (name, value) VALUES ('type', 'baselayer')"
+            << "INSERT INTO metadata (name, value) VALUES ('version', '1.0')";
+
+    foreach ( const QString &statement, statements ) {
+        QSqlQuery query( db );
+        if ( !query.exec( statement ) ) {
+            m_errorMessage = m_fileName + QLatin1String( ": " ) + query.lastError().text();
+            mDebug() << "Unable to create tile pack:" << m_errorMessage;
+            return false;
+        }
+    }
+
+    m_hasTimestamps = true;
+    return true;
+}
+
+bool MbTileStorage::cachedTile( quint64 key, CachedTile &tile )
+{
+    QMutexLocker locker( &m_mutex );
+    const CachedTile *cached = m_cache.object( key );
+    if ( !cached ) {
+        return false;
+    }
+    tile = *cached;
+    return true;
+}
+
+MbTileStorage::CachedTile MbTileStorage::readBlock( int zoomLevel, int column, int row )
+{
+    const int firstColumn = column - column % BlockSize;
+    const int firstRow = row - row % BlockSize;
+
+    CachedTile result;
+    result.modified = 0;
+
+    // Only the lookup of the connection needs the lock. The query runs
+    // without it, so that other threads get their tiles from the cache
+    // in the meantime.
+    QMutexLocker locker( &m_mutex );
+    const QSqlDatabase db = database();
+    const qint64 fileModified = m_fileModified;
+    const quint64 writeCount = m_writeCount;
+    locker.unlock();
+
+    QSqlQuery query( db );
+    query.setForwardOnly( true );
+    if ( m_hasTimestamps ) {
+        query.prepare( "SELECT tile_column, tile_row, tile_data, modified FROM tiles"
+                       " WHERE zoom_level=? AND tile_column BETWEEN ? AND ? AND tile_row BETWEEN ? AND ?" );
+    } else {
+        query.prepare( "SELECT tile_column, tile_row, tile_data FROM tiles"
+                       " WHERE zoom_level=? AND tile_column BETWEEN ? AND ? AND tile_row BETWEEN ? AND ?" );
+    }
+    query.addBindValue( zoomLevel );
+    query.addBindValue( firstColumn );
+    query.addBindValue( firstColumn + BlockSize - 1 );
+    query.addBindValue( firstRow );
+    query.addBindValue( firstRow + BlockSize - 1 );
+    if ( !query.exec() ) {
+        mDebug() << "Unable to read tiles from" << m_fileName << query.lastError().text();
+        return result;
+    }
+
+    QHash<quint64, CachedTile> block;
+    while ( query.next() ) {
+        CachedTile tile;
+        tile.data = query.value( 2 ).toByteArray();
+        tile.modified = m_hasTimestamps ? query.value( 3 ).toLongLong() : fileModified;
+        block.insert( cacheKey( zoomLevel, query.value( 0 ).toInt(), query.value( 1 ).toInt() ), tile );
+    }
+    query.finish();
+
+    result = block.value( cacheKey( zoomLevel, column, row ), result );
+
+    locker.relock();
+    // tiles stored or removed meanwhile must not be replaced by older data
+    if ( m_writeCount != writeCount ) {
+        return result;
+    }
+
+    // remember the missing tiles as well, so that they are not queried again
+    for ( int c = firstColumn; c < firstColumn + BlockSize; ++c ) {
+        for ( int r = firstRow; r < firstRow + BlockSize; ++r ) {
+            const quint64 key = cacheKey( zoomLevel, c, r );
+            CachedTile *tile = new CachedTile;
+            tile->modified = 0;
+            QHash<quint64, CachedTile>::const_iterator const pos = block.constFind( key );
+            if ( pos != block.constEnd() ) {
+                *tile = *pos;
+            }
+            m_cache.insert( key, tile, tile->data.size() + 1 );
+        }
+    }
+    return result;
+}
+
+}
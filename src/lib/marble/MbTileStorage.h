@@ -0,0 +1,134 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_MBTILESTORAGE_H
+#define MARBLE_MBTILESTORAGE_H
+
+#include "marble_export.h"
+
+#include <QByteArray>
+#include <QCache>
+#include <QDateTime>
+#include <QMutex>
+#include <QString>
+
+class QSqlDatabase;
+
+namespace Marble
+{
+
+/**
+ * @short A tile pack: all tiles of a theme in a single MBTiles (SQLite) file.
+ *
+ * Tiles are addressed by the directory components of their relative file
+ * name as created by GeoSceneTileDataset::relativeTileFileName(). The pack
+ * of the tile "maps/earth/osm/12/2143/1406.png" is the file
+ * "maps/earth/osm/tiles.mbtiles" which stores it with the zoom level 12,
+ * column 2143 and row 1406. This way tile packs written by
+ * tools/mbtile-import can be used as well.
+ *
+ * Reads are batched: looking up a tile reads the whole aligned block of
+ * 4x4 tiles around it with a single indexed query, because the neighbors
+ * are usually requested right afterwards.
+ *
+ * Every thread uses its own database connection, so the storage can be
+ * used from the tile loading threads. The blocks are read without holding
+ * the lock of the cache.
+ */
+class MARBLE_EXPORT MbTileStorage
+{
+public:
+    /**
+     * Returns the storage of the pack @p fileName. If the file does not
+     * exist yet, it gets created if @p create is true. Otherwise 0 is
+     * returned.
+     *
+     * Storages are shared and live until the application quits.
+     */
+    static MbTileStorage *storage( const QString &fileName, bool create = false );
+
+    /**
+     * Splits the relative file name of a tile @p tileFileName into the
+     * theme directory, the zoom level, column and row. Returns false if
+     * it does not look like a tile file name.
+     */
+    static bool parseTileFileName( const QString &tileFileName, QString &themePath,
+                                   int &zoomLevel, int &column, int &row );
+
+    /**
+     * Returns the file name of the pack that stores the tiles of the
+     * theme directory @p themePath.
+     */
+    static QString packFileName( const QString &themePath );
+
+    ~MbTileStorage();
+
+    QString fileName() const;
+
+    /**
+     * Returns the data of the tile or an empty byte array if it is not
+     * stored. @p lastModified is set to the time the tile has been
+     * stored, if the pack keeps track of it, or to the modification
+     * time of the pack otherwise.
+     */
+    QByteArray tileData( int zoomLevel, int column, int row, QDateTime *lastModified = 0 );
+
+    bool containsTile( int zoomLevel, int column, int row );
+
+    /**
+     * Stores the tile, replacing a previous version. @p sizeDelta is set to
+     * the number of bytes the pack grew by.
+     */
+    bool storeTile( int zoomLevel, int column, int row, const QByteArray &data, qint64 *sizeDelta = 0 );
+
+    /**
+     * Removes the tile. Returns false if it is not stored.
+     */
+    bool removeTile( int zoomLevel, int column, int row );
+
+    /**
+     * Removes all tiles of @p minimumZoomLevel and above. Returns the
+     * number of bytes of tile data removed.
+     */
+    qint64 removeTiles( int minimumZoomLevel );
+
+    QString lastErrorMessage() const;
+
+private:
+    explicit MbTileStorage( const QString &fileName );
+    Q_DISABLE_COPY( MbTileStorage )
+
+    struct CachedTile
+    {
+        QByteArray data;
+        qint64 modified;
+    };
+
+    static quint64 cacheKey( int zoomLevel, int column, int row );
+    QSqlDatabase database();
+    bool createSchema();
+    bool cachedTile( quint64 key, CachedTile &tile );
+    CachedTile readBlock( int zoomLevel, int column, int row );
+
+    friend class MbTileStorageRegistry;
+
+    const QString m_fileName;
+    QMutex m_mutex;
+    bool m_hasTimestamps;
+    qint64 m_fileModified;
+    // counts the changes of the stored tiles, so that blocks read while
+    // tiles were changed do not replace their newer cache entries
+    quint64 m_writeCount;
+    // entries without data mark tiles known to be missing
+    QCache<quint64, CachedTile> m_cache;
+    QString m_errorMessage;
+};
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "MbTileStoragePolicy.h"
+
+#include "FileStorageIndex.h"
+#include "MarbleDebug.h"
+#include "MarbleDirs.h"
+#include "MarbleGlobal.h"
+#include "MbTileStorage.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QImageReader>
+
+using namespace Marble;
+
+MbTileStoragePolicy::MbTileStoragePolicy( const QString &dataDirectory, QObject *parent )
+    : StoragePolicy( parent ),
+      m_dataDirectory( dataDirectory.isEmpty() ? MarbleDirs::localPath() + QLatin1String("/cache/") : dataDirectory ),
+      m_filePolicy( m_dataDirectory )
+{
+    connect( &m_filePolicy, SIGNAL(cleared()), this, SIGNAL(cleared()) );
+    connect( &m_filePolicy, SIGNAL(sizeChanged(qint64)), this, SIGNAL(sizeChanged(qint64)) );
+}
+
+MbTileStoragePolicy::~MbTileStoragePolicy()
+{
+}
+
+bool MbTileStoragePolicy::fileExists( const QString &fileName ) const
+{
+    QString packFileName;
+    int zoomLevel, column, row;
+    if ( isPackedTile( fileName, packFileName, zoomLevel, column, row ) ) {
+        MbTileStorage *const storage = MbTileStorage::storage( packFileName );
+        if ( storage && storage->containsTile( zoomLevel, column, row ) ) {
+            return true;
+        }
+    }
+
+    return m_filePolicy.fileExists( fileName );
+}
+
+bool MbTileStoragePolicy::updateFile( const QString &fileName, const QByteArray &data )
+{
+    QString packFileName;
+    int zoomLevel, column, row;
+    if ( !isPackedTile( fileName, packFileName, zoomLevel, column, row ) ) {
+        return m_filePolicy.updateFile( fileName, data );
+    }
+
+    MbTileStorage *const storage = MbTileStorage::storage( packFileName, true );
+    if ( !storage ) {
+        m_errorMsg = packFileName + QLatin1String(": cannot create tile pack");
+        return false;
+    }
+
+    qint64 sizeDelta = 0;
+    if ( !storage->storeTile( zoomLevel, column, row, data, &sizeDelta ) ) {
+        m_errorMsg = storage->lastErrorMessage();
+        return false;
+    }
+
+    FileStorageIndex::index( m_dataDirectory )->recordUpdate( fileName, data.size() );
+    emit sizeChanged( sizeDelta );
+    return true;
+}
+
+void MbTileStoragePolicy::clearCache()
+{
+    m_filePolicy.clearCache();
+
+    if ( m_dataDirectory.isEmpty() || !m_dataDirectory.endsWith(QLatin1String( "data" )) )
+    {
+        return;
+    }
+
+    // maps/<planet>/<theme>/tiles.mbtiles
+    const QString cachedMapsDirectory = m_dataDirectory + QLatin1String("/maps");
+    QDirIterator it( cachedMapsDirectory, QStringList() << QFileInfo( MbTileStorage::packFileName( QString() ) ).fileName(),
+                     QDir::Files, QDirIterator::Subdirectories );
+    while ( it.hasNext() ) {
+        MbTileStorage *const storage = MbTileStorage::storage( it.next() );
+        if ( storage ) {
+            emit sizeChanged( -storage->removeTiles( maxBaseTileLevel + 1 ) );
+        }
+    }
+}
+
+QString MbTileStoragePolicy::lastErrorMessage() const
+{
+    return m_errorMsg.isEmpty() ? m_filePolicy.lastErrorMessage() : m_errorMsg;
+}
+
+bool MbTileStoragePolicy::isPackedTile( const QString &fileName, QString &packFileName,
+                                        int &zoomLevel, int &column, int &row ) const
+{
+    // Only images are packed, TileLoader hands vector tiles to parser
+    // plugins which need files
+    const QByteArray suffix = QFileInfo( fileName ).suffix().toLower().toLatin1();
+    if ( !QImageReader::supportedImageFormats().contains( suffix ) ) {
+        return false;
+    }
+
+    QString themePath;
+    if ( !MbTileStorage::parseTileFileName( fileName, themePath, zoomLevel, column, row ) ) {
+        return false;
+    }
+
+    // Base tiles stay files, e.g. GeoSceneTileDataset reads the tile size from them
+    if ( zoomLevel <= maxBaseTileLevel ) {
+        return false;
+    }
+
+    const QString packName = MbTileStorage::packFileName( themePath );
+    packFileName = QFileInfo( packName ).isAbsolute() ? packName : m_dataDirectory + QLatin1Char('/') + packName;
+    return true;
+}
+
+#include "moc_MbTileStoragePolicy.cpp"
@@ -0,0 +1,74 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_MBTILESTORAGEPOLICY_H
+#define MARBLE_MBTILESTORAGEPOLICY_H
+
+#include "StoragePolicy.h"
+#include "FileStoragePolicy.h"
+
+namespace Marble
+{
+
+/**
+ * @short Stores downloaded texture tiles in one MBTiles pack per theme.
+ *
+ * Millions of tiles stored as individual files exhaust the inodes of the
+ * file system and make reading them seek-bound. This policy stores image
+ * tiles above maxBaseTileLevel in the tile pack of their theme instead (see
+ * MbTileStorage), where TileLoader finds them. Base tiles, vector tiles and
+ * all other files are written as files like FileStoragePolicy does.
+ */
+class MbTileStoragePolicy : public StoragePolicy
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * Creates a new tile pack storage policy.
+         *
+         * @param dataDirectory The directory where the data should go to.
+         */
+        explicit MbTileStoragePolicy( const QString &dataDirectory = QString(), QObject *parent = 0 );
+
+        ~MbTileStoragePolicy();
+
+        /**
+         * Returns whether the @p fileName exists already, either in a tile pack or as a file.
+         */
+        bool fileExists( const QString &fileName ) const;
+
+        /**
+         * Updates the @p fileName with the given @p data.
+         */
+        bool updateFile( const QString &fileName, const QByteArray &data );
+
+        /**
+         * Clears the cache.
+         */
+        void clearCache();
+
+        /**
+         * Returns the last error message.
+         */
+        QString lastErrorMessage() const;
+
+    private:
+        Q_DISABLE_COPY( MbTileStoragePolicy )
+
+        bool isPackedTile( const QString &fileName, QString &packFileName,
+                           int &zoomLevel, int &column, int &row ) const;
+
+        QString m_dataDirectory;
+        FileStoragePolicy m_filePolicy;
+        QString m_errorMsg;
+};
+
+}
+
+#endif
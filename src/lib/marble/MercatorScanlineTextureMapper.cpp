@@ -21,6 +21,7 @@
 #include <QRunnable>
 
 // Marble
+#include "FrameProfiler.h"
 #include "GeoPainter.h"
 #include "MarbleDebug.h"
 #include "ScanlineTextureMapperContext.h"
@@ -35,7 +36,8 @@ using namespace Marble;
 class MercatorScanlineTextureMapper::RenderJob : public QRunnable
 {
 public:
-    RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, int yTop, int yBottom );
+    RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality,
+               int xLeft, int xRight, ScanlineJobQueue *jobQueue );
 
     virtual void run();
 
@@ -45,18 +47,22 @@ private:
     QImage *const m_canvasImage;
     const ViewportParams *const m_viewport;
     const MapQuality m_mapQuality;
-    const int m_yPaintedTop;
-    const int m_yPaintedBottom;
+    // columns [m_xLeft, m_xRight) of the scanlines get mapped
+    const int m_xLeft;
+    const int m_xRight;
+    ScanlineJobQueue *const m_jobQueue;
 };
 
-MercatorScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, int yTop, int yBottom )
+MercatorScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality,
+                                                     int xLeft, int xRight, ScanlineJobQueue *jobQueue )
     : m_tileLoader( tileLoader ),
       m_tileLevel( tileLevel ),
       m_canvasImage( canvasImage ),
       m_viewport( viewport ),
       m_mapQuality( mapQuality ),
-      m_yPaintedTop( yTop ),
-      m_yPaintedBottom( yBottom )
+      m_xLeft( xLeft ),
+      m_xRight( xRight ),
+      m_jobQueue( jobQueue )
 {
 }
 
@@ -64,7 +70,17 @@ MercatorScanlineTextureMapper::MercatorScanlineTextureMapper( StackedTileLoader
     : TextureMapperInterface(),
       m_tileLoader( tileLoader ),
       m_radius( 0 ),
-      m_oldYPaintedTop( 0 )
+      m_oldYPaintedTop( 0 ),
+      m_centerLon( 0.0 ),
+      m_yCenterOffset( 0 ),
+      m_shiftedWidth( 0 ),
+      m_shiftedHeight( 0 ),
+      m_tileLevel( -1 ),
+      m_mapQuality( NormalQuality )
+{
+}
+
+void MercatorScanlineTextureMapper::setCenterChanged()
 {
 }
 
@@ -89,16 +105,31 @@ void MercatorScanlineTextureMapper::mapTexture( GeoPainter *painter,
         m_repaintNeeded = true;
     }
 
+    // The colorizer embosses the canvas as a whole, so reusing it would
+    // leave traces of the previous frame.
+    if ( !m_repaintNeeded
+         && ( viewport->centerLongitude() != m_centerLon || yCenterOffset( viewport ) != m_yCenterOffset ) ) {
+        m_repaintNeeded = texColorizer
+                          || tileZoomLevel != m_tileLevel
+                          || painter->mapQuality() != m_mapQuality
+                          || !shiftTexture( viewport, tileZoomLevel, painter->mapQuality() );
+    }
+
     if ( m_repaintNeeded ) {
         mapTexture( viewport, tileZoomLevel, painter->mapQuality() );
 
         if ( texColorizer ) {
-            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality() );
+            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality(), &m_threadPool );
         }
 
+        m_centerLon = viewport->centerLongitude();
         m_repaintNeeded = false;
     }
 
+    m_yCenterOffset = yCenterOffset( viewport );
+    m_tileLevel = tileZoomLevel;
+    m_mapQuality = painter->mapQuality();
+
     painter->drawImage( dirtyRect, m_canvasImage, dirtyRect );
 }
 
@@ -113,28 +144,10 @@ void MercatorScanlineTextureMapper::mapTexture( const ViewportParams *viewport,
 
     // Calculate y-range the represented by the center point, yTop and
     // what actually can be painted
-
-    qreal realYTop, realYBottom, dummyX;
-    GeoDataCoordinates yNorth(0, viewport->currentProjection()->maxLat(), 0);
-    GeoDataCoordinates ySouth(0, viewport->currentProjection()->minLat(), 0);
-    viewport->screenCoordinates(yNorth, dummyX, realYTop );
-    viewport->screenCoordinates(ySouth, dummyX, realYBottom );
-
-    const int yTop     = qBound(qreal(0.0), realYTop, qreal(imageHeight));
-    int yPaintedTop    = yTop;
-    int yPaintedBottom = qBound(qreal(0.0), realYBottom, qreal(imageHeight));
- 
-    yPaintedTop = qBound(0, yPaintedTop, imageHeight);
-    yPaintedBottom = qBound(0, yPaintedBottom, imageHeight);
-
-    const int numThreads = m_threadPool.maxThreadCount();
-    const int yStep = ( yPaintedBottom - yPaintedTop ) / numThreads;
-    for ( int i = 0; i < numThreads; ++i ) {
-        const int yStart = yPaintedTop +  i      * yStep;
-        const int yEnd   = yPaintedTop + (i + 1) * yStep;
-        QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality, yStart, yEnd );
-        m_threadPool.start( job );
-    }
+    int yPaintedTop;
+    int yPaintedBottom;
+    paintedRange( viewport, imageHeight, yPaintedTop, yPaintedBottom );
+    const int yTop = yPaintedTop;
 
     // Remove unused lines
     const int clearStart = ( yPaintedTop - m_oldYPaintedTop <= 0 ) ? yPaintedBottom : 0;
@@ -147,11 +160,120 @@ void MercatorScanlineTextureMapper::mapTexture( const ViewportParams *viewport,
         *(it) = 0;
     }
 
-    m_threadPool.waitForDone();
+    const QRect paintedRect( 0, yPaintedTop, m_canvasImage.width(), yPaintedBottom - yPaintedTop );
+    mapRects( QVector<QRect>() << paintedRect, viewport, tileZoomLevel, mapQuality );
+
+    m_oldYPaintedTop = yPaintedTop;
+    m_shiftedWidth = 0;
+    m_shiftedHeight = 0;
+
+    m_tileLoader->cleanupTilehash();
+}
+
+bool MercatorScanlineTextureMapper::shiftTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality )
+{
+    const int imageWidth  = m_canvasImage.width();
+    const int imageHeight = m_canvasImage.height();
+    const float rad2Pixel = (float)( 2 * viewport->radius() ) / M_PI;
+    const qreal pixel2Rad = 1.0/rad2Pixel;
+
+    qreal deltaLon = viewport->centerLongitude() - m_centerLon;
+    while ( deltaLon < -M_PI ) deltaLon += 2 * M_PI;
+    while ( deltaLon >  M_PI ) deltaLon -= 2 * M_PI;
+
+    // The scanlines only line up with the previous ones if the map moved by
+    // whole pixels, which is the case while the map gets dragged around.
+    // m_centerLon is the longitude the canvas shows, so the fractions of a
+    // pixel left over by earlier shifts do not add up.
+    const qreal realDx = deltaLon / pixel2Rad;
+    const int dx = qRound( realDx );
+    const int dy = yCenterOffset( viewport ) - m_yCenterOffset;
+    // The tiles under the reused part of the canvas stay on display, so it
+    // gets mapped as a whole again once that part might have left the view.
+    // This drops the tiles which are no longer shown.
+    if ( qAbs( realDx - dx ) > 0.05
+         || m_shiftedWidth + qAbs( dx ) >= imageWidth || m_shiftedHeight + qAbs( dy ) >= imageHeight ) {
+        return false;
+    }
+    if ( dx == 0 && dy == 0 ) {
+        return true;
+    }
+
+    int yPaintedTop;
+    int yPaintedBottom;
+    paintedRange( viewport, imageHeight, yPaintedTop, yPaintedBottom );
+
+    m_tileLoader->keepTilehash();
+
+    // the map moves to the left as the center moves to the east
+    ScanlineTextureMapperContext::shiftCanvas( &m_canvasImage, -dx, dy );
+
+    // Remove the lines moved beyond the maximum latitudes
+    const int bytesPerLine = m_canvasImage.bytesPerLine();
+    memset( m_canvasImage.scanLine( 0 ), 0, yPaintedTop * bytesPerLine );
+    if ( yPaintedBottom < imageHeight ) {
+        memset( m_canvasImage.scanLine( yPaintedBottom ), 0, ( imageHeight - yPaintedBottom ) * bytesPerLine );
+    }
+
+    mapRects( ScanlineTextureMapperContext::exposedRects( m_canvasImage.size(), -dx, dy, yPaintedTop, yPaintedBottom ),
+              viewport, tileZoomLevel, mapQuality );
 
     m_oldYPaintedTop = yPaintedTop;
+    m_shiftedWidth += qAbs( dx );
+    m_shiftedHeight += qAbs( dy );
+    m_centerLon += dx * pixel2Rad;
+    if ( m_centerLon < -M_PI ) m_centerLon += 2 * M_PI;
+    if ( m_centerLon >  M_PI ) m_centerLon -= 2 * M_PI;
 
     m_tileLoader->cleanupTilehash();
+
+    return true;
+}
+
+void MercatorScanlineTextureMapper::mapRects( const QVector<QRect> &rects, const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality )
+{
+    const int numThreads = m_threadPool.maxThreadCount();
+    QList<ScanlineJobQueue *> jobQueues;
+    int mappedPixels = 0;
+
+    foreach ( const QRect &rect, rects ) {
+        if ( rect.isEmpty() ) {
+            continue;
+        }
+
+        ScanlineJobQueue *const jobQueue = new ScanlineJobQueue( rect.top(), rect.bottom() + 1, numThreads );
+        jobQueues << jobQueue;
+        for ( int i = 0; i < numThreads; ++i ) {
+            QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality,
+                                                  rect.left(), rect.right() + 1, jobQueue );
+            m_threadPool.start( job );
+        }
+        mappedPixels += rect.width() * rect.height();
+    }
+
+    m_threadPool.waitForDone();
+    qDeleteAll( jobQueues );
+
+    FrameProfiler::instance()->addCounter( "texture pixels mapped", mappedPixels );
+}
+
+void MercatorScanlineTextureMapper::paintedRange( const ViewportParams *viewport, int imageHeight, int &yPaintedTop, int &yPaintedBottom )
+{
+    qreal realYTop, realYBottom, dummyX;
+    GeoDataCoordinates yNorth(0, viewport->currentProjection()->maxLat(), 0);
+    GeoDataCoordinates ySouth(0, viewport->currentProjection()->minLat(), 0);
+    viewport->screenCoordinates(yNorth, dummyX, realYTop );
+    viewport->screenCoordinates(ySouth, dummyX, realYBottom );
+
+    yPaintedTop    = qBound(qreal(0.0), realYTop, qreal(imageHeight));
+    yPaintedBottom = qBound(qreal(0.0), realYBottom, qreal(imageHeight));
+}
+
+int MercatorScanlineTextureMapper::yCenterOffset( const ViewportParams *viewport )
+{
+    const float rad2Pixel = (float)( 2 * viewport->radius() ) / M_PI;
+
+    return (int)( asinh( tan( viewport->centerLatitude() ) ) * rad2Pixel );
 }
 
 
@@ -180,11 +302,11 @@ void MercatorScanlineTextureMapper::RenderJob::run()
 
     const int yCenterOffset = (int)( asinh( tan( centerLat ) ) * rad2Pixel  );
 
-    qreal leftLon = + centerLon - ( imageWidth / 2 * pixel2Rad );
+    qreal leftLon = + centerLon - ( imageWidth / 2 * pixel2Rad ) + m_xLeft * pixel2Rad;
     while ( leftLon < -M_PI ) leftLon += 2 * M_PI;
     while ( leftLon >  M_PI ) leftLon -= 2 * M_PI;
 
-    const int maxInterpolationPointX = n * (int)( imageWidth / n - 1 ) + 1;
+    const int maxInterpolationPointX = m_xLeft + n * (int)( ( m_xRight - m_xLeft ) / n - 1 ) + 1;
 
 
     // initialize needed variables that are modified during texture mapping:
@@ -194,58 +316,65 @@ void MercatorScanlineTextureMapper::RenderJob::run()
 
     // Scanline based algorithm to do texture mapping
 
-    for ( int y = m_yPaintedTop; y < m_yPaintedBottom; ++y ) {
-
-        QRgb * scanLine = (QRgb*)( m_canvasImage->scanLine( y ) );
-
-        qreal lon = leftLon;
-        const qreal lat = gd ( ( (imageHeight / 2 + yCenterOffset) - y )
-                    * pixel2Rad );
-
-        for ( int x = 0; x < imageWidth; ++x ) {
-            // Prepare for interpolation
-            bool interpolate = false;
-            if ( x > 0 && x <= maxInterpolationPointX ) {
-                x += n - 1;
-                lon += (n - 1) * pixel2Rad;
-                interpolate = !printQuality;
-            }
-            else {
-                interpolate = false;
+    // Keep pulling chunks of scanlines until the canvas is done, reusing
+    // the context (and its current tile) across chunks.
+    int yStart;
+    int yEnd;
+    while ( m_jobQueue->nextChunk( yStart, yEnd ) ) {
+
+        for ( int y = yStart; y < yEnd; ++y ) {
+
+            QRgb * scanLine = (QRgb*)( m_canvasImage->scanLine( y ) ) + m_xLeft;
+
+            qreal lon = leftLon;
+            const qreal lat = gd ( ( (imageHeight / 2 + yCenterOffset) - y )
+                        * pixel2Rad );
+
+            for ( int x = m_xLeft; x < m_xRight; ++x ) {
+                // Prepare for interpolation
+                bool interpolate = false;
+                if ( x > m_xLeft && x <= maxInterpolationPointX ) {
+                    x += n - 1;
+                    lon += (n - 1) * pixel2Rad;
+                    interpolate = !printQuality;
+                }
+                else {
+                    interpolate = false;
+                }
+
+                if ( lon < -M_PI ) lon += 2 * M_PI;
+                if ( lon >  M_PI ) lon -= 2 * M_PI;
+
+                if ( interpolate ) {
+                    if (highQuality)
+                        context.pixelValueApproxF( lon, lat, scanLine, n );
+                    else
+                        context.pixelValueApprox( lon, lat, scanLine, n );
+
+                    scanLine += ( n - 1 );
+                }
+
+                if ( x < m_xRight ) {
+                    if ( highQuality )
+                        context.pixelValueF( lon, lat, scanLine );
+                    else
+                        context.pixelValue( lon, lat, scanLine );
+                }
+
+                ++scanLine;
+                lon += pixel2Rad;
             }
 
-            if ( lon < -M_PI ) lon += 2 * M_PI;
-            if ( lon >  M_PI ) lon -= 2 * M_PI;
+            // copy scanline to improve performance
+            if ( interlaced && y + 1 < yEnd ) { 
 
-            if ( interpolate ) {
-                if (highQuality)
-                    context.pixelValueApproxF( lon, lat, scanLine, n );
-                else
-                    context.pixelValueApprox( lon, lat, scanLine, n );
+                const int pixelByteSize = m_canvasImage->bytesPerLine() / imageWidth;
 
-                scanLine += ( n - 1 );
+                memcpy( m_canvasImage->scanLine( y + 1 ) + m_xLeft * pixelByteSize,
+                        m_canvasImage->scanLine( y     ) + m_xLeft * pixelByteSize,
+                        ( m_xRight - m_xLeft ) * pixelByteSize );
+                ++y;
             }
-
-            if ( x < imageWidth ) {
-                if ( highQuality )
-                    context.pixelValueF( lon, lat, scanLine );
-                else
-                    context.pixelValue( lon, lat, scanLine );
-            }
-
-            ++scanLine;
-            lon += pixel2Rad;
-        }
-
-        // copy scanline to improve performance
-        if ( interlaced && y + 1 < m_yPaintedBottom ) { 
-
-            const int pixelByteSize = m_canvasImage->bytesPerLine() / imageWidth;
-
-            memcpy( m_canvasImage->scanLine( y + 1 ),
-                    m_canvasImage->scanLine( y     ),
-                    imageWidth * pixelByteSize );
-            ++y;
         }
     }
 }
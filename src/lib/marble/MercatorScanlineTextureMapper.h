@@ -20,6 +20,7 @@
 
 #include <QThreadPool>
 #include <QImage>
+#include <QVector>
 
 
 namespace Marble
@@ -36,8 +37,19 @@ class MercatorScanlineTextureMapper : public TextureMapperInterface
                              const QRect &dirtyRect,
                              TextureColorizer *texColorizer );
 
+    /**
+     * Panning is detected in mapTexture(), which moves the canvas along
+     * as long as the map moved by whole pixels.
+     */
+    virtual void setCenterChanged();
+
  private:
     void mapTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality );
+    bool shiftTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality );
+    void mapRects( const QVector<QRect> &rects, const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality );
+
+    static void paintedRange( const ViewportParams *viewport, int imageHeight, int &yPaintedTop, int &yPaintedBottom );
+    static int yCenterOffset( const ViewportParams *viewport );
 
  private:
     class RenderJob;
@@ -46,6 +58,14 @@ class MercatorScanlineTextureMapper : public TextureMapperInterface
     int m_radius;
     QImage m_canvasImage;
     int    m_oldYPaintedTop;
+    // the view the canvas has been mapped for
+    qreal  m_centerLon;
+    int    m_yCenterOffset;
+    // the pixels the canvas has been shifted by since it was mapped as a whole
+    int    m_shiftedWidth;
+    int    m_shiftedHeight;
+    int    m_tileLevel;
+    MapQuality m_mapQuality;
     QThreadPool m_threadPool;
 };
 
@@ -27,6 +27,7 @@
 #include "GeoSceneTextureTileDataset.h"
 #include "ImageF.h"
 #include "StackedTile.h"
+#include "SunShadingMap.h"
 #include "TileLoaderHelper.h"
 #include "TextureTile.h"
 #include "TileLoader.h"
@@ -35,6 +36,9 @@
 
 #include <QPointer>
 #include <QPainter>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QWriteLocker>
 
 using namespace Marble;
 
@@ -43,8 +47,6 @@ class Q_DECL_HIDDEN MergedLayerDecorator::Private
 public:
     Private( TileLoader *tileLoader, const SunLocator *sunLocator );
 
-    static int maxDivisor( int maximum, int fullLength );
-
     StackedTile *createTile( const QVector<QSharedPointer<TextureTile> > &tiles ) const;
 
     void renderGroundOverlays( QImage *tileImage, const QVector<QSharedPointer<TextureTile> > &tiles ) const;
@@ -66,6 +68,9 @@ public:
     bool m_showSunShading;
     bool m_showCityLights;
     bool m_showTileId;
+    // Tiles are loaded on worker threads as well, so guard the settings above
+    // against modification while a tile is being created.
+    QReadWriteLock m_settingsLock;
 };
 
 MergedLayerDecorator::Private::Private( TileLoader *tileLoader, const SunLocator *sunLocator ) :
@@ -98,6 +103,8 @@ void MergedLayerDecorator::setTextureLayers( const QVector<const GeoSceneTexture
 {
     mDebug() << Q_FUNC_INFO;
 
+    QWriteLocker locker( &d->m_settingsLock );
+
     if ( textureLayers.count() > 0 ) {
         const GeoSceneTileDataset *const firstTexture = textureLayers.at( 0 );
         d->m_levelZeroColumns = firstTexture->levelZeroColumns();
@@ -113,6 +120,7 @@ void MergedLayerDecorator::setTextureLayers( const QVector<const GeoSceneTexture
 
 void MergedLayerDecorator::updateGroundOverlays(const QList<const GeoDataGroundOverlay *> &groundOverlays )
 {
+    QWriteLocker locker( &d->m_settingsLock );
     d->m_groundOverlays = groundOverlays;
 }
 
@@ -301,8 +309,10 @@ void MergedLayerDecorator::Private::renderGroundOverlays( QImage *tileImage, con
     }
 }
 
-StackedTile *MergedLayerDecorator::loadTile( const TileId &stackedTileId )
+StackedTile *MergedLayerDecorator::loadTile( const TileId &stackedTileId, DownloadUsage usage )
 {
+    QReadLocker locker( &d->m_settingsLock );
+
     const QVector<const GeoSceneTextureTileDataset *> textureLayers = d->findRelevantTextureLayers( stackedTileId );
     QVector<QSharedPointer<TextureTile> > tiles;
     tiles.reserve(textureLayers.size());
@@ -320,7 +330,7 @@ StackedTile *MergedLayerDecorator::loadTile( const TileId &stackedTileId )
         }
 
         const GeoSceneTextureTileDataset *const textureLayer = static_cast<const GeoSceneTextureTileDataset *>( layer );
-        const QImage tileImage = d->m_tileLoader->loadTileImage( textureLayer, tileId, DownloadBrowse );
+        const QImage tileImage = d->m_tileLoader->loadTileImage( textureLayer, tileId, usage );
 
         QSharedPointer<TextureTile> tile( new TextureTile( tileId, tileImage, blending ) );
         tiles.append( tile );
@@ -369,7 +379,11 @@ StackedTile *MergedLayerDecorator::updateTile( const StackedTile &stackedTile, c
 {
     Q_ASSERT( !tileImage.isNull() );
 
+    d->m_settingsLock.lockForWrite();
     d->detectMaxTileLevel();
+    d->m_settingsLock.unlock();
+
+    QReadLocker locker( &d->m_settingsLock );
 
     QVector<QSharedPointer<TextureTile> > tiles = stackedTile.tiles();
 
@@ -384,6 +398,32 @@ StackedTile *MergedLayerDecorator::updateTile( const StackedTile &stackedTile, c
     return d->createTile( tiles );
 }
 
+StackedTile *MergedLayerDecorator::recreateTile( const StackedTile &stackedTile )
+{
+    QReadLocker locker( &d->m_settingsLock );
+
+    return d->createTile( stackedTile.tiles() );
+}
+
+bool MergedLayerDecorator::isSunShadingOutdated( const TileId &stackedTileId, qreal previousSunLon, qreal previousSunLat ) const
+{
+    QReadLocker locker( &d->m_settingsLock );
+
+    if ( !d->m_showSunShading ) {
+        return false;
+    }
+
+    const SunShadingMap::Coverage previous = SunShadingMap::coverage( d->m_sunLocator, previousSunLon, previousSunLat,
+                                                                      stackedTileId, d->m_levelZeroColumns, d->m_levelZeroRows );
+    if ( previous == SunShadingMap::Twilight ) {
+        return true;
+    }
+
+    const SunShadingMap::Coverage current = SunShadingMap::coverage( d->m_sunLocator, d->m_sunLocator->getLon(), d->m_sunLocator->getLat(),
+                                                                     stackedTileId, d->m_levelZeroColumns, d->m_levelZeroRows );
+    return current != previous;
+}
+
 void MergedLayerDecorator::downloadStackedTile( const TileId &id, DownloadUsage usage )
 {
     const QVector<const GeoSceneTextureTileDataset *> textureLayers = d->findRelevantTextureLayers( id );
@@ -397,6 +437,7 @@ void MergedLayerDecorator::downloadStackedTile( const TileId &id, DownloadUsage
 
 void MergedLayerDecorator::setShowSunShading( bool show )
 {
+    QWriteLocker locker( &d->m_settingsLock );
     d->m_showSunShading = show;
 }
 
@@ -407,6 +448,7 @@ bool MergedLayerDecorator::showSunShading() const
 
 void MergedLayerDecorator::setShowCityLights( bool show )
 {
+    QWriteLocker locker( &d->m_settingsLock );
     d->m_showCityLights = show;
 }
 
@@ -417,88 +459,15 @@ bool MergedLayerDecorator::showCityLights() const
 
 void MergedLayerDecorator::setShowTileId( bool visible )
 {
+    QWriteLocker locker( &d->m_settingsLock );
     d->m_showTileId = visible;
 }
 
 void MergedLayerDecorator::Private::paintSunShading( QImage *tileImage, const TileId &id ) const
 {
-    if ( tileImage->depth() != 32 )
-        return;
-
     // TODO add support for 8-bit maps?
-    // add sun shading
-    const qreal  global_width  = tileImage->width()
-            * TileLoaderHelper::levelToColumn( m_levelZeroColumns, id.zoomLevel() );
-    const qreal  global_height = tileImage->height()
-            * TileLoaderHelper::levelToRow( m_levelZeroRows, id.zoomLevel() );
-    const qreal lon_scale = 2*M_PI / global_width;
-    const qreal lat_scale = -M_PI / global_height;
-    const int tileHeight = tileImage->height();
-    const int tileWidth = tileImage->width();
-
-    // First we determine the supporting point interval for the interpolation.
-    const int n = maxDivisor( 30, tileWidth );
-    const int ipRight = n * (int)( tileWidth / n );
-
-    for ( int cur_y = 0; cur_y < tileHeight; ++cur_y ) {
-        const qreal lat = lat_scale * ( id.y() * tileHeight + cur_y ) - 0.5*M_PI;
-        const qreal a = sin( (lat+DEG2RAD * m_sunLocator->getLat() )/2.0 );
-        const qreal c = cos(lat)*cos( -DEG2RAD * m_sunLocator->getLat() );
-
-        QRgb* scanline = (QRgb*)tileImage->scanLine( cur_y );
-
-        qreal lastShade = -10.0;
-
-        int cur_x = 0;
-
-        while ( cur_x < tileWidth ) {
-
-            const bool interpolate = ( cur_x != 0 && cur_x < ipRight && cur_x + n < tileWidth );
-
-            qreal shade = 0;
-
-            if ( interpolate ) {
-                const int check = cur_x + n;
-                const qreal checklon   = lon_scale * ( id.x() * tileWidth + check );
-                shade = m_sunLocator->shading( checklon, a, c );
-
-                // if the shading didn't change across the interpolation
-                // interval move on and don't change anything.
-                if ( shade == lastShade && shade == 1.0 ) {
-                    scanline += n;
-                    cur_x += n;
-                    continue;
-                }
-                if ( shade == lastShade && shade == 0.0 ) {
-                    for ( int t = 0; t < n; ++t ) {
-                        m_sunLocator->shadePixel( *scanline, shade );
-                        ++scanline;
-                    }
-                    cur_x += n;
-                    continue;
-                }
-                for ( int t = 0; t < n ; ++t ) {
-                    const qreal lon   = lon_scale * ( id.x() * tileWidth + cur_x );
-                    shade = m_sunLocator->shading( lon, a, c );
-                    m_sunLocator->shadePixel( *scanline, shade );
-                    ++scanline;
-                    ++cur_x;
-                }
-            }
-
-            else {
-                // Make sure we don't exceed the image memory
-                if ( cur_x < tileWidth ) {
-                    const qreal lon   = lon_scale * ( id.x() * tileWidth + cur_x );
-                    shade = m_sunLocator->shading( lon, a, c );
-                    m_sunLocator->shadePixel( *scanline, shade );
-                    ++scanline;
-                    ++cur_x;
-                }
-            }
-            lastShade = shade;
-        }
-    }
+    const SunShadingMap shadingMap( m_sunLocator, id, tileImage->size(), m_levelZeroColumns, m_levelZeroRows );
+    shadingMap.shade( tileImage );
 }
 
 void MergedLayerDecorator::Private::paintTileId( QImage *tileImage, const TileId &id ) const
@@ -593,25 +562,3 @@ QVector<const GeoSceneTextureTileDataset *> MergedLayerDecorator::Private::findR
 
     return result;
 }
-
-// TODO: This should likely go into a math class in the future ...
-
-int MergedLayerDecorator::Private::maxDivisor( int maximum, int fullLength )
-{
-    // Find the optimal interpolation interval n for the
-    // current image canvas width
-    int best = 2;
-
-    int  nEvalMin = fullLength;
-    for ( int it = 1; it <= maximum; ++it ) {
-        // The optimum is the interval which results in the least amount
-        // supporting points taking into account the rest which can't
-        // get used for interpolation.
-        int nEval = fullLength / it + fullLength % it;
-        if ( nEval < nEvalMin ) {
-            nEvalMin = nEval;
-            best = it;
-        }
-    }
-    return best;
-}
@@ -61,15 +61,34 @@ class MergedLayerDecorator
 
     QSize tileSize() const;
 
-    StackedTile *loadTile( const TileId &id );
+    /**
+     * Reads, decodes and blends the texture tiles of the stacked tile @p id.
+     * Missing texture tiles are queued for download with the given @p usage.
+     * @note This method is thread-safe and gets called from worker threads.
+     */
+    StackedTile *loadTile( const TileId &id, DownloadUsage usage = DownloadBrowse );
 
     StackedTile *updateTile( const StackedTile &stackedTile, const TileId &tileId, const QImage &tileImage );
 
+    /**
+     * Blends the texture tiles of @p stackedTile once more, e.g. to pick up
+     * a new position of the sun.
+     */
+    StackedTile *recreateTile( const StackedTile &stackedTile );
+
     void downloadStackedTile( const TileId &id, DownloadUsage usage );
 
     void setShowSunShading( bool show );
     bool showSunShading() const;
 
+    /**
+     * Returns whether the sun shading of the stacked tile @p stackedTileId
+     * needs to be blended again since the sun moved from @p previousSunLon
+     * and @p previousSunLat (in degrees) to its current position. This is
+     * the case for tiles at the terminator only.
+     */
+    bool isSunShadingOutdated( const TileId &stackedTileId, qreal previousSunLon, qreal previousSunLat ) const;
+
     void setShowCityLights( bool show );
     bool showCityLights() const;
 
@@ -0,0 +1,275 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PlacemarkGlyphAtlas.h"
+
+#include "FrameProfiler.h"
+
+#include <QImage>
+#include <QPainter>
+
+namespace Marble
+{
+
+namespace
+{
+
+// space kept free around glyphs, so that neighbors never bleed into each other
+const int GlyphPadding = 1;
+
+}
+
+class PlacemarkGlyphAtlasInstance
+{
+public:
+    PlacemarkGlyphAtlas atlas;
+};
+
+Q_GLOBAL_STATIC( PlacemarkGlyphAtlasInstance, s_instance )
+
+PlacemarkGlyphAtlas *PlacemarkGlyphAtlas::instance()
+{
+    return &s_instance->atlas;
+}
+
+PlacemarkGlyphAtlas::PlacemarkGlyphAtlas( int pageSize, int maximumPages ) :
+    m_pageSize( qMax( 64, pageSize ) ),
+    m_maximumPages( qMax( 1, maximumPages ) ),
+    m_frame( 0 )
+{
+}
+
+PlacemarkGlyphAtlas::~PlacemarkGlyphAtlas()
+{
+}
+
+int PlacemarkGlyphAtlas::pageSize() const
+{
+    return m_pageSize;
+}
+
+int PlacemarkGlyphAtlas::maximumPages() const
+{
+    return m_maximumPages;
+}
+
+void PlacemarkGlyphAtlas::beginFrame()
+{
+    QMutexLocker locker( &m_mutex );
+    ++m_frame;
+
+    // pages may have been added beyond the limit while every page was in use
+    while ( allocatedPages() > m_maximumPages ) {
+        const int index = evictablePage();
+        if ( index < 0 ) {
+            break;
+        }
+        clearPage( index, true );
+    }
+}
+
+PlacemarkGlyphAtlas::Glyph PlacemarkGlyphAtlas::glyph( const QString &key )
+{
+    QMutexLocker locker( &m_mutex );
+    const Glyph glyph = m_glyphs.value( key );
+    if ( glyph.isValid() ) {
+        m_pages[glyph.page].lastUsed = m_frame;
+    }
+    return glyph;
+}
+
+PlacemarkGlyphAtlas::Glyph PlacemarkGlyphAtlas::insert( const QString &key, const QImage &image )
+{
+    if ( image.isNull() ) {
+        return Glyph();
+    }
+
+    QMutexLocker locker( &m_mutex );
+
+    Glyph glyph = m_glyphs.value( key );
+    if ( glyph.isValid() ) {
+        m_pages[glyph.page].lastUsed = m_frame;
+        return glyph;
+    }
+
+    const QSize size = image.size() + QSize( GlyphPadding, GlyphPadding );
+    QRect rect;
+
+    int index = 0;
+    for ( ; index < m_pages.size(); ++index ) {
+        if ( !m_pages[index].pixmap.isNull() && allocate( m_pages[index], size, rect ) ) {
+            break;
+        }
+    }
+
+    if ( index == m_pages.size() ) {
+        // Reuse the least recently used page once the atlas is full. Pages of
+        // the current frame are still to be drawn, so the atlas rather grows
+        // until the next frame if all of them are in use.
+        index = allocatedPages() < m_maximumPages ? -1 : evictablePage();
+        if ( index >= 0 ) {
+            clearPage( index, m_pages[index].pixmap.width() < size.width()
+                              || m_pages[index].pixmap.height() < size.height() );
+        } else {
+            for ( index = 0; index < m_pages.size(); ++index ) {
+                if ( m_pages[index].pixmap.isNull() ) {
+                    break;
+                }
+            }
+            if ( index == m_pages.size() ) {
+                Page page;
+                page.height = 0;
+                page.generation = 0;
+                page.lastUsed = m_frame;
+                m_pages << page;
+            }
+        }
+
+        Page &page = m_pages[index];
+        if ( page.pixmap.isNull() ) {
+            // glyphs larger than a page get a page of their own
+            page.pixmap = QPixmap( qMax( m_pageSize, size.width() ), qMax( m_pageSize, size.height() ) );
+            page.pixmap.fill( Qt::transparent );
+        }
+
+        const bool allocated = allocate( page, size, rect );
+        Q_ASSERT( allocated );
+        Q_UNUSED( allocated );
+    }
+
+    Page &page = m_pages[index];
+    QPainter painter( &page.pixmap );
+    painter.setCompositionMode( QPainter::CompositionMode_Source );
+    painter.drawImage( rect.topLeft(), image );
+    painter.end();
+
+    page.keys << key;
+    page.lastUsed = m_frame;
+
+    glyph.page = index;
+    glyph.generation = page.generation;
+    glyph.rect = QRect( rect.topLeft(), image.size() );
+    m_glyphs.insert( key, glyph );
+
+    FrameProfiler::instance()->addCounter( "glyphs rasterized", 1 );
+    return glyph;
+}
+
+bool PlacemarkGlyphAtlas::use( const Glyph &glyph )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( !glyph.isValid() || glyph.page >= m_pages.size() ) {
+        return false;
+    }
+
+    Page &page = m_pages[glyph.page];
+    if ( page.generation != glyph.generation || page.pixmap.isNull() ) {
+        return false;
+    }
+
+    page.lastUsed = m_frame;
+    return true;
+}
+
+QPixmap PlacemarkGlyphAtlas::page( int index ) const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_pages.value( index ).pixmap;
+}
+
+int PlacemarkGlyphAtlas::pageCount() const
+{
+    QMutexLocker locker( &m_mutex );
+    return allocatedPages();
+}
+
+void PlacemarkGlyphAtlas::clear()
+{
+    QMutexLocker locker( &m_mutex );
+    for ( int i = 0; i < m_pages.size(); ++i ) {
+        clearPage( i, true );
+    }
+}
+
+bool PlacemarkGlyphAtlas::allocate( Page &page, const QSize &size, QRect &rect ) const
+{
+    const int width = page.pixmap.width();
+
+    // Use the first shelf the glyph fits in without wasting more than
+    // a third of the shelf height.
+    for ( int i = 0; i < page.shelves.size(); ++i ) {
+        Shelf &shelf = page.shelves[i];
+        if ( size.height() <= shelf.height && 2 * shelf.height <= 3 * size.height()
+             && shelf.x + size.width() <= width ) {
+            rect = QRect( QPoint( shelf.x, shelf.y ), size );
+            shelf.x += size.width();
+            return true;
+        }
+    }
+
+    if ( page.height + size.height() > page.pixmap.height() || size.width() > width ) {
+        return false;
+    }
+
+    Shelf shelf;
+    shelf.y = page.height;
+    shelf.height = size.height();
+    shelf.x = size.width();
+    page.shelves << shelf;
+    page.height += size.height();
+
+    rect = QRect( QPoint( 0, shelf.y ), size );
+    return true;
+}
+
+int PlacemarkGlyphAtlas::evictablePage() const
+{
+    int result = -1;
+    for ( int i = 0; i < m_pages.size(); ++i ) {
+        const Page &page = m_pages[i];
+        if ( page.pixmap.isNull() || page.lastUsed >= m_frame ) {
+            continue;
+        }
+        if ( result < 0 || page.lastUsed < m_pages[result].lastUsed ) {
+            result = i;
+        }
+    }
+    return result;
+}
+
+void PlacemarkGlyphAtlas::clearPage( int index, bool release )
+{
+    Page &page = m_pages[index];
+    foreach ( const QString &key, page.keys ) {
+        m_glyphs.remove( key );
+    }
+    page.keys.clear();
+    page.shelves.clear();
+    page.height = 0;
+    ++page.generation;
+    page.lastUsed = m_frame;
+
+    if ( release ) {
+        page.pixmap = QPixmap();
+    } else {
+        page.pixmap.fill( Qt::transparent );
+    }
+}
+
+int PlacemarkGlyphAtlas::allocatedPages() const
+{
+    int count = 0;
+    foreach ( const Page &page, m_pages ) {
+        if ( !page.pixmap.isNull() ) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+}
@@ -0,0 +1,132 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_PLACEMARKGLYPHATLAS_H
+#define MARBLE_PLACEMARKGLYPHATLAS_H
+
+#include "marble_export.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QPixmap>
+#include <QRect>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QImage;
+
+namespace Marble
+{
+
+/**
+ * @short A size-bounded texture atlas for placemark labels and symbols.
+ *
+ * Rasterized labels and symbols are packed into a few large pixmaps, the
+ * pages, so that they survive the placemarks leaving and re-entering the
+ * view and can be drawn in batches with QPainter::drawPixmapFragments().
+ * Glyphs are identified by a key describing everything they are rendered
+ * from, e.g. the text, font, color and style of a label.
+ *
+ * Pages are packed in shelves. Once more than maximumPages() pages are in
+ * use, the least recently used pages are cleared at the start of the next
+ * frame. Pages used in the current frame are never cleared, so the glyphs
+ * of a frame stay valid until it has been drawn.
+ *
+ * All methods are thread-safe.
+ */
+class MARBLE_EXPORT PlacemarkGlyphAtlas
+{
+public:
+    struct Glyph
+    {
+        Glyph() : page( -1 ), generation( 0 ) {}
+
+        bool isValid() const { return page >= 0; }
+
+        int page;
+        // the generation of the page the glyph has been stored in
+        int generation;
+        QRect rect;
+    };
+
+    /**
+     * Returns the atlas shared by all placemark layers.
+     */
+    static PlacemarkGlyphAtlas *instance();
+
+    explicit PlacemarkGlyphAtlas( int pageSize = 512, int maximumPages = 8 );
+    ~PlacemarkGlyphAtlas();
+
+    int pageSize() const;
+    int maximumPages() const;
+
+    /**
+     * Starts a new frame, clearing the least recently used pages beyond
+     * maximumPages().
+     */
+    void beginFrame();
+
+    /**
+     * Returns the glyph stored for @p key or an invalid glyph.
+     */
+    Glyph glyph( const QString &key );
+
+    /**
+     * Stores @p image as the glyph for @p key.
+     */
+    Glyph insert( const QString &key, const QImage &image );
+
+    /**
+     * Marks @p glyph as used in the current frame. Returns false if its page
+     * has been cleared since, so the glyph needs to be looked up again.
+     */
+    bool use( const Glyph &glyph );
+
+    QPixmap page( int index ) const;
+    int pageCount() const;
+
+    void clear();
+
+private:
+    Q_DISABLE_COPY( PlacemarkGlyphAtlas )
+
+    struct Shelf
+    {
+        int y;
+        int height;
+        int x;
+    };
+
+    struct Page
+    {
+        QPixmap pixmap;
+        QVector<Shelf> shelves;
+        // the height used by the shelves
+        int height;
+        int generation;
+        qint64 lastUsed;
+        QStringList keys;
+    };
+
+    bool allocate( Page &page, const QSize &size, QRect &rect ) const;
+    int evictablePage() const;
+    void clearPage( int index, bool release );
+    int allocatedPages() const;
+
+    const int m_pageSize;
+    const int m_maximumPages;
+    mutable QMutex m_mutex;
+    QVector<Page> m_pages;
+    QHash<QString, Glyph> m_glyphs;
+    qint64 m_frame;
+};
+
+}
+
+#endif
@@ -21,6 +21,9 @@
 #include <QItemSelectionModel>
 #include <qmath.h>
 
+#include <algorithm>
+
+#include "FrameProfiler.h"
 #include "GeoDataPlacemark.h"
 #include "GeoDataStyle.h"
 #include "GeoDataTypes.h"
@@ -40,19 +43,18 @@
 #include <StyleBuilder.h>
 
 namespace
-{   //Helper function that checks for available room for the label
-    bool hasRoomFor(const QVector<Marble::VisiblePlacemark*> & placemarks, const QRectF &labelRect)
+{
+    // Position in one of the sorted placemark lists of the visible tiles
+    struct PlacemarkCursor
     {
-        // Check if there is another label or symbol that overlaps.
-        QVector<Marble::VisiblePlacemark*>::const_iterator beforeItEnd = placemarks.constEnd();
-        for ( QVector<Marble::VisiblePlacemark*>::ConstIterator beforeIt = placemarks.constBegin();
-              beforeIt != beforeItEnd; ++beforeIt )
-        {
-            if ( labelRect.intersects( (*beforeIt)->labelRect() ) ) {
-                return false;
-            }
-        }
-        return true;
+        QList<const Marble::GeoDataPlacemark*>::const_iterator current;
+        QList<const Marble::GeoDataPlacemark*>::const_iterator end;
+    };
+
+    // Puts the cursor at the placemark coming first in layout order on top of the heap
+    bool placemarkCursorGreater( const PlacemarkCursor &left, const PlacemarkCursor &right )
+    {
+        return Marble::GeoDataPlacemark::placemarkLayoutOrderCompare( *right.current, *left.current );
     }
 }
 
@@ -176,10 +178,18 @@ PlacemarkLayout::PlacemarkLayout( QAbstractItemModel  *placemarkModel,
       m_showMaria( false ),
       m_maxLabelHeight(maxLabelHeight()),
       m_styleResetRequested( true ),
-      m_styleBuilder(styleBuilder)
+      m_styleBuilder(styleBuilder),
+      m_layoutValid( false ),
+      m_layoutCenterLon( 0 ),
+      m_layoutCenterLat( 0 ),
+      m_layoutRadius( 0 ),
+      m_layoutProjection( 0 )
 {
     Q_ASSERT(m_placemarkModel);
 
+    // positions of placemarks with a time span change with the time
+    connect( m_clock, SIGNAL(timeChanged()), this, SLOT(invalidateLayout()) );
+
     connect( m_selectionModel,  SIGNAL( selectionChanged( QItemSelection,
                                                            QItemSelection) ),
              this,               SLOT(requestStyleReset()) );
@@ -202,36 +212,43 @@ PlacemarkLayout::~PlacemarkLayout()
 void PlacemarkLayout::setShowPlaces( bool show )
 {
     m_showPlaces = show;
+    invalidateLayout();
 }
 
 void PlacemarkLayout::setShowCities( bool show )
 {
     m_showCities = show;
+    invalidateLayout();
 }
 
 void PlacemarkLayout::setShowTerrain( bool show )
 {
     m_showTerrain = show;
+    invalidateLayout();
 }
 
 void PlacemarkLayout::setShowOtherPlaces( bool show )
 {
     m_showOtherPlaces = show;
+    invalidateLayout();
 }
 
 void PlacemarkLayout::setShowLandingSites( bool show )
 {
     m_showLandingSites = show;
+    invalidateLayout();
 }
 
 void PlacemarkLayout::setShowCraters( bool show )
 {
     m_showCraters = show;
+    invalidateLayout();
 }
 
 void PlacemarkLayout::setShowMaria( bool show )
 {
     m_showMaria = show;
+    invalidateLayout();
 }
 
 void PlacemarkLayout::requestStyleReset()
@@ -240,8 +257,14 @@ void PlacemarkLayout::requestStyleReset()
     m_styleResetRequested = true;
 }
 
+void PlacemarkLayout::invalidateLayout()
+{
+    m_layoutValid = false;
+}
+
 void PlacemarkLayout::styleReset()
 {
+    m_layoutValid = false;
     m_paintOrder.clear();
     m_labelArea = 0;
     qDeleteAll( m_visiblePlacemarks );
@@ -260,7 +283,7 @@ QVector<const GeoDataFeature*> PlacemarkLayout::whichPlacemarkAt( const QPoint&
 
     foreach( VisiblePlacemark* mark, m_paintOrder ) {
         if ( mark->labelRect().contains( curpos )
-             || QRect( mark->symbolPosition(), mark->symbolPixmap().size() ).contains( curpos ) ) {
+             || QRect( mark->symbolPosition(), mark->symbolSize() ).contains( curpos ) ) {
             ret.append( mark->placemark() );
         }
     }
@@ -301,7 +324,9 @@ void PlacemarkLayout::addPlacemarks( const QModelIndex& parent, int first, int l
         int zoomLevel = placemark->zoomLevel();
         TileId key = TileId::fromCoordinates( coordinates, zoomLevel );
         m_placemarkCache[key].append( placemark );
+        m_unsortedTiles.insert( key );
     }
+    m_layoutValid = false;
     emit repaintNeeded();
 }
 
@@ -328,6 +353,7 @@ void PlacemarkLayout::removePlacemarks( const QModelIndex& parent, int first, in
             }
         }
     }
+    m_layoutValid = false;
     emit repaintNeeded();
 }
 
@@ -337,6 +363,7 @@ void PlacemarkLayout::resetCacheData()
 
     m_osmIds.clear();
     m_placemarkCache.clear();
+    m_unsortedTiles.clear();
     requestStyleReset();
     addPlacemarks( m_placemarkModel->index( 0, 0 ), 0, rowCount );
     emit repaintNeeded();
@@ -396,6 +423,7 @@ QSet<TileId> PlacemarkLayout::visibleTiles( const ViewportParams *viewport )
 
 QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParams *viewport )
 {
+    FrameProfiler::Scope scope( "PlacemarkLayout: generate layout" );
     m_runtimeTrace.clear();
     if ( m_placemarkModel->rowCount() <= 0 )
         return QVector<VisiblePlacemark *>();
@@ -408,9 +436,14 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
         return QVector<VisiblePlacemark *>();
     }
 
-    const int secnumber = viewport->height() / m_maxLabelHeight + 1;
-    m_rowsection.clear();
-    m_rowsection.resize(secnumber);
+    // Labels are placed the same way as long as the view moved by less than
+    // half a pixel, e.g. when the map is redrawn while panning slowly.
+    if ( isLayoutReusable( viewport ) ) {
+        FrameProfiler::instance()->addCounter( "labels placed", m_paintOrder.size() );
+        return m_paintOrder;
+    }
+
+    m_labelGrid.reset( viewport->size(), 2 * m_maxLabelHeight );
 
     m_paintOrder.clear();
     m_labelArea = 0;
@@ -418,11 +451,18 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
     // First handle the selected placemarks as they have the highest priority.
 
     const QModelIndexList selectedIndexes = m_selectionModel->selection().indexes();
-
+    QVector<const GeoDataPlacemark*> selectedPlacemarkList;
+    selectedPlacemarkList.reserve( selectedIndexes.count() );
     for ( int i = 0; i < selectedIndexes.count(); ++i ) {
         const QModelIndex index = selectedIndexes.at( i );
         const GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>(index.data( MarblePlacemarkModel::ObjectPointerRole ) ));
         Q_ASSERT(placemark);
+        selectedPlacemarkList << placemark;
+    }
+    // looked up for every other placemark below
+    const QSet<const GeoDataPlacemark*> selectedPlacemarks = selectedPlacemarkList.toList().toSet();
+
+    foreach ( const GeoDataPlacemark *placemark, selectedPlacemarkList ) {
         const GeoDataCoordinates coordinates = placemarkIconCoordinates( placemark );
 
         if ( !coordinates.isValid() ) {
@@ -450,16 +490,38 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
 
     // Now handle all other placemarks...
 
-    const QItemSelection selection = m_selectionModel->selection();
-
-    QList<const GeoDataPlacemark*> placemarkList;
+    // The lists of the tiles are sorted already, so they only need to be
+    // merged, which stops as soon as the screen is full.
+    int placemarkCount = 0;
+    QVector<PlacemarkCursor> cursors;
     foreach ( const TileId &tileId, visibleTiles( viewport ) ) {
-        placemarkList += m_placemarkCache.value( tileId );
+        QMap<TileId, QList<const GeoDataPlacemark*> >::iterator const tile = m_placemarkCache.find( tileId );
+        if ( tile == m_placemarkCache.end() || tile->isEmpty() ) {
+            continue;
+        }
+        if ( m_unsortedTiles.remove( tileId ) ) {
+            std::sort( tile->begin(), tile->end(), GeoDataPlacemark::placemarkLayoutOrderCompare );
+        }
+        PlacemarkCursor cursor;
+        cursor.current = tile->constBegin();
+        cursor.end = tile->constEnd();
+        cursors << cursor;
+        placemarkCount += tile->size();
     }
-    qSort(placemarkList.begin(), placemarkList.end(), GeoDataPlacemark::placemarkLayoutOrderCompare);
+    std::make_heap( cursors.begin(), cursors.end(), placemarkCursorGreater );
 
     auto const viewLatLonAltBox = viewport->viewLatLonAltBox();
-    foreach ( const GeoDataPlacemark *placemark, placemarkList ) {
+    while ( !cursors.isEmpty() ) {
+        std::pop_heap( cursors.begin(), cursors.end(), placemarkCursorGreater );
+        PlacemarkCursor &cursor = cursors.last();
+        const GeoDataPlacemark *placemark = *cursor.current;
+        ++cursor.current;
+        if ( cursor.current == cursor.end ) {
+            cursors.removeLast();
+        } else {
+            std::push_heap( cursors.begin(), cursors.end(), placemarkCursorGreater );
+        }
+
         const GeoDataCoordinates coordinates = placemarkIconCoordinates( placemark );
         if ( !coordinates.isValid() ) {
             continue;
@@ -525,20 +587,10 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
             continue;
 
         // We handled selected placemarks already, so we skip them here...
-        // Assuming that only a small amount of places is selected
-        // we check for the selected state after all other filters
-        bool isSelected = false;
-        foreach ( const QModelIndex &index, selection.indexes() ) {
-            const GeoDataPlacemark *mark = dynamic_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>(index.data( MarblePlacemarkModel::ObjectPointerRole ) ));
-            if (mark == placemark ) {
-                isSelected = true;
-                break;
-            }
-        }
-        if ( isSelected )
+        if ( selectedPlacemarks.contains( placemark ) )
             continue;
 
-        if( layoutPlacemark( placemark, x, y, isSelected ) ) {
+        if( layoutPlacemark( placemark, x, y, false ) ) {
             // Make sure not to draw more placemarks on the screen than
             // specified by placemarksOnScreenLimit().
             if ( placemarksOnScreenLimit( viewport->size() ) )
@@ -546,10 +598,37 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
         }
     }
 
-    m_runtimeTrace = QString("Placemarks: %1 Drawn: %2").arg( placemarkList.count() ).arg( m_paintOrder.size() );
+    m_layoutValid = true;
+    m_layoutCenterLon = viewport->centerLongitude();
+    m_layoutCenterLat = viewport->centerLatitude();
+    m_layoutRadius = viewport->radius();
+    m_layoutSize = viewport->size();
+    m_layoutProjection = viewport->projection();
+
+    m_runtimeTrace = QString("Placemarks: %1 Drawn: %2").arg( placemarkCount ).arg( m_paintOrder.size() );
+    FrameProfiler::instance()->addCounter( "labels placed", m_paintOrder.size() );
     return m_paintOrder;
 }
 
+bool PlacemarkLayout::isLayoutReusable( const ViewportParams *viewport ) const
+{
+    if ( !m_layoutValid
+         || viewport->radius() != m_layoutRadius
+         || viewport->size() != m_layoutSize
+         || viewport->projection() != m_layoutProjection ) {
+        return false;
+    }
+
+    qreal x = 0;
+    qreal y = 0;
+    if ( !viewport->screenCoordinates( m_layoutCenterLon, m_layoutCenterLat, x, y ) ) {
+        return false;
+    }
+
+    return qAbs( x - 0.5 * viewport->width() ) < 0.5
+        && qAbs( y - 0.5 * viewport->height() ) < 0.5;
+}
+
 QString PlacemarkLayout::runtimeTrace() const
 {
     return m_runtimeTrace;
@@ -598,14 +677,7 @@ bool PlacemarkLayout::layoutPlacemark( const GeoDataPlacemark *placemark, qreal
     mark->setLabelRect( labelRect );
 
     if ( !labelRect.isEmpty() ) {
-        // Add the current placemark to the matching row and its
-        // direct neighbors.
-        int idx = y / m_maxLabelHeight;
-        if ( idx - 1 >= 0 )
-            m_rowsection[ idx - 1 ].append( mark );
-        m_rowsection[ idx ].append( mark );
-        if ( idx + 1 < m_rowsection.size() )
-            m_rowsection[ idx + 1 ].append( mark );
+        m_labelGrid.insert( labelRect );
     }
 
     m_paintOrder.append( mark );
@@ -645,8 +717,6 @@ QRectF PlacemarkLayout::roomForLabel( const GeoDataStyle::ConstPtr &style,
         textWidth = ( QFontMetrics( labelFont ).width( labelText ) );
     }
 
-    const QVector<VisiblePlacemark*> currentsec = m_rowsection.at( y / m_maxLabelHeight );
-
     if ( style->labelStyle().alignment() == GeoDataLabelStyle::Corner ) {
         const int symbolWidth = style->iconStyle().scaledIcon().size().width();
 
@@ -658,7 +728,7 @@ QRectF PlacemarkLayout::roomForLabel( const GeoDataStyle::ConstPtr &style,
                                               y - textHeight;
             const QRectF labelRect = QRectF( xPos, yPos, textWidth, textHeight );
 
-            if (hasRoomFor(currentsec, labelRect)) {
+            if (m_labelGrid.hasRoomFor(labelRect)) {
                 // claim the place immediately if it hasn't been used yet
                 return labelRect;
             }
@@ -669,7 +739,7 @@ QRectF PlacemarkLayout::roomForLabel( const GeoDataStyle::ConstPtr &style,
         QRectF  labelRect( x - textWidth / 2, offsetY + y - textHeight / 2,
                           textWidth, textHeight );
 
-        if (hasRoomFor(currentsec, labelRect)) {
+        if (m_labelGrid.hasRoomFor(labelRect)) {
             // claim the place immediately if it hasn't been used yet 
             return labelRect;
         }
@@ -689,7 +759,7 @@ QRectF PlacemarkLayout::roomForLabel( const GeoDataStyle::ConstPtr &style,
 
             const QRectF labelRect = QRectF(xPos, yPos, textWidth, textHeight);
 
-            if (hasRoomFor(currentsec, labelRect))
+            if (m_labelGrid.hasRoomFor(labelRect))
             {
                 return labelRect;
             }
@@ -706,6 +776,75 @@ bool PlacemarkLayout::placemarksOnScreenLimit( const QSize &screenSize ) const
     return ratio >= 40;
 }
 
+PlacemarkLayout::LabelGrid::LabelGrid() :
+    m_cellSize( 1 ),
+    m_columns( 0 ),
+    m_rows( 0 )
+{
+}
+
+void PlacemarkLayout::LabelGrid::reset( const QSize &screenSize, int cellSize )
+{
+    m_cellSize = qMax( 1, cellSize );
+    m_columns = screenSize.width() / m_cellSize + 1;
+    m_rows = screenSize.height() / m_cellSize + 1;
+
+    // keep the memory of the cells for the next frame
+    if ( m_cells.size() != m_columns * m_rows ) {
+        m_cells.clear();
+        m_cells.resize( m_columns * m_rows );
+    } else {
+        for ( int i = 0; i < m_cells.size(); ++i ) {
+            m_cells[i].resize( 0 );
+        }
+    }
+}
+
+QRect PlacemarkLayout::LabelGrid::cellRange( const QRectF &rect ) const
+{
+    // labels may reach beyond the screen, they are kept in the border cells then
+    const int left = qBound( 0, qFloor( rect.left() / m_cellSize ), m_columns - 1 );
+    const int right = qBound( 0, qFloor( rect.right() / m_cellSize ), m_columns - 1 );
+    const int top = qBound( 0, qFloor( rect.top() / m_cellSize ), m_rows - 1 );
+    const int bottom = qBound( 0, qFloor( rect.bottom() / m_cellSize ), m_rows - 1 );
+    return QRect( QPoint( left, top ), QPoint( right, bottom ) );
+}
+
+bool PlacemarkLayout::LabelGrid::hasRoomFor( const QRectF &rect ) const
+{
+    if ( m_cells.isEmpty() ) {
+        return true;
+    }
+
+    // Check if there is another label that overlaps.
+    const QRect range = cellRange( rect );
+    for ( int row = range.top(); row <= range.bottom(); ++row ) {
+        for ( int column = range.left(); column <= range.right(); ++column ) {
+            const QVector<QRectF> &cell = m_cells.at( row * m_columns + column );
+            for ( int i = 0; i < cell.size(); ++i ) {
+                if ( rect.intersects( cell.at( i ) ) ) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void PlacemarkLayout::LabelGrid::insert( const QRectF &rect )
+{
+    if ( m_cells.isEmpty() ) {
+        return;
+    }
+
+    const QRect range = cellRange( rect );
+    for ( int row = range.top(); row <= range.bottom(); ++row ) {
+        for ( int column = range.left(); column <= range.right(); ++column ) {
+            m_cells[row * m_columns + column].append( rect );
+        }
+    }
+}
+
 }
 
 #include "moc_PlacemarkLayout.cpp"
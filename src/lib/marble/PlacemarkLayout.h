@@ -102,6 +102,9 @@ class PlacemarkLayout : public QObject
  Q_SIGNALS:
     void repaintNeeded();
 
+ private Q_SLOTS:
+    void invalidateLayout();
+
  private:
     /**
      * Returns a the maximum height of all possible labels.
@@ -117,6 +120,12 @@ class PlacemarkLayout : public QObject
     static QSet<TileId> visibleTiles( const ViewportParams *viewport );
     bool layoutPlacemark( const GeoDataPlacemark *placemark, qreal x, qreal y, bool selected );
 
+    /**
+     * Returns true if the layout of the previous frame can be used for @p viewport
+     * because nothing changed but the view moved by less than half a pixel.
+     */
+    bool isLayoutReusable( const ViewportParams *viewport ) const;
+
     /**
      * Returns the coordinates at which an icon should be drawn for the @p placemark.
      * @p ok is set to true if the coordinates are valid and should be used for drawing,
@@ -130,6 +139,28 @@ class PlacemarkLayout : public QObject
 
     bool    placemarksOnScreenLimit( const QSize &screenSize ) const;
 
+    /**
+     * A uniform grid covering the screen which keeps the label rectangles
+     * placed so far, so that only labels in nearby cells are checked for
+     * overlaps.
+     */
+    class LabelGrid
+    {
+    public:
+        LabelGrid();
+        void reset( const QSize &screenSize, int cellSize );
+        bool hasRoomFor( const QRectF &rect ) const;
+        void insert( const QRectF &rect );
+
+    private:
+        QRect cellRange( const QRectF &rect ) const;
+
+        int m_cellSize;
+        int m_columns;
+        int m_rows;
+        QVector< QVector<QRectF> > m_cells;
+    };
+
  private:
     Q_DISABLE_COPY( PlacemarkLayout )
     QAbstractItemModel*  m_placemarkModel;
@@ -140,12 +171,23 @@ class PlacemarkLayout : public QObject
     QString m_runtimeTrace;
     int m_labelArea;
     QHash<const GeoDataPlacemark*, VisiblePlacemark*> m_visiblePlacemarks;
-    QVector< QVector< VisiblePlacemark* > >  m_rowsection;
+    LabelGrid m_labelGrid;
 
-    /// map providing the list of placemark belonging in TileId as key
+    /// map providing the list of placemark belonging in TileId as key,
+    /// sorted by GeoDataPlacemark::placemarkLayoutOrderCompare
     QMap<TileId, QList<const GeoDataPlacemark*> > m_placemarkCache;
+    /// tiles whose lists got placemarks appended and need to be sorted again
+    QSet<TileId> m_unsortedTiles;
     QSet<qint64> m_osmIds;
 
+    // the view the current layout has been generated for
+    bool m_layoutValid;
+    qreal m_layoutCenterLon;
+    qreal m_layoutCenterLat;
+    int m_layoutRadius;
+    QSize m_layoutSize;
+    int m_layoutProjection;
+
     const QSet< GeoDataFeature::GeoDataVisualCategory > m_acceptedVisualCategories;
 
     // earth
@@ -0,0 +1,319 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PlacemarkNameIndex.h"
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QTime>
+#include <QWriteLocker>
+
+#include <algorithm>
+
+#include "GeoDataLatLonBox.h"
+#include "GeoDataPlacemark.h"
+#include "MarbleDebug.h"
+#include "MarbleMath.h"
+#include "MarblePlacemarkModel.h"
+
+namespace Marble
+{
+
+namespace
+{
+
+struct Entry
+{
+    QString name;
+    const GeoDataPlacemark *placemark;
+
+    bool operator<( const Entry &other ) const
+    {
+        return name < other.name;
+    }
+};
+
+struct EntryBefore
+{
+    bool operator()( const Entry &entry, const QString &name ) const
+    {
+        return entry.name < name;
+    }
+};
+
+struct EntryRemoved
+{
+    explicit EntryRemoved( const QSet<const GeoDataPlacemark *> &placemarks ) :
+        m_placemarks( placemarks )
+    {}
+
+    bool operator()( const Entry &entry ) const
+    {
+        return m_placemarks.contains( entry.placemark );
+    }
+
+private:
+    const QSet<const GeoDataPlacemark *> &m_placemarks;
+};
+
+struct Candidate
+{
+    const GeoDataPlacemark *placemark;
+    int zoomLevel;
+    qint64 popularity;
+    qreal distance;
+    // position in the index, i.e. in the order of names
+    int position;
+
+    bool operator<( const Candidate &other ) const
+    {
+        if ( zoomLevel != other.zoomLevel ) {
+            return zoomLevel < other.zoomLevel;
+        }
+        if ( popularity != other.popularity ) {
+            return popularity > other.popularity;
+        }
+        if ( distance != other.distance ) {
+            return distance < other.distance;
+        }
+        return position < other.position;
+    }
+};
+
+}
+
+class PlacemarkNameIndexPrivate
+{
+public:
+    explicit PlacemarkNameIndexPrivate( const QAbstractItemModel *placemarkModel );
+
+    const GeoDataPlacemark *placemark( const QModelIndex &parent, int row ) const;
+
+    // Adds the placemarks in the given rows to newEntries unless indexed already
+    void collect( const QModelIndex &parent, int first, int last, QVector<Entry> &newEntries );
+
+    // Merges newEntries into the sorted entries
+    void insert( QVector<Entry> &newEntries );
+
+    void remove( const QSet<const GeoDataPlacemark *> &placemarks );
+
+    const QAbstractItemModel *const m_placemarkModel;
+
+    // guards the entries against searches from other threads
+    mutable QReadWriteLock m_lock;
+    QVector<Entry> m_entries;
+    // the indexed name of each placemark, to find its entry again
+    QHash<const GeoDataPlacemark *, QString> m_names;
+};
+
+PlacemarkNameIndexPrivate::PlacemarkNameIndexPrivate( const QAbstractItemModel *placemarkModel ) :
+    m_placemarkModel( placemarkModel )
+{
+}
+
+const GeoDataPlacemark *PlacemarkNameIndexPrivate::placemark( const QModelIndex &parent, int row ) const
+{
+    const QModelIndex index = m_placemarkModel->index( row, 0, parent );
+    return dynamic_cast<const GeoDataPlacemark *>( qvariant_cast<GeoDataObject *>( index.data( MarblePlacemarkModel::ObjectPointerRole ) ) );
+}
+
+void PlacemarkNameIndexPrivate::collect( const QModelIndex &parent, int first, int last, QVector<Entry> &newEntries )
+{
+    for ( int row = first; row <= last; ++row ) {
+        const GeoDataPlacemark *const placemark = this->placemark( parent, row );
+        if ( !placemark || m_names.contains( placemark ) ) {
+            continue;
+        }
+
+        const Entry entry = { PlacemarkNameIndex::normalized( placemark->name() ), placemark };
+        if ( entry.name.isEmpty() ) {
+            continue;
+        }
+        m_names.insert( placemark, entry.name );
+        newEntries << entry;
+    }
+}
+
+void PlacemarkNameIndexPrivate::insert( QVector<Entry> &newEntries )
+{
+    if ( newEntries.isEmpty() ) {
+        return;
+    }
+
+    std::stable_sort( newEntries.begin(), newEntries.end() );
+
+    QVector<Entry> entries;
+    entries.resize( m_entries.size() + newEntries.size() );
+    std::merge( m_entries.constBegin(), m_entries.constEnd(), newEntries.constBegin(), newEntries.constEnd(), entries.begin() );
+
+    QWriteLocker locker( &m_lock );
+    m_entries.swap( entries );
+}
+
+void PlacemarkNameIndexPrivate::remove( const QSet<const GeoDataPlacemark *> &placemarks )
+{
+    if ( placemarks.isEmpty() ) {
+        return;
+    }
+
+    QWriteLocker locker( &m_lock );
+    m_entries.erase( std::remove_if( m_entries.begin(), m_entries.end(), EntryRemoved( placemarks ) ), m_entries.end() );
+}
+
+PlacemarkNameIndex::PlacemarkNameIndex( const QAbstractItemModel *placemarkModel, QObject *parent ) :
+    QObject( parent ),
+    d( new PlacemarkNameIndexPrivate( placemarkModel ) )
+{
+    connect( placemarkModel, SIGNAL(rowsInserted(QModelIndex,int,int)),
+             this, SLOT(addPlacemarks(QModelIndex,int,int)) );
+    connect( placemarkModel, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)),
+             this, SLOT(removePlacemarks(QModelIndex,int,int)) );
+    connect( placemarkModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+             this, SLOT(updatePlacemarks(QModelIndex,QModelIndex)) );
+    connect( placemarkModel, SIGNAL(modelAboutToBeReset()),
+             this, SLOT(clear()) );
+    connect( placemarkModel, SIGNAL(modelReset()),
+             this, SLOT(reset()) );
+
+    reset();
+}
+
+PlacemarkNameIndex::~PlacemarkNameIndex()
+{
+    delete d;
+}
+
+QVector<GeoDataPlacemark *> PlacemarkNameIndex::find( const QString &prefix, const GeoDataLatLonBox &preferred, int limit ) const
+{
+    const QString name = normalized( prefix.trimmed() );
+    if ( name.isEmpty() || limit <= 0 ) {
+        return QVector<GeoDataPlacemark *>();
+    }
+
+    const bool searchEverywhere = preferred.isEmpty();
+    const GeoDataCoordinates center = preferred.center();
+
+    QReadLocker locker( &d->m_lock );
+
+    QVector<Candidate> candidates;
+    QVector<Entry>::const_iterator entry = std::lower_bound( d->m_entries.constBegin(), d->m_entries.constEnd(), name, EntryBefore() );
+    for ( ; entry != d->m_entries.constEnd() && entry->name.startsWith( name ); ++entry ) {
+        const GeoDataPlacemark *const placemark = entry->placemark;
+        const GeoDataCoordinates coordinates = placemark->coordinate();
+        if ( !searchEverywhere && !preferred.contains( coordinates ) ) {
+            continue;
+        }
+
+        const Candidate candidate = {
+            placemark,
+            placemark->zoomLevel(),
+            placemark->popularity(),
+            searchEverywhere ? 0.0 : distanceSphere( coordinates, center ),
+            int( entry - d->m_entries.constBegin() )
+        };
+        candidates << candidate;
+    }
+
+    const int size = qMin( limit, candidates.size() );
+    std::partial_sort( candidates.begin(), candidates.begin() + size, candidates.end() );
+
+    // copy while still locked, the model may delete the placemarks afterwards
+    QVector<GeoDataPlacemark *> result;
+    result.reserve( size );
+    for ( int i = 0; i < size; ++i ) {
+        result << new GeoDataPlacemark( *candidates.at( i ).placemark );
+    }
+    return result;
+}
+
+int PlacemarkNameIndex::size() const
+{
+    QReadLocker locker( &d->m_lock );
+    return d->m_entries.size();
+}
+
+QString PlacemarkNameIndex::normalized( const QString &name )
+{
+    QString result = name.normalized( QString::NormalizationForm_D );
+
+    int size = 0;
+    for ( int i = 0; i < result.size(); ++i ) {
+        if ( result.at( i ).category() != QChar::Mark_NonSpacing ) {
+            result[size++] = result.at( i );
+        }
+    }
+    result.truncate( size );
+
+    result = result.toCaseFolded();
+    // letters with a stroke do not decompose
+    result.replace( QChar( 0x00F8 ), QLatin1Char( 'o' ) );
+    result.replace( QChar( 0x0142 ), QLatin1Char( 'l' ) );
+    return result;
+}
+
+void PlacemarkNameIndex::addPlacemarks( const QModelIndex &parent, int first, int last )
+{
+    QVector<Entry> newEntries;
+    d->collect( parent, first, last, newEntries );
+    d->insert( newEntries );
+}
+
+void PlacemarkNameIndex::removePlacemarks( const QModelIndex &parent, int first, int last )
+{
+    QSet<const GeoDataPlacemark *> placemarks;
+    for ( int row = first; row <= last; ++row ) {
+        const GeoDataPlacemark *const placemark = d->placemark( parent, row );
+        if ( placemark && d->m_names.remove( placemark ) ) {
+            placemarks << placemark;
+        }
+    }
+    d->remove( placemarks );
+}
+
+void PlacemarkNameIndex::updatePlacemarks( const QModelIndex &topLeft, const QModelIndex &bottomRight )
+{
+    // reindex the placemarks which were renamed
+    QSet<const GeoDataPlacemark *> placemarks;
+    for ( int row = topLeft.row(); row <= bottomRight.row(); ++row ) {
+        const GeoDataPlacemark *const placemark = d->placemark( topLeft.parent(), row );
+        if ( placemark && d->m_names.value( placemark ) != normalized( placemark->name() ) ) {
+            d->m_names.remove( placemark );
+            placemarks << placemark;
+        }
+    }
+    d->remove( placemarks );
+    addPlacemarks( topLeft.parent(), topLeft.row(), bottomRight.row() );
+}
+
+void PlacemarkNameIndex::clear()
+{
+    // the model may delete the placemarks before it announces the reset
+    QWriteLocker locker( &d->m_lock );
+    d->m_entries.clear();
+    d->m_names.clear();
+}
+
+void PlacemarkNameIndex::reset()
+{
+    QTime t;
+    t.start();
+
+    clear();
+
+    const int rowCount = d->m_placemarkModel->rowCount();
+    addPlacemarks( QModelIndex(), 0, rowCount - 1 );
+
+    mDebug() << "PlacemarkNameIndex: Indexed" << size() << "names in" << t.elapsed() << "ms.";
+}
+
+}
+
+#include "moc_PlacemarkNameIndex.cpp"
@@ -0,0 +1,92 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_PLACEMARKNAMEINDEX_H
+#define MARBLE_PLACEMARKNAMEINDEX_H
+
+#include <QObject>
+#include <QVector>
+
+#include "marble_export.h"
+
+class QAbstractItemModel;
+class QModelIndex;
+
+namespace Marble
+{
+
+class GeoDataLatLonBox;
+class GeoDataPlacemark;
+class PlacemarkNameIndexPrivate;
+
+/**
+ * @short An index of the names of the placemarks in a placemark model.
+ *
+ * Names are kept sorted with case and diacritics folded away, so the
+ * placemarks whose name starts with some text are found by a binary search
+ * instead of looking at every row of the model. The index follows the rows
+ * inserted into, removed from and changed in the model.
+ */
+class MARBLE_EXPORT PlacemarkNameIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Indexes the placemarks of @p placemarkModel, a flat model like
+     * MarbleModel::placemarkModel() providing the placemarks by its
+     * MarblePlacemarkModel::ObjectPointerRole.
+     */
+    explicit PlacemarkNameIndex( const QAbstractItemModel *placemarkModel, QObject *parent = 0 );
+
+    ~PlacemarkNameIndex();
+
+    /**
+     * Returns up to @p limit placemarks whose name starts with @p prefix,
+     * ignoring case and diacritics. If @p preferred is not empty, only the
+     * placemarks inside of it are returned.
+     *
+     * Popular placemarks come first, that is the ones shown at lower zoom
+     * levels and then the ones of a higher popularity. Others are ordered by
+     * their distance to the center of @p preferred and then by name.
+     *
+     * This method may be called from any thread. The placemarks are copied
+     * while the index is locked, so the model may change while the caller
+     * uses them. The caller takes ownership of the copies.
+     */
+    QVector<GeoDataPlacemark *> find( const QString &prefix, const GeoDataLatLonBox &preferred, int limit ) const;
+
+    /**
+     * Returns the number of indexed placemarks.
+     */
+    int size() const;
+
+    /**
+     * Returns @p name the way it is indexed: case folded and without diacritics.
+     */
+    static QString normalized( const QString &name );
+
+private Q_SLOTS:
+    void addPlacemarks( const QModelIndex &parent, int first, int last );
+
+    void removePlacemarks( const QModelIndex &parent, int first, int last );
+
+    void updatePlacemarks( const QModelIndex &topLeft, const QModelIndex &bottomRight );
+
+    void clear();
+
+    void reset();
+
+private:
+    Q_DISABLE_COPY( PlacemarkNameIndex )
+    PlacemarkNameIndexPrivate *const d;
+};
+
+}
+
+#endif
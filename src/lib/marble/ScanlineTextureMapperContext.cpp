@@ -12,6 +12,7 @@
 #include "ScanlineTextureMapperContext.h"
 
 #include <QImage>
+#include <QRegion>
 
 #include "MarbleDebug.h"
 #include "StackedTile.h"
@@ -22,6 +23,61 @@
 
 using namespace Marble;
 
+static int scanlineChunkHeight( int yTop, int yBottom, int threadCount )
+{
+    // Aim at several chunks per thread so that idle threads have something
+    // left to pick up, but keep chunks large enough to amortize the setup
+    // of a scanline.
+    const int chunksPerThread = 8;
+    const int minChunkHeight = 8;
+
+    const int lineCount = qMax( 0, yBottom - yTop );
+    int chunkHeight = lineCount / qMax( 1, threadCount * chunksPerThread );
+    chunkHeight = qMax( minChunkHeight, chunkHeight );
+
+    // keep interlaced scanline pairs within a single chunk
+    return chunkHeight + ( chunkHeight % 2 );
+}
+
+ScanlineJobQueue::ScanlineJobQueue( int yTop, int yBottom, int threadCount )
+    : m_yTop( yTop ),
+      m_yBottom( yBottom ),
+      m_chunkHeight( scanlineChunkHeight( yTop, yBottom, threadCount ) ),
+      m_chunkTops(),
+      m_nextChunk( 0 )
+{
+}
+
+ScanlineJobQueue::ScanlineJobQueue( const QVector<int> &chunkTops, int chunkHeight, int yBottom )
+    : m_yTop( yBottom ),
+      m_yBottom( yBottom ),
+      m_chunkHeight( chunkHeight + ( chunkHeight % 2 ) ),
+      m_chunkTops( chunkTops ),
+      m_nextChunk( 0 )
+{
+}
+
+bool ScanlineJobQueue::nextChunk( int &yStart, int &yEnd )
+{
+    const int chunk = m_nextChunk.fetchAndAddRelaxed( 1 );
+
+    if ( m_chunkTops.isEmpty() ) {
+        yStart = m_yTop + chunk * m_chunkHeight;
+    } else if ( chunk < m_chunkTops.size() ) {
+        yStart = m_chunkTops.at( chunk );
+    } else {
+        return false;
+    }
+
+    if ( yStart >= m_yBottom ) {
+        return false;
+    }
+
+    yEnd = qMin( m_yBottom, yStart + m_chunkHeight );
+
+    return true;
+}
+
 ScanlineTextureMapperContext::ScanlineTextureMapperContext( StackedTileLoader * const tileLoader, int tileLevel )
     : m_tileLoader( tileLoader ),
       m_textureProjection( tileLoader->tileProjection() ),  // cache texture projection
@@ -32,6 +88,7 @@ ScanlineTextureMapperContext::ScanlineTextureMapperContext( StackedTileLoader *
       m_normGlobalWidth( m_globalWidth / ( 2 * M_PI ) ),
       m_normGlobalHeight( m_globalHeight /  M_PI ),
       m_tile( 0 ),
+      m_usedTiles( 0 ),
       m_tilePosX( 65535 ),
       m_tilePosY( 65535 ),
       m_toTileCoordinatesLon( 0.5 * m_globalWidth  - m_tilePosX ),
@@ -427,6 +484,57 @@ QImage::Format ScanlineTextureMapperContext::optimalCanvasImageFormat( const Vie
 }
 
 
+void ScanlineTextureMapperContext::shiftCanvas( QImage *canvasImage, int dx, int dy )
+{
+    const int width = canvasImage->width();
+    const int height = canvasImage->height();
+    if ( qAbs( dx ) >= width || qAbs( dy ) >= height ) {
+        return;
+    }
+
+    const int pixelByteSize = canvasImage->depth() / 8;
+    const int rowBytes = ( width - qAbs( dx ) ) * pixelByteSize;
+    const int sourceOffset = qMax( 0, -dx ) * pixelByteSize;
+    const int targetOffset = qMax( 0, dx ) * pixelByteSize;
+
+    // walk the scanlines against the direction of the move so that no
+    // scanline gets overwritten before it has been copied
+    if ( dy > 0 ) {
+        for ( int y = height - 1; y >= dy; --y ) {
+            memmove( canvasImage->scanLine( y ) + targetOffset,
+                     canvasImage->constScanLine( y - dy ) + sourceOffset, rowBytes );
+        }
+    } else {
+        for ( int y = 0; y < height + dy; ++y ) {
+            memmove( canvasImage->scanLine( y ) + targetOffset,
+                     canvasImage->constScanLine( y - dy ) + sourceOffset, rowBytes );
+        }
+    }
+}
+
+QVector<QRect> ScanlineTextureMapperContext::exposedRects( const QSize &canvasSize, int dx, int dy,
+                                                           int yPaintedTop, int yPaintedBottom )
+{
+    const QRect canvas( QPoint( 0, 0 ), canvasSize );
+    QRegion region = QRegion( canvas ).subtracted( QRegion( canvas.translated( dx, dy ) ) );
+
+    // The border of the map doesn't necessarily move by whole pixels, so the
+    // outermost scanlines get mapped once more.
+    region += QRect( 0, yPaintedTop, canvasSize.width(), 2 );
+    region += QRect( 0, yPaintedBottom - 2, canvasSize.width(), 2 );
+
+    return region.intersected( QRect( 0, yPaintedTop, canvasSize.width(), yPaintedBottom - yPaintedTop ) ).rects();
+}
+
+void ScanlineTextureMapperContext::setUsedTiles( QSet<TileId> *tileIds )
+{
+    m_usedTiles = tileIds;
+
+    if ( m_usedTiles && m_tile ) {
+        m_usedTiles->insert( m_tile->id() );
+    }
+}
+
 void ScanlineTextureMapperContext::nextTile( int &posX, int &posY )
 {
     // Move from tile coordinates to global texture coordinates 
@@ -450,7 +558,11 @@ void ScanlineTextureMapperContext::nextTile( int &posX, int &posY )
     const int tileCol = lon / m_tileSize.width();
     const int tileRow = lat / m_tileSize.height();
 
-    m_tile = m_tileLoader->loadTile( TileId( 0, m_tileLevel, tileCol, tileRow ) );
+    const TileId id( 0, m_tileLevel, tileCol, tileRow );
+    m_tile = m_tileLoader->loadTile( id );
+    if ( m_usedTiles ) {
+        m_usedTiles->insert( id );
+    }
 
     // Update position variables:
     // m_tilePosX/Y stores the position of the tiles in 
@@ -489,7 +601,11 @@ void ScanlineTextureMapperContext::nextTile( qreal &posX, qreal &posY )
     const int tileCol = lon / m_tileSize.width();
     const int tileRow = lat / m_tileSize.height();
 
-    m_tile = m_tileLoader->loadTile( TileId( 0, m_tileLevel, tileCol, tileRow ) );
+    const TileId id( 0, m_tileLevel, tileCol, tileRow );
+    m_tile = m_tileLoader->loadTile( id );
+    if ( m_usedTiles ) {
+        m_usedTiles->insert( id );
+    }
 
     // Update position variables:
     // m_tilePosX/Y stores the position of the tiles in 
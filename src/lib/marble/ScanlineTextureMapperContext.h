@@ -12,12 +12,17 @@
 #ifndef MARBLE_SCANLINETEXTUREMAPPERCONTEXT_H
 #define MARBLE_SCANLINETEXTUREMAPPERCONTEXT_H
 
+#include <QAtomicInt>
+#include <QRect>
+#include <QSet>
 #include <QSize>
 #include <QImage>
+#include <QVector>
 
 #include "GeoSceneTileDataset.h"
 #include "MarbleMath.h"
 #include "MathHelper.h"
+#include "TileId.h"
 
 namespace Marble
 {
@@ -27,6 +32,45 @@ class StackedTileLoader;
 class ViewportParams;
 
 
+/**
+ * @short Hands out chunks of scanlines to the render jobs of a texture mapper.
+ *
+ * Instead of assigning one fixed band of the canvas to each thread, the
+ * scanline texture mappers start one render job per thread which keep pulling
+ * small chunks from this queue until it runs dry. Threads that happen to
+ * render cheap areas (space, polar regions) thereby take over work from
+ * threads that render expensive ones.
+ *
+ * Chunks always have an even height so that interlaced rendering never has
+ * to copy a scanline across a chunk boundary.
+ */
+class ScanlineJobQueue
+{
+public:
+    ScanlineJobQueue( int yTop, int yBottom, int threadCount );
+
+    /**
+     * Hands out the given chunks [chunkTop, chunkTop + chunkHeight) only,
+     * clipped to @p yBottom.
+     */
+    ScanlineJobQueue( const QVector<int> &chunkTops, int chunkHeight, int yBottom );
+
+    /**
+     * Fetches the next chunk of scanlines [yStart, yEnd).
+     * @return false if all scanlines have been handed out
+     * @note This method is thread-safe.
+     */
+    bool nextChunk( int &yStart, int &yEnd );
+
+private:
+    int const  m_yTop;
+    int const  m_yBottom;
+    int const  m_chunkHeight;
+    QVector<int> const m_chunkTops;
+    QAtomicInt m_nextChunk;
+};
+
+
 class ScanlineTextureMapperContext
 {
 public:
@@ -46,6 +90,27 @@ public:
 
     static QImage::Format optimalCanvasImageFormat( const ViewportParams *viewport );
 
+    /**
+     * Moves the content of @p canvasImage by @p dx and @p dy pixels.
+     * The pixels which get exposed keep their previous content.
+     */
+    static void shiftCanvas( QImage *canvasImage, int dx, int dy );
+
+    /**
+     * Returns the areas of a cylindrical map which need to be mapped once
+     * more after its canvas has been moved by @p dx and @p dy pixels,
+     * limited to the scanlines [@p yPaintedTop, @p yPaintedBottom) covered
+     * by the map.
+     */
+    static QVector<QRect> exposedRects( const QSize &canvasSize, int dx, int dy,
+                                        int yPaintedTop, int yPaintedBottom );
+
+    /**
+     * Records the ids of the tiles used from now on in @p tileIds, starting
+     * with the current tile. Pass 0 to stop recording.
+     */
+    void setUsedTiles( QSet<TileId> *tileIds );
+
     int globalWidth() const;
     int globalHeight() const;
 
@@ -84,6 +149,7 @@ private:
     qreal const      m_normGlobalHeight;
 
     const StackedTile *m_tile;
+    QSet<TileId> *m_usedTiles;
 
     // Coordinate transformations:
 
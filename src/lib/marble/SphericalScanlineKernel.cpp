@@ -0,0 +1,54 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "SphericalScanlineKernel.h"
+#include "SphericalScanlineKernel_p.h"
+
+namespace Marble
+{
+
+#ifdef MARBLE_HAVE_AVX2_KERNEL
+static bool cpuSupportsAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+}
+#endif
+
+void sphericalScanlineCoordinates( const matrix &planetAxisMatrix,
+                                   qreal qy, qreal qr,
+                                   const qreal *qx, int count,
+                                   qreal *lon, qreal *lat )
+{
+    int i = 0;
+
+#ifndef QT_COORD_TYPE
+#ifdef MARBLE_HAVE_AVX2_KERNEL
+    static const bool hasAvx2 = cpuSupportsAvx2();
+    if ( hasAvx2 ) {
+        i = sphericalScanlineCoordinatesAvx2( planetAxisMatrix, qy, qr, qx, count, lon, lat );
+    }
+#endif
+#ifdef MARBLE_SCANLINE_KERNEL_SSE2
+    i += SphericalScanlineKernel<Sse2Vector>::run( planetAxisMatrix, qy, qr,
+                                                   qx + i, count - i, lon + i, lat + i );
+#endif
+#endif
+
+    // remaining pixels or no SIMD support at all
+    for ( ; i < count; ++i ) {
+        const qreal qr2z = qr - qx[i] * qx[i];
+        const qreal qz = ( qr2z > 0.0 ) ? sqrt( qr2z ) : 0.0;
+
+        Quaternion qpos( 0.0, qx[i], qy, qz );
+        qpos.rotateAroundAxis( planetAxisMatrix );
+        qpos.getSpherical( lon[i], lat[i] );
+    }
+}
+
+}
@@ -0,0 +1,36 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_SPHERICALSCANLINEKERNEL_H
+#define MARBLE_SPHERICALSCANLINEKERNEL_H
+
+#include "Quaternion.h"
+
+namespace Marble
+{
+
+/**
+ * Calculates the geographic coordinates of a row of pixels on the globe.
+ *
+ * For every screen position qx[i] on the scanline with the normalized
+ * y-coordinate @p qy (and qr = 1 - qy * qy) the 3D position vector on the
+ * unit sphere is rotated by @p planetAxisMatrix and converted into
+ * longitude and latitude measured in radian.
+ *
+ * This is equivalent to building a Quaternion for each pixel, calling
+ * rotateAroundAxis( planetAxisMatrix ) and getSpherical() on it, but
+ * processes several pixels at once if the CPU supports it (SSE2 or AVX2).
+ */
+void sphericalScanlineCoordinates( const matrix &planetAxisMatrix,
+                                   qreal qy, qreal qr,
+                                   const qreal *qx, int count,
+                                   qreal *lon, qreal *lat );
+
+}
+
+#endif
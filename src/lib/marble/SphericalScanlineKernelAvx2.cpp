@@ -0,0 +1,25 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+// This file is compiled with AVX2 code generation enabled. Its code must
+// only be called after checking that the CPU supports it.
+
+#include "SphericalScanlineKernel_p.h"
+
+namespace Marble
+{
+
+int sphericalScanlineCoordinatesAvx2( const matrix &planetAxisMatrix,
+                                      qreal qy, qreal qr,
+                                      const double *qx, int count,
+                                      double *lon, double *lat )
+{
+    return SphericalScanlineKernel<AvxVector>::run( planetAxisMatrix, qy, qr, qx, count, lon, lat );
+}
+
+}
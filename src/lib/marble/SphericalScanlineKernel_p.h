@@ -0,0 +1,198 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_SPHERICALSCANLINEKERNEL_P_H
+#define MARBLE_SPHERICALSCANLINEKERNEL_P_H
+
+#include "Quaternion.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define MARBLE_SCANLINE_KERNEL_SSE2
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MARBLE_SCANLINE_KERNEL_AVX
+#endif
+
+namespace Marble
+{
+
+// The kernel gets compiled with different code generation flags in
+// different translation units. Keep it local to each of them so that the
+// linker can never mix up the instances.
+namespace
+{
+
+#ifdef MARBLE_SCANLINE_KERNEL_SSE2
+/// Two doubles per register
+struct Sse2Vector
+{
+    typedef __m128d Type;
+    enum { Size = 2 };
+
+    static inline Type set1( double a ) { return _mm_set1_pd( a ); }
+    static inline Type load( const double *p ) { return _mm_loadu_pd( p ); }
+    static inline void store( double *p, Type a ) { _mm_storeu_pd( p, a ); }
+    static inline Type add( Type a, Type b ) { return _mm_add_pd( a, b ); }
+    static inline Type sub( Type a, Type b ) { return _mm_sub_pd( a, b ); }
+    static inline Type mul( Type a, Type b ) { return _mm_mul_pd( a, b ); }
+    static inline Type div( Type a, Type b ) { return _mm_div_pd( a, b ); }
+    static inline Type sqrt( Type a ) { return _mm_sqrt_pd( a ); }
+    static inline Type min( Type a, Type b ) { return _mm_min_pd( a, b ); }
+    static inline Type max( Type a, Type b ) { return _mm_max_pd( a, b ); }
+    static inline Type abs( Type a ) { return _mm_andnot_pd( _mm_set1_pd( -0.0 ), a ); }
+    static inline Type greaterThan( Type a, Type b ) { return _mm_cmpgt_pd( a, b ); }
+    static inline Type lessThan( Type a, Type b ) { return _mm_cmplt_pd( a, b ); }
+    static inline Type select( Type mask, Type a, Type b )
+    {
+        return _mm_or_pd( _mm_and_pd( mask, a ), _mm_andnot_pd( mask, b ) );
+    }
+};
+#endif
+
+#ifdef MARBLE_SCANLINE_KERNEL_AVX
+/// Four doubles per register
+struct AvxVector
+{
+    typedef __m256d Type;
+    enum { Size = 4 };
+
+    static inline Type set1( double a ) { return _mm256_set1_pd( a ); }
+    static inline Type load( const double *p ) { return _mm256_loadu_pd( p ); }
+    static inline void store( double *p, Type a ) { _mm256_storeu_pd( p, a ); }
+    static inline Type add( Type a, Type b ) { return _mm256_add_pd( a, b ); }
+    static inline Type sub( Type a, Type b ) { return _mm256_sub_pd( a, b ); }
+    static inline Type mul( Type a, Type b ) { return _mm256_mul_pd( a, b ); }
+    static inline Type div( Type a, Type b ) { return _mm256_div_pd( a, b ); }
+    static inline Type sqrt( Type a ) { return _mm256_sqrt_pd( a ); }
+    static inline Type min( Type a, Type b ) { return _mm256_min_pd( a, b ); }
+    static inline Type max( Type a, Type b ) { return _mm256_max_pd( a, b ); }
+    static inline Type abs( Type a ) { return _mm256_andnot_pd( _mm256_set1_pd( -0.0 ), a ); }
+    static inline Type greaterThan( Type a, Type b ) { return _mm256_cmp_pd( a, b, _CMP_GT_OQ ); }
+    static inline Type lessThan( Type a, Type b ) { return _mm256_cmp_pd( a, b, _CMP_LT_OQ ); }
+    static inline Type select( Type mask, Type a, Type b ) { return _mm256_blendv_pd( b, a, mask ); }
+};
+#endif
+
+/**
+ * Branch free implementation of the scanline kernel for a SIMD vector type V.
+ *
+ * atan2() follows the Cephes double precision approximation of atan(), so
+ * the results match the ones of the C library up to a few ulps.
+ */
+template <class V>
+class SphericalScanlineKernel
+{
+    typedef typename V::Type T;
+
+public:
+    /**
+     * Processes as many pixels as fit into full vectors.
+     * @return the number of processed pixels
+     */
+    static int run( const matrix &m, qreal qy, qreal qr,
+                    const double *qx, int count,
+                    double *lon, double *lat )
+    {
+        const T m00 = V::set1( m[0][0] );
+        const T m01 = V::set1( m[0][1] );
+        const T m02 = V::set1( m[0][2] );
+        const T m10y = V::set1( m[1][0] * qy );
+        const T m11y = V::set1( m[1][1] * qy );
+        const T m12y = V::set1( m[1][2] * qy );
+        const T m20 = V::set1( m[2][0] );
+        const T m21 = V::set1( m[2][1] );
+        const T m22 = V::set1( m[2][2] );
+        const T vqr = V::set1( qr );
+        const T zero = V::set1( 0.0 );
+        const T one = V::set1( 1.0 );
+        const T minusOne = V::set1( -1.0 );
+        const T lonThreshold = V::set1( 0.00005 );
+
+        int i = 0;
+        for ( ; i + V::Size <= count; i += V::Size ) {
+            const T x0 = V::load( qx + i );
+            const T z0 = V::sqrt( V::max( V::sub( vqr, V::mul( x0, x0 ) ), zero ) );
+
+            // rotate around the planet axis
+            const T x = V::add( V::add( V::mul( m00, x0 ), m10y ), V::mul( m20, z0 ) );
+            T       y = V::add( V::add( V::mul( m01, x0 ), m11y ), V::mul( m21, z0 ) );
+            const T z = V::add( V::add( V::mul( m02, x0 ), m12y ), V::mul( m22, z0 ) );
+
+            // asin( y ) == atan2( y, sqrt( 1 - y * y ) ) for |y| <= 1
+            y = V::min( V::max( y, minusOne ), one );
+            const T cosLat = V::sqrt( V::max( V::sub( one, V::mul( y, y ) ), zero ) );
+            V::store( lat + i, atan2( y, cosLat ) );
+
+            const T xz = V::add( V::mul( x, x ), V::mul( z, z ) );
+            V::store( lon + i, V::select( V::greaterThan( xz, lonThreshold ), atan2( x, z ), zero ) );
+        }
+
+        return i;
+    }
+
+private:
+    static inline T atan2( T a, T b )
+    {
+        const T zero = V::set1( 0.0 );
+        const T one = V::set1( 1.0 );
+
+        const T absA = V::abs( a );
+        const T absB = V::abs( b );
+
+        // reduce to atan( t ) with t in [0, 1]
+        const T numerator = V::min( absA, absB );
+        const T denominator = V::max( V::max( absA, absB ), V::set1( 1e-300 ) );
+        T t = V::div( numerator, denominator );
+
+        // further reduce to |t| <= tan(pi/8) using atan( t ) = pi/4 + atan( (t-1)/(t+1) )
+        const T large = V::greaterThan( t, V::set1( 0.66 ) );
+        t = V::select( large, V::div( V::sub( t, one ), V::add( t, one ) ), t );
+        const T offset = V::select( large, V::set1( M_PI / 4.0 ), zero );
+        const T moreBits = V::select( large, V::set1( 0.5 * 6.123233995736765886130E-17 ), zero );
+
+        const T z = V::mul( t, t );
+        T p = V::set1( -8.750608600031904122785E-1 );
+        p = V::add( V::mul( p, z ), V::set1( -1.615753718733365076637E1 ) );
+        p = V::add( V::mul( p, z ), V::set1( -7.500855792314704667340E1 ) );
+        p = V::add( V::mul( p, z ), V::set1( -1.228866684490136173410E2 ) );
+        p = V::add( V::mul( p, z ), V::set1( -6.485021904942025371773E1 ) );
+        T q = V::add( z, V::set1( 2.485846490142306297962E1 ) );
+        q = V::add( V::mul( q, z ), V::set1( 1.650270098316988542046E2 ) );
+        q = V::add( V::mul( q, z ), V::set1( 4.328810604912902668951E2 ) );
+        q = V::add( V::mul( q, z ), V::set1( 4.853903996359136964868E2 ) );
+        q = V::add( V::mul( q, z ), V::set1( 1.945506571482613964425E2 ) );
+
+        const T poly = V::add( V::mul( t, V::div( V::mul( z, p ), q ) ), t );
+        T result = V::add( offset, V::add( poly, moreBits ) );
+
+        // undo the reduction to the first octant ...
+        result = V::select( V::greaterThan( absA, absB ),
+                            V::sub( V::set1( M_PI / 2.0 ), result ), result );
+        // ... and restore the quadrant
+        result = V::select( V::lessThan( b, zero ), V::sub( V::set1( M_PI ), result ), result );
+        result = V::select( V::lessThan( a, zero ), V::sub( zero, result ), result );
+
+        return result;
+    }
+};
+
+}
+
+#ifdef MARBLE_HAVE_AVX2_KERNEL
+int sphericalScanlineCoordinatesAvx2( const matrix &planetAxisMatrix,
+                                      qreal qy, qreal qr,
+                                      const double *qx, int count,
+                                      double *lon, double *lat );
+#endif
+
+}
+
+#endif
@@ -16,14 +16,17 @@
 
 #include <qmath.h>
 #include <QRunnable>
+#include <QVector>
 
 #include "MarbleGlobal.h"
 #include "GeoPainter.h"
 #include "GeoDataPolygon.h"
 #include "GeoDataDocument.h"
 #include "MarbleDebug.h"
+#include "FrameProfiler.h"
 #include "Quaternion.h"
 #include "ScanlineTextureMapperContext.h"
+#include "SphericalScanlineKernel.h"
 #include "StackedTileLoader.h"
 #include "StackedTile.h"
 #include "TextureColorizer.h"
@@ -33,10 +36,19 @@
 
 using namespace Marble;
 
+namespace
+{
+
+// height of the bands of scanlines which get mapped again when a tile changes
+const int BandHeight = 16;
+
+}
+
 class SphericalScanlineTextureMapper::RenderJob : public QRunnable
 {
 public:
-    RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, int yTop, int yBottom );
+    RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality,
+               int bandTop, QSet<TileId> *bandTiles, ScanlineJobQueue *jobQueue );
 
     virtual void run();
 
@@ -46,18 +58,21 @@ private:
     QImage *const m_canvasImage;
     const ViewportParams *const m_viewport;
     const MapQuality m_mapQuality;
-    int const m_yTop;
-    int const m_yBottom;
+    const int m_bandTop;
+    QSet<TileId> *const m_bandTiles;
+    ScanlineJobQueue *const m_jobQueue;
 };
 
-SphericalScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, int yTop, int yBottom )
+SphericalScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality,
+                                                      int bandTop, QSet<TileId> *bandTiles, ScanlineJobQueue *jobQueue )
     : m_tileLoader( tileLoader ),
       m_tileLevel( tileLevel ),
       m_canvasImage( canvasImage ),
       m_viewport( viewport ),
       m_mapQuality( mapQuality ),
-      m_yTop( yTop ),
-      m_yBottom( yBottom )
+      m_bandTop( bandTop ),
+      m_bandTiles( bandTiles ),
+      m_jobQueue( jobQueue )
 {
 }
 
@@ -65,10 +80,32 @@ SphericalScanlineTextureMapper::SphericalScanlineTextureMapper( StackedTileLoade
     : TextureMapperInterface()
     , m_tileLoader( tileLoader )
     , m_radius( 0 )
+    , m_bandTop( 0 )
+    , m_bandBottom( 0 )
+    , m_tileLevel( -1 )
+    , m_mapQuality( NormalQuality )
     , m_threadPool()
 {
 }
 
+void SphericalScanlineTextureMapper::setTileChanged( const TileId &stackedTileId )
+{
+    if ( m_repaintNeeded ) {
+        return;
+    }
+
+    if ( m_bandTiles.isEmpty() ) {
+        m_repaintNeeded = true;
+        return;
+    }
+
+    for ( int band = 0; band < m_bandTiles.size(); ++band ) {
+        if ( m_bandTiles.at( band ).contains( stackedTileId ) ) {
+            m_dirtyBands.insert( band );
+        }
+    }
+}
+
 void SphericalScanlineTextureMapper::mapTexture( GeoPainter *painter,
                                                  const ViewportParams *viewport,
                                                  int tileZoomLevel,
@@ -90,16 +127,40 @@ void SphericalScanlineTextureMapper::mapTexture( GeoPainter *painter,
         m_repaintNeeded = true;
     }
 
+    // The colorizer embosses the canvas as a whole, so it can't be updated
+    // band by band.
+    if ( !m_repaintNeeded && !m_dirtyBands.isEmpty() ) {
+        if ( texColorizer || tileZoomLevel != m_tileLevel || painter->mapQuality() != m_mapQuality ) {
+            m_repaintNeeded = true;
+        } else {
+            QList<int> bands = m_dirtyBands.toList();
+            qSort( bands );
+
+            QVector<int> bandTops;
+            foreach ( int band, bands ) {
+                bandTops << m_bandTop + band * BandHeight;
+            }
+
+            // The view didn't change, so the tiles the other bands are made
+            // of stay in use.
+            mapBands( bandTops, viewport, tileZoomLevel, painter->mapQuality() );
+        }
+    }
+
     if ( m_repaintNeeded ) {
         mapTexture( viewport, tileZoomLevel, painter->mapQuality() );
 
         if ( texColorizer ) {
-            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality() );
+            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality(), &m_threadPool );
         }
 
         m_repaintNeeded = false;
     }
 
+    m_dirtyBands.clear();
+    m_tileLevel = tileZoomLevel;
+    m_mapQuality = painter->mapQuality();
+
     const int radius = viewport->radius();
 
     QRect rect( viewport->width() / 2 - radius, viewport->height() / 2 - radius,
@@ -126,18 +187,36 @@ void SphericalScanlineTextureMapper::mapTexture( const ViewportParams *viewport,
     const int yBottom = ( yTop == 0 ) ? imageHeight - skip
                                       : yTop + radius + radius - skip;
 
+    m_bandTop = yTop;
+    m_bandBottom = yBottom;
+    m_bandTiles = QVector<QSet<TileId> >( qMax( 0, ( yBottom - yTop + BandHeight - 1 ) / BandHeight ) );
+
+    QVector<int> bandTops;
+    for ( int band = 0; band < m_bandTiles.size(); ++band ) {
+        bandTops << yTop + band * BandHeight;
+    }
+
+    mapBands( bandTops, viewport, tileZoomLevel, mapQuality );
+
+    m_tileLoader->cleanupTilehash();
+}
+
+void SphericalScanlineTextureMapper::mapBands( const QVector<int> &bandTops, const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality )
+{
+    QSet<TileId> *const bandTiles = m_bandTiles.data();
+
     const int numThreads = m_threadPool.maxThreadCount();
-    const int yStep = qCeil(qreal( yBottom - yTop ) / qreal(numThreads));
+    ScanlineJobQueue jobQueue( bandTops, BandHeight, m_bandBottom );
     for ( int i = 0; i < numThreads; ++i ) {
-        const int yStart = yTop +  i      * yStep;
-        const int yEnd   = qMin(yBottom, yTop + (i + 1) * yStep);
-        QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality, yStart, yEnd );
+        QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality,
+                                              m_bandTop, bandTiles, &jobQueue );
         m_threadPool.start( job );
     }
 
     m_threadPool.waitForDone();
 
-    m_tileLoader->cleanupTilehash();
+    const int mappedWidth = qMin<qint64>( m_canvasImage.width(), 2 * viewport->radius() );
+    FrameProfiler::instance()->addCounter( "texture pixels mapped", bandTops.size() * BandHeight * mappedWidth );
 }
 
 void SphericalScanlineTextureMapper::RenderJob::run()
@@ -168,133 +247,163 @@ void SphericalScanlineTextureMapper::RenderJob::run()
     // initialize needed variables that are modified during texture mapping:
 
     ScanlineTextureMapperContext context( m_tileLoader, m_tileLevel );
-    qreal  lon = 0.0;
-    qreal  lat = 0.0;
-
-    // Scanline based algorithm to texture map a sphere
-    for ( int y = m_yTop; y < m_yBottom ; ++y ) {
-
-        // Evaluate coordinates for the 3D position vector of the current pixel
-        const qreal qy = inverseRadius * (qreal)( imageHeight / 2 - y );
-        const qreal qr = 1.0 - qy * qy;
-
-        // rx is the radius component in x direction
-        const int rx = (int)sqrt( (qreal)( radius * radius
-                                      - ( ( y - imageHeight / 2 )
-                                          * ( y - imageHeight / 2 ) ) ) );
-
-        // Calculate the actual x-range of the map within the current scanline.
-        // 
-        // If the circular border of the earth disk is still visible then xLeft
-        // equals the scanline position of the most left pixel that gets covered
-        // by the earth disk. In terms of math this equals the half image width minus 
-        // the radius component on the current scanline in x direction ("rx").
-        //
-        // If the zoom factor is high enough then the whole screen gets covered
-        // by the earth and the border of the earth disk isn't visible anymore.
-        // In that situation xLeft equals zero.
-        // For xRight the situation is similar.
-
-        const int xLeft  = ( imageWidth / 2 - rx > 0 ) ? imageWidth / 2 - rx
-                                                       : 0;
-        const int xRight = ( imageWidth / 2 - rx > 0 ) ? xLeft + rx + rx
-                                                       : imageWidth;
-
-        QRgb * scanLine = (QRgb*)( m_canvasImage->scanLine( y ) ) + xLeft;
-
-        const int xIpLeft  = ( imageWidth / 2 - rx > 0 ) ? n * (int)( xLeft / n + 1 )
-                                                         : 1;
-        const int xIpRight = ( imageWidth / 2 - rx > 0 ) ? n * (int)( xRight / n - 1 )
-                                                         : n * (int)( xRight / n - 1 ) + 1; 
-
-        // Decrease pole distortion due to linear approximation ( y-axis )
-        bool crossingPoleArea = false;
-        if ( northPole.v[Q_Z] > 0
-             && northPoleY - ( n * 0.75 ) <= y
-             && northPoleY + ( n * 0.75 ) >= y ) 
-        {
-            crossingPoleArea = true;
-        }
-
-        int ncount = 0;
-
-        for ( int x = xLeft; x < xRight; ++x ) {
-            // Prepare for interpolation
-
-            const int leftInterval = xIpLeft + ncount * n;
 
-            bool interpolate = false;
-            if ( x >= xIpLeft && x <= xIpRight ) {
+    // Per scanline buffers of the exactly evaluated pixels
+    QVector<int>   sampleXBuffer( imageWidth + 1 );
+    QVector<bool>  sampleInterpolateBuffer( imageWidth + 1 );
+    QVector<qreal> sampleQxBuffer( imageWidth + 1 );
+    QVector<qreal> sampleLonBuffer( imageWidth + 1 );
+    QVector<qreal> sampleLatBuffer( imageWidth + 1 );
+    int *const   sampleX = sampleXBuffer.data();
+    bool *const  sampleInterpolate = sampleInterpolateBuffer.data();
+    qreal *const sampleQx = sampleQxBuffer.data();
+    qreal *const sampleLon = sampleLonBuffer.data();
+    qreal *const sampleLat = sampleLatBuffer.data();
+
+    // Keep pulling chunks of scanlines until the canvas is done, reusing
+    // the context (and its current tile) across chunks.
+    int yStart;
+    int yEnd;
+    while ( m_jobQueue->nextChunk( yStart, yEnd ) ) {
+
+        // Every chunk is a band of its own.
+        QSet<TileId> *const usedTiles = m_bandTiles + ( yStart - m_bandTop ) / BandHeight;
+        usedTiles->clear();
+        context.setUsedTiles( usedTiles );
+
+        // Scanline based algorithm to texture map a sphere
+        for ( int y = yStart; y < yEnd ; ++y ) {
+
+            // Evaluate coordinates for the 3D position vector of the current pixel
+            const qreal qy = inverseRadius * (qreal)( imageHeight / 2 - y );
+            const qreal qr = 1.0 - qy * qy;
+
+            // rx is the radius component in x direction
+            const int rx = (int)sqrt( (qreal)( radius * radius
+                                          - ( ( y - imageHeight / 2 )
+                                              * ( y - imageHeight / 2 ) ) ) );
+
+            // Calculate the actual x-range of the map within the current scanline.
+            // 
+            // If the circular border of the earth disk is still visible then xLeft
+            // equals the scanline position of the most left pixel that gets covered
+            // by the earth disk. In terms of math this equals the half image width minus 
+            // the radius component on the current scanline in x direction ("rx").
+            //
+            // If the zoom factor is high enough then the whole screen gets covered
+            // by the earth and the border of the earth disk isn't visible anymore.
+            // In that situation xLeft equals zero.
+            // For xRight the situation is similar.
+
+            const int xLeft  = ( imageWidth / 2 - rx > 0 ) ? imageWidth / 2 - rx
+                                                           : 0;
+            const int xRight = ( imageWidth / 2 - rx > 0 ) ? xLeft + rx + rx
+                                                           : imageWidth;
+
+            QRgb * scanLine = (QRgb*)( m_canvasImage->scanLine( y ) ) + xLeft;
+
+            const int xIpLeft  = ( imageWidth / 2 - rx > 0 ) ? n * (int)( xLeft / n + 1 )
+                                                             : 1;
+            const int xIpRight = ( imageWidth / 2 - rx > 0 ) ? n * (int)( xRight / n - 1 )
+                                                             : n * (int)( xRight / n - 1 ) + 1; 
+
+            // Decrease pole distortion due to linear approximation ( y-axis )
+            bool crossingPoleArea = false;
+            if ( northPole.v[Q_Z] > 0
+                 && northPoleY - ( n * 0.75 ) <= y
+                 && northPoleY + ( n * 0.75 ) >= y ) 
+            {
+                crossingPoleArea = true;
+            }
 
-                // Decrease pole distortion due to linear approximation ( x-axis )
-//                mDebug() << QString("NorthPole X: %1, LeftInterval: %2").arg( northPoleX ).arg( leftInterval );
-                if ( crossingPoleArea
-                     && northPoleX >= leftInterval + n
-                     && northPoleX < leftInterval + 2 * n
-                     && x < leftInterval + 3 * n )
-                {
-                    interpolate = false;
+            // First determine the pixels which get evaluated exactly, so
+            // that their coordinates can be calculated in one batch.
+            int sampleCount = 0;
+            int ncount = 0;
+
+            for ( int x = xLeft; x < xRight; ++x ) {
+                // Prepare for interpolation
+
+                const int leftInterval = xIpLeft + ncount * n;
+
+                bool interpolate = false;
+                if ( x >= xIpLeft && x <= xIpRight ) {
+
+                    // Decrease pole distortion due to linear approximation ( x-axis )
+    //                mDebug() << QString("NorthPole X: %1, LeftInterval: %2").arg( northPoleX ).arg( leftInterval );
+                    if ( crossingPoleArea
+                         && northPoleX >= leftInterval + n
+                         && northPoleX < leftInterval + 2 * n
+                         && x < leftInterval + 3 * n )
+                    {
+                        interpolate = false;
+                    }
+                    else {
+                        x += n - 1;
+                        interpolate = !printQuality;
+                        ++ncount;
+                    } 
                 }
-                else {
-                    x += n - 1;
-                    interpolate = !printQuality;
-                    ++ncount;
-                } 
-            }
-            else
-                interpolate = false;
-
-            // Evaluate more coordinates for the 3D position vector of
-            // the current pixel.
-            const qreal qx = (qreal)( x - imageWidth / 2 ) * inverseRadius;
-            const qreal qr2z = qr - qx * qx;
-            const qreal qz = ( qr2z > 0.0 ) ? sqrt( qr2z ) : 0.0;
-
-            // Create Quaternion from vector coordinates and rotate it
-            // around globe axis
-            Quaternion qpos( 0.0, qx, qy, qz );
-            qpos.rotateAroundAxis( planetAxisMatrix );
-
-            qpos.getSpherical( lon, lat );
-//            mDebug() << QString("lon: %1 lat: %2").arg(lon).arg(lat);
-            // Approx for n-1 out of n pixels within the boundary of
-            // xIpLeft to xIpRight
-
-            if ( interpolate ) {
-                if (highQuality)
-                    context.pixelValueApproxF( lon, lat, scanLine, n );
                 else
-                    context.pixelValueApprox( lon, lat, scanLine, n );
+                    interpolate = false;
 
-                scanLine += ( n - 1 );
+                // Evaluate more coordinates for the 3D position vector of
+                // the current pixel.
+                sampleX[sampleCount] = x;
+                sampleInterpolate[sampleCount] = interpolate;
+                sampleQx[sampleCount] = (qreal)( x - imageWidth / 2 ) * inverseRadius;
+                ++sampleCount;
             }
 
-//          Comment out the pixelValue line and run Marble if you want
-//          to understand the interpolation:
+            // Rotate the 3D position vectors around the globe axis and
+            // convert them to longitude and latitude
+            sphericalScanlineCoordinates( planetAxisMatrix, qy, qr,
+                                          sampleQx, sampleCount,
+                                          sampleLon, sampleLat );
+
+            for ( int i = 0; i < sampleCount; ++i ) {
+                const qreal lon = sampleLon[i];
+                const qreal lat = sampleLat[i];
+    //            mDebug() << QString("lon: %1 lat: %2").arg(lon).arg(lat);
+                // Approx for n-1 out of n pixels within the boundary of
+                // xIpLeft to xIpRight
+
+                if ( sampleInterpolate[i] ) {
+                    if (highQuality)
+                        context.pixelValueApproxF( lon, lat, scanLine, n );
+                    else
+                        context.pixelValueApprox( lon, lat, scanLine, n );
+
+                    scanLine += ( n - 1 );
+                }
 
-//          Uncomment the crossingPoleArea line to check precise 
-//          rendering around north pole:
+    //          Comment out the pixelValue line and run Marble if you want
+    //          to understand the interpolation:
 
-//            if ( !crossingPoleArea )
-            if ( x < imageWidth ) {
-                if ( highQuality )
-                    context.pixelValueF( lon, lat, scanLine );
-                else
-                    context.pixelValue( lon, lat, scanLine );
-            }
+    //          Uncomment the crossingPoleArea line to check precise 
+    //          rendering around north pole:
 
-            ++scanLine;
-        }
+    //            if ( !crossingPoleArea )
+                if ( sampleX[i] < imageWidth ) {
+                    if ( highQuality )
+                        context.pixelValueF( lon, lat, scanLine );
+                    else
+                        context.pixelValue( lon, lat, scanLine );
+                }
 
-        // copy scanline to improve performance
-        if ( interlaced && y + 1 < m_yBottom ) { 
+                ++scanLine;
+            }
+
+            // copy scanline to improve performance
+            if ( interlaced && y + 1 < yEnd ) { 
 
-            const int pixelByteSize = m_canvasImage->bytesPerLine() / imageWidth;
+                const int pixelByteSize = m_canvasImage->bytesPerLine() / imageWidth;
 
-            memcpy( m_canvasImage->scanLine( y + 1 ) + xLeft * pixelByteSize, 
-                    m_canvasImage->scanLine( y ) + xLeft * pixelByteSize, 
-                    ( xRight - xLeft ) * pixelByteSize );
-            ++y;
+                memcpy( m_canvasImage->scanLine( y + 1 ) + xLeft * pixelByteSize, 
+                        m_canvasImage->scanLine( y ) + xLeft * pixelByteSize, 
+                        ( xRight - xLeft ) * pixelByteSize );
+                ++y;
+            }
         }
     }
 }
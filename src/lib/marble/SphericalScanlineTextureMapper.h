@@ -16,9 +16,12 @@
 #include "TextureMapperInterface.h"
 
 #include "MarbleGlobal.h"
+#include "TileId.h"
 
 #include <QThreadPool>
 #include <QImage>
+#include <QSet>
+#include <QVector>
 
 
 namespace Marble
@@ -47,14 +50,28 @@ class SphericalScanlineTextureMapper : public TextureMapperInterface
                              const QRect &dirtyRect,
                              TextureColorizer *texColorizer );
 
+    /**
+     * Maps the bands of scanlines again which show the tile @p stackedTileId.
+     */
+    virtual void setTileChanged( const TileId &stackedTileId );
+
  private:
     void mapTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality );
+    void mapBands( const QVector<int> &bandTops, const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality );
 
  private:
     class RenderJob;
     StackedTileLoader *const m_tileLoader;
     int m_radius;
     QImage m_canvasImage;
+    // The canvas is mapped in horizontal bands of scanlines, which remember
+    // the tiles they show.
+    int m_bandTop;
+    int m_bandBottom;
+    QVector<QSet<TileId> > m_bandTiles;
+    QSet<int> m_dirtyBands;
+    int m_tileLevel;
+    MapQuality m_mapQuality;
     QThreadPool m_threadPool;
 };
 
@@ -24,6 +24,7 @@
 
 #include "StackedTileLoader.h"
 
+#include "FrameProfiler.h"
 #include "MarbleDebug.h"
 #include "MergedLayerDecorator.h"
 #include "StackedTile.h"
@@ -33,28 +34,126 @@
 
 #include <QCache>
 #include <QHash>
+#include <QMutex>
 #include <QReadWriteLock>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
 #include <QImage>
 
 
 namespace Marble
 {
 
+/**
+ * Reads, decodes and blends a stacked tile on a worker thread while a
+ * placeholder is being displayed.
+ */
+class StackedTileLoadJob : public QRunnable
+{
+public:
+    StackedTileLoadJob( StackedTileLoader *tileLoader, const TileId &stackedTileId, int generation,
+                        DownloadUsage usage = DownloadBrowse );
+
+    virtual void run();
+
+private:
+    StackedTileLoader *const m_tileLoader;
+    const TileId m_stackedTileId;
+    const int m_generation;
+    const DownloadUsage m_usage;
+};
+
 class StackedTileLoaderPrivate
 {
 public:
+    struct LoadedTile
+    {
+        TileId id;
+        StackedTile *tile;
+        int generation;
+    };
+
     explicit StackedTileLoaderPrivate( MergedLayerDecorator *mergedLayerDecorator )
-        : m_layerDecorator( mergedLayerDecorator )
+        : m_layerDecorator( mergedLayerDecorator ),
+          m_generation( 0 )
     {
         m_tileCache.setMaxCost( 20000 * 1024 ); // Cache size measured in bytes
     }
 
+    StackedTile *createPlaceholderTile( const TileId &stackedTileId );
+
     MergedLayerDecorator *const m_layerDecorator;
     QHash <TileId, StackedTile*>  m_tilesOnDisplay;
+    // Copy of m_tilesOnDisplay taken at the start of each frame. It is never
+    // modified while the render threads are running and can thus be read
+    // without holding m_cacheLock.
+    QHash <TileId, StackedTile*>  m_frameTiles;
     QCache <TileId, StackedTile>  m_tileCache;
     QReadWriteLock m_cacheLock;
+
+    // Asynchronous loading
+    QThreadPool m_threadPool;
+    QSet<TileId> m_pendingTiles;   // tiles represented by a placeholder or being prefetched
+    QSet<TileId> m_outdatedTiles;  // pending tiles whose data changed meanwhile
+    int m_generation;              // increased whenever the tiles get cleared
+    QMutex m_loadedTilesMutex;
+    QList<LoadedTile> m_loadedTiles;
 };
 
+StackedTileLoadJob::StackedTileLoadJob( StackedTileLoader *tileLoader, const TileId &stackedTileId, int generation,
+                                        DownloadUsage usage )
+    : m_tileLoader( tileLoader ),
+      m_stackedTileId( stackedTileId ),
+      m_generation( generation ),
+      m_usage( usage )
+{
+}
+
+void StackedTileLoadJob::run()
+{
+    StackedTileLoaderPrivate *const d = m_tileLoader->d;
+
+    StackedTileLoaderPrivate::LoadedTile loadedTile;
+    loadedTile.id = m_stackedTileId;
+    loadedTile.tile = d->m_layerDecorator->loadTile( m_stackedTileId, m_usage );
+    loadedTile.generation = m_generation;
+
+    d->m_loadedTilesMutex.lock();
+    d->m_loadedTiles.append( loadedTile );
+    d->m_loadedTilesMutex.unlock();
+
+    QMetaObject::invokeMethod( m_tileLoader, "replacePlaceholderTiles", Qt::QueuedConnection );
+}
+
+StackedTile *StackedTileLoaderPrivate::createPlaceholderTile( const TileId &stackedTileId )
+{
+    // Use the closest tile of a lower level which is still in memory
+    for ( int level = stackedTileId.zoomLevel() - 1; level >= 0; --level ) {
+        const int deltaLevel = stackedTileId.zoomLevel() - level;
+        const TileId ancestorId( 0, level, stackedTileId.x() >> deltaLevel, stackedTileId.y() >> deltaLevel );
+
+        const StackedTile *ancestor = m_tilesOnDisplay.value( ancestorId, 0 );
+        if ( !ancestor ) {
+            ancestor = m_tileCache.object( ancestorId );
+        }
+        if ( !ancestor ) {
+            continue;
+        }
+
+        const QImage *const image = ancestor->resultImage();
+        const int restTileX = stackedTileId.x() % ( 1 << deltaLevel );
+        const int restTileY = stackedTileId.y() % ( 1 << deltaLevel );
+        const int partWidth = qMax( 1, image->width() >> deltaLevel );
+        const int partHeight = qMax( 1, image->height() >> deltaLevel );
+        const QImage part = image->copy( restTileX * partWidth, restTileY * partHeight, partWidth, partHeight );
+
+        return new StackedTile( stackedTileId, part.scaled( image->size() ), ancestor->tiles() );
+    }
+
+    return 0;
+}
+
 StackedTileLoader::StackedTileLoader( MergedLayerDecorator *mergedLayerDecorator, QObject *parent )
     : QObject( parent ),
       d( new StackedTileLoaderPrivate( mergedLayerDecorator ) )
@@ -63,6 +162,10 @@ StackedTileLoader::StackedTileLoader( MergedLayerDecorator *mergedLayerDecorator
 
 StackedTileLoader::~StackedTileLoader()
 {
+    d->m_threadPool.waitForDone();
+    foreach ( const StackedTileLoaderPrivate::LoadedTile &loadedTile, d->m_loadedTiles ) {
+        delete loadedTile.tile;
+    }
     qDeleteAll( d->m_tilesOnDisplay );
     delete d;
 }
@@ -95,10 +198,22 @@ void StackedTileLoader::resetTilehash()
         Q_ASSERT( it.value()->used() && "contained in m_tilesOnDisplay should imply used()" );
         it.value()->setUsed( false );
     }
+
+    // Cheap due to implicit sharing. Tiles loaded during the frame go into
+    // m_tilesOnDisplay only, which detaches it from the snapshot.
+    d->m_frameTiles = d->m_tilesOnDisplay;
+}
+
+void StackedTileLoader::keepTilehash()
+{
+    d->m_frameTiles = d->m_tilesOnDisplay;
 }
 
 void StackedTileLoader::cleanupTilehash()
 {
+    // The render threads are done, so tiles may be moved and deleted again.
+    d->m_frameTiles.clear();
+
     // Make sure that tiles which haven't been used during the last
     // rendering of the map at all get removed from the tile hash.
 
@@ -117,7 +232,16 @@ void StackedTileLoader::cleanupTilehash()
 
 const StackedTile* StackedTileLoader::loadTile( TileId const & stackedTileId )
 {
-    // check if the tile is in the hash
+    // check if the tile has been on display in the previous frame already,
+    // which is the case for the vast majority of lookups
+    QHash<TileId, StackedTile*>::const_iterator const frameTile = d->m_frameTiles.constFind( stackedTileId );
+    if ( frameTile != d->m_frameTiles.constEnd() ) {
+        ( *frameTile )->setUsed( true );
+        return *frameTile;
+    }
+    // here ends the performance critical section of this method
+
+    // check if the tile has been loaded during the current frame
     d->m_cacheLock.lockForRead();
     StackedTile * stackedTile = d->m_tilesOnDisplay.value( stackedTileId, 0 );
     d->m_cacheLock.unlock();
@@ -125,7 +249,6 @@ const StackedTile* StackedTileLoader::loadTile( TileId const & stackedTileId )
         stackedTile->setUsed( true );
         return stackedTile;
     }
-    // here ends the performance critical section of this method
 
     d->m_cacheLock.lockForWrite();
 
@@ -144,26 +267,56 @@ const StackedTile* StackedTileLoader::loadTile( TileId const & stackedTileId )
         stackedTile->setUsed( true );
         d->m_tilesOnDisplay[ stackedTileId ] = stackedTile;
         d->m_cacheLock.unlock();
+        FrameProfiler::instance()->addCounter( "tile cache hits" );
         return stackedTile;
     }
 
     // tile (valid) has not been found in hash or cache, so load it from disk
-    // and place it in the hash from where it will get transferred to the cache
+    // and place it in the hash from where it will get transferred to the cache.
+    // Show a scaled version of a lower level tile meanwhile if there is any.
 
-    mDebug() << "load tile from disk:" << stackedTileId;
+    stackedTile = d->createPlaceholderTile( stackedTileId );
+    if ( stackedTile ) {
+        // a prefetched tile is on its way already
+        if ( !d->m_pendingTiles.contains( stackedTileId ) ) {
+            mDebug() << "load tile from disk in the background:" << stackedTileId;
 
-    stackedTile = d->m_layerDecorator->loadTile( stackedTileId );
+            d->m_pendingTiles.insert( stackedTileId );
+            d->m_threadPool.start( new StackedTileLoadJob( this, stackedTileId, d->m_generation ) );
+        }
+    }
+    else {
+        mDebug() << "load tile from disk:" << stackedTileId;
+
+        stackedTile = d->m_layerDecorator->loadTile( stackedTileId );
+    }
     Q_ASSERT( stackedTile );
     stackedTile->setUsed( true );
 
     d->m_tilesOnDisplay[ stackedTileId ] = stackedTile;
     d->m_cacheLock.unlock();
 
+    FrameProfiler::instance()->addCounter( "tiles loaded" );
     emit tileLoaded( stackedTileId );
 
     return stackedTile;
 }
 
+bool StackedTileLoader::prefetchTile( TileId const &stackedTileId )
+{
+    if ( d->m_tilesOnDisplay.contains( stackedTileId ) ||
+         d->m_tileCache.contains( stackedTileId ) ||
+         d->m_pendingTiles.contains( stackedTileId ) ) {
+        return false;
+    }
+
+    d->m_pendingTiles.insert( stackedTileId );
+    // tiles which are visible already take precedence
+    d->m_threadPool.start( new StackedTileLoadJob( this, stackedTileId, d->m_generation, DownloadBulk ), -1 );
+
+    return true;
+}
+
 quint64 StackedTileLoader::volatileCacheLimit() const
 {
     return d->m_tileCache.maxCost() / 1024;
@@ -189,6 +342,12 @@ void StackedTileLoader::updateTile( TileId const &tileId, QImage const &tileImag
 {
     const TileId stackedTileId( 0, tileId.zoomLevel(), tileId.x(), tileId.y() );
 
+    if ( d->m_pendingTiles.contains( stackedTileId ) ) {
+        // the background job might have read the tile before it got updated
+        d->m_outdatedTiles.insert( stackedTileId );
+        return;
+    }
+
     StackedTile * displayedTile = d->m_tilesOnDisplay.take( stackedTileId );
     if ( displayedTile ) {
         Q_ASSERT( !d->m_tileCache.contains( stackedTileId ) );
@@ -206,6 +365,51 @@ void StackedTileLoader::updateTile( TileId const &tileId, QImage const &tileImag
     }
 }
 
+QList<TileId> StackedTileLoader::updateSunShading( qreal previousSunLon, qreal previousSunLat )
+{
+    foreach ( const TileId &stackedTileId, d->m_pendingTiles ) {
+        if ( d->m_layerDecorator->isSunShadingOutdated( stackedTileId, previousSunLon, previousSunLat ) ) {
+            // the background job might have blended the tile with the old position
+            d->m_outdatedTiles.insert( stackedTileId );
+        }
+    }
+
+    QList<TileId> updatedTiles;
+
+    d->m_cacheLock.lockForWrite();
+
+    QHash<TileId, StackedTile*>::iterator it = d->m_tilesOnDisplay.begin();
+    QHash<TileId, StackedTile*>::iterator const end = d->m_tilesOnDisplay.end();
+    for (; it != end; ++it ) {
+        if ( d->m_pendingTiles.contains( it.key() ) ||
+             !d->m_layerDecorator->isSunShadingOutdated( it.key(), previousSunLon, previousSunLat ) ) {
+            continue;
+        }
+
+        StackedTile *const stackedTile = d->m_layerDecorator->recreateTile( *it.value() );
+        stackedTile->setUsed( true );
+        delete it.value();
+        it.value() = stackedTile;
+        updatedTiles << it.key();
+    }
+
+    foreach ( const TileId &stackedTileId, d->m_tileCache.keys() ) {
+        if ( d->m_layerDecorator->isSunShadingOutdated( stackedTileId, previousSunLon, previousSunLat ) ) {
+            d->m_tileCache.remove( stackedTileId );
+        }
+    }
+
+    d->m_cacheLock.unlock();
+
+    FrameProfiler::instance()->addCounter( "sun shading tiles updated", updatedTiles.size() );
+
+    foreach ( const TileId &stackedTileId, updatedTiles ) {
+        emit tileLoaded( stackedTileId );
+    }
+
+    return updatedTiles;
+}
+
 RenderState StackedTileLoader::renderState() const
 {
     RenderState renderState( "Stacked Tiles" );
@@ -221,13 +425,64 @@ void StackedTileLoader::clear()
 {
     mDebug() << Q_FUNC_INFO;
 
+    // The jobs use the texture layers which may get deleted next, so drop
+    // the queued ones and wait for the running ones. Their results get
+    // discarded.
+    d->m_threadPool.clear();
+    d->m_threadPool.waitForDone();
+    ++d->m_generation;
+    d->m_pendingTiles.clear();
+    d->m_outdatedTiles.clear();
+
     qDeleteAll( d->m_tilesOnDisplay );
     d->m_tilesOnDisplay.clear();
+    d->m_frameTiles.clear();
     d->m_tileCache.clear(); // clear the tile cache in physical memory
 
     emit cleared();
 }
 
+void StackedTileLoader::replacePlaceholderTiles()
+{
+    d->m_loadedTilesMutex.lock();
+    const QList<StackedTileLoaderPrivate::LoadedTile> loadedTiles = d->m_loadedTiles;
+    d->m_loadedTiles.clear();
+    d->m_loadedTilesMutex.unlock();
+
+    foreach ( const StackedTileLoaderPrivate::LoadedTile &loadedTile, loadedTiles ) {
+        const TileId &stackedTileId = loadedTile.id;
+
+        if ( loadedTile.generation != d->m_generation ) {
+            delete loadedTile.tile;
+            continue;
+        }
+
+        if ( d->m_outdatedTiles.remove( stackedTileId ) ) {
+            // load once more to pick up the data that arrived meanwhile
+            delete loadedTile.tile;
+            d->m_threadPool.start( new StackedTileLoadJob( this, stackedTileId, d->m_generation ) );
+            continue;
+        }
+
+        d->m_pendingTiles.remove( stackedTileId );
+
+        StackedTile *const placeholder = d->m_tilesOnDisplay.take( stackedTileId );
+        if ( placeholder ) {
+            loadedTile.tile->setUsed( true );
+            d->m_tilesOnDisplay.insert( stackedTileId, loadedTile.tile );
+            delete placeholder;
+
+            emit tileLoaded( stackedTileId );
+            emit placeholderReplaced( stackedTileId );
+        }
+        else {
+            // replaces (and deletes) the placeholder if it is still in the cache,
+            // prefetched tiles wait there until they get displayed
+            d->m_tileCache.insert( stackedTileId, loadedTile.tile, loadedTile.tile->byteCount() );
+        }
+    }
+}
+
 }
 
 #include "moc_StackedTileLoader.cpp"
@@ -42,6 +42,7 @@ class MergedLayerDecorator;
 class StackedTile;
 
 class StackedTileLoaderPrivate;
+class StackedTileLoadJob;
 
 /**
  * @short Tile loading from a quad tree
@@ -81,16 +82,42 @@ class StackedTileLoader : public QObject
         /**
          * Loads a tile and returns it.
          *
+         * Tiles that were already displayed in the previous frame are looked up
+         * without locking, so this method is cheap to call from many render
+         * threads between resetTilehash() and cleanupTilehash().
+         *
+         * Tiles that are neither displayed nor cached get loaded on a worker
+         * thread. Until they are ready, a scaled part of a lower level tile
+         * is returned and placeholderReplaced() is emitted later on.
+         *
          * @param stackedTileId The Id of the requested tile, containing the x and y coordinate
          *                      and the zoom level.
          */
         const StackedTile* loadTile( TileId const &stackedTileId );
 
         /**
-         * Resets the internal tile hash.
+         * Loads a tile into the cache on a worker thread ahead of its display.
+         *
+         * Texture tiles which are not available on disc are queued for bulk
+         * download. Nothing happens if the tile is in memory or on its way already.
+         *
+         * @return whether loading the tile has been started
+         */
+        bool prefetchTile( TileId const &stackedTileId );
+
+        /**
+         * Resets the internal tile hash and takes the snapshot of the displayed
+         * tiles for the upcoming frame.
          */
         void resetTilehash();
 
+        /**
+         * Takes the snapshot of the displayed tiles for mapping parts of the
+         * canvas while the rest of it keeps showing them. Unlike
+         * resetTilehash() all displayed tiles stay in use.
+         */
+        void keepTilehash();
+
         /**
          * Cleans up the internal tile hash.
          *
@@ -123,7 +150,8 @@ class StackedTileLoader : public QObject
 
         /**
          * Effectively triggers a reload of all tiles that are currently in use
-         * and clears the tile cache in physical memory.
+         * and clears the tile cache in physical memory. Waits for the tiles
+         * being loaded in the background.
          */
         void clear();
 
@@ -131,16 +159,34 @@ class StackedTileLoader : public QObject
          */
         void updateTile(TileId const & tileId, QImage const &tileImage );
 
+        /**
+         * Blends the tiles at the terminator once more after the sun moved
+         * away from @p previousSunLon and @p previousSunLat (in degrees).
+         * Tiles in full daylight or darkness are kept.
+         * Returns the ids of the tiles on display which have changed.
+         */
+        QList<TileId> updateSunShading( qreal previousSunLon, qreal previousSunLat );
+
         RenderState renderState() const;
 
     Q_SIGNALS:
         void tileLoaded( TileId const &tileId );
         void cleared();
 
+        /**
+         * A tile which was displayed as a scaled placeholder so far has been
+         * loaded in the background and is ready to be painted.
+         */
+        void placeholderReplaced( TileId const &tileId );
+
+    private Q_SLOTS:
+        void replacePlaceholderTiles();
+
     private:
         Q_DISABLE_COPY( StackedTileLoader )
 
         friend class StackedTileLoaderPrivate;
+        friend class StackedTileLoadJob;
         StackedTileLoaderPrivate* const d;
 };
 
@@ -140,6 +140,18 @@ qreal SunLocator::shading(qreal lon, qreal a, qreal c) const
     return brightness;
 }
 
+qreal SunLocator::shading(qreal distance) const
+{
+    const qreal b = sin(distance / 2.0);
+    const qreal h = b * b;
+
+    if ( h <= 0.5 - d->m_twilightZone / 2.0 )
+        return 1.0;
+    if ( h >= 0.5 + d->m_twilightZone / 2.0 )
+        return 0.0;
+    return ( 0.5 + d->m_twilightZone/2.0 - h ) / d->m_twilightZone;
+}
+
 void SunLocator::shadePixel(QRgb& pixcol, qreal brightness) const
 {
     // daylight - no change
@@ -38,6 +38,12 @@ class MARBLE_EXPORT SunLocator : public QObject
     virtual ~SunLocator();
 
     qreal shading(qreal lon, qreal a, qreal c) const;
+
+    /**
+     * Returns the brightness at the angular @p distance (in radians) from the
+     * subsolar point, 1.0 in daylight and 0.0 at night.
+     */
+    qreal shading(qreal distance) const;
     void  shadePixel(QRgb& pixcol, qreal shade) const;
     void  shadePixelComposite(QRgb& pixcol, const QRgb& dpixcol, qreal shade) const;
 
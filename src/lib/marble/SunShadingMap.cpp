@@ -0,0 +1,244 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "SunShadingMap.h"
+
+#include "MarbleGlobal.h"
+#include "MarbleMath.h"
+#include "SunLocator.h"
+#include "TileId.h"
+#include "TileLoaderHelper.h"
+
+#include <QImage>
+#include <QVarLengthArray>
+
+#include <cstring>
+
+namespace Marble
+{
+
+namespace
+{
+
+// distance of the supporting points in pixels
+const int SupportingPointStep = 16;
+
+// brightness of the night side when shading without a night map, 0.35 * 256
+const int NightFactor = 90;
+
+QVector<int> supportingPoints( int length )
+{
+    QVector<int> result;
+    for ( int position = 0; position < length - 1; position += SupportingPointStep ) {
+        result << position;
+    }
+    result << qMax( 0, length - 1 );
+    return result;
+}
+
+// Returns the index of the interval between two supporting points containing position.
+int interval( const QVector<int> &points, int position )
+{
+    return qBound( 0, position / SupportingPointStep, qMax( 0, points.size() - 2 ) );
+}
+
+}
+
+SunShadingMap::SunShadingMap( const SunLocator *sunLocator, const TileId &id, const QSize &tileSize,
+                              int levelZeroColumns, int levelZeroRows ) :
+    m_tileSize( tileSize ),
+    m_coverage( coverage( sunLocator, sunLocator->getLon(), sunLocator->getLat(),
+                          id, levelZeroColumns, levelZeroRows ) )
+{
+    if ( m_coverage != Twilight ) {
+        return;
+    }
+
+    m_columns = supportingPoints( tileSize.width() );
+    m_rows = supportingPoints( tileSize.height() );
+
+    const qreal globalWidth = tileSize.width()
+        * TileLoaderHelper::levelToColumn( levelZeroColumns, id.zoomLevel() );
+    const qreal globalHeight = tileSize.height()
+        * TileLoaderHelper::levelToRow( levelZeroRows, id.zoomLevel() );
+    const qreal sunLon = DEG2RAD * sunLocator->getLon();
+    const qreal sunLat = DEG2RAD * sunLocator->getLat();
+
+    m_weights.reserve( m_rows.size() * m_columns.size() );
+    foreach ( int y, m_rows ) {
+        const qreal lat = 0.5 * M_PI - M_PI * ( id.y() * tileSize.height() + y ) / globalHeight;
+        foreach ( int x, m_columns ) {
+            const qreal lon = 2 * M_PI * ( id.x() * tileSize.width() + x ) / globalWidth - M_PI;
+            const qreal brightness = sunLocator->shading( distanceSphere( lon, lat, sunLon, sunLat ) );
+            m_weights << qRound( 256 * brightness );
+        }
+    }
+}
+
+SunShadingMap::Coverage SunShadingMap::coverage( const SunLocator *sunLocator, qreal sunLon, qreal sunLat,
+                                                 const TileId &id, int levelZeroColumns, int levelZeroRows )
+{
+    const qreal tileWidth = 2 * M_PI / TileLoaderHelper::levelToColumn( levelZeroColumns, id.zoomLevel() );
+    const qreal tileHeight = M_PI / TileLoaderHelper::levelToRow( levelZeroRows, id.zoomLevel() );
+
+    // The corners are the points of the tile farthest away from its center
+    // only as long as the tile doesn't span more than a quarter of the globe.
+    if ( tileWidth > 0.5 * M_PI || tileHeight > 0.5 * M_PI ) {
+        return Twilight;
+    }
+
+    const qreal west = -M_PI + id.x() * tileWidth;
+    const qreal east = west + tileWidth;
+    const qreal north = 0.5 * M_PI - id.y() * tileHeight;
+    const qreal south = north - tileHeight;
+    const qreal centerLon = west + 0.5 * tileWidth;
+    const qreal centerLat = north - 0.5 * tileHeight;
+
+    const qreal radius = qMax( qMax( distanceSphere( centerLon, centerLat, west, north ),
+                                     distanceSphere( centerLon, centerLat, east, north ) ),
+                               qMax( distanceSphere( centerLon, centerLat, west, south ),
+                                     distanceSphere( centerLon, centerLat, east, south ) ) );
+    const qreal sunDistance = distanceSphere( centerLon, centerLat, DEG2RAD * sunLon, DEG2RAD * sunLat );
+
+    if ( sunLocator->shading( qMin( qreal( M_PI ), sunDistance + radius ) ) >= 1.0 ) {
+        return Daylight;
+    }
+    if ( sunLocator->shading( qMax( qreal( 0.0 ), sunDistance - radius ) ) <= 0.0 ) {
+        return Darkness;
+    }
+    return Twilight;
+}
+
+SunShadingMap::Coverage SunShadingMap::coverage() const
+{
+    return m_coverage;
+}
+
+void SunShadingMap::shade( QImage *tileImage ) const
+{
+    if ( tileImage->depth() != 32 || m_coverage == Daylight ) {
+        return;
+    }
+
+    Q_ASSERT( tileImage->size() == m_tileSize );
+
+    const int width = m_tileSize.width();
+    QVector<int> weights( width );
+
+    for ( int y = 0; y < m_tileSize.height(); ++y ) {
+        const Coverage rowCoverage = m_coverage == Darkness ? Darkness : rowWeights( y, weights );
+        if ( rowCoverage == Daylight ) {
+            continue;
+        }
+
+        QRgb *const scanline = reinterpret_cast<QRgb *>( tileImage->scanLine( y ) );
+        if ( rowCoverage == Darkness ) {
+            for ( int x = 0; x < width; ++x ) {
+                const QRgb pixel = scanline[x];
+                scanline[x] = ( pixel & 0xff000000 )
+                              | ( ( ( ( pixel >> 16 ) & 0xff ) * NightFactor >> 8 ) << 16 )
+                              | ( ( ( ( pixel >> 8 ) & 0xff ) * NightFactor >> 8 ) << 8 )
+                              | ( ( pixel & 0xff ) * NightFactor >> 8 );
+            }
+            continue;
+        }
+
+        const int *const weight = weights.constData();
+        for ( int x = 0; x < width; ++x ) {
+            const QRgb pixel = scanline[x];
+            const uint factor = NightFactor + ( ( 256 - NightFactor ) * weight[x] >> 8 );
+            scanline[x] = ( pixel & 0xff000000 )
+                          | ( ( ( ( pixel >> 16 ) & 0xff ) * factor >> 8 ) << 16 )
+                          | ( ( ( ( pixel >> 8 ) & 0xff ) * factor >> 8 ) << 8 )
+                          | ( ( pixel & 0xff ) * factor >> 8 );
+        }
+    }
+}
+
+void SunShadingMap::shadeComposite( QImage *tileImage, const QImage &nightImage ) const
+{
+    if ( tileImage->depth() != 32 || m_coverage == Daylight ) {
+        return;
+    }
+
+    Q_ASSERT( tileImage->size() == m_tileSize );
+    Q_ASSERT( nightImage.size() == m_tileSize && nightImage.depth() == 32 );
+
+    const int width = m_tileSize.width();
+    QVector<int> weights( width );
+
+    for ( int y = 0; y < m_tileSize.height(); ++y ) {
+        const Coverage rowCoverage = m_coverage == Darkness ? Darkness : rowWeights( y, weights );
+        if ( rowCoverage == Daylight ) {
+            continue;
+        }
+
+        QRgb *const scanline = reinterpret_cast<QRgb *>( tileImage->scanLine( y ) );
+        const QRgb *const nightScanline = reinterpret_cast<const QRgb *>( nightImage.scanLine( y ) );
+        if ( rowCoverage == Darkness ) {
+            memcpy( scanline, nightScanline, width * sizeof( QRgb ) );
+            continue;
+        }
+
+        const int *const weight = weights.constData();
+        for ( int x = 0; x < width; ++x ) {
+            const QRgb pixel = scanline[x];
+            const QRgb nightPixel = nightScanline[x];
+            const uint day = weight[x];
+            const uint night = 256 - day;
+            scanline[x] = ( pixel & 0xff000000 )
+                          | ( ( ( ( pixel >> 16 ) & 0xff ) * day + ( ( nightPixel >> 16 ) & 0xff ) * night ) >> 8 << 16 )
+                          | ( ( ( ( pixel >> 8 ) & 0xff ) * day + ( ( nightPixel >> 8 ) & 0xff ) * night ) >> 8 << 8 )
+                          | ( ( ( pixel & 0xff ) * day + ( nightPixel & 0xff ) * night ) >> 8 );
+        }
+    }
+}
+
+SunShadingMap::Coverage SunShadingMap::rowWeights( int y, QVector<int> &weights ) const
+{
+    const int columnCount = m_columns.size();
+    const int row = interval( m_rows, y );
+    const int nextRow = qMin( row + 1, m_rows.size() - 1 );
+    const int dy = y - m_rows[row];
+    const int rowDistance = qMax( 1, m_rows[nextRow] - m_rows[row] );
+
+    // interpolate the supporting points of the row first
+    QVarLengthArray<int, 64> points( columnCount );
+    bool daylight = true;
+    bool darkness = true;
+    for ( int column = 0; column < columnCount; ++column ) {
+        const int top = m_weights[row * columnCount + column];
+        const int bottom = m_weights[nextRow * columnCount + column];
+        points[column] = ( top * ( rowDistance - dy ) + bottom * dy ) / rowDistance;
+        daylight = daylight && points[column] == 256;
+        darkness = darkness && points[column] == 0;
+    }
+
+    if ( daylight ) {
+        return Daylight;
+    }
+    if ( darkness ) {
+        return Darkness;
+    }
+
+    int *const weight = weights.data();
+    for ( int column = 0; column + 1 < columnCount; ++column ) {
+        const int left = m_columns[column];
+        const int right = m_columns[column + 1];
+        const int leftWeight = points[column];
+        const int rightWeight = points[column + 1];
+        for ( int x = left; x < right; ++x ) {
+            weight[x] = ( leftWeight * ( right - x ) + rightWeight * ( x - left ) ) / ( right - left );
+        }
+    }
+    weight[m_columns.last()] = points[columnCount - 1];
+
+    return Twilight;
+}
+
+}
@@ -0,0 +1,82 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_SUNSHADINGMAP_H
+#define MARBLE_SUNSHADINGMAP_H
+
+#include <QSize>
+#include <QVector>
+
+class QImage;
+
+namespace Marble
+{
+
+class SunLocator;
+class TileId;
+
+/**
+ * @short The illumination of a texture tile by the sun.
+ *
+ * Tiles completely in daylight or darkness are recognized from the angular
+ * distance of the tile to the subsolar point without looking at any pixel.
+ * For the tiles in between, the brightness is evaluated on a coarse grid
+ * of supporting points and interpolated bilinearly, as it changes smoothly
+ * across the twilight zone.
+ *
+ * The tile is expected to be in equirectangular projection.
+ */
+class SunShadingMap
+{
+public:
+    enum Coverage {
+        Daylight,
+        Twilight,
+        Darkness
+    };
+
+    SunShadingMap( const SunLocator *sunLocator, const TileId &id, const QSize &tileSize,
+                   int levelZeroColumns, int levelZeroRows );
+
+    /**
+     * Returns how the tile @p id is lit with the subsolar point at
+     * @p sunLon and @p sunLat (in degrees).
+     */
+    static Coverage coverage( const SunLocator *sunLocator, qreal sunLon, qreal sunLat,
+                              const TileId &id, int levelZeroColumns, int levelZeroRows );
+
+    Coverage coverage() const;
+
+    /**
+     * Darkens the night side of @p tileImage.
+     */
+    void shade( QImage *tileImage ) const;
+
+    /**
+     * Replaces the night side of @p tileImage by @p nightImage, blending
+     * both in the twilight zone.
+     */
+    void shadeComposite( QImage *tileImage, const QImage &nightImage ) const;
+
+private:
+    // Fills the weights of the daylight for the row y in the range 0..256.
+    // Returns the coverage of the row.
+    Coverage rowWeights( int y, QVector<int> &weights ) const;
+
+    const QSize m_tileSize;
+    Coverage m_coverage;
+    // positions of the supporting points along the axes
+    QVector<int> m_columns;
+    QVector<int> m_rows;
+    // brightness at the supporting points in the range 0..256, row by row
+    QVector<int> m_weights;
+};
+
+}
+
+#endif
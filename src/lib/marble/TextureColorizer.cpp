@@ -22,6 +22,8 @@
 #include <QColor>
 #include <QImage>
 #include <QPainter>
+#include <QRunnable>
+#include <QThreadPool>
 
 #include "MarbleGlobal.h"
 #include "GeoPainter.h"
@@ -34,6 +36,7 @@
 #include "GeoDataPlacemark.h"
 #include "GeoDataDocument.h"
 #include "AbstractProjection.h"
+#include "ScanlineTextureMapperContext.h"
 
 namespace Marble
 {
@@ -65,9 +68,76 @@ private:
 };
 
 
+/**
+ * Colors chunks of scanlines of the canvas on a worker thread.
+ */
+class TextureColorizer::ColorizeJob : public QRunnable
+{
+public:
+    ColorizeJob( const TextureColorizer *colorizer, QImage *canvasImage, qint64 radius, ScanlineJobQueue *jobQueue );
+
+    virtual void run();
+
+private:
+    const TextureColorizer *const m_colorizer;
+    QImage *const m_canvasImage;
+    // the radius of the globe if it is in view, -1 if all pixels get colored
+    const qint64 m_radius;
+    ScanlineJobQueue *const m_jobQueue;
+};
+
+TextureColorizer::ColorizeJob::ColorizeJob( const TextureColorizer *colorizer, QImage *canvasImage, qint64 radius,
+                                            ScanlineJobQueue *jobQueue )
+    : m_colorizer( colorizer ),
+      m_canvasImage( canvasImage ),
+      m_radius( radius ),
+      m_jobQueue( jobQueue )
+{
+}
+
+void TextureColorizer::ColorizeJob::run()
+{
+    const int imgwidth = m_canvasImage->width();
+    const int imgrx    = imgwidth / 2;
+    const int imgry    = m_canvasImage->height() / 2;
+
+    QVector<uint> seaColors( imgwidth );
+    QVector<uint> landColors( imgwidth );
+
+    int yStart;
+    int yEnd;
+    while ( m_jobQueue->nextChunk( yStart, yEnd ) ) {
+        for ( int y = yStart; y < yEnd; ++y ) {
+            int  xLeft  = 0;
+            int  xRight = imgwidth;
+
+            if ( m_radius >= 0 ) {
+                const int  dy = imgry - y;
+                const int  rx = (int)sqrt( (qreal)( m_radius * m_radius - dy * dy ) );
+                if ( imgrx-rx > 0 ) {
+                    xLeft  = imgrx - rx;
+                    xRight = imgrx + rx;
+                }
+            }
+
+            QRgb *const scanline    = (QRgb*)( m_canvasImage->scanLine( y ) ) + xLeft;
+            const QRgb *const coastData = (const QRgb*)( m_colorizer->m_coastImage.constScanLine( y ) ) + xLeft;
+
+            m_colorizer->colorizeScanline( scanline, coastData, xRight - xLeft, m_radius >= 0,
+                                           seaColors.data(), landColors.data() );
+        }
+    }
+}
+
 TextureColorizer::TextureColorizer( const QString &seafile,
                                     const QString &landfile )
-    : m_showRelief( false ),
+    : m_coastImageValid( false ),
+      m_coastProjection( Spherical ),
+      m_coastRadius( 0 ),
+      m_coastCenterLon( 0.0 ),
+      m_coastCenterLat( 0.0 ),
+      m_coastAntialiased( false ),
+      m_showRelief( false ),
       m_landColor(qRgb( 255, 0, 0 ) ),
       m_seaColor( qRgb( 0, 255, 0 ) )
 {
@@ -148,11 +218,13 @@ TextureColorizer::TextureColorizer( const QString &seafile,
 void TextureColorizer::addSeaDocument( const GeoDataDocument *seaDocument )
 {
     m_seaDocuments.append( seaDocument );
+    m_coastImageValid = false;
 }
 
 void TextureColorizer::addLandDocument( const GeoDataDocument *landDocument )
 {
     m_landDocuments.append( landDocument );
+    m_coastImageValid = false;
 }
 
 void TextureColorizer::setShowRelief( bool show )
@@ -223,21 +295,9 @@ void TextureColorizer::drawTextureMap( GeoPainter *painter )
     }
 }
 
-void TextureColorizer::colorize( QImage *origimg, const ViewportParams *viewport, MapQuality mapQuality )
+void TextureColorizer::colorize( QImage *origimg, const ViewportParams *viewport, MapQuality mapQuality, QThreadPool *threadPool )
 {
-    if ( m_coastImage.size() != viewport->size() )
-        m_coastImage = QImage( viewport->size(), QImage::Format_RGB32 );
-
-    // update coast image
-    m_coastImage.fill( QColor( 0, 0, 255, 0).rgb() );
-
-    const bool antialiased =    mapQuality == HighQuality
-                             || mapQuality == PrintQuality;
-
-    GeoPainter painter( &m_coastImage, viewport, mapQuality );
-    painter.setRenderHint( QPainter::Antialiasing, antialiased );
-
-    drawTextureMap( &painter );
+    updateCoastImage( viewport, mapQuality );
 
     const qint64 radius = viewport->radius() * viewport->currentProjection()->clippingRadius();
 
@@ -245,130 +305,128 @@ void TextureColorizer::colorize( QImage *origimg, const ViewportParams *viewport
     const int  imgwidth  = origimg->width();
     const int  imgrx     = imgwidth / 2;
     const int  imgry     = imgheight / 2;
-    // This variable is not used anywhere..
     const int  imgradius = imgrx * imgrx + imgry * imgry;
 
-    int     bump = 8;
+    int yTop = 0;
+    int yBottom = imgheight;
+    // the globe doesn't cover the whole canvas, so only the pixels within its radius get colored
+    const bool globeInView = radius * radius <= imgradius && viewport->currentProjection()->isClippedToSphere();
 
-    if ( radius * radius > imgradius
-         || !viewport->currentProjection()->isClippedToSphere() )
+    if ( globeInView ) {
+        yTop = ( imgry-radius < 0 ) ? 0 : imgry-radius;
+        yBottom = ( yTop == 0 ) ? imgheight : imgry + radius;
+    }
+    else if( !viewport->currentProjection()->isClippedToSphere() && !viewport->currentProjection()->traversablePoles() )
     {
-        int yTop = 0;
-        int yBottom = imgheight;
-
-        if( !viewport->currentProjection()->isClippedToSphere() && !viewport->currentProjection()->traversablePoles() )
-        {
-            qreal realYTop, realYBottom, dummyX;
-            GeoDataCoordinates yNorth(0, viewport->currentProjection()->maxLat(), 0);
-            GeoDataCoordinates ySouth(0, viewport->currentProjection()->minLat(), 0);
-            viewport->screenCoordinates(yNorth, dummyX, realYTop );
-            viewport->screenCoordinates(ySouth, dummyX, realYBottom );
-            yTop = qBound(qreal(0.0), realYTop, qreal(imgheight));
-            yBottom = qBound(qreal(0.0), realYBottom, qreal(imgheight));
-        }
+        qreal realYTop, realYBottom, dummyX;
+        GeoDataCoordinates yNorth(0, viewport->currentProjection()->maxLat(), 0);
+        GeoDataCoordinates ySouth(0, viewport->currentProjection()->minLat(), 0);
+        viewport->screenCoordinates(yNorth, dummyX, realYTop );
+        viewport->screenCoordinates(ySouth, dummyX, realYBottom );
+        yTop = qBound(qreal(0.0), realYTop, qreal(imgheight));
+        yBottom = qBound(qreal(0.0), realYBottom, qreal(imgheight));
+    }
 
-        const int itEnd = yBottom;
+    const int numThreads = threadPool->maxThreadCount();
+    ScanlineJobQueue jobQueue( yTop, yBottom, numThreads );
+    for ( int i = 0; i < numThreads; ++i ) {
+        threadPool->start( new ColorizeJob( this, origimg, globeInView ? radius : -1, &jobQueue ) );
+    }
+    threadPool->waitForDone();
+}
 
-        for (int y = yTop; y < itEnd; ++y) {
+void TextureColorizer::updateCoastImage( const ViewportParams *viewport, MapQuality mapQuality )
+{
+    const bool antialiased =    mapQuality == HighQuality
+                             || mapQuality == PrintQuality;
+    const QVector<bool> seaVisibility = seaDocumentsVisibility();
+
+    if ( m_coastImageValid
+         && m_coastImage.size() == viewport->size()
+         && m_coastProjection == viewport->projection()
+         && m_coastRadius == viewport->radius()
+         && m_coastCenterLon == viewport->centerLongitude()
+         && m_coastCenterLat == viewport->centerLatitude()
+         && m_coastAntialiased == antialiased
+         && m_coastSeaVisibility == seaVisibility ) {
+        return;
+    }
 
-            QRgb  *writeData         = (QRgb*)( origimg->scanLine( y ) );
-            const QRgb  *coastData   = (QRgb*)( m_coastImage.scanLine( y ) );
+    if ( m_coastImage.size() != viewport->size() )
+        m_coastImage = QImage( viewport->size(), QImage::Format_RGB32 );
 
-            uchar *readDataStart     = origimg->scanLine( y );
-            const uchar *readDataEnd = readDataStart + imgwidth*4;
+    // update coast image
+    m_coastImage.fill( QColor( 0, 0, 255, 0).rgb() );
 
-            EmbossFifo  emboss;
+    GeoPainter painter( &m_coastImage, viewport, mapQuality );
+    painter.setRenderHint( QPainter::Antialiasing, antialiased );
 
-            for ( uchar* readData = readDataStart; 
-                  readData < readDataEnd;
-                  readData += 4, ++writeData, ++coastData )
-            {
+    drawTextureMap( &painter );
 
-                // Cheap Emboss / Bumpmapping
-                uchar&  grey = *readData; // qBlue(*data);
+    m_coastImageValid = true;
+    m_coastProjection = viewport->projection();
+    m_coastRadius = viewport->radius();
+    m_coastCenterLon = viewport->centerLongitude();
+    m_coastCenterLat = viewport->centerLatitude();
+    m_coastAntialiased = antialiased;
+    m_coastSeaVisibility = seaVisibility;
+}
 
-                if ( m_showRelief ) {
-                    emboss.enqueue(grey);
-                    bump = ( emboss.head() + 8 - grey );
-                    if (bump < 0) {
-                        bump = 0;
-                    } else if (bump > 15) {
-                        bump = 15;
-                    }
-                }
-                setPixel( coastData, writeData, bump, grey );
-            }
-        }
+QVector<bool> TextureColorizer::seaDocumentsVisibility() const
+{
+    QVector<bool> result;
+    result.reserve( m_seaDocuments.size() );
+    foreach( const GeoDataDocument *doc, m_seaDocuments ) {
+        result << doc->isVisible();
     }
-    else {
-        int yTop    = ( imgry-radius < 0 ) ? 0 : imgry-radius;
-        const int yBottom = ( yTop == 0 ) ? imgheight : imgry + radius;
-
-        EmbossFifo  emboss;
-
-        for ( int y = yTop; y < yBottom; ++y ) {
-            const int  dy = imgry - y;
-            int  rx = (int)sqrt( (qreal)( radius * radius - dy * dy ) );
-            int  xLeft  = 0; 
-            int  xRight = imgwidth;
-
-            if ( imgrx-rx > 0 ) {
-                xLeft  = imgrx - rx; 
-                xRight = imgrx + rx;
-            }
+    return result;
+}
 
-            QRgb  *writeData         = (QRgb*)( origimg->scanLine( y ) )  + xLeft;
-            const QRgb *coastData    = (QRgb*)( m_coastImage.scanLine( y ) ) + xLeft;
-
-            uchar *readDataStart     = origimg->scanLine( y ) + xLeft * 4;
-            const uchar *readDataEnd = origimg->scanLine( y ) + xRight * 4;
-
- 
-            for ( uchar* readData = readDataStart;
-                  readData < readDataEnd;
-                  readData += 4, ++writeData, ++coastData )
-            {
-                // Cheap Emboss / Bumpmapping
-
-                uchar& grey = *readData; // qBlue(*data);
-
-                if ( m_showRelief ) {
-                    emboss.enqueue(grey);
-                    bump = ( emboss.head() + 16 - grey ) >> 1;
-                    if (bump < 0) {
-                        bump = 0;
-                    } else if (bump > 15) {
-                        bump = 15;
-                    }
-                }
-                setPixel( coastData, writeData, bump, grey );
+void TextureColorizer::colorizeScanline( QRgb *scanline, const QRgb *coastData, int width, bool softRelief,
+                                         uint *seaColors, uint *landColors ) const
+{
+    const uint *const palette = &texturepalette[0][0];
+
+    // Cheap Emboss / Bumpmapping. It depends on the previous pixels, so the
+    // palette indices are determined first and looked up separately.
+    EmbossFifo  emboss;
+    int  bump = 8;
+    for ( int x = 0; x < width; ++x ) {
+        const uchar grey = qBlue( scanline[x] );
+
+        if ( m_showRelief ) {
+            emboss.enqueue(grey);
+            bump = softRelief ? ( emboss.head() + 16 - grey ) >> 1
+                              : ( emboss.head() + 8 - grey );
+            if (bump < 0) {
+                bump = 0;
+            } else if (bump > 15) {
+                bump = 15;
             }
         }
+        seaColors[x] = bump * 512 + grey;
     }
-}
 
-void TextureColorizer::setPixel( const QRgb *coastData, QRgb *writeData, int bump, uchar grey )
-{
-    int alpha = qRed( *coastData );
-    if ( alpha == 255 )
-        *writeData = texturepalette[bump][grey + 0x100];
-    else if( alpha == 0 ){
-        *writeData = texturepalette[bump][grey];
+    // the land colors follow the sea colors in each row of the palette
+    for ( int x = 0; x < width; ++x ) {
+        const uint index = seaColors[x];
+        landColors[x] = palette[index + 0x100];
+        seaColors[x] = palette[index];
     }
-    else {
-        qreal c = 1.0 / 255.0;
-
-        QRgb landcolor  = (QRgb)(texturepalette[bump][grey + 0x100]);
-        QRgb watercolor = (QRgb)(texturepalette[bump][grey]);
-
-        *writeData = qRgb(
-                    (int) ( c * ( alpha * qRed( landcolor )
-                                  + ( 255 - alpha ) * qRed( watercolor ) ) ),
-                    (int) ( c * ( alpha * qGreen( landcolor )
-                                  + ( 255 - alpha ) * qGreen( watercolor ) ) ),
-                    (int) ( c * ( alpha * qBlue( landcolor )
-                                  + ( 255 - alpha ) * qBlue( watercolor ) ) )
-                    );
+
+    // The red channel of the coast image holds the land coverage. Blending
+    // every pixel keeps the loop free of branches, pure land and sea pixels
+    // come out unchanged.
+    for ( int x = 0; x < width; ++x ) {
+        const uint land = qRed( coastData[x] );
+        const uint sea = 255 - land;
+        const uint landColor = landColors[x];
+        const uint seaColor = seaColors[x];
+        scanline[x] = 0xff000000
+                      | ( ( ( ( landColor >> 16 ) & 0xff ) * land + ( ( seaColor >> 16 ) & 0xff ) * sea ) / 255 << 16 )
+                      | ( ( ( ( landColor >> 8 ) & 0xff ) * land + ( ( seaColor >> 8 ) & 0xff ) * sea ) / 255 << 8 )
+                      | ( ( landColor & 0xff ) * land + ( seaColor & 0xff ) * sea ) / 255;
     }
 }
+
 }
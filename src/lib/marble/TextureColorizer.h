@@ -23,6 +23,9 @@
 #include <QString>
 #include <QImage>
 #include <QColor>
+#include <QVector>
+
+class QThreadPool;
 
 namespace Marble
 {
@@ -47,16 +50,36 @@ class TextureColorizer
 
     void drawTextureMap( GeoPainter *painter );
 
-    void colorize( QImage *origimg, const ViewportParams *viewport, MapQuality mapQuality );
-
-    void setPixel( const QRgb *coastData, QRgb *writeData, int bump, uchar grey );
+    /**
+     * Colors the gray scale height field in @p origimg. The scanlines are
+     * split among the threads of @p threadPool, which is expected to be idle.
+     */
+    void colorize( QImage *origimg, const ViewportParams *viewport, MapQuality mapQuality, QThreadPool *threadPool );
 
  private:
+    class ColorizeJob;
+
+    // Renders the land and sea documents into m_coastImage unless they
+    // have been rendered for the same view already.
+    void updateCoastImage( const ViewportParams *viewport, MapQuality mapQuality );
+    QVector<bool> seaDocumentsVisibility() const;
+
+    void colorizeScanline( QRgb *scanline, const QRgb *coastData, int width, bool softRelief,
+                           uint *seaColors, uint *landColors ) const;
+
     QString m_seafile;
     QString m_landfile;
     QList<const GeoDataDocument*> m_seaDocuments;
     QList<const GeoDataDocument*> m_landDocuments;
     QImage m_coastImage;
+    // the view m_coastImage has been rendered for
+    bool m_coastImageValid;
+    Projection m_coastProjection;
+    int m_coastRadius;
+    qreal m_coastCenterLon;
+    qreal m_coastCenterLat;
+    bool m_coastAntialiased;
+    QVector<bool> m_coastSeaVisibility;
     uint texturepalette[16][512];
     bool m_showRelief;
     QRgb      m_landColor;
@@ -11,6 +11,8 @@
 
 #include "TextureMapperInterface.h"
 
+#include "TileId.h"
+
 using namespace Marble;
 
 TextureMapperInterface::TextureMapperInterface() :
@@ -27,3 +29,15 @@ void TextureMapperInterface::setRepaintNeeded()
 {
     m_repaintNeeded = true;
 }
+
+void TextureMapperInterface::setCenterChanged()
+{
+    m_repaintNeeded = true;
+}
+
+void TextureMapperInterface::setTileChanged( const TileId &stackedTileId )
+{
+    Q_UNUSED( stackedTileId );
+
+    m_repaintNeeded = true;
+}
@@ -21,6 +21,7 @@ class GeoPainter;
 class StackedTile;
 class StackedTileLoader;
 class TextureColorizer;
+class TileId;
 class ViewportParams;
 
 
@@ -38,6 +39,19 @@ public:
 
     void setRepaintNeeded();
 
+    /**
+     * Notifies the mapper that the center of the viewport moved. The
+     * default implementation maps the whole texture again.
+     */
+    virtual void setCenterChanged();
+
+    /**
+     * Notifies the mapper that the content of the stacked tile
+     * @p stackedTileId changed. The default implementation maps the whole
+     * texture again.
+     */
+    virtual void setTileChanged( const TileId &stackedTileId );
+
 protected:
     bool m_repaintNeeded;
 };
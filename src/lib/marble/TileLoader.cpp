@@ -24,6 +24,7 @@
 #include <QFileInfo>
 #include <QMetaType>
 #include <QImage>
+#include <QRunnable>
 #include <QUrl>
 
 #include "GeoSceneTextureTileDataset.h"
@@ -32,24 +33,57 @@
 #include "GeoSceneVectorTileDataset.h"
 #include "GeoDataDocument.h"
 #include "GeoDataContainer.h"
+#include "FileStorageIndex.h"
 #include "HttpDownloadManager.h"
 #include "MarbleDebug.h"
 #include "MarbleDirs.h"
+#include "MbTileStorage.h"
 #include "TileLoaderHelper.h"
 #include "ParseRunnerPlugin.h"
 #include "ParsingRunner.h"
+#include "VectorTileCache.h"
 
 Q_DECLARE_METATYPE( Marble::DownloadUsage )
 
 namespace Marble
 {
 
+class VectorTileCacheJob : public QRunnable
+{
+public:
+    VectorTileCacheJob( const TileLoader *loader, const QString &fileName ) :
+        m_loader( loader ),
+        m_fileName( fileName )
+    {
+    }
+
+    virtual void run()
+    {
+        m_loader->writeVectorTileCache( m_fileName );
+    }
+
+private:
+    const TileLoader *const m_loader;
+    const QString m_fileName;
+};
+
+// Returns the name of @p fileName relative to the local data directory, as
+// used by the cache index, or an empty string for files outside of it
+static QString localFileName( const QString &fileName )
+{
+    const QString localPath = MarbleDirs::localPath() + QLatin1Char( '/' );
+    return fileName.startsWith( localPath ) ? fileName.mid( localPath.size() ) : QString();
+}
+
 TileLoader::TileLoader(HttpDownloadManager * const downloadManager, const PluginManager *pluginManager) :
     m_pluginManager(pluginManager)
 {
+    // one thread keeps the cache writes from competing with loading tiles
+    m_cacheThreadPool.setMaxThreadCount( 1 );
     qRegisterMetaType<DownloadUsage>( "DownloadUsage" );
-    connect( this, SIGNAL(downloadTile(QUrl,QString,QString,DownloadUsage)),
-             downloadManager, SLOT(addJob(QUrl,QString,QString,DownloadUsage)));
+    qRegisterMetaType<GeoDataCoordinates>( "GeoDataCoordinates" );
+    connect( this, SIGNAL(downloadTile(QUrl,QString,QString,DownloadUsage,GeoDataCoordinates,int)),
+             downloadManager, SLOT(addJob(QUrl,QString,QString,DownloadUsage,GeoDataCoordinates,int)));
     connect( downloadManager, SIGNAL(downloadComplete(QString,QString)),
              SLOT(updateTile(QString,QString)));
     connect( downloadManager, SIGNAL(downloadComplete(QByteArray,QString)),
@@ -58,7 +92,8 @@ TileLoader::TileLoader(HttpDownloadManager * const downloadManager, const Plugin
 
 TileLoader::~TileLoader()
 {
-    // nothing to do
+    m_cacheThreadPool.clear();
+    m_cacheThreadPool.waitForDone();
 }
 
 // If the tile image file is locally available:
@@ -80,8 +115,11 @@ QImage TileLoader::loadTileImage( GeoSceneTextureTileDataset const *textureLayer
             triggerDownload( textureLayer, tileId, usage );
         }
 
-        QImage const image( fileName );
+        QByteArray const data = packedTileData( textureLayer, tileId );
+        QImage const image = data.isEmpty() ? QImage( fileName ) : QImage::fromData( data );
         if ( !image.isNull() ) {
+            // keeps the tile from being removed from the cache soon
+            FileStorageIndex::index( MarbleDirs::localPath() )->recordAccess( textureLayer->relativeTileFileName( tileId ) );
             // file is there, so create and return a tile object in any case
             return image;
         }
@@ -199,13 +237,17 @@ bool TileLoader::baseTilesAvailable( GeoSceneTileDataset const & tileData )
 
 TileLoader::TileStatus TileLoader::tileStatus( GeoSceneTileDataset const *tileData, const TileId &tileId )
 {
-    QString const fileName = tileFileName( tileData, tileId );
-    QFileInfo fileInfo( fileName );
-    if ( !fileInfo.exists() ) {
-        return Missing;
+    // A tile in the pack is newer than a file left over from before it
+    QDateTime lastModified;
+    if ( packedTileData( tileData, tileId, &lastModified ).isEmpty() ) {
+        QString const fileName = tileFileName( tileData, tileId );
+        QFileInfo fileInfo( fileName );
+        if ( !fileInfo.exists() ) {
+            return Missing;
+        }
+        lastModified = fileInfo.lastModified();
     }
 
-    const QDateTime lastModified = fileInfo.lastModified();
     const int expireSecs = tileData->expire();
     const bool isExpired = lastModified.secsTo( QDateTime::currentDateTime() ) >= expireSecs;
     return isExpired ? Expired : Available;
@@ -260,6 +302,41 @@ QString TileLoader::tileFileName( GeoSceneTileDataset const * tileData, TileId c
     return dirInfo.isAbsolute() ? fileName : MarbleDirs::path( fileName );
 }
 
+QByteArray TileLoader::packedTileData( GeoSceneTileDataset const * tileData, TileId const & tileId, QDateTime *lastModified )
+{
+    // Base tiles and vector tiles are always stored as files, see MbTileStoragePolicy
+    if ( tileId.zoomLevel() <= maxBaseTileLevel || tileData->nodeType() != GeoSceneTypes::GeoSceneTextureTileType ) {
+        return QByteArray();
+    }
+
+    QString themePath;
+    int zoomLevel, column, row;
+    if ( !MbTileStorage::parseTileFileName( tileData->relativeTileFileName( tileId ), themePath, zoomLevel, column, row ) ) {
+        return QByteArray();
+    }
+
+    QString const packFileName = MbTileStorage::packFileName( themePath );
+    QStringList candidates;
+    if ( QFileInfo( packFileName ).isAbsolute() ) {
+        candidates << packFileName;
+    } else {
+        candidates << MarbleDirs::localPath() + QLatin1Char( '/' ) + packFileName
+                   << MarbleDirs::systemPath() + QLatin1Char( '/' ) + packFileName;
+    }
+
+    foreach ( const QString &candidate, candidates ) {
+        MbTileStorage *const storage = MbTileStorage::storage( candidate );
+        if ( storage ) {
+            QByteArray const data = storage->tileData( zoomLevel, column, row, lastModified );
+            if ( !data.isEmpty() ) {
+                return data;
+            }
+        }
+    }
+
+    return QByteArray();
+}
+
 void TileLoader::triggerDownload( GeoSceneTileDataset const *tileData, TileId const &id, DownloadUsage const usage )
 {
     if (id.zoomLevel() > 0) {
@@ -273,7 +350,7 @@ void TileLoader::triggerDownload( GeoSceneTileDataset const *tileData, TileId co
     QUrl const sourceUrl = tileData->downloadUrl( id );
     QString const destFileName = tileData->relativeTileFileName( id );
     QString const idStr = QString( "%1:%2:%3:%4:%5" ).arg( tileData->nodeType()).arg( tileData->sourceDir() ).arg( id.zoomLevel() ).arg( id.x() ).arg( id.y() );
-    emit downloadTile( sourceUrl, destFileName, idStr, usage );
+    emit downloadTile( sourceUrl, destFileName, idStr, usage, id.toLatLonBox( tileData ).center(), id.zoomLevel() );
 }
 
 QImage TileLoader::scaledLowerLevelTile( const GeoSceneTextureTileDataset * textureData, TileId const & id )
@@ -291,7 +368,8 @@ QImage TileLoader::scaledLowerLevelTile( const GeoSceneTextureTileDataset * text
                                         id.x() >> deltaLevel, id.y() >> deltaLevel );
         QString const fileName = tileFileName( textureData, replacementTileId );
         mDebug() << "TileLoader::scaledLowerLevelTile" << "trying" << fileName;
-        QImage toScale = QFile::exists(fileName) ? QImage(fileName) : QImage();
+        QByteArray const data = packedTileData( textureData, replacementTileId );
+        QImage toScale = !data.isEmpty() ? QImage::fromData( data ) : QFile::exists(fileName) ? QImage(fileName) : QImage();
 
         if ( level == 0 && toScale.isNull() ) {
             mDebug() << "No level zero tile installed in map theme dir. Falling back to a transparent image for now.";
@@ -321,6 +399,38 @@ QImage TileLoader::scaledLowerLevelTile( const GeoSceneTextureTileDataset * text
 }
 
 GeoDataDocument *TileLoader::openVectorFile(const QString &fileName) const
+{
+    // Loading the binary cache is much faster than parsing the tile. It
+    // is only used if it has been written after the tile was downloaded.
+    QString const cacheFileName = VectorTileCache::cacheFileName(fileName);
+    QFileInfo const cacheInfo(cacheFileName);
+    GeoDataDocument* document = nullptr;
+    if (cacheInfo.exists() && cacheInfo.lastModified() >= QFileInfo(fileName).lastModified()) {
+        document = VectorTileCache::load(cacheFileName);
+    }
+
+    bool const cached = document != nullptr;
+    if (!cached) {
+        document = parseVectorFile(fileName);
+        if (document) {
+            queueVectorTileCache(fileName);
+        }
+    }
+
+    // keeps the tile and its cache from being removed from the cache soon
+    QString const localName = localFileName(fileName);
+    if (document && !localName.isEmpty()) {
+        FileStorageIndex *const index = FileStorageIndex::index(MarbleDirs::localPath());
+        index->recordAccess(localName);
+        if (cached) {
+            index->recordAccess(VectorTileCache::cacheFileName(localName));
+        }
+    }
+
+    return document;
+}
+
+GeoDataDocument *TileLoader::parseVectorFile(const QString &fileName) const
 {
     QList<const ParseRunnerPlugin*> plugins = m_pluginManager->parsingRunnerPlugins();
     const QFileInfo fileInfo( fileName );
@@ -345,6 +455,40 @@ GeoDataDocument *TileLoader::openVectorFile(const QString &fileName) const
     return nullptr;
 }
 
+void TileLoader::queueVectorTileCache(const QString &fileName) const
+{
+    // Serializing the document would delay the tile, and the document
+    // belongs to the tree model as soon as it is returned. So the cache
+    // gets written from a document of its own in the background.
+    if (!QFileInfo(QFileInfo(fileName).absolutePath()).isWritable()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_cacheMutex);
+    if (m_queuedCacheFiles.contains(fileName)) {
+        return;
+    }
+    m_queuedCacheFiles.insert(fileName);
+    m_cacheThreadPool.start(new VectorTileCacheJob(this, fileName));
+}
+
+void TileLoader::writeVectorTileCache(const QString &fileName) const
+{
+    GeoDataDocument* document = parseVectorFile(fileName);
+    if (document) {
+        QString const cacheFileName = VectorTileCache::cacheFileName(fileName);
+        QString const localName = localFileName(cacheFileName);
+        if (VectorTileCache::save(*document, cacheFileName) && !localName.isEmpty()) {
+            // accounted for like the tiles, so the cache size limit covers it
+            FileStorageIndex::index(MarbleDirs::localPath())->recordUpdate(localName, QFileInfo(cacheFileName).size());
+        }
+        delete document;
+    }
+
+    QMutexLocker locker(&m_cacheMutex);
+    m_queuedCacheFiles.remove(fileName);
+}
+
 }
 
 #include "moc_TileLoader.cpp"
@@ -20,14 +20,19 @@
 #ifndef MARBLE_TILELOADER_H
 #define MARBLE_TILELOADER_H
 
+#include <QMutex>
 #include <QObject>
+#include <QSet>
+#include <QThreadPool>
 
 #include "TileId.h"
 #include "GeoDataContainer.h"
+#include "GeoDataCoordinates.h"
 #include "PluginManager.h"
 #include "MarbleGlobal.h"
 
 class QByteArray;
+class QDateTime;
 class QImage;
 class QUrl;
 class QString;
@@ -81,7 +86,8 @@ class TileLoader: public QObject
 
  Q_SIGNALS:
     void downloadTile( QUrl const & sourceUrl, QString const & destinationFileName,
-                       QString const & id, DownloadUsage );
+                       QString const & id, DownloadUsage,
+                       GeoDataCoordinates const & tilePosition, int tileZoomLevel );
 
     void tileCompleted( TileId const & tileId, QImage const & tileImage );
 
@@ -89,12 +95,23 @@ class TileLoader: public QObject
 
  private:
     static QString tileFileName( GeoSceneTileDataset const * tileData, TileId const & );
+    static QByteArray packedTileData( GeoSceneTileDataset const * tileData, TileId const &, QDateTime *lastModified = 0 );
     void triggerDownload( GeoSceneTileDataset const *tileData, TileId const &, DownloadUsage const );
     static QImage scaledLowerLevelTile( GeoSceneTextureTileDataset const * textureData, TileId const & );
     GeoDataDocument* openVectorFile(const QString &filename) const;
+    GeoDataDocument* parseVectorFile(const QString &fileName) const;
+    void queueVectorTileCache(const QString &fileName) const;
+    void writeVectorTileCache(const QString &fileName) const;
+
+    friend class VectorTileCacheJob;
 
     // For vectorTile parsing
     PluginManager const * m_pluginManager;
+
+    // Writes the binary caches of vector tiles in the background
+    mutable QThreadPool m_cacheThreadPool;
+    mutable QMutex m_cacheMutex;
+    mutable QSet<QString> m_queuedCacheFiles;
 };
 
 }
@@ -139,7 +139,7 @@ void TileScalingTextureMapper::mapTexture( GeoPainter *painter, const ViewportPa
         }
 
         if ( texColorizer ) {
-            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality() );
+            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality(), &m_threadPool );
         }
     } else {
         painter->save();
@@ -20,6 +20,7 @@
 #include <QCache>
 #include <QImage>
 #include <QPixmap>
+#include <QThreadPool>
 
 namespace Marble
 {
@@ -52,6 +53,7 @@ class TileScalingTextureMapper : public QObject, public TextureMapperInterface
     QCache<TileId, const QPixmap> m_cache;
     QImage m_canvasImage;
     int    m_radius;
+    QThreadPool m_threadPool;   // for colorizing the canvas
 };
 
 }
@@ -0,0 +1,611 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "VectorTileCache.h"
+
+#include "GeoDataDocument.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "GeoDataPolyStyle.h"
+#include "GeoDataStyle.h"
+#include "GeoDataTypes.h"
+#include "MarbleDebug.h"
+#include "MarbleGlobal.h"
+#include "OsmObjectManager.h"
+#include "OsmPlacemarkData.h"
+
+#include <QByteArray>
+#include <QColor>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <iterator>
+
+namespace Marble
+{
+
+namespace
+{
+
+const quint32 MagicNumber = 0x4354564d; // "MVTC"
+const quint16 FormatVersion = 2;
+// magic, version, flags, number of strings, styles and placemarks
+const int HeaderSize = 4 + 2 + 2 + 3 * 4;
+
+enum GeometryType {
+    NoGeometry,
+    PointGeometry,
+    LineStringGeometry,
+    LinearRingGeometry,
+    PolygonGeometry
+};
+
+inline qint32 toFixed( qreal radian )
+{
+    return qRound( radian * RAD2DEG * 1e7 );
+}
+
+inline qreal fromFixed( qint64 fixed )
+{
+    return fixed * ( 1e-7 * DEG2RAD );
+}
+
+class Writer
+{
+public:
+    Writer() :
+        m_lastLon( 0 ),
+        m_lastLat( 0 ),
+        m_styleCount( 0 ),
+        m_placemarkCount( 0 )
+    {
+    }
+
+    bool writeDocument( const GeoDataDocument &document, QByteArray &data );
+
+private:
+    bool writeStyle( const GeoDataStyle &style );
+    bool writePlacemark( const GeoDataPlacemark &placemark );
+    bool writeGeometry( const GeoDataGeometry *geometry );
+    bool writeOsmData( const OsmPlacemarkData &osmData );
+    bool writeCoordinates( const GeoDataCoordinates &coordinates );
+    bool writeLineString( const GeoDataLineString &lineString );
+
+    void writeVarint( QByteArray &data, quint64 value );
+    void writeVarint( quint64 value ) { writeVarint( m_body, value ); }
+    void writeSigned( qint64 value ) { writeVarint( ( quint64( value ) << 1 ) ^ quint64( value >> 63 ) ); }
+    void writeString( const QString &string );
+
+    QByteArray m_body;
+    QByteArray m_styles;
+    QHash<QString, quint32> m_stringIndex;
+    QVector<QString> m_strings;
+    qint64 m_lastLon;
+    qint64 m_lastLat;
+    quint32 m_styleCount;
+    quint32 m_placemarkCount;
+};
+
+bool Writer::writeDocument( const GeoDataDocument &document, QByteArray &data )
+{
+    foreach ( const GeoDataStyle::ConstPtr &style, document.styles() ) {
+        if ( !writeStyle( *style ) ) {
+            return false;
+        }
+    }
+    m_styles.swap( m_body );
+
+    foreach ( const GeoDataFeature *feature, document.featureList() ) {
+        if ( feature->nodeType() != GeoDataTypes::GeoDataPlacemarkType ) {
+            return false;
+        }
+        if ( !writePlacemark( *static_cast<const GeoDataPlacemark *>( feature ) ) ) {
+            return false;
+        }
+    }
+
+    QByteArray strings;
+    foreach ( const QString &string, m_strings ) {
+        const QByteArray utf8 = string.toUtf8();
+        writeVarint( strings, utf8.size() );
+        strings += utf8;
+    }
+
+    data.resize( HeaderSize );
+    uchar *header = reinterpret_cast<uchar *>( data.data() );
+    qToLittleEndian<quint32>( MagicNumber, header );
+    qToLittleEndian<quint16>( FormatVersion, header + 4 );
+    qToLittleEndian<quint16>( 0, header + 6 );
+    qToLittleEndian<quint32>( m_strings.size(), header + 8 );
+    qToLittleEndian<quint32>( m_styleCount, header + 12 );
+    qToLittleEndian<quint32>( m_placemarkCount, header + 16 );
+
+    data.reserve( HeaderSize + strings.size() + m_styles.size() + m_body.size() );
+    data += strings;
+    data += m_styles;
+    data += m_body;
+    return true;
+}
+
+bool Writer::writeStyle( const GeoDataStyle &style )
+{
+    // Only the poly style is supported, which is all the vector tile
+    // parsers use (e.g. for the background of the tile)
+    GeoDataStyle polyOnly;
+    polyOnly.setId( style.id() );
+    polyOnly.setPolyStyle( style.polyStyle() );
+    if ( !( style == polyOnly ) ) {
+        return false;
+    }
+
+    writeString( style.id() );
+    writeVarint( style.polyStyle().color().rgba() );
+    writeVarint( ( style.polyStyle().fill() ? 1 : 0 ) | ( style.polyStyle().outline() ? 2 : 0 ) );
+    ++m_styleCount;
+    return true;
+}
+
+bool Writer::writePlacemark( const GeoDataPlacemark &placemark )
+{
+    if ( !placemark.styleUrl().isEmpty() || placemark.customStyle() ) {
+        return false;
+    }
+
+    writeVarint( placemark.visualCategory() );
+    writeString( placemark.name() );
+    writeVarint( placemark.isVisible() ? 1 : 0 );
+    writeSigned( placemark.zoomLevel() );
+    writeSigned( placemark.popularity() );
+    writeSigned( placemark.population() );
+    if ( !writeOsmData( placemark.osmData() ) || !writeGeometry( placemark.geometry() ) ) {
+        return false;
+    }
+
+    ++m_placemarkCount;
+    return true;
+}
+
+bool Writer::writeGeometry( const GeoDataGeometry *geometry )
+{
+    if ( !geometry ) {
+        writeVarint( NoGeometry );
+        return true;
+    }
+
+    const char *type = geometry->nodeType();
+    if ( type == GeoDataTypes::GeoDataPointType ) {
+        writeVarint( PointGeometry );
+        return writeCoordinates( static_cast<const GeoDataPoint *>( geometry )->coordinates() );
+    }
+    if ( type == GeoDataTypes::GeoDataLineStringType ) {
+        writeVarint( LineStringGeometry );
+        return writeLineString( *static_cast<const GeoDataLineString *>( geometry ) );
+    }
+    if ( type == GeoDataTypes::GeoDataLinearRingType ) {
+        writeVarint( LinearRingGeometry );
+        return writeLineString( *static_cast<const GeoDataLinearRing *>( geometry ) );
+    }
+    if ( type == GeoDataTypes::GeoDataPolygonType ) {
+        const GeoDataPolygon *polygon = static_cast<const GeoDataPolygon *>( geometry );
+        writeVarint( PolygonGeometry );
+        if ( !writeLineString( polygon->outerBoundary() ) ) {
+            return false;
+        }
+        writeVarint( polygon->innerBoundaries().size() );
+        foreach ( const GeoDataLinearRing &ring, polygon->innerBoundaries() ) {
+            if ( !writeLineString( ring ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool Writer::writeOsmData( const OsmPlacemarkData &osmData )
+{
+    writeSigned( osmData.id() );
+
+    writeVarint( std::distance( osmData.tagsBegin(), osmData.tagsEnd() ) );
+    for ( auto iter = osmData.tagsBegin(), end = osmData.tagsEnd(); iter != end; ++iter ) {
+        writeString( iter.key() );
+        writeString( iter.value() );
+    }
+
+    // Nodes without tags only carry their id, which is not needed for display
+    QVector<QHash<GeoDataCoordinates, OsmPlacemarkData>::const_iterator> nodes;
+    for ( auto iter = osmData.nodeReferencesBegin(), end = osmData.nodeReferencesEnd(); iter != end; ++iter ) {
+        if ( iter.value().tagsBegin() != iter.value().tagsEnd() ) {
+            nodes << iter;
+        }
+    }
+    writeVarint( nodes.size() );
+    for ( int i = 0; i < nodes.size(); ++i ) {
+        if ( !writeCoordinates( nodes[i].key() ) || !writeOsmData( nodes[i].value() ) ) {
+            return false;
+        }
+    }
+
+    writeVarint( std::distance( osmData.memberReferencesBegin(), osmData.memberReferencesEnd() ) );
+    for ( auto iter = osmData.memberReferencesBegin(), end = osmData.memberReferencesEnd(); iter != end; ++iter ) {
+        writeSigned( iter.key() );
+        if ( !writeOsmData( iter.value() ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Writer::writeCoordinates( const GeoDataCoordinates &coordinates )
+{
+    if ( coordinates.altitude() != 0.0 ) {
+        return false;
+    }
+
+    const qint64 lon = toFixed( coordinates.longitude() );
+    const qint64 lat = toFixed( coordinates.latitude() );
+    writeSigned( lon - m_lastLon );
+    writeSigned( lat - m_lastLat );
+    // the level of detail assigned by GeoDataLineString::optimize()
+    m_body += char( coordinates.detail() );
+    m_lastLon = lon;
+    m_lastLat = lat;
+    return true;
+}
+
+bool Writer::writeLineString( const GeoDataLineString &lineString )
+{
+    writeVarint( lineString.size() );
+    for ( int i = 0; i < lineString.size(); ++i ) {
+        if ( !writeCoordinates( lineString.at( i ) ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Writer::writeVarint( QByteArray &data, quint64 value )
+{
+    while ( value >= 0x80 ) {
+        data += char( ( value & 0x7f ) | 0x80 );
+        value >>= 7;
+    }
+    data += char( value );
+}
+
+void Writer::writeString( const QString &string )
+{
+    auto iter = m_stringIndex.constFind( string );
+    if ( iter == m_stringIndex.constEnd() ) {
+        iter = m_stringIndex.insert( string, m_strings.size() );
+        m_strings << string;
+    }
+    writeVarint( iter.value() );
+}
+
+class Reader
+{
+public:
+    Reader( const uchar *data, qint64 size ) :
+        m_pos( data ),
+        m_end( data + size ),
+        m_ok( true ),
+        m_lastLon( 0 ),
+        m_lastLat( 0 )
+    {
+    }
+
+    GeoDataDocument *readDocument();
+
+private:
+    GeoDataPlacemark *readPlacemark();
+    GeoDataGeometry *readGeometry();
+    void readOsmData( OsmPlacemarkData &osmData );
+    GeoDataCoordinates readCoordinates();
+    void readLineString( GeoDataLineString &lineString );
+
+    quint64 readVarint();
+    qint64 readSigned()
+    {
+        const quint64 value = readVarint();
+        return qint64( value >> 1 ) ^ -qint64( value & 1 );
+    }
+    quint8 readByte();
+    const QString &readString();
+    int readCount();
+
+    const uchar *m_pos;
+    const uchar *const m_end;
+    bool m_ok;
+    QVector<QString> m_strings;
+    qint64 m_lastLon;
+    qint64 m_lastLat;
+};
+
+GeoDataDocument *Reader::readDocument()
+{
+    if ( m_end - m_pos < HeaderSize ||
+         qFromLittleEndian<quint32>( m_pos ) != MagicNumber ||
+         qFromLittleEndian<quint16>( m_pos + 4 ) != FormatVersion ) {
+        return 0;
+    }
+
+    const quint32 stringCount = qFromLittleEndian<quint32>( m_pos + 8 );
+    const quint32 styleCount = qFromLittleEndian<quint32>( m_pos + 12 );
+    const quint32 placemarkCount = qFromLittleEndian<quint32>( m_pos + 16 );
+    m_pos += HeaderSize;
+
+    // every entry takes at least one byte
+    if ( qint64( stringCount ) + styleCount + placemarkCount > m_end - m_pos ) {
+        return 0;
+    }
+
+    m_strings.reserve( stringCount );
+    for ( quint32 i = 0; i < stringCount && m_ok; ++i ) {
+        const quint64 length = readVarint();
+        if ( length > quint64( m_end - m_pos ) ) {
+            return 0;
+        }
+        m_strings << QString::fromUtf8( reinterpret_cast<const char *>( m_pos ), length );
+        m_pos += length;
+    }
+
+    GeoDataDocument *document = new GeoDataDocument;
+
+    for ( quint32 i = 0; i < styleCount && m_ok; ++i ) {
+        GeoDataStyle::Ptr style( new GeoDataStyle );
+        style->setId( readString() );
+        GeoDataPolyStyle polyStyle;
+        polyStyle.setColor( QColor::fromRgba( readVarint() ) );
+        const quint64 flags = readVarint();
+        polyStyle.setFill( flags & 1 );
+        polyStyle.setOutline( flags & 2 );
+        style->setPolyStyle( polyStyle );
+        document->addStyle( style );
+    }
+
+    for ( quint32 i = 0; i < placemarkCount && m_ok; ++i ) {
+        GeoDataPlacemark *placemark = readPlacemark();
+        if ( placemark ) {
+            document->append( placemark );
+        }
+    }
+
+    if ( !m_ok ) {
+        delete document;
+        return 0;
+    }
+
+    return document;
+}
+
+GeoDataPlacemark *Reader::readPlacemark()
+{
+    GeoDataPlacemark *placemark = new GeoDataPlacemark;
+    placemark->setVisualCategory( GeoDataFeature::GeoDataVisualCategory( readVarint() ) );
+    placemark->setName( readString() );
+    placemark->setVisible( readVarint() & 1 );
+    placemark->setZoomLevel( readSigned() );
+    placemark->setPopularity( readSigned() );
+    placemark->setPopulation( readSigned() );
+    readOsmData( placemark->osmData() );
+
+    GeoDataGeometry *geometry = readGeometry();
+    if ( !m_ok ) {
+        delete geometry;
+        delete placemark;
+        return 0;
+    }
+    if ( geometry ) {
+        placemark->setGeometry( geometry );
+    }
+
+    OsmObjectManager::registerId( placemark->osmData().id() );
+    return placemark;
+}
+
+GeoDataGeometry *Reader::readGeometry()
+{
+    switch ( readVarint() ) {
+    case NoGeometry:
+        return 0;
+    case PointGeometry:
+        return new GeoDataPoint( readCoordinates() );
+    case LineStringGeometry: {
+        GeoDataLineString *lineString = new GeoDataLineString;
+        readLineString( *lineString );
+        return lineString;
+    }
+    case LinearRingGeometry: {
+        GeoDataLinearRing *ring = new GeoDataLinearRing;
+        readLineString( *ring );
+        return ring;
+    }
+    case PolygonGeometry: {
+        GeoDataPolygon *polygon = new GeoDataPolygon;
+        GeoDataLinearRing outer;
+        readLineString( outer );
+        polygon->setOuterBoundary( outer );
+        const int innerCount = readCount();
+        for ( int i = 0; i < innerCount && m_ok; ++i ) {
+            GeoDataLinearRing inner;
+            readLineString( inner );
+            polygon->appendInnerBoundary( inner );
+        }
+        return polygon;
+    }
+    }
+
+    m_ok = false;
+    return 0;
+}
+
+void Reader::readOsmData( OsmPlacemarkData &osmData )
+{
+    osmData.setId( readSigned() );
+
+    const int tagCount = readCount();
+    for ( int i = 0; i < tagCount && m_ok; ++i ) {
+        const QString &key = readString();
+        osmData.addTag( key, readString() );
+    }
+
+    const int nodeCount = readCount();
+    for ( int i = 0; i < nodeCount && m_ok; ++i ) {
+        const GeoDataCoordinates coordinates = readCoordinates();
+        OsmPlacemarkData node;
+        readOsmData( node );
+        osmData.addNodeReference( coordinates, node );
+    }
+
+    const int memberCount = readCount();
+    for ( int i = 0; i < memberCount && m_ok; ++i ) {
+        const int key = readSigned();
+        OsmPlacemarkData member;
+        readOsmData( member );
+        osmData.addMemberReference( key, member );
+    }
+}
+
+GeoDataCoordinates Reader::readCoordinates()
+{
+    m_lastLon += readSigned();
+    m_lastLat += readSigned();
+    const int detail = readByte();
+    return GeoDataCoordinates( fromFixed( m_lastLon ), fromFixed( m_lastLat ), 0.0, GeoDataCoordinates::Radian, detail );
+}
+
+void Reader::readLineString( GeoDataLineString &lineString )
+{
+    const int count = readCount();
+    QVector<GeoDataCoordinates> coordinates;
+    coordinates.reserve( count );
+    for ( int i = 0; i < count && m_ok; ++i ) {
+        coordinates << readCoordinates();
+    }
+    lineString.append( coordinates );
+}
+
+quint64 Reader::readVarint()
+{
+    quint64 value = 0;
+    for ( int shift = 0; shift < 64; shift += 7 ) {
+        if ( m_pos >= m_end ) {
+            break;
+        }
+        const uchar byte = *m_pos++;
+        value |= quint64( byte & 0x7f ) << shift;
+        if ( !( byte & 0x80 ) ) {
+            return value;
+        }
+    }
+
+    m_ok = false;
+    return 0;
+}
+
+quint8 Reader::readByte()
+{
+    if ( m_pos >= m_end ) {
+        m_ok = false;
+        return 0;
+    }
+    return *m_pos++;
+}
+
+const QString &Reader::readString()
+{
+    static const QString empty;
+    const quint64 index = readVarint();
+    if ( index >= quint64( m_strings.size() ) ) {
+        m_ok = false;
+        return empty;
+    }
+    return m_strings.at( index );
+}
+
+int Reader::readCount()
+{
+    // every element takes at least one byte, so larger counts are corrupt
+    const quint64 count = readVarint();
+    if ( count > quint64( m_end - m_pos ) ) {
+        m_ok = false;
+        return 0;
+    }
+    return count;
+}
+
+}
+
+QString VectorTileCache::cacheFileName( const QString &tileFileName )
+{
+    return tileFileName + QLatin1String( ".mvtc" );
+}
+
+GeoDataDocument *VectorTileCache::load( const QString &fileName )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        return 0;
+    }
+
+    const qint64 size = file.size();
+    const uchar *data = file.map( 0, size );
+    if ( !data ) {
+        mDebug() << "Unable to map vector tile cache" << fileName;
+        return 0;
+    }
+
+    GeoDataDocument *document = read( data, size );
+    if ( !document ) {
+        mDebug() << "Invalid vector tile cache" << fileName;
+    }
+    // the mapping is released when the file gets closed
+    return document;
+}
+
+GeoDataDocument *VectorTileCache::read( const uchar *data, qint64 size )
+{
+    Reader reader( data, size );
+    return reader.readDocument();
+}
+
+bool VectorTileCache::save( const GeoDataDocument &document, const QString &fileName )
+{
+    // Do not serialize documents which cannot be stored anyway
+    if ( !QFileInfo( QFileInfo( fileName ).absolutePath() ).isWritable() ) {
+        return false;
+    }
+
+    QByteArray data;
+    if ( !write( document, data ) ) {
+        return false;
+    }
+
+    // Readers must never see a partially written file
+    QSaveFile file( fileName );
+    if ( !file.open( QIODevice::WriteOnly ) || file.write( data ) != data.size() ) {
+        mDebug() << "Unable to write vector tile cache" << fileName;
+        return false;
+    }
+    return file.commit();
+}
+
+bool VectorTileCache::write( const GeoDataDocument &document, QByteArray &data )
+{
+    Writer writer;
+    return writer.writeDocument( document, data );
+}
+
+}
@@ -0,0 +1,85 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_VECTORTILECACHE_H
+#define MARBLE_VECTORTILECACHE_H
+
+#include "marble_export.h"
+
+#include <QtGlobal>
+
+class QByteArray;
+class QString;
+
+namespace Marble
+{
+
+class GeoDataDocument;
+
+/**
+ * @short A compact binary file format for vector tiles that loads without parsing.
+ *
+ * Vector tiles are usually stored as o5m or OSM files which need to be parsed
+ * into a GeoDataDocument every time they enter the view. The cache format
+ * stores the result of that parsing step instead:
+ *
+ * - all strings (tag keys and values, names) are stored once in a string table
+ *   and shared by all placemarks of the tile
+ * - the visual category, name and zoom level of each placemark are resolved
+ *   already, so StyleBuilder::determineVisualCategory() is not needed
+ * - coordinates are stored as fixed point values in 1e-7 degrees (the
+ *   resolution of o5m), delta encoded and written as variable length integers
+ *   followed by their level of detail
+ *
+ * Cache files get memory mapped and the document is built directly from the
+ * mapped memory.
+ *
+ * Only documents which contain nothing but placemarks with point, line
+ * string, linear ring or polygon geometries on the ground can be written.
+ * This is what the OSM parser creates. Of the OSM data only the ids, tags
+ * and the references of nodes with tags get stored, which is everything
+ * needed for rendering.
+ */
+class MARBLE_EXPORT VectorTileCache
+{
+public:
+    /**
+     * Returns the name of the cache file that belongs to the vector tile
+     * @p tileFileName.
+     */
+    static QString cacheFileName( const QString &tileFileName );
+
+    /**
+     * Returns the document stored in the cache file @p fileName or 0 if
+     * the file does not exist or is not a valid cache file.
+     */
+    static GeoDataDocument *load( const QString &fileName );
+
+    /**
+     * Builds the document stored in the @p size bytes starting at @p data.
+     * Returns 0 if the data is not a valid cache file.
+     */
+    static GeoDataDocument *read( const uchar *data, qint64 size );
+
+    /**
+     * Stores @p document in the cache file @p fileName. Returns false if the
+     * document contains data that cannot be represented in the cache format
+     * or if the file cannot be written.
+     */
+    static bool save( const GeoDataDocument &document, const QString &fileName );
+
+    /**
+     * Serializes @p document into @p data. Returns false if the document
+     * contains data that cannot be represented in the cache format.
+     */
+    static bool write( const GeoDataDocument &document, QByteArray &data );
+};
+
+}
+
+#endif
@@ -11,6 +11,7 @@
 
 #include "VectorTileModel.h"
 
+#include "FrameProfiler.h"
 #include "GeoDataDocument.h"
 #include "GeoDataLatLonBox.h"
 #include "GeoDataTreeModel.h"
@@ -37,6 +38,7 @@ TileRunner::TileRunner( TileLoader *loader, const GeoSceneVectorTileDataset *tex
 
 void TileRunner::run()
 {
+    FrameProfiler::Scope scope( "TileRunner: load vector tile" );
     GeoDataDocument *const document = m_loader->loadTileVectorData( m_texture, m_id, DownloadBrowse );
 
     emit documentLoaded( m_id, document );
@@ -71,24 +73,7 @@ VectorTileModel::VectorTileModel( TileLoader *loader, const GeoSceneVectorTileDa
 
 void VectorTileModel::setViewport( const GeoDataLatLonBox &latLonBox, int radius )
 {
-    // choose the smaller dimension for selecting the tile level, leading to higher-resolution results
-    const int levelZeroWidth = m_layer->tileSize().width() * m_layer->levelZeroColumns();
-    const int levelZeroHight = m_layer->tileSize().height() * m_layer->levelZeroRows();
-    const int levelZeroMinDimension = qMin( levelZeroWidth, levelZeroHight );
-
-    qreal linearLevel = ( 4.0 * (qreal)( radius ) / (qreal)( levelZeroMinDimension ) );
-
-    if ( linearLevel < 1.0 )
-        linearLevel = 1.0; // Dirty fix for invalid entry linearLevel
-
-    // As our tile resolution doubles with each level we calculate
-    // the tile level from tilesize and the globe radius via log(2)
-
-    qreal tileLevelF = qLn( linearLevel ) / qLn( 2.0 );
-    int tileZoomLevel = (int)( tileLevelF * 1.00001 );
-    // snap to the sharper tile level a tiny bit earlier
-    // to work around rounding errors when the radius
-    // roughly equals the global texture width
+    int tileZoomLevel = zoomLevel( radius );
     m_tileZoomLevel = tileZoomLevel;
 
     // Determine available tile levels in the layer and thereby
@@ -100,14 +85,7 @@ void VectorTileModel::setViewport( const GeoDataLatLonBox &latLonBox, int radius
         m_documents.clear();
         return;
     }
-    int tileLevel = tileLevels.first();
-    for (int i=1, n=tileLevels.size(); i<n; ++i) {
-        if (tileLevels[i] > tileZoomLevel) {
-            break;
-        }
-        tileLevel = tileLevels[i];
-    }
-    tileZoomLevel = tileLevel;
+    tileZoomLevel = tileLevels[tileLevelIndex( tileLevels, tileZoomLevel )];
 
     // if zoom level has changed, empty vectortile cache
     if ( tileZoomLevel != m_tileLoadLevel ) {
@@ -142,6 +120,110 @@ void VectorTileModel::setViewport( const GeoDataLatLonBox &latLonBox, int radius
     removeTilesOutOfView(latLonBox);
 }
 
+int VectorTileModel::prefetchTiles( const GeoDataLatLonBox &latLonBox, int radius, int budget )
+{
+    const QVector<int> tileLevels = m_layer->tileLevels();
+    if ( tileLevels.isEmpty() ) {
+        return 0;
+    }
+
+    // the level which would be displayed and the one above it
+    const int index = tileLevelIndex( tileLevels, zoomLevel( radius ) );
+    QVector<TileId> tiles = tilesInBox( latLonBox, tileLevels[index] );
+    if ( index > 0 ) {
+        tiles << tilesInBox( latLonBox, tileLevels[index - 1] );
+    }
+
+    // Parsed documents would end up in the tree model right away, so just
+    // make sure the files are on disc by the time they are needed.
+    int requested = 0;
+    foreach ( const TileId &tileId, tiles ) {
+        if ( requested >= budget ) {
+            break;
+        }
+        if ( m_documents.contains( tileId ) || m_pendingDocuments.contains( tileId ) ) {
+            continue;
+        }
+        if ( TileLoader::tileStatus( m_layer, tileId ) == TileLoader::Available ) {
+            continue;
+        }
+        m_loader->downloadTile( m_layer, tileId, DownloadBulk );
+        ++requested;
+    }
+
+    return requested;
+}
+
+int VectorTileModel::zoomLevel( int radius ) const
+{
+    // choose the smaller dimension for selecting the tile level, leading to higher-resolution results
+    const int levelZeroWidth = m_layer->tileSize().width() * m_layer->levelZeroColumns();
+    const int levelZeroHight = m_layer->tileSize().height() * m_layer->levelZeroRows();
+    const int levelZeroMinDimension = qMin( levelZeroWidth, levelZeroHight );
+
+    qreal linearLevel = ( 4.0 * (qreal)( radius ) / (qreal)( levelZeroMinDimension ) );
+
+    if ( linearLevel < 1.0 )
+        linearLevel = 1.0; // Dirty fix for invalid entry linearLevel
+
+    // As our tile resolution doubles with each level we calculate
+    // the tile level from tilesize and the globe radius via log(2)
+
+    qreal tileLevelF = qLn( linearLevel ) / qLn( 2.0 );
+    // snap to the sharper tile level a tiny bit earlier
+    // to work around rounding errors when the radius
+    // roughly equals the global texture width
+    return (int)( tileLevelF * 1.00001 );
+}
+
+int VectorTileModel::tileLevelIndex( const QVector<int> &tileLevels, int zoomLevel )
+{
+    Q_ASSERT( !tileLevels.isEmpty() );
+
+    int index = 0;
+    for (int i=1, n=tileLevels.size(); i<n; ++i) {
+        if (tileLevels[i] > zoomLevel) {
+            break;
+        }
+        index = i;
+    }
+    return index;
+}
+
+QVector<TileId> VectorTileModel::tilesInBox( const GeoDataLatLonBox &latLonBox, int tileZoomLevel ) const
+{
+    const unsigned int maxTileX = ( 1 << tileZoomLevel ) * m_layer->levelZeroColumns();
+    const unsigned int maxTileY = ( 1 << tileZoomLevel ) * m_layer->levelZeroRows();
+
+    const unsigned int westX = qBound<unsigned int>(  0, lon2tileX( latLonBox.west(),  maxTileX ), maxTileX - 1 );
+    const unsigned int northY = qBound<unsigned int>( 0, lat2tileY( latLonBox.north(), maxTileY ), maxTileY - 1 );
+    unsigned int eastX = qBound<unsigned int>(  0, lon2tileX( latLonBox.east(),  maxTileX ), maxTileX - 1 );
+    const unsigned int southY = qBound<unsigned int>( 0, lat2tileY( latLonBox.south(), maxTileY ), maxTileY - 1 );
+    if ( latLonBox.crossesDateLine() ) {
+        eastX += maxTileX;
+    }
+
+    QVector<TileId> tiles;
+    for ( unsigned int x = westX; x <= eastX; ++x ) {
+        for ( unsigned int y = northY; y <= southY; ++y ) {
+            tiles << TileId( 0, tileZoomLevel, x % maxTileX, y );
+        }
+    }
+
+    // tiles in the center of the box come first
+    const qreal centerX = 0.5 * ( westX + eastX + 1 );
+    const qreal centerY = 0.5 * ( northY + southY + 1 );
+    qSort( tiles.begin(), tiles.end(), [=]( const TileId &a, const TileId &b ) {
+        const qreal ax = ( a.x() < int( westX ) ? a.x() + maxTileX : a.x() ) + 0.5 - centerX;
+        const qreal bx = ( b.x() < int( westX ) ? b.x() + maxTileX : b.x() ) + 0.5 - centerX;
+        const qreal ay = a.y() + 0.5 - centerY;
+        const qreal by = b.y() + 0.5 - centerY;
+        return ax * ax + ay * ay < bx * bx + by * by;
+    } );
+
+    return tiles;
+}
+
 void VectorTileModel::removeTilesOutOfView(const GeoDataLatLonBox &boundingBox)
 {
     GeoDataLatLonBox const extendedViewport = boundingBox.scaled(2.0, 2.0);
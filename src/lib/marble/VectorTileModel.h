@@ -16,6 +16,7 @@
 #include <QRunnable>
 
 #include <QMap>
+#include <QVector>
 
 #include "TileId.h"
 
@@ -57,6 +58,12 @@ public:
 
     void setViewport( const GeoDataLatLonBox &bbox, int radius );
 
+    /**
+     * Queues the missing tiles which the given view would show for download.
+     * @return the number of requested tiles, at most @p budget
+     */
+    int prefetchTiles( const GeoDataLatLonBox &bbox, int radius, int budget );
+
     QString name() const;
 
     void removeTile(GeoDataDocument* document);
@@ -81,6 +88,9 @@ private Q_SLOTS:
 private:
     void removeTilesOutOfView(const GeoDataLatLonBox &boundingBox);
     void queryTiles( int tileZoomLevel, unsigned int minX, unsigned int minY, unsigned int maxX, unsigned int maxY );
+    int zoomLevel( int radius ) const;
+    static int tileLevelIndex( const QVector<int> &tileLevels, int zoomLevel );
+    QVector<TileId> tilesInBox( const GeoDataLatLonBox &latLonBox, int tileZoomLevel ) const;
 
     static unsigned int lon2tileX( qreal lon, unsigned int maxTileX );
     static unsigned int lat2tileY( qreal lat, unsigned int maxTileY );
@@ -16,9 +16,9 @@
 
 #include "GeoDataPlacemark.h"
 #include "GeoDataStyle.h"
-#include "PlacemarkLayer.h"
 
 #include <QApplication>
+#include <QImage>
 #include <QPainter>
 #include <QPalette>
 
@@ -33,7 +33,7 @@ VisiblePlacemark::VisiblePlacemark( const GeoDataPlacemark *placemark, const Geo
     QObject::connect( remoteLoader, SIGNAL(iconReady()),
                      this, SLOT(setSymbolPixmap()) );
 
-    drawLabelPixmap();
+    updateLabelKey();
     setSymbolPixmap();
 }
 
@@ -42,9 +42,26 @@ const GeoDataPlacemark* VisiblePlacemark::placemark() const
     return m_placemark;
 }
 
-const QPixmap& VisiblePlacemark::symbolPixmap() const
+PlacemarkGlyphAtlas::Glyph VisiblePlacemark::symbolGlyph()
 {
-    return m_symbolPixmap;
+    if ( m_symbolKey.isEmpty() ) {
+        return PlacemarkGlyphAtlas::Glyph();
+    }
+
+    PlacemarkGlyphAtlas *const atlas = PlacemarkGlyphAtlas::instance();
+    if ( !atlas->use( m_symbolGlyph ) ) {
+        // most symbols are shared by many placemarks and rasterized already
+        m_symbolGlyph = atlas->glyph( m_symbolKey );
+        if ( !m_symbolGlyph.isValid() ) {
+            m_symbolGlyph = atlas->insert( m_symbolKey, m_style->iconStyle().scaledIcon() );
+        }
+    }
+    return m_symbolGlyph;
+}
+
+const QSize& VisiblePlacemark::symbolSize() const
+{
+    return m_symbolSize;
 }
 
 bool VisiblePlacemark::selected() const
@@ -55,7 +72,7 @@ bool VisiblePlacemark::selected() const
 void VisiblePlacemark::setSelected( bool selected )
 {
     m_selected = selected;
-    drawLabelPixmap();
+    updateLabelKey();
 }
 
 const QPoint& VisiblePlacemark::symbolPosition() const
@@ -103,15 +120,30 @@ void VisiblePlacemark::setSymbolPosition( const QPoint& position )
     m_symbolPosition = position;
 }
 
-const QPixmap& VisiblePlacemark::labelPixmap() const
+PlacemarkGlyphAtlas::Glyph VisiblePlacemark::labelGlyph()
 {
-    return m_labelPixmap;
+    if ( m_labelKey.isEmpty() ) {
+        return PlacemarkGlyphAtlas::Glyph();
+    }
+
+    PlacemarkGlyphAtlas *const atlas = PlacemarkGlyphAtlas::instance();
+    if ( !atlas->use( m_labelGlyph ) ) {
+        m_labelGlyph = atlas->glyph( m_labelKey );
+        if ( !m_labelGlyph.isValid() ) {
+            m_labelGlyph = atlas->insert( m_labelKey, drawLabelImage() );
+        }
+    }
+    return m_labelGlyph;
 }
 
 void VisiblePlacemark::setSymbolPixmap()
 {
     if (m_style) {
-        m_symbolPixmap = QPixmap::fromImage(m_style->iconStyle().scaledIcon() );
+        const QImage icon = m_style->iconStyle().scaledIcon();
+        m_symbolSize = icon.size();
+        // the icon is shared by all placemarks of the style, and so is its glyph
+        m_symbolKey = icon.isNull() ? QString() : QStringLiteral( "symbol:%1" ).arg( icon.cacheKey() );
+        m_symbolGlyph = PlacemarkGlyphAtlas::Glyph();
         emit updateNeeded();
     }
     else {
@@ -132,7 +164,7 @@ void VisiblePlacemark::setLabelRect( const QRectF& labelRect )
 void VisiblePlacemark::setStyle(const GeoDataStyle::ConstPtr &style)
 {
     m_style = style;
-    drawLabelPixmap();
+    updateLabelKey();
     setSymbolPixmap();
 }
 
@@ -141,24 +173,49 @@ GeoDataStyle::ConstPtr VisiblePlacemark::style() const
     return m_style;
 }
 
-void VisiblePlacemark::drawLabelPixmap()
+VisiblePlacemark::LabelStyle VisiblePlacemark::labelStyle() const
+{
+    if ( m_selected ) {
+        return Selected;
+    } else if ( m_style->labelStyle().glow() ) {
+        return Glow;
+    }
+    return Normal;
+}
+
+void VisiblePlacemark::updateLabelKey()
 {
-    QString labelName = m_placemark->displayName();
-    if ( labelName.isEmpty() || m_style->labelStyle().color() == QColor(Qt::transparent) ) {
-        m_labelPixmap = QPixmap();
+    m_labelGlyph = PlacemarkGlyphAtlas::Glyph();
+
+    const QString labelName = m_placemark->displayName();
+    const QColor labelColor = m_style->labelStyle().color();
+    if ( labelName.isEmpty() || labelColor == QColor(Qt::transparent) ) {
+        m_labelKey.clear();
         return;
     }
 
+    // Everything the label is rendered from, so that placemarks with the
+    // same name and style share their label.
+    const LabelStyle style = labelStyle();
+    m_labelKey = QStringLiteral( "label:%1:%2:%3:" )
+            .arg( int( style ) )
+            .arg( labelColor.rgba(), 0, 16 )
+            .arg( m_style->labelStyle().scaledFont().toString() );
+    if ( style == Selected ) {
+        const QPalette palette = QApplication::palette();
+        m_labelKey += QStringLiteral( "%1:%2:" )
+                .arg( palette.highlight().color().rgba(), 0, 16 )
+                .arg( palette.highlightedText().color().rgba(), 0, 16 );
+    }
+    m_labelKey += labelName;
+}
+
+QImage VisiblePlacemark::drawLabelImage() const
+{
+    const QString labelName = m_placemark->displayName();
     QFont  labelFont  = m_style->labelStyle().scaledFont();
     QColor labelColor = m_style->labelStyle().color();
 
-    LabelStyle labelStyle = Normal;
-    if ( m_selected ) {
-        labelStyle = Selected;
-    } else if ( m_style->labelStyle().glow() ) {
-        labelStyle = Glow;
-    }
-
     int textHeight = QFontMetrics( labelFont ).height();
 
     int textWidth;
@@ -170,29 +227,23 @@ void VisiblePlacemark::drawLabelPixmap()
         textWidth = ( QFontMetrics( labelFont ).width( labelName ) );
     }
 
+    if ( textWidth <= 0 || textHeight <= 0 ) {
+        return QImage();
+    }
 
-    // Due to some XOrg bug this requires a workaround via
-    // QImage in some cases (at least with Qt 4.2).
-    if ( !PlacemarkLayer::m_useXWorkaround ) {
-        m_labelPixmap = QPixmap( QSize( textWidth, textHeight ) );
-        m_labelPixmap.fill( Qt::transparent );
-
-        QPainter labelPainter( &m_labelPixmap );
-
-        drawLabelText( labelPainter, labelName, labelFont, labelStyle, labelColor );
-    } else {
-        QImage image( QSize( textWidth, textHeight ),
-                      QImage::Format_ARGB32_Premultiplied );
-        image.fill( 0 );
+    // Labels are rendered to an image rather than a pixmap as some XOrg
+    // servers make text on transparent pixmaps fully transparent.
+    QImage image( QSize( textWidth, textHeight ),
+                  QImage::Format_ARGB32_Premultiplied );
+    image.fill( 0 );
 
-        QPainter labelPainter( &image );
+    QPainter labelPainter( &image );
 
-        drawLabelText( labelPainter, labelName, labelFont, labelStyle, labelColor );
+    drawLabelText( labelPainter, labelName, labelFont, labelStyle(), labelColor );
 
-        labelPainter.end();
+    labelPainter.end();
 
-        m_labelPixmap = QPixmap::fromImage( image );
-    }
+    return image;
 }
 
 void VisiblePlacemark::drawLabelText(QPainter &labelPainter, const QString &text,
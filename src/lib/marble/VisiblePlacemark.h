@@ -17,11 +17,12 @@
 #define MARBLE_VISIBLEPLACEMARK_H
 
 #include <QObject>
-#include <QPixmap>
 #include <QPoint>
 #include <QRectF>
+#include <QSize>
 
 #include <GeoDataStyle.h>
+#include "PlacemarkGlyphAtlas.h"
 
 namespace Marble
 {
@@ -50,9 +51,15 @@ class VisiblePlacemark : public QObject
     const GeoDataPlacemark* placemark() const;
 
     /**
-     * Returns the pixmap of the place mark symbol.
+     * Returns the glyph of the place mark symbol in the shared atlas,
+     * rasterizing it if needed.
      */
-    const QPixmap& symbolPixmap() const;
+    PlacemarkGlyphAtlas::Glyph symbolGlyph();
+
+    /**
+     * Returns the size of the place mark symbol.
+     */
+    const QSize& symbolSize() const;
 
     /**
      * Returns the state of the place mark.
@@ -80,9 +87,10 @@ class VisiblePlacemark : public QObject
     void setSymbolPosition( const QPoint& position );
 
     /**
-     * Returns the pixmap of the place mark name label.
+     * Returns the glyph of the place mark name label in the shared atlas,
+     * rasterizing it if needed.
      */
-    const QPixmap& labelPixmap() const;
+    PlacemarkGlyphAtlas::Glyph labelGlyph();
 
     /**
      * Returns the area covered by the place mark name label on the map.
@@ -112,17 +120,24 @@ private Q_SLOTS:
 
  private:
     static void drawLabelText( QPainter &labelPainter, const QString &text, const QFont &labelFont, LabelStyle labelStyle, const QColor &color );
-    void drawLabelPixmap();
+    LabelStyle labelStyle() const;
+    void updateLabelKey();
+    QImage drawLabelImage() const;
 
     const GeoDataPlacemark *m_placemark;
 
     // View stuff
     QPoint      m_symbolPosition; // position of the placemark's symbol
     bool        m_selected;       // state of the placemark
-    QPixmap     m_labelPixmap;    // the text label (most often name)
     QRectF      m_labelRect;      // bounding box of label
 
-    mutable QPixmap     m_symbolPixmap; // cached value
+    // the text label (most often name) and the symbol are kept in the atlas
+    QString     m_labelKey;
+    PlacemarkGlyphAtlas::Glyph m_labelGlyph;
+    QString     m_symbolKey;
+    QSize       m_symbolSize;
+    PlacemarkGlyphAtlas::Glyph m_symbolGlyph;
+
     GeoDataStyle::ConstPtr m_style;
 };
 
@@ -18,13 +18,103 @@
 #include "TextureTile.h"
 
 #include <cmath>
+#include <limits>
 
 #include <QImage>
 #include <QPainter>
+#include <QVector>
 
 namespace Marble
 {
 
+namespace
+{
+
+// Applies blendPixel to all pixels of bottom and the corresponding pixels of
+// top, both 32 bit images of the same size. The operator is inlined into the
+// scanline loop, so there are no calls per pixel.
+template<typename Operator>
+void blendScanlines( QImage * const bottom, QImage const &top, Operator const &blendPixel )
+{
+    int const width = bottom->width();
+    int const height = bottom->height();
+    for ( int y = 0; y < height; ++y ) {
+        QRgb * const bottomLine = reinterpret_cast<QRgb *>( bottom->scanLine( y ) );
+        QRgb const * const topLine = reinterpret_cast<QRgb const *>( top.constScanLine( y ) );
+        for ( int x = 0; x < width; ++x ) {
+            bottomLine[x] = blendPixel( bottomLine[x], topLine[x] );
+        }
+    }
+}
+
+// Applies blendPixel like blendScanlines(), passing the pixels of top
+// premultiplied. The usual tile formats are read directly, instead of
+// converting the whole top image on every blend.
+template<typename Operator>
+void blendPremultipliedScanlines( QImage * const bottom, QImage const &top, Operator const &blendPixel )
+{
+    switch ( top.format() ) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        blendScanlines( bottom, top, blendPixel );
+        return;
+    case QImage::Format_ARGB32:
+        blendScanlines( bottom, top, [&blendPixel]( QRgb const bottomPixel, QRgb const topPixel ) {
+            return blendPixel( bottomPixel, qPremultiply( topPixel ) );
+        } );
+        return;
+    case QImage::Format_Indexed8: {
+        // indexes beyond the color table are transparent
+        QVector<QRgb> colors = top.colorTable();
+        colors.resize( 256 );
+        for ( int i = 0; i < colors.size(); ++i ) {
+            colors[i] = qPremultiply( colors[i] );
+        }
+        QRgb const * const colorTable = colors.constData();
+        int const width = bottom->width();
+        int const height = bottom->height();
+        for ( int y = 0; y < height; ++y ) {
+            QRgb * const bottomLine = reinterpret_cast<QRgb *>( bottom->scanLine( y ) );
+            uchar const * const topLine = top.constScanLine( y );
+            for ( int x = 0; x < width; ++x ) {
+                bottomLine[x] = blendPixel( bottomLine[x], colorTable[topLine[x]] );
+            }
+        }
+        return;
+    }
+    default:
+        blendScanlines( bottom, top.convertToFormat( QImage::Format_ARGB32_Premultiplied ), blendPixel );
+    }
+}
+
+// Returns the color channel for the intensity value in the range 0..255,
+// the way qRgb() used to truncate it.
+inline uchar channelValue( qreal const value )
+{
+    if ( value != value ) {
+        return 0;
+    }
+    qreal const clamped = qBound( qreal( std::numeric_limits<int>::min() ), value,
+                                  qreal( std::numeric_limits<int>::max() ) );
+    return uchar( int( clamped ) & 0xff );
+}
+
+// lookup table for the intensities of clouds blending, indexed by the bottom
+// intensity * 256 + the top red intensity
+QVector<uchar> createCloudsTable()
+{
+    QVector<uchar> table( 256 * 256 );
+    for ( int bottom = 0; bottom < 256; ++bottom ) {
+        for ( int top = 0; top < 256; ++top ) {
+            qreal const c = top / 255.0;
+            table[bottom * 256 + top] = uchar( int( bottom + ( 255 - bottom ) * c ) );
+        }
+    }
+    return table;
+}
+
+}
+
 void OverpaintBlending::blend( QImage * const bottom, TextureTile const * const top ) const
 {
     Q_ASSERT( bottom );
@@ -45,21 +135,22 @@ void GrayscaleBlending::blend( QImage * const bottom, TextureTile const * const
     Q_ASSERT( top->image() );
     Q_ASSERT( bottom->size() == top->image()->size() );
     Q_ASSERT( bottom->format() == QImage::Format_ARGB32_Premultiplied );
-    QImage const topImagePremult = top->image()->convertToFormat( QImage::Format_ARGB32_Premultiplied );
 
-    // Draw a grayscale version of the bottom image
-    int const width = bottom->width();
-    int const height = bottom->height();
+    // Draw a grayscale version of the top image
+    blendPremultipliedScanlines( bottom, *top->image(), []( QRgb const, QRgb const topPixel ) {
+        int const gray = qGray( topPixel );
+        return qRgb( gray, gray, gray );
+    } );
+}
 
-    for ( int y = 0; y < height; ++y ) {
-        for ( int x = 0; x < width; ++x ) {
-            QRgb const topPixel = topImagePremult.pixel( x, y );
-            int const gray = qGray( topPixel );
-            QRgb const grayPixel = qRgb( gray, gray, gray );
-            bottom->setPixel( x, y,grayPixel );
-        }
-    }
+IndependentChannelBlending::IndependentChannelBlending() :
+    m_channelTable( 0 )
+{
+}
 
+IndependentChannelBlending::~IndependentChannelBlending()
+{
+    delete[] m_channelTable.load();
 }
 
 // pre-conditions:
@@ -73,24 +164,36 @@ void IndependentChannelBlending::blend( QImage * const bottom,
     Q_ASSERT( bottom->size() == topImage->size() );
     Q_ASSERT( bottom->format() == QImage::Format_ARGB32_Premultiplied );
 
-    int const width = bottom->width();
-    int const height = bottom->height();
-    QImage const topImagePremult = topImage->convertToFormat( QImage::Format_ARGB32_Premultiplied );
-    for ( int y = 0; y < height; ++y ) {
-        for ( int x = 0; x < width; ++x ) {
-            QRgb const bottomPixel = bottom->pixel( x, y );
-            QRgb const topPixel = topImagePremult.pixel( x, y );
-            qreal const resultRed = blendChannel( qRed( bottomPixel ) / 255.0,
-                                                  qRed( topPixel ) / 255.0 );
-            qreal const resultGreen = blendChannel( qGreen( bottomPixel ) / 255.0,
-                                                    qGreen( topPixel ) / 255.0 );
-            qreal const resultBlue = blendChannel( qBlue( bottomPixel ) / 255.0,
-                                                   qBlue( topPixel ) / 255.0 );
-            bottom->setPixel( x, y, qRgb( resultRed * 255.0,
-                                          resultGreen * 255.0,
-                                          resultBlue * 255.0 ));
+    uchar const * const table = channelTable();
+    blendPremultipliedScanlines( bottom, *topImage, [table]( QRgb const bottomPixel, QRgb const topPixel ) {
+        return qRgb( table[qRed( bottomPixel ) * 256 + qRed( topPixel )],
+                     table[qGreen( bottomPixel ) * 256 + qGreen( topPixel )],
+                     table[qBlue( bottomPixel ) * 256 + qBlue( topPixel )] );
+    } );
+}
+
+uchar const * IndependentChannelBlending::channelTable() const
+{
+    uchar const * table = m_channelTable.loadAcquire();
+    if ( table ) {
+        return table;
+    }
+
+    // As there are only 256 intensities per channel, blendChannel() is
+    // evaluated once for all of their combinations.
+    uchar * const newTable = new uchar[256 * 256];
+    for ( int bottom = 0; bottom < 256; ++bottom ) {
+        for ( int top = 0; top < 256; ++top ) {
+            newTable[bottom * 256 + top] = channelValue( blendChannel( bottom / 255.0, top / 255.0 ) * 255.0 );
         }
     }
+
+    // another thread may have been faster
+    if ( m_channelTable.testAndSetOrdered( 0, newTable ) ) {
+        return newTable;
+    }
+    delete[] newTable;
+    return m_channelTable.loadAcquire();
 }
 
 
@@ -325,20 +428,24 @@ void CloudsBlending::blend( QImage * const bottom, TextureTile const * const top
     QImage const * const topImage = top->image();
     Q_ASSERT( topImage );
     Q_ASSERT( bottom->size() == topImage->size() );
-    int const width = bottom->width();
-    int const height = bottom->height();
-    for ( int y = 0; y < height; ++y ) {
-        for ( int x = 0; x < width; ++x ) {
-            qreal const c = qRed( topImage->pixel( x, y )) / 255.0;
-            QRgb const bottomPixel = bottom->pixel( x, y );
-            int const bottomRed = qRed( bottomPixel );
-            int const bottomGreen = qGreen( bottomPixel );
-            int const bottomBlue = qBlue( bottomPixel );
-            bottom->setPixel( x, y, qRgb(( int )( bottomRed + ( 255 - bottomRed ) * c ),
-                                         ( int )( bottomGreen + ( 255 - bottomGreen ) * c ),
-                                         ( int )( bottomBlue + ( 255 - bottomBlue ) * c )));
-        }
+    Q_ASSERT( bottom->format() == QImage::Format_ARGB32_Premultiplied );
+
+    // the red channel of the top image is the cloud intensity
+    QImage topImage32 = *topImage;
+    if ( topImage32.format() != QImage::Format_RGB32 &&
+         topImage32.format() != QImage::Format_ARGB32 &&
+         topImage32.format() != QImage::Format_ARGB32_Premultiplied ) {
+        topImage32 = topImage32.convertToFormat( QImage::Format_ARGB32 );
     }
+
+    static QVector<uchar> const cloudsTable = createCloudsTable();
+    uchar const * const table = cloudsTable.constData();
+    blendScanlines( bottom, topImage32, [table]( QRgb const bottomPixel, QRgb const topPixel ) {
+        int const c = qRed( topPixel );
+        return qRgb( table[qRed( bottomPixel ) * 256 + c],
+                     table[qGreen( bottomPixel ) * 256 + c],
+                     table[qBlue( bottomPixel ) * 256 + c] );
+    } );
 }
 
 
@@ -16,6 +16,7 @@
 #ifndef MARBLE_BLENDING_ALGORITHMS_H
 #define MARBLE_BLENDING_ALGORITHMS_H
 
+#include <QAtomicPointer>
 #include <QtGlobal>
 
 #include "Blending.h"
@@ -32,14 +33,25 @@ class OverpaintBlending: public Blending
 class IndependentChannelBlending: public Blending
 {
  public:
+    IndependentChannelBlending();
+    ~IndependentChannelBlending();
     virtual void blend( QImage * const bottom, TextureTile const * const top ) const;
  private:
+    Q_DISABLE_COPY( IndependentChannelBlending )
+
+    // returns the result intensities of blendChannel() for all combinations
+    // of 8 bit intensities, indexed by bottom intensity * 256 + top intensity
+    uchar const * channelTable() const;
+
     // bottomColorIntensity: intensity of one color channel (of one pixel) of the bottom image
     // topColorIntensity: intensity of one color channel (of one pixel) of the top image
     // return: intensity of the color channel (of a given pixel) of the result image
     // all color intensity values are in the range 0..1
     virtual qreal blendChannel( qreal const bottomColorIntensity,
                                 qreal const topColorIntensity ) const = 0;
+
+    // created on first use, as blendChannel() is not available in the constructor
+    mutable QAtomicPointer<uchar> m_channelTable;
 };
 
 
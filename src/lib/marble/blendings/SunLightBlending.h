@@ -35,7 +35,6 @@ class SunLightBlending: public Blending
     void setLevelZeroLayout( int levelZeroColumns, int levelZeroRows );
 
  private:
-    static int maxDivisor( int maximum, int fullLength );
     const SunLocator * const m_sunLocator;
     int m_levelZeroColumns;
     int m_levelZeroRows;
@@ -36,7 +36,6 @@ namespace Marble
 
 const qreal TWOPI = 2 * M_PI;
 
-class GeoDataCoordinatesPrivate;
 class Quaternion;
 
 /**
@@ -44,7 +43,9 @@ class Quaternion;
  *
  * GeoDataCoordinates is the simple representation of a single three
  * dimensional point. It can be used all through out marble as the data type
- * for three dimensional objects. it comprises of a Quaternion for speed issues.
+ * for three dimensional objects. It is a plain value type holding longitude,
+ * latitude and altitude, so large amounts of coordinates can be stored in
+ * contiguous memory without any allocation per point.
  * This class was introduced to reflect the difference between a simple 3d point
  * and the GeoDataGeometry object containing such a point. The latter is a 
  * GeoDataPoint and is simply derived from GeoDataCoordinates.
@@ -104,8 +105,6 @@ class GEODATA_EXPORT GeoDataCoordinates
     typedef QVector<GeoDataCoordinates> Vector;
     typedef QVector<GeoDataCoordinates*> PtrVector;
 
-    GeoDataCoordinates( const GeoDataCoordinates& other );
-
     /**
      * @brief constructs an invalid instance
      *
@@ -127,8 +126,6 @@ class GEODATA_EXPORT GeoDataCoordinates
                         GeoDataCoordinates::Unit unit = GeoDataCoordinates::Radian,
                         int detail = 0 );
 
-    virtual ~GeoDataCoordinates();
-
     /**
      * @brief Returns @code true @endcode if the coordinate is valid, @code false @endcode otherwise.
      * @return whether the coordinate is valid
@@ -292,8 +289,10 @@ class GEODATA_EXPORT GeoDataCoordinates
 
     /**
     * @brief return a Quaternion with the used coordinates
+    *
+    * The quaternion is calculated on each call, so store it when needed repeatedly.
     */
-    const Quaternion &quaternion() const;
+    Quaternion quaternion() const;
 
     /**
      * @brief slerp (spherical linear) interpolation between this coordinate and the given target coordinate
@@ -407,29 +406,61 @@ class GEODATA_EXPORT GeoDataCoordinates
      */
     QString latToString() const;
     
-    virtual bool operator==( const GeoDataCoordinates& ) const;
-    virtual bool operator !=( const GeoDataCoordinates& ) const;
-    GeoDataCoordinates& operator=( const GeoDataCoordinates &other );
+    bool operator==( const GeoDataCoordinates& ) const;
+    bool operator !=( const GeoDataCoordinates& ) const;
 
     /** Serialize the contents of the feature to @p stream. */
-    virtual void pack( QDataStream& stream ) const;
+    void pack( QDataStream& stream ) const;
     /** Unserialize the contents of the feature from @p stream. */
-    virtual void unpack( QDataStream& stream );
-
-    virtual void detach();
- protected:
-    GeoDataCoordinatesPrivate* d;
+    void unpack( QDataStream& stream );
 
  private:
+    qreal  m_lon;
+    qreal  m_lat;
+    qreal  m_altitude;     // in meters above sea level
+    quint8 m_detail;
+    bool   m_valid;
+
     static GeoDataCoordinates::Notation s_notation;
-    static const GeoDataCoordinates null;
 };
 
 uint qHash(const GeoDataCoordinates& coordinates );
 
 
+// inline definitions
+
+inline GeoDataCoordinates::GeoDataCoordinates()
+    : m_lon( 0 ),
+      m_lat( 0 ),
+      m_altitude( 0 ),
+      m_detail( 0 ),
+      m_valid( false )
+{
+}
+
+inline bool GeoDataCoordinates::isValid() const
+{
+    return m_valid;
+}
+
+inline qreal GeoDataCoordinates::longitude( GeoDataCoordinates::Unit unit ) const
+{
+    return unit == Degree ? m_lon * RAD2DEG : m_lon;
+}
+
+inline qreal GeoDataCoordinates::latitude( GeoDataCoordinates::Unit unit ) const
+{
+    return unit == Degree ? m_lat * RAD2DEG : m_lat;
+}
+
+inline qreal GeoDataCoordinates::altitude() const
+{
+    return m_altitude;
+}
+
 }
 
+Q_DECLARE_TYPEINFO( Marble::GeoDataCoordinates, Q_MOVABLE_TYPE );
 Q_DECLARE_METATYPE( Marble::GeoDataCoordinates )
 
 #endif
@@ -292,6 +292,7 @@ GeoDataCoordinates& GeoDataLineString::at( int pos )
     GeoDataGeometry::detach();
     p()->m_dirtyRange = true;
     p()->m_dirtyBox = true;
+    p()->m_dirtyArrays = true;
     return p()->m_vector[ pos ];
 }
 
@@ -305,6 +306,7 @@ GeoDataCoordinates& GeoDataLineString::operator[]( int pos )
     GeoDataGeometry::detach();
     p()->m_dirtyRange = true;
     p()->m_dirtyBox = true;
+    p()->m_dirtyArrays = true;
     return p()->m_vector[ pos ];
 }
 
@@ -318,12 +320,14 @@ GeoDataCoordinates& GeoDataLineString::last()
     GeoDataGeometry::detach();
     p()->m_dirtyRange = true;
     p()->m_dirtyBox = true;
+    p()->m_dirtyArrays = true;
     return p()->m_vector.last();
 }
 
 GeoDataCoordinates& GeoDataLineString::first()
 {
     GeoDataGeometry::detach();
+    p()->m_dirtyArrays = true;
     return p()->m_vector.first();
 }
 
@@ -340,6 +344,7 @@ const GeoDataCoordinates& GeoDataLineString::first() const
 QVector<GeoDataCoordinates>::Iterator GeoDataLineString::begin()
 {
     GeoDataGeometry::detach();
+    p()->m_dirtyArrays = true;
     return p()->m_vector.begin();
 }
 
@@ -351,6 +356,7 @@ QVector<GeoDataCoordinates>::ConstIterator GeoDataLineString::begin() const
 QVector<GeoDataCoordinates>::Iterator GeoDataLineString::end()
 {
     GeoDataGeometry::detach();
+    p()->m_dirtyArrays = true;
     return p()->m_vector.end();
 }
 
@@ -378,6 +384,7 @@ void GeoDataLineString::insert( int index, const GeoDataCoordinates& value )
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
     d->m_vector.insert( index, value );
+    d->insertIntoArrays( index, value );
 }
 
 void GeoDataLineString::append ( const GeoDataCoordinates& value )
@@ -389,6 +396,7 @@ void GeoDataLineString::append ( const GeoDataCoordinates& value )
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
     d->m_vector.append( value );
+    d->appendToArrays( value );
 }
 
 void GeoDataLineString::append(const QVector<GeoDataCoordinates>& values)
@@ -408,6 +416,9 @@ void GeoDataLineString::append(const QVector<GeoDataCoordinates>& values)
         d->m_vector.append(coordinates);
     }
 #endif
+    foreach (const GeoDataCoordinates &coordinates, values) {
+        d->appendToArrays(coordinates);
+    }
 }
 
 GeoDataLineString& GeoDataLineString::operator << ( const GeoDataCoordinates& value )
@@ -419,6 +430,7 @@ GeoDataLineString& GeoDataLineString::operator << ( const GeoDataCoordinates& va
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
     d->m_vector.append( value );
+    d->appendToArrays( value );
     return *this;
 }
 
@@ -437,6 +449,7 @@ GeoDataLineString& GeoDataLineString::operator << ( const GeoDataLineString& val
     d->m_vector.reserve(d->m_vector.size() + value.size());
     for( ; itCoords != itEnd; ++itCoords ) {
         d->m_vector.append( *itCoords );
+        d->appendToArrays( *itCoords );
     }
 
     return *this;
@@ -483,6 +496,10 @@ void GeoDataLineString::clear()
     d->m_dirtyBox = true;
 
     d->m_vector.clear();
+    d->m_longitudes.clear();
+    d->m_latitudes.clear();
+    d->m_altitudes.clear();
+    d->m_dirtyArrays = false;
 }
 
 bool GeoDataLineString::isClosed() const
@@ -530,7 +547,12 @@ void GeoDataLineString::reverse()
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
-    std::reverse(begin(), end());
+    std::reverse(d->m_vector.begin(), d->m_vector.end());
+    if ( !d->m_dirtyArrays ) {
+        std::reverse(d->m_longitudes.begin(), d->m_longitudes.end());
+        std::reverse(d->m_latitudes.begin(), d->m_latitudes.end());
+        std::reverse(d->m_altitudes.begin(), d->m_altitudes.end());
+    }
 }
 
 GeoDataLineString GeoDataLineString::toNormalized() const
@@ -798,6 +820,83 @@ qreal GeoDataLineString::length( qreal planetRadius, int offset ) const
     return planetRadius * length;
 }
 
+const qreal* GeoDataLineString::longitudes() const
+{
+    p()->updateArrays();
+    return p()->m_longitudes.constData();
+}
+
+const qreal* GeoDataLineString::latitudes() const
+{
+    p()->updateArrays();
+    return p()->m_latitudes.constData();
+}
+
+const qreal* GeoDataLineString::altitudes() const
+{
+    p()->updateArrays();
+    return p()->m_altitudes.constData();
+}
+
+void GeoDataLineStringPrivate::appendToArrays( const GeoDataCoordinates &coordinates )
+{
+    if ( m_dirtyArrays ) {
+        return;
+    }
+
+    qreal lon, lat, altitude;
+    coordinates.geoCoordinates( lon, lat, altitude );
+    m_longitudes.append( lon );
+    m_latitudes.append( lat );
+    m_altitudes.append( altitude );
+}
+
+void GeoDataLineStringPrivate::insertIntoArrays( int index, const GeoDataCoordinates &coordinates )
+{
+    if ( m_dirtyArrays ) {
+        return;
+    }
+
+    qreal lon, lat, altitude;
+    coordinates.geoCoordinates( lon, lat, altitude );
+    m_longitudes.insert( index, lon );
+    m_latitudes.insert( index, lat );
+    m_altitudes.insert( index, altitude );
+}
+
+void GeoDataLineStringPrivate::removeFromArrays( int index, int count )
+{
+    if ( m_dirtyArrays ) {
+        return;
+    }
+
+    m_longitudes.remove( index, count );
+    m_latitudes.remove( index, count );
+    m_altitudes.remove( index, count );
+}
+
+void GeoDataLineStringPrivate::updateArrays() const
+{
+    if ( !m_dirtyArrays ) {
+        return;
+    }
+
+    const int size = m_vector.size();
+    m_longitudes.resize( size );
+    m_latitudes.resize( size );
+    m_altitudes.resize( size );
+
+    qreal *lon = m_longitudes.data();
+    qreal *lat = m_latitudes.data();
+    qreal *altitude = m_altitudes.data();
+    const GeoDataCoordinates *coordinates = m_vector.constData();
+    for ( int i = 0; i < size; ++i ) {
+        coordinates[i].geoCoordinates( lon[i], lat[i], altitude[i] );
+    }
+
+    m_dirtyArrays = false;
+}
+
 QVector<GeoDataCoordinates>::Iterator GeoDataLineString::erase ( QVector<GeoDataCoordinates>::Iterator pos )
 {
     GeoDataGeometry::detach();
@@ -806,6 +905,7 @@ QVector<GeoDataCoordinates>::Iterator GeoDataLineString::erase ( QVector<GeoData
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
+    d->removeFromArrays( pos - d->m_vector.begin(), 1 );
     return d->m_vector.erase( pos );
 }
 
@@ -818,6 +918,7 @@ QVector<GeoDataCoordinates>::Iterator GeoDataLineString::erase ( QVector<GeoData
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
+    d->removeFromArrays( begin - d->m_vector.begin(), end - begin );
     return d->m_vector.erase( begin, end );
 }
 
@@ -828,6 +929,7 @@ void GeoDataLineString::remove ( int i )
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
     d->m_vector.remove( i );
+    d->removeFromArrays( i, 1 );
 }
 
 GeoDataLineString GeoDataLineString::optimized () const
@@ -835,10 +937,13 @@ GeoDataLineString GeoDataLineString::optimized () const
     if( isClosed() ) {
         GeoDataLinearRing linearRing(*this);
         p()->optimize(linearRing);
+        // only the detail levels changed, so the arrays still hold the nodes
+        static_cast<GeoDataLineString&>(linearRing).p()->m_dirtyArrays = p()->m_dirtyArrays;
         return linearRing;
     } else {
         GeoDataLineString lineString(*this);
         p()->optimize(lineString);
+        lineString.p()->m_dirtyArrays = p()->m_dirtyArrays;
         return lineString;
     }
 }
@@ -879,6 +984,7 @@ void GeoDataLineString::unpack( QDataStream& stream )
         GeoDataCoordinates coord;
         coord.unpack( stream );
         p()->m_vector.append( coord );
+        p()->appendToArrays( coord );
     }
 }
 
@@ -159,6 +159,33 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
   */
     virtual qreal length( qreal planetRadius, int offset = 0 ) const;
 
+/*!
+    \brief Returns the longitudes of all nodes as one contiguous array.
+
+    Together with latitudes() and altitudes() this provides a structure of
+    arrays view onto the nodes which suits batch processing like
+    AbstractProjection::projectPoints(). Adding, inserting and removing
+    nodes keeps the arrays up to date. Only after writable nodes have been
+    handed out by at(), operator[](), first(), last(), begin() or end() the
+    arrays get recreated by the next call. The pointers stay valid until the
+    LineString gets modified. The angles are measured in radian.
+*/
+    const qreal* longitudes() const;
+
+/*!
+    \brief Returns the latitudes of all nodes as one contiguous array.
+
+    \see longitudes()
+*/
+    const qreal* latitudes() const;
+
+/*!
+    \brief Returns the altitudes of all nodes as one contiguous array.
+
+    \see longitudes()
+*/
+    const qreal* altitudes() const;
+
 /*!
     \brief Provides a more generic representation of the LineString.
 
@@ -25,6 +25,7 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
         :  m_rangeCorrected( 0 ),
            m_dirtyRange( true ),
            m_dirtyBox( true ),
+           m_dirtyArrays( false ),
            m_tessellationFlags( f ),
            m_previousResolution( -1 ),
            m_level( -1 )
@@ -34,7 +35,8 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
     GeoDataLineStringPrivate()
          : m_rangeCorrected( 0 ),
            m_dirtyRange( true ),
-           m_dirtyBox( true )
+           m_dirtyBox( true ),
+           m_dirtyArrays( false )
     {
     }
 
@@ -50,6 +52,10 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
         m_rangeCorrected = 0;
         m_dirtyRange = true;
         m_dirtyBox = other.m_dirtyBox;
+        m_longitudes = other.m_longitudes;
+        m_latitudes = other.m_latitudes;
+        m_altitudes = other.m_altitudes;
+        m_dirtyArrays = other.m_dirtyArrays;
         m_tessellationFlags = other.m_tessellationFlags;
         return *this;
     }
@@ -90,6 +96,10 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
     quint8 levelForResolution(qreal resolution) const;
     qreal resolutionForLevel(int level) const;
     void optimize(GeoDataLineString& lineString) const;
+    void appendToArrays( const GeoDataCoordinates &coordinates );
+    void insertIntoArrays( int index, const GeoDataCoordinates &coordinates );
+    void removeFromArrays( int index, int count );
+    void updateArrays() const;
 
     QVector<GeoDataCoordinates> m_vector;
 
@@ -99,6 +109,14 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
     mutable bool                m_dirtyBox; // tells whether there have been changes to the
                                             // GeoDataPoints since the LatLonAltBox has 
                                             // been calculated. Saves performance. 
+
+    // The nodes as a structure of arrays. The methods adding and removing
+    // nodes keep them in step with m_vector, only handing out writable
+    // nodes requires to recreate them.
+    mutable QVector<qreal>      m_longitudes;
+    mutable QVector<qreal>      m_latitudes;
+    mutable QVector<qreal>      m_altitudes;
+    mutable bool                m_dirtyArrays;
     TessellationFlags           m_tessellationFlags;
     mutable qreal  m_previousResolution;
     mutable quint8 m_level;
@@ -60,8 +60,8 @@ bool KmlOsmPlacemarkDataTagWriter::writeOsmData( const GeoDataGeometry *geometry
     writer.writeOptionalAttribute( "action", osmData.action() );
 
     // Writing the tags
-    QHash<QString, QString>::const_iterator tagsIt = osmData.tagsBegin();
-    QHash<QString, QString>::const_iterator tagsEnd = osmData.tagsEnd();
+    OsmPlacemarkData::TagIterator tagsIt = osmData.tagsBegin();
+    OsmPlacemarkData::TagIterator tagsEnd = osmData.tagsEnd();
     for ( ; tagsIt != tagsEnd; ++tagsIt ) {
         writer.writeStartElement( kml::kmlTag_nameSpaceMx, "tag" );
         writer.writeAttribute( "k", tagsIt.key() );
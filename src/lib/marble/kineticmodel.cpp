@@ -78,6 +78,24 @@ bool KineticModel::hasVelocity() const
     return !d_ptr->velocity.isNull();
 }
 
+QPointF KineticModel::finalPosition() const
+{
+    Q_D(const KineticModel);
+
+    // where the model comes to rest unless it gets stopped before
+    if (!d->ticker.isActive())
+        return d->position;
+
+    // the velocity decreases linearly, so the distance is v^2 / (2 * a)
+    QPointF distance(0, 0);
+    if (d->deacceleration.x() > 0)
+        distance.setX( d->velocity.x() * qAbs(d->velocity.x()) / (2 * d->deacceleration.x()) );
+    if (d->deacceleration.y() > 0)
+        distance.setY( d->velocity.y() * qAbs(d->velocity.y()) / (2 * d->deacceleration.y()) );
+
+    return d->position + distance;
+}
+
 int KineticModel::duration() const
 {
     return d_ptr->duration;
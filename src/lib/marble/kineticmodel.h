@@ -51,6 +51,7 @@ public:
     QPointF position() const;
     int updateInterval() const;
     bool hasVelocity() const;
+    QPointF finalPosition() const;
 
 public Q_SLOTS:
     void setDuration(int ms);
@@ -27,6 +27,7 @@
 #include "GeoDataTrack.h"
 #include "GeoDataTypes.h"
 #include "GeoDataFeature.h"
+#include "FrameProfiler.h"
 #include "MarbleDebug.h"
 #include "GeoPainter.h"
 #include "ViewportParams.h"
@@ -122,7 +123,11 @@ bool GeometryLayer::render( GeoPainter *painter, ViewportParams *viewport,
     painter->save();
 
     const int maxZoomLevel = qMin<int>(qMax<int>(qLn(viewport->radius()*4/256)/qLn(2.0), 1), d->m_styleBuilder->maximumZoomLevel());
-    QList<GeoGraphicsItem*> items = d->m_scene.items( viewport->viewLatLonAltBox(), maxZoomLevel );
+    QList<GeoGraphicsItem*> items;
+    {
+        FrameProfiler::Scope scope( "GeometryLayer: query scene" );
+        items = d->m_scene.items( viewport->viewLatLonAltBox(), maxZoomLevel );
+    }
 
     typedef QPair<QString, GeoGraphicsItem*> LayerItem;
     QList<LayerItem> defaultLayer;
@@ -152,6 +157,9 @@ bool GeometryLayer::render( GeoPainter *painter, ViewportParams *viewport,
         }
     }
 
+    FrameProfiler::instance()->addCounter( "geometries painted", paintedItems );
+
+    FrameProfiler::Scope scope( "GeometryLayer: paint" );
     foreach (const QString &layer, d->m_styleBuilder->renderOrder()) {
         QList<GeoGraphicsItem*> & layerItems = paintedFragments[layer];
         qStableSort(layerItems.begin(), layerItems.end(), GeoGraphicsItem::zValueLessThan);
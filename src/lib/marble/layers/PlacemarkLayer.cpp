@@ -20,13 +20,12 @@
 #include "GeoDataStyle.h"
 #include "GeoPainter.h"
 #include "GeoDataPlacemark.h"
+#include "PlacemarkGlyphAtlas.h"
 #include "ViewportParams.h"
 #include "VisiblePlacemark.h"
 
 using namespace Marble;
 
-bool PlacemarkLayer::m_useXWorkaround = false;
-
 PlacemarkLayer::PlacemarkLayer(QAbstractItemModel *placemarkModel,
                                 QItemSelectionModel *selectionModel,
                                 MarbleClock *clock, const StyleBuilder *styleBuilder,
@@ -34,9 +33,6 @@ PlacemarkLayer::PlacemarkLayer(QAbstractItemModel *placemarkModel,
     QObject( parent ),
     m_layout( placemarkModel, selectionModel, clock, styleBuilder )
 {
-    m_useXWorkaround = testXBug();
-    mDebug() << "Use workaround: " << ( m_useXWorkaround ? "1" : "0" );
-
     connect( &m_layout, SIGNAL(repaintNeeded()), SIGNAL(repaintNeeded()) );
 }
 
@@ -61,17 +57,27 @@ bool PlacemarkLayer::render( GeoPainter *geoPainter, ViewportParams *viewport,
     Q_UNUSED( layer )
 
     QVector<VisiblePlacemark*> visiblePlacemarks = m_layout.generateLayout( viewport );
+
+    PlacemarkGlyphAtlas *const atlas = PlacemarkGlyphAtlas::instance();
+    atlas->beginFrame();
+
+    // Symbols and labels are collected per atlas page and drawn in one
+    // batch each, symbols first so that they never cover labels.
+    QVector<QVector<QPainter::PixmapFragment> > symbolFragments;
+    QVector<QVector<QPainter::PixmapFragment> > labelFragments;
+
     // draw placemarks less important first
     QVector<VisiblePlacemark*>::const_iterator visit = visiblePlacemarks.constEnd();
     QVector<VisiblePlacemark*>::const_iterator itEnd = visiblePlacemarks.constBegin();
 
-    QPainter *const painter = geoPainter;
-
     while ( visit != itEnd ) {
         --visit;
 
         VisiblePlacemark *const mark = *visit;
 
+        const PlacemarkGlyphAtlas::Glyph symbolGlyph = mark->symbolGlyph();
+        const PlacemarkGlyphAtlas::Glyph labelGlyph = mark->labelGlyph();
+
         QRect labelRect( mark->labelRect().toRect() );
         QPoint symbolPos( mark->symbolPosition() );
 
@@ -88,18 +94,48 @@ bool PlacemarkLayer::render( GeoPainter *geoPainter, ViewportParams *viewport,
                 labelRect.moveLeft(i - symbolX + textX );
                 symbolPos.setX( i );
 
-                painter->drawPixmap( symbolPos, mark->symbolPixmap() );
-                painter->drawPixmap( labelRect, mark->labelPixmap() );
+                addFragment( symbolFragments, symbolGlyph, symbolPos );
+                addFragment( labelFragments, labelGlyph, labelRect.topLeft() );
             }
         } else { // simple case, one draw per placemark
-            painter->drawPixmap( symbolPos, mark->symbolPixmap() );
-            painter->drawPixmap( labelRect, mark->labelPixmap() );
+            addFragment( symbolFragments, symbolGlyph, symbolPos );
+            addFragment( labelFragments, labelGlyph, labelRect.topLeft() );
         }
     }
 
+    QPainter *const painter = geoPainter;
+    drawFragments( painter, symbolFragments );
+    drawFragments( painter, labelFragments );
+
     return true;
 }
 
+void PlacemarkLayer::addFragment( QVector<QVector<QPainter::PixmapFragment> > &fragments,
+                                  const PlacemarkGlyphAtlas::Glyph &glyph, const QPoint &position )
+{
+    if ( !glyph.isValid() ) {
+        return;
+    }
+
+    if ( fragments.size() <= glyph.page ) {
+        fragments.resize( glyph.page + 1 );
+    }
+
+    // fragments are positioned by their center
+    const QPointF center = QPointF( position ) + QPointF( 0.5 * glyph.rect.width(), 0.5 * glyph.rect.height() );
+    fragments[glyph.page] << QPainter::PixmapFragment::create( center, glyph.rect );
+}
+
+void PlacemarkLayer::drawFragments( QPainter *painter, const QVector<QVector<QPainter::PixmapFragment> > &fragments )
+{
+    PlacemarkGlyphAtlas *const atlas = PlacemarkGlyphAtlas::instance();
+    for ( int page = 0; page < fragments.size(); ++page ) {
+        if ( !fragments[page].isEmpty() ) {
+            painter->drawPixmapFragments( fragments[page].constData(), fragments[page].size(), atlas->page( page ) );
+        }
+    }
+}
+
 RenderState PlacemarkLayer::renderState() const
 {
     return RenderState( "Placemarks" );
@@ -155,42 +191,5 @@ void PlacemarkLayer::requestStyleReset()
     m_layout.requestStyleReset();
 }
 
-
-// Test if there a bug in the X server which makes 
-// text fully transparent if it gets written on 
-// QPixmaps that were initialized by filling them 
-// with Qt::transparent
-
-bool PlacemarkLayer::testXBug()
-{
-    QString  testchar( "K" );
-    QFont    font( "Sans Serif", 10 );
-
-    int fontheight = QFontMetrics( font ).height();
-    int fontwidth  = QFontMetrics( font ).width(testchar);
-    int fontascent = QFontMetrics( font ).ascent();
-
-    QPixmap  pixmap( fontwidth, fontheight );
-    pixmap.fill( Qt::transparent );
-
-    QPainter textpainter;
-    textpainter.begin( &pixmap );
-    textpainter.setPen( QColor( 0, 0, 0, 255 ) );
-    textpainter.setFont( font );
-    textpainter.drawText( 0, fontascent, testchar );
-    textpainter.end();
-
-    QImage image = pixmap.toImage();
-
-    for ( int x = 0; x < fontwidth; ++x ) {
-        for ( int y = 0; y < fontheight; ++y ) {
-            if ( qAlpha( image.pixel( x, y ) ) > 0 )
-                return false;
-        }
-    }
-
-    return true;
-}
-
 #include "moc_PlacemarkLayer.cpp"
 
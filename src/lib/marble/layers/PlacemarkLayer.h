@@ -21,8 +21,10 @@
 #include <QObject>
 #include "LayerInterface.h"
 
+#include <QPainter>
 #include <QVector>
 
+#include "PlacemarkGlyphAtlas.h"
 #include "PlacemarkLayout.h"
 
 class QAbstractItemModel;
@@ -77,7 +79,6 @@ class PlacemarkLayer : public QObject, public LayerInterface
      */
     QVector<const GeoDataFeature *> whichPlacemarkAt( const QPoint &pos );
 
-    static bool m_useXWorkaround;  // Indicates need for an X windows workaround.
  public Q_SLOTS:
    // earth
    void setShowPlaces( bool show );
@@ -96,7 +97,9 @@ class PlacemarkLayer : public QObject, public LayerInterface
    void repaintNeeded();
 
  private:
-    static bool testXBug();
+    static void addFragment( QVector<QVector<QPainter::PixmapFragment> > &fragments,
+                             const PlacemarkGlyphAtlas::Glyph &glyph, const QPoint &position );
+    static void drawFragments( QPainter *painter, const QVector<QVector<QPainter::PixmapFragment> > &fragments );
 
     PlacemarkLayout m_layout;
 };
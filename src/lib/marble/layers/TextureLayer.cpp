@@ -15,6 +15,7 @@
 #include <qmath.h>
 #include <QTimer>
 #include <QList>
+#include <QVector>
 #include <QSortFilterProxyModel>
 
 #include "SphericalScanlineTextureMapper.h"
@@ -22,6 +23,7 @@
 #include "MercatorScanlineTextureMapper.h"
 #include "GenericScanlineTextureMapper.h"
 #include "TileScalingTextureMapper.h"
+#include "FrameProfiler.h"
 #include "GeoDataGroundOverlay.h"
 #include "GeoPainter.h"
 #include "GeoSceneGroup.h"
@@ -29,6 +31,7 @@
 #include "MergedLayerDecorator.h"
 #include "MarbleDebug.h"
 #include "MarbleDirs.h"
+#include "MarbleMath.h"
 #include "MarblePlacemarkModel.h"
 #include "StackedTile.h"
 #include "StackedTileLoader.h"
@@ -51,9 +54,10 @@ public:
              QAbstractItemModel *groundOverlayModel,
              TextureLayer *parent );
 
-    void requestDelayedRepaint();
+    void tileChanged( const TileId &stackedTileId );
     void updateTextureLayers();
     void updateTile( const TileId &tileId, const QImage &tileImage );
+    void updateSunShading();
 
     void addGroundOverlays( const QModelIndex& parent, int first, int last );
     void removeGroundOverlays( const QModelIndex& parent, int first, int last );
@@ -62,6 +66,10 @@ public:
     void updateGroundOverlays();
     void addCustomTextures();
 
+    int tileLevel( int radius ) const;
+    qreal tileRow( qreal lat, int rows ) const;
+    QVector<TileId> tilesInView( const ViewportParams *viewport, int tileLevel ) const;
+
     static bool drawOrderLessThan( const GeoDataGroundOverlay* o1, const GeoDataGroundOverlay* o2 );
 
 public:
@@ -83,6 +91,9 @@ public:
     // For scheduling repaints
     QTimer           m_repaintTimer;
     RenderState m_renderState;
+    // position of the sun the tiles have been shaded for, in degrees
+    qreal m_sunLon;
+    qreal m_sunLat;
 };
 
 TextureLayer::Private::Private( HttpDownloadManager *downloadManager,
@@ -101,6 +112,8 @@ TextureLayer::Private::Private( HttpDownloadManager *downloadManager,
     , m_texcolorizer( 0 )
     , m_textureLayerSettings( 0 )
     , m_repaintTimer()
+    , m_sunLon( sunLocator->getLon() )
+    , m_sunLat( sunLocator->getLat() )
 {
     m_groundOverlayModel.setSourceModel( groundOverlayModel );
     m_groundOverlayModel.setDynamicSortFilter( true );
@@ -122,10 +135,10 @@ TextureLayer::Private::Private( HttpDownloadManager *downloadManager,
     updateGroundOverlays();
 }
 
-void TextureLayer::Private::requestDelayedRepaint()
+void TextureLayer::Private::tileChanged( const TileId &stackedTileId )
 {
     if ( m_texmapper ) {
-        m_texmapper->setRepaintNeeded();
+        m_texmapper->setTileChanged( stackedTileId );
     }
 
     if ( !m_repaintTimer.isActive() ) {
@@ -155,6 +168,8 @@ void TextureLayer::Private::updateTextureLayers()
 
     m_layerDecorator.setTextureLayers( result );
     m_tileLoader.clear();
+    m_sunLon = m_sunLocator->getLon();
+    m_sunLat = m_sunLocator->getLat();
 
     m_tileZoomLevel = -1;
     m_parent->setNeedsUpdate();
@@ -167,7 +182,23 @@ void TextureLayer::Private::updateTile( const TileId &tileId, const QImage &tile
 
     m_tileLoader.updateTile( tileId, tileImage );
 
-    requestDelayedRepaint();
+    tileChanged( TileId( 0, tileId.zoomLevel(), tileId.x(), tileId.y() ) );
+}
+
+void TextureLayer::Private::updateSunShading()
+{
+    // only the tiles at the terminator need to be blended and mapped again
+    const QList<TileId> updatedTiles = m_tileLoader.updateSunShading( m_sunLon, m_sunLat );
+    m_sunLon = m_sunLocator->getLon();
+    m_sunLat = m_sunLocator->getLat();
+
+    if ( m_texmapper ) {
+        foreach ( const TileId &stackedTileId, updatedTiles ) {
+            m_texmapper->setTileChanged( stackedTileId );
+        }
+    }
+
+    emit m_parent->repaintNeeded();
 }
 
 bool TextureLayer::Private::drawOrderLessThan( const GeoDataGroundOverlay* o1, const GeoDataGroundOverlay* o2 )
@@ -239,6 +270,74 @@ void TextureLayer::Private::addCustomTextures()
     }
 }
 
+int TextureLayer::Private::tileLevel( int radius ) const
+{
+    // choose the smaller dimension for selecting the tile level, leading to higher-resolution results
+    const int levelZeroWidth = m_layerDecorator.tileSize().width() * m_layerDecorator.tileColumnCount( 0 );
+    const int levelZeroHight = m_layerDecorator.tileSize().height() * m_layerDecorator.tileRowCount( 0 );
+    const int levelZeroMinDimension = qMin( levelZeroWidth, levelZeroHight );
+
+    // limit to 1 as dirty fix for invalid entry linearLevel
+    const qreal linearLevel = qMax<qreal>( 1.0, radius * 4.0 / levelZeroMinDimension );
+
+    // As our tile resolution doubles with each level we calculate
+    // the tile level from tilesize and the globe radius via log(2)
+    const qreal tileLevelF = qLn( linearLevel ) / qLn( 2.0 ) * 1.00001;  // snap to the sharper tile level a tiny bit earlier
+                                                                         // to work around rounding errors when the radius
+                                                                         // roughly equals the global texture width
+
+    return qMin<int>( m_layerDecorator.maximumTileLevel(), tileLevelF );
+}
+
+qreal TextureLayer::Private::tileRow( qreal lat, int rows ) const
+{
+    if ( m_layerDecorator.tileProjection() == GeoSceneTileDataset::Mercator ) {
+        // the inverse Gudermannian function is only defined between -85°S and 85°N
+        const qreal maxLat = 85.0 * DEG2RAD;
+        return ( 1.0 - gdInv( qBound( -maxLat, lat, maxLat ) ) / M_PI ) / 2.0 * rows;
+    }
+
+    return ( 0.5 - lat / M_PI ) * rows;
+}
+
+QVector<TileId> TextureLayer::Private::tilesInView( const ViewportParams *viewport, int tileLevel ) const
+{
+    const int columns = m_layerDecorator.tileColumnCount( tileLevel );
+    const int rows = m_layerDecorator.tileRowCount( tileLevel );
+    const GeoDataLatLonAltBox &box = viewport->viewLatLonAltBox();
+
+    const int westX = qBound( 0, int( ( box.west() / M_PI + 1.0 ) / 2.0 * columns ), columns - 1 );
+    int eastX = qBound( 0, int( ( box.east() / M_PI + 1.0 ) / 2.0 * columns ), columns - 1 );
+    if ( eastX < westX ) {
+        eastX += columns; // the view crosses the date line
+    }
+    const int northY = qBound( 0, int( tileRow( box.north(), rows ) ), rows - 1 );
+    const int southY = qBound( 0, int( tileRow( box.south(), rows ) ), rows - 1 );
+
+    QVector<TileId> tiles;
+    tiles.reserve( ( eastX - westX + 1 ) * ( southY - northY + 1 ) );
+    for ( int x = westX; x <= eastX; ++x ) {
+        for ( int y = northY; y <= southY; ++y ) {
+            tiles << TileId( 0, tileLevel, x % columns, y );
+        }
+    }
+
+    // tiles in the center of the view come first
+    const qreal centerX = ( viewport->centerLongitude() / M_PI + 1.0 ) / 2.0 * columns;
+    const qreal centerY = tileRow( viewport->centerLatitude(), rows );
+    qSort( tiles.begin(), tiles.end(), [=]( const TileId &a, const TileId &b ) {
+        const qreal ax = qAbs( a.x() + 0.5 - centerX );
+        const qreal bx = qAbs( b.x() + 0.5 - centerX );
+        const qreal dxA = qMin( ax, columns - ax );
+        const qreal dxB = qMin( bx, columns - bx );
+        const qreal dyA = a.y() + 0.5 - centerY;
+        const qreal dyB = b.y() + 0.5 - centerY;
+        return dxA * dxA + dyA * dyA < dxB * dxB + dyB * dyB;
+    } );
+
+    return tiles;
+}
+
 TextureLayer::TextureLayer( HttpDownloadManager *downloadManager,
                             PluginManager* pluginManager,
                             const SunLocator *sunLocator,
@@ -248,6 +347,8 @@ TextureLayer::TextureLayer( HttpDownloadManager *downloadManager,
 {
     connect( &d->m_loader, SIGNAL(tileCompleted(TileId,QImage)),
              this, SLOT(updateTile(TileId,QImage)) );
+    connect( &d->m_tileLoader, SIGNAL(placeholderReplaced(TileId)),
+             this, SLOT(tileChanged(TileId)) );
 
     // Repaint timer
     d->m_repaintTimer.setSingleShot( true );
@@ -323,24 +424,10 @@ bool TextureLayer::render( GeoPainter *painter, ViewportParams *viewport,
          d->m_centerCoordinates.latitude() != viewport->centerLatitude() ) {
         d->m_centerCoordinates.setLongitude( viewport->centerLongitude() );
         d->m_centerCoordinates.setLatitude( viewport->centerLatitude() );
-        d->m_texmapper->setRepaintNeeded();
+        d->m_texmapper->setCenterChanged();
     }
 
-    // choose the smaller dimension for selecting the tile level, leading to higher-resolution results
-    const int levelZeroWidth = d->m_layerDecorator.tileSize().width() * d->m_layerDecorator.tileColumnCount( 0 );
-    const int levelZeroHight = d->m_layerDecorator.tileSize().height() * d->m_layerDecorator.tileRowCount( 0 );
-    const int levelZeroMinDimension = qMin( levelZeroWidth, levelZeroHight );
-
-    // limit to 1 as dirty fix for invalid entry linearLevel
-    const qreal linearLevel = qMax<qreal>( 1.0, viewport->radius() * 4.0 / levelZeroMinDimension );
-
-    // As our tile resolution doubles with each level we calculate
-    // the tile level from tilesize and the globe radius via log(2)
-    const qreal tileLevelF = qLn( linearLevel ) / qLn( 2.0 ) * 1.00001;  // snap to the sharper tile level a tiny bit earlier
-                                                                         // to work around rounding errors when the radius
-                                                                         // roughly equals the global texture width
-
-    const int tileLevel = qMin<int>( d->m_layerDecorator.maximumTileLevel(), tileLevelF );
+    const int tileLevel = d->tileLevel( viewport->radius() );
 
     if ( tileLevel != d->m_tileZoomLevel ) {
         d->m_tileZoomLevel = tileLevel;
@@ -348,6 +435,7 @@ bool TextureLayer::render( GeoPainter *painter, ViewportParams *viewport,
     }
 
     const QRect dirtyRect = QRect( QPoint( 0, 0), viewport->size() );
+    FrameProfiler::Scope scope( "TextureLayer: map texture" );
     d->m_texmapper->mapTexture( painter, viewport, d->m_tileZoomLevel, dirtyRect, d->m_texcolorizer );
     d->m_renderState.addChild( d->m_tileLoader.renderState() );
     d->m_runtimeTrace = QString("Texture Cache: %1 ").arg(d->m_tileLoader.tileCount());
@@ -369,11 +457,11 @@ void TextureLayer::setShowRelief( bool show )
 void TextureLayer::setShowSunShading( bool show )
 {
     disconnect( d->m_sunLocator, SIGNAL(positionChanged(qreal,qreal)),
-                this, SLOT(reset()) );
+                this, SLOT(updateSunShading()) );
 
     if ( show ) {
         connect( d->m_sunLocator, SIGNAL(positionChanged(qreal,qreal)),
-                 this,       SLOT(reset()) );
+                 this,       SLOT(updateSunShading()) );
     }
 
     d->m_layerDecorator.setShowSunShading( show );
@@ -450,6 +538,8 @@ void TextureLayer::reset()
     mDebug() << Q_FUNC_INFO;
 
     d->m_tileLoader.clear();
+    d->m_sunLon = d->m_sunLocator->getLon();
+    d->m_sunLat = d->m_sunLocator->getLat();
     setNeedsUpdate();
 }
 
@@ -468,6 +558,35 @@ void TextureLayer::downloadStackedTile( const TileId &stackedTileId )
     d->m_layerDecorator.downloadStackedTile( stackedTileId, DownloadBulk );
 }
 
+int TextureLayer::prefetchTiles( const ViewportParams *viewport, int budget )
+{
+    if ( !d->m_texmapper || d->m_layerDecorator.textureLayersSize() == 0 ) {
+        return 0;
+    }
+
+    const int tileLevel = d->tileLevel( viewport->radius() );
+
+    // The tiles of the level above serve as placeholders as long as the
+    // sharper ones aren't ready. They are few, so fetch them first.
+    QVector<TileId> tiles;
+    if ( tileLevel > 0 ) {
+        tiles << d->tilesInView( viewport, tileLevel - 1 );
+    }
+    tiles << d->tilesInView( viewport, tileLevel );
+
+    int requested = 0;
+    foreach ( const TileId &id, tiles ) {
+        if ( requested >= budget ) {
+            break;
+        }
+        if ( d->m_tileLoader.prefetchTile( id ) ) {
+            ++requested;
+        }
+    }
+
+    return requested;
+}
+
 void TextureLayer::setMapTheme( const QVector<const GeoSceneTextureTileDataset *> &textures, const GeoSceneGroup *textureLayerSettings, const QString &seaFile, const QString &landFile )
 {
     delete d->m_texcolorizer;
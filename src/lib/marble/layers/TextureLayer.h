@@ -91,6 +91,17 @@ class MARBLE_EXPORT TextureLayer : public QObject, public LayerInterface
 
     RenderState renderState() const;
 
+    /**
+     * @brief Loads the tiles which @p viewport would show ahead of time
+     *
+     * Tiles of the level matching the viewport and of the level above get
+     * read from disc on a worker thread or queued for bulk download. Tiles
+     * close to the center of the viewport are requested first.
+     * @param budget the maximum number of tiles to request
+     * @return the number of requested tiles
+     */
+    int prefetchTiles( const ViewportParams *viewport, int budget );
+
     virtual QString runtimeTrace() const;
 
     virtual bool render( GeoPainter *painter, ViewportParams *viewport,
@@ -129,9 +140,10 @@ public Q_SLOTS:
     void repaintNeeded();
 
  private:
-    Q_PRIVATE_SLOT( d, void requestDelayedRepaint() )
+    Q_PRIVATE_SLOT( d, void tileChanged( const TileId &stackedTileId ) )
     Q_PRIVATE_SLOT( d, void updateTextureLayers() )
     Q_PRIVATE_SLOT( d, void updateTile( const TileId &tileId, const QImage &tileImage ) )
+    Q_PRIVATE_SLOT( d, void updateSunShading() )
     Q_PRIVATE_SLOT( d, void addGroundOverlays( const QModelIndex& parent, int first, int last ) )
     Q_PRIVATE_SLOT( d, void removeGroundOverlays( const QModelIndex& parent, int first, int last ) )
     Q_PRIVATE_SLOT( d, void resetGroundOverlaysCache() )
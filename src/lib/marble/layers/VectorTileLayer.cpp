@@ -17,6 +17,7 @@
 #include <QThreadPool>
 
 #include "VectorTileModel.h"
+#include "FrameProfiler.h"
 #include "GeoPainter.h"
 #include "GeoSceneGroup.h"
 #include "GeoSceneTypes.h"
@@ -160,6 +161,7 @@ bool VectorTileLayer::render( GeoPainter *painter, ViewportParams *viewport,
     int const oldLevel = tileZoomLevel();
     int level = 0;
     foreach ( VectorTileModel *mapper, d->m_activeTexmappers ) {
+        FrameProfiler::Scope scope( QLatin1String( "VectorTileLayer: " ) + mapper->name() );
         mapper->setViewport( viewport->viewLatLonAltBox(), viewport->radius() );
         level = qMax(level, mapper->tileZoomLevel());
     }
@@ -170,6 +172,16 @@ bool VectorTileLayer::render( GeoPainter *painter, ViewportParams *viewport,
     return true;
 }
 
+int VectorTileLayer::prefetchTiles( const ViewportParams *viewport, int budget )
+{
+    int requested = 0;
+    foreach ( VectorTileModel *mapper, d->m_activeTexmappers ) {
+        requested += mapper->prefetchTiles( viewport->viewLatLonAltBox(), viewport->radius(), budget - requested );
+    }
+
+    return requested;
+}
+
 void VectorTileLayer::reset()
 {
     foreach ( VectorTileModel *mapper, d->m_texmappers ) {
@@ -53,6 +53,13 @@ class VectorTileLayer : public QObject, public LayerInterface
 
     QString runtimeTrace() const;
 
+    /**
+     * @brief Queues the missing tiles which @p viewport would show for download
+     * @param budget the maximum number of tiles to request
+     * @return the number of requested tiles
+     */
+    int prefetchTiles( const ViewportParams *viewport, int budget );
+
     bool render( GeoPainter *painter, ViewportParams *viewport,
                  const QString &renderPos = QLatin1String("NONE"),
                  GeoSceneLayer *layer = 0 );
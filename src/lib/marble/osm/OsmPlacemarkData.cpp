@@ -15,11 +15,167 @@
 #include "GeoDataPlacemark.h"
 #include "GeoDataExtendedData.h"
 
+#include <QDate>
+#include <QDateTime>
+#include <QReadWriteLock>
+#include <QSet>
 #include <QXmlStreamAttributes>
 
 namespace Marble
 {
 
+class OsmPlacemarkDataPrivate : public QSharedData
+{
+public:
+    OsmPlacemarkDataPrivate();
+
+    qint64 m_changeset;
+    qint64 m_uid;
+    qint64 m_timestamp;  // seconds since the epoch
+    int m_version;
+    // -1 if unknown, otherwise 0 or 1
+    qint8 m_visible;
+    QString m_user;
+    QString m_action;
+
+    // small enough to be scanned faster than a hash is looked up
+    QVector<OsmPlacemarkData::Tag> m_tags;
+
+    /**
+     * @brief m_nodeReferences is used to store a way's component nodes
+     * ( It is empty for other placemark types )
+     */
+    QHash< GeoDataCoordinates, OsmPlacemarkData > m_nodeReferences;
+
+    /**
+     * @brief m_memberReferences is used to store a polygon's member boundaries
+     *  the key represents the index of the boundary within the polygon geometry:
+     *  -1 represents the outerBoundary, and 0,1,2... its innerBoundaries, in the
+     *  order provided by polygon->innerBoundaries()
+     */
+    QHash<int, OsmPlacemarkData> m_memberReferences;
+
+    /**
+     * @brief m_relationReferences is used to store the relations the placemark is part of
+     * and the role it has within them.
+     * Eg. an entry ( "123", "stop" ) means that the parent placemark is a member of
+     * the relation with id "123", while having the "stop" role
+     */
+    QHash<qint64, QString> m_relationReferences;
+};
+
+OsmPlacemarkDataPrivate::OsmPlacemarkDataPrivate() :
+    m_changeset( -1 ),
+    m_uid( -1 ),
+    m_timestamp( -1 ),
+    m_version( -1 ),
+    m_visible( -1 )
+{
+}
+
+namespace
+{
+
+// Longer tag values are mostly names and the like, which hardly repeat.
+const int MaximumInternedValueLength = 24;
+
+/**
+ * Returns the instance of @p string shared by all tags, so that the string
+ * is kept in memory only once.
+ */
+QString intern( const QString &string )
+{
+    static QReadWriteLock lock;
+    static QSet<QString> strings;
+
+    if ( string.isEmpty() ) {
+        return QString();
+    }
+
+    {
+        QReadLocker locker( &lock );
+        auto const iter = strings.constFind( string );
+        if ( iter != strings.constEnd() ) {
+            return *iter;
+        }
+    }
+
+    QWriteLocker locker( &lock );
+    return *strings.insert( string );
+}
+
+QString internValue( const QString &value )
+{
+    return value.size() <= MaximumInternedValueLength ? intern( value ) : value;
+}
+
+// interned strings are compared by their address first
+bool equals( const QString &string1, const QString &string2 )
+{
+    return string1.constData() == string2.constData() || string1 == string2;
+}
+
+qint64 fromNumber( const QString &number )
+{
+    bool ok;
+    qint64 const result = number.toLongLong( &ok );
+    return ok && result >= 0 ? result : -1;
+}
+
+QString toNumber( qint64 number )
+{
+    return number >= 0 ? QString::number( number ) : QString();
+}
+
+int digits( const QString &string, int position, int count )
+{
+    int result = 0;
+    for ( int i = position; i < position + count; ++i ) {
+        int const digit = string.at( i ).unicode() - '0';
+        if ( digit < 0 || digit > 9 ) {
+            return -1;
+        }
+        result = 10 * result + digit;
+    }
+    return result;
+}
+
+qint64 fromTimestamp( const QString &timestamp )
+{
+    if ( timestamp.isEmpty() ) {
+        return -1;
+    }
+
+    // OSM writes all timestamps as yyyy-MM-ddTHH:mm:ssZ, which is parsed
+    // here without the overhead of QDateTime
+    if ( timestamp.size() == 20 && timestamp.at( 4 ) == QLatin1Char( '-' ) && timestamp.at( 7 ) == QLatin1Char( '-' )
+         && timestamp.at( 10 ) == QLatin1Char( 'T' ) && timestamp.at( 13 ) == QLatin1Char( ':' )
+         && timestamp.at( 16 ) == QLatin1Char( ':' ) && timestamp.at( 19 ) == QLatin1Char( 'Z' ) ) {
+        QDate const date( digits( timestamp, 0, 4 ), digits( timestamp, 5, 2 ), digits( timestamp, 8, 2 ) );
+        int const hours = digits( timestamp, 11, 2 );
+        int const minutes = digits( timestamp, 14, 2 );
+        int const seconds = digits( timestamp, 17, 2 );
+        if ( date.isValid() && hours >= 0 && hours < 24 && minutes >= 0 && minutes < 60 && seconds >= 0 && seconds < 60 ) {
+            return ( date.toJulianDay() - QDate( 1970, 1, 1 ).toJulianDay() ) * 86400
+                    + hours * 3600 + minutes * 60 + seconds;
+        }
+    }
+
+    QDateTime const dateTime = QDateTime::fromString( timestamp, Qt::ISODate );
+    return dateTime.isValid() ? dateTime.toMSecsSinceEpoch() / 1000 : -1;
+}
+
+QString toTimestamp( qint64 timestamp )
+{
+    if ( timestamp < 0 ) {
+        return QString();
+    }
+
+    return QDateTime::fromMSecsSinceEpoch( 1000 * timestamp, Qt::UTC ).toString( Qt::ISODate );
+}
+
+}
+
 const QString OsmPlacemarkData::osmDataKey = "osm_data";
 const char OsmPlacemarkData::osmPlacemarkDataType[] = "OsmPlacemarkDataType";
 
@@ -29,6 +185,32 @@ OsmPlacemarkData::OsmPlacemarkData():
     // nothing to do
 }
 
+OsmPlacemarkData::OsmPlacemarkData( const OsmPlacemarkData &other ) :
+    GeoNode( other ),
+    m_id( other.m_id ),
+    d( other.d )
+{
+}
+
+OsmPlacemarkData::~OsmPlacemarkData()
+{
+}
+
+OsmPlacemarkData &OsmPlacemarkData::operator=( const OsmPlacemarkData &other )
+{
+    m_id = other.m_id;
+    d = other.d;
+    return *this;
+}
+
+OsmPlacemarkDataPrivate *OsmPlacemarkData::data()
+{
+    if ( !d ) {
+        d = new OsmPlacemarkDataPrivate;
+    }
+    return d.data();
+}
+
 qint64 OsmPlacemarkData::id() const
 {
     return m_id;
@@ -36,37 +218,40 @@ qint64 OsmPlacemarkData::id() const
 
 QString OsmPlacemarkData::changeset() const
 {
-    return m_changeset;
+    return d ? toNumber( d->m_changeset ) : QString();
 }
 
 QString OsmPlacemarkData::version() const
 {
-    return m_version;
+    return d ? toNumber( d->m_version ) : QString();
 }
 
 QString OsmPlacemarkData::uid() const
 {
-    return m_uid;
+    return d ? toNumber( d->m_uid ) : QString();
 }
 
 QString OsmPlacemarkData::isVisible() const
 {
-    return m_visible;
+    if ( !d || d->m_visible < 0 ) {
+        return QString();
+    }
+    return d->m_visible ? QStringLiteral( "true" ) : QStringLiteral( "false" );
 }
 
 QString OsmPlacemarkData::user() const
 {
-    return m_user;
+    return d ? d->m_user : QString();
 }
 
 QString OsmPlacemarkData::timestamp() const
 {
-    return m_timestamp;
+    return d ? toTimestamp( d->m_timestamp ) : QString();
 }
 
 QString OsmPlacemarkData::action() const
 {
-    return m_action;
+    return d ? d->m_action : QString();
 }
 
 void OsmPlacemarkData::setId( qint64 id )
@@ -76,75 +261,127 @@ void OsmPlacemarkData::setId( qint64 id )
 
 void OsmPlacemarkData::setVersion( const QString& version )
 {
-    m_version = version;
+    if ( d || !version.isEmpty() ) {
+        data()->m_version = fromNumber( version );
+    }
 }
 
 void OsmPlacemarkData::setChangeset( const QString& changeset )
 {
-    m_changeset = changeset;
+    if ( d || !changeset.isEmpty() ) {
+        data()->m_changeset = fromNumber( changeset );
+    }
 }
 
 void OsmPlacemarkData::setUid( const QString& uid )
 {
-    m_uid = uid;
+    if ( d || !uid.isEmpty() ) {
+        data()->m_uid = fromNumber( uid );
+    }
 }
 
 void OsmPlacemarkData::setVisible( const QString& visible )
 {
-    m_visible = visible;
+    if ( d || !visible.isEmpty() ) {
+        data()->m_visible = visible == QLatin1String( "true" ) ? 1
+                          : visible == QLatin1String( "false" ) ? 0 : -1;
+    }
 }
 
 void OsmPlacemarkData::setUser( const QString& user )
 {
-    m_user = user;
+    if ( d || !user.isEmpty() ) {
+        data()->m_user = intern( user );
+    }
 }
 
 void OsmPlacemarkData::setTimestamp( const QString& timestamp )
 {
-    m_timestamp = timestamp;
+    if ( d || !timestamp.isEmpty() ) {
+        data()->m_timestamp = fromTimestamp( timestamp );
+    }
 }
 
 void OsmPlacemarkData::setAction( const QString& action )
 {
-    m_action = action;
+    if ( d || !action.isEmpty() ) {
+        data()->m_action = intern( action );
+    }
 }
 
 
 
 QString OsmPlacemarkData::tagValue( const QString& key ) const
 {
-    return m_tags.value( key );
+    if ( d ) {
+        for ( const Tag &tag: d->m_tags ) {
+            if ( equals( tag.first, key ) ) {
+                return tag.second;
+            }
+        }
+    }
+    return QString();
 }
 
 void OsmPlacemarkData::addTag( const QString& key, const QString& value )
 {
-    m_tags.insert( key, value );
+    QVector<Tag> &tags = data()->m_tags;
+    for ( Tag &tag: tags ) {
+        if ( equals( tag.first, key ) ) {
+            tag.second = internValue( value );
+            return;
+        }
+    }
+    tags << Tag( intern( key ), internValue( value ) );
 }
 
 void OsmPlacemarkData::removeTag( const QString &key )
 {
-    m_tags.remove( key );
+    if ( !containsTagKey( key ) ) {
+        return;
+    }
+
+    QVector<Tag> &tags = data()->m_tags;
+    for ( int i = 0; i < tags.size(); ++i ) {
+        if ( equals( tags.at( i ).first, key ) ) {
+            tags.remove( i );
+            return;
+        }
+    }
 }
 
 bool OsmPlacemarkData::containsTag( const QString &key, const QString &value ) const
 {
-    auto const iter = m_tags.constFind(key);
-    return iter == m_tags.constEnd() ? false : iter.value() == value;
+    if ( d ) {
+        for ( const Tag &tag: d->m_tags ) {
+            if ( equals( tag.first, key ) ) {
+                return equals( tag.second, value );
+            }
+        }
+    }
+    return false;
 }
 
 bool OsmPlacemarkData::containsTagKey( const QString &key ) const
 {
-    return m_tags.contains( key );
+    if ( d ) {
+        for ( const Tag &tag: d->m_tags ) {
+            if ( equals( tag.first, key ) ) {
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
-QHash< QString, QString >::const_iterator OsmPlacemarkData::tagsBegin() const
+OsmPlacemarkData::TagIterator OsmPlacemarkData::tagsBegin() const
 {
-    return m_tags.begin();
+    return d ? TagIterator( d->m_tags.constData() ) : TagIterator();
 }
 
-QHash< QString, QString >::const_iterator OsmPlacemarkData::tagsEnd() const
+OsmPlacemarkData::TagIterator OsmPlacemarkData::tagsEnd() const
 {
-    return m_tags.constEnd();
+    return d ? TagIterator( d->m_tags.constData() + d->m_tags.size() ) : TagIterator();
 }
 
 
@@ -153,69 +390,78 @@ QHash< QString, QString >::const_iterator OsmPlacemarkData::tagsEnd() const
 
 OsmPlacemarkData &OsmPlacemarkData::nodeReference( const GeoDataCoordinates &coordinates )
 {
-    return m_nodeReferences[ coordinates ];
+    return data()->m_nodeReferences[ coordinates ];
 }
 
 OsmPlacemarkData OsmPlacemarkData::nodeReference( const GeoDataCoordinates &coordinates ) const
 {
-    return m_nodeReferences.value( coordinates );
+    return d ? d->m_nodeReferences.value( coordinates ) : OsmPlacemarkData();
 }
 
 void OsmPlacemarkData::addNodeReference( const GeoDataCoordinates &key, const OsmPlacemarkData &value )
 {
-    m_nodeReferences.insert( key, value );
+    data()->m_nodeReferences.insert( key, value );
 }
 
 void OsmPlacemarkData::removeNodeReference( const GeoDataCoordinates &key )
 {
-    m_nodeReferences.remove( key );
+    if ( containsNodeReference( key ) ) {
+        data()->m_nodeReferences.remove( key );
+    }
 }
 
 bool OsmPlacemarkData::containsNodeReference( const GeoDataCoordinates &key ) const
 {
-    return m_nodeReferences.contains( key );
+    return d && d->m_nodeReferences.contains( key );
 }
 
 void OsmPlacemarkData::changeNodeReference( const GeoDataCoordinates &oldKey, const GeoDataCoordinates &newKey )
 {
-    m_nodeReferences.insert( newKey, m_nodeReferences.value( oldKey ) );
-    m_nodeReferences.remove( oldKey );
+    QHash< GeoDataCoordinates, OsmPlacemarkData > &nodeReferences = data()->m_nodeReferences;
+    nodeReferences.insert( newKey, nodeReferences.value( oldKey ) );
+    nodeReferences.remove( oldKey );
 }
 
 QHash< GeoDataCoordinates, OsmPlacemarkData >::const_iterator OsmPlacemarkData::nodeReferencesBegin() const
 {
-    return m_nodeReferences.begin();
+    static const QHash< GeoDataCoordinates, OsmPlacemarkData > empty;
+    return d ? d->m_nodeReferences.constBegin() : empty.constBegin();
 }
 
 QHash< GeoDataCoordinates, OsmPlacemarkData >::const_iterator OsmPlacemarkData::nodeReferencesEnd() const
 {
-    return m_nodeReferences.constEnd();
+    static const QHash< GeoDataCoordinates, OsmPlacemarkData > empty;
+    return d ? d->m_nodeReferences.constEnd() : empty.constEnd();
 }
 
 
 OsmPlacemarkData &OsmPlacemarkData::memberReference( int key )
 {
-    return m_memberReferences[ key ];
+    return data()->m_memberReferences[ key ];
 }
 
 OsmPlacemarkData OsmPlacemarkData::memberReference( int key ) const
 {
-    return m_memberReferences.value( key );
+    return d ? d->m_memberReferences.value( key ) : OsmPlacemarkData();
 }
 
 
 void OsmPlacemarkData::addMemberReference( int key, const OsmPlacemarkData &value )
 {
-    m_memberReferences.insert( key, value );
+    data()->m_memberReferences.insert( key, value );
 }
 
 void OsmPlacemarkData::removeMemberReference( int key )
 {
+    if ( !d ) {
+        return;
+    }
+
     // If an inner boundary is deleted, all indexes higher than the deleted one
     // must be lowered by 1 to keep order.
     QHash< int, OsmPlacemarkData > newHash;
-    QHash< int, OsmPlacemarkData >::iterator it = m_memberReferences.begin();
-    QHash< int, OsmPlacemarkData >::iterator end = m_memberReferences.end();
+    QHash< int, OsmPlacemarkData >::const_iterator it = d->m_memberReferences.constBegin();
+    QHash< int, OsmPlacemarkData >::const_iterator end = d->m_memberReferences.constEnd();
 
     for ( ; it != end; ++it ) {
         if ( it.key() > key ) {
@@ -225,47 +471,53 @@ void OsmPlacemarkData::removeMemberReference( int key )
             newHash.insert( it.key(), it.value() );
         }
     }
-    m_memberReferences = newHash;
+    data()->m_memberReferences = newHash;
 }
 
 bool OsmPlacemarkData::containsMemberReference( int key ) const
 {
-    return m_memberReferences.contains( key );
+    return d && d->m_memberReferences.contains( key );
 }
 
 QHash< int, OsmPlacemarkData >::const_iterator OsmPlacemarkData::memberReferencesBegin() const
 {
-    return m_memberReferences.begin();
+    static const QHash< int, OsmPlacemarkData > empty;
+    return d ? d->m_memberReferences.constBegin() : empty.constBegin();
 }
 
 QHash< int, OsmPlacemarkData >::const_iterator OsmPlacemarkData::memberReferencesEnd() const
 {
-    return m_memberReferences.constEnd();
+    static const QHash< int, OsmPlacemarkData > empty;
+    return d ? d->m_memberReferences.constEnd() : empty.constEnd();
 }
 
 void OsmPlacemarkData::addRelation( qint64 id, const QString &role )
 {
-    m_relationReferences.insert( id, role );
+    data()->m_relationReferences.insert( id, intern( role ) );
 }
 
 void OsmPlacemarkData::removeRelation( qint64 id )
 {
-    m_relationReferences.remove( id );
+    if ( containsRelation( id ) ) {
+        data()->m_relationReferences.remove( id );
+    }
 }
 
 bool OsmPlacemarkData::containsRelation( qint64 id ) const
 {
-    return m_relationReferences.contains( id );
+    return d && d->m_relationReferences.contains( id );
 }
 
 QHash< qint64, QString >::const_iterator OsmPlacemarkData::relationReferencesBegin() const
 {
-    return m_relationReferences.begin();
+    static const QHash< qint64, QString > empty;
+    return d ? d->m_relationReferences.constBegin() : empty.constBegin();
 }
 
 QHash< qint64, QString >::const_iterator OsmPlacemarkData::relationReferencesEnd() const
 {
-    return m_relationReferences.constEnd();
+    static const QHash< qint64, QString > empty;
+    return d ? d->m_relationReferences.constEnd() : empty.constEnd();
 }
 
 QString OsmPlacemarkData::osmHashKey()
@@ -280,15 +532,15 @@ bool OsmPlacemarkData::isNull() const
 
 bool OsmPlacemarkData::isEmpty() const
 {
-    return m_tags.isEmpty() &&
-            m_nodeReferences.isEmpty() &&
-            m_memberReferences.isEmpty() &&
-            m_relationReferences.isEmpty() &&
-            m_version.isEmpty() &&
-            m_changeset.isEmpty() &&
-            m_uid.isEmpty() &&
-            m_user.isEmpty() &&
-            m_timestamp.isEmpty();
+    return !d || ( d->m_tags.isEmpty() &&
+            d->m_nodeReferences.isEmpty() &&
+            d->m_memberReferences.isEmpty() &&
+            d->m_relationReferences.isEmpty() &&
+            d->m_version < 0 &&
+            d->m_changeset < 0 &&
+            d->m_uid < 0 &&
+            d->m_user.isEmpty() &&
+            d->m_timestamp < 0 );
 }
 
 OsmPlacemarkData OsmPlacemarkData::fromParserAttributes( const QXmlStreamAttributes &attributes )
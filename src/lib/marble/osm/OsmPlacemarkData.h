@@ -14,7 +14,12 @@
 // Qt
 #include <QHash>
 #include <QMetaType>
+#include <QPair>
+#include <QSharedDataPointer>
 #include <QString>
+#include <QVector>
+
+#include <iterator>
 
 // Marble
 #include "GeoDataCoordinates.h"
@@ -28,6 +33,7 @@ namespace Marble
 
 class GeoDataGeometry;
 class GeoDataPlacemark;
+class OsmPlacemarkDataPrivate;
 
 /**
  * This class is used to encapsulate the osm data fields kept within a placemark's extendedData.
@@ -49,12 +55,56 @@ class GeoDataPlacemark;
  * The OsmObjectManager assigns OsmPlacemarkData objects to placemarks that do not have it
  * ( these are usually newly created placemarks within the editor, or placemarks loaded from
  * ".kml" files ). Placemarks that already have it, are simply written as-is.
+ *
+ * Storage:
+ * An OsmPlacemarkData with nothing but an id, like most nodes of a way, takes no more than
+ * the id. Everything else lives in implicitly shared data. Tag keys and short tag values are
+ * interned in a table shared by all documents, so repeated strings like "highway" or "yes"
+ * exist only once. The metadata is stored as numbers: the numeric fields and the timestamp
+ * are written back in their canonical form.
  */
 class MARBLE_EXPORT OsmPlacemarkData: public GeoNode
 {
 
 public:
+    typedef QPair<QString, QString> Tag;
+
+    /**
+     * @brief Iterates the tags in the order they were added. Offers key() and value()
+     * like the iterators of QHash.
+     */
+    class TagIterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Tag value_type;
+        typedef qptrdiff difference_type;
+        typedef const Tag *pointer;
+        typedef const Tag &reference;
+
+        TagIterator() : m_tag( nullptr ) {}
+        explicit TagIterator( const Tag *tag ) : m_tag( tag ) {}
+
+        const QString &key() const { return m_tag->first; }
+        const QString &value() const { return m_tag->second; }
+        reference operator*() const { return *m_tag; }
+        pointer operator->() const { return m_tag; }
+
+        TagIterator &operator++() { ++m_tag; return *this; }
+        TagIterator operator++( int ) { TagIterator result = *this; ++m_tag; return result; }
+
+        bool operator==( const TagIterator &other ) const { return m_tag == other.m_tag; }
+        bool operator!=( const TagIterator &other ) const { return m_tag != other.m_tag; }
+
+    private:
+        const Tag *m_tag;
+    };
+
     OsmPlacemarkData();
+    OsmPlacemarkData( const OsmPlacemarkData &other );
+    ~OsmPlacemarkData();
+
+    OsmPlacemarkData &operator=( const OsmPlacemarkData &other );
 
     qint64 id() const;
     QString version() const;
@@ -107,10 +157,10 @@ public:
     bool containsTagKey( const QString& key ) const;
 
     /**
-     * @brief iterators for the tags hash.
+     * @brief iterators for the tags.
      */
-    QHash< QString, QString >::const_iterator tagsBegin() const;
-    QHash< QString, QString >::const_iterator tagsEnd() const;
+    TagIterator tagsBegin() const;
+    TagIterator tagsEnd() const;
 
 
     /**
@@ -205,39 +255,13 @@ public:
     static const char osmPlacemarkDataType[];
 
 private:
+    // creates the shared data on the first write and detaches it
+    OsmPlacemarkDataPrivate *data();
+
     qint64 m_id;
-    QString m_version;
-    QString m_changeset;
-    QString m_uid;
-    QString m_visible;
-    QString m_user;
-    QString m_timestamp;
-    QString m_action;
-    QHash<QString, QString> m_tags;
+    // null as long as nothing but the id has been set
+    QSharedDataPointer<OsmPlacemarkDataPrivate> d;
     static const QString osmDataKey;
-
-    /**
-     * @brief m_ndRefs is used to store a way's component nodes
-     * ( It is empty for other placemark types )
-     */
-    QHash< GeoDataCoordinates, OsmPlacemarkData > m_nodeReferences;
-
-    /**
-     * @brief m_memberRefs is used to store a polygon's member boundaries
-     *  the key represents the index of the boundary within the polygon geometry:
-     *  -1 represents the outerBoundary, and 0,1,2... its innerBoundaries, in the
-     *  order provided by polygon->innerBoundaries()
-     */
-    QHash<int, OsmPlacemarkData> m_memberReferences;
-
-    /**
-     * @brief m_relationReferences is used to store the relations the placemark is part of
-     * and the role it has within them.
-     * Eg. an entry ( "123", "stop" ) means that the parent placemark is a member of
-     * the relation with id "123", while having the "stop" role
-     */
-    QHash<qint64, QString> m_relationReferences;
-
 };
 
 }
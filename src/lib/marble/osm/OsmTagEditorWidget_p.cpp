@@ -65,8 +65,8 @@ void OsmTagEditorWidgetPrivate::populateCurrentTagsList()
     // Other tags
     if( m_placemark->hasOsmData() ) {
         OsmPlacemarkData osmData = m_placemark->osmData();
-        QHash< QString, QString>::const_iterator it = osmData.tagsBegin();
-        QHash< QString, QString>::const_iterator end = osmData.tagsEnd();
+        OsmPlacemarkData::TagIterator it = osmData.tagsBegin();
+        OsmPlacemarkData::TagIterator end = osmData.tagsEnd();
         for ( ; it != end; ++it ) {
             QTreeWidgetItem *tagItem = tagWidgetItem(OsmTag(it.key(), it.value()));
             m_currentTagsList->addTopLevelItem( tagItem );
@@ -18,6 +18,7 @@
 #include "MarbleDebug.h"
 #include <QRegion>
 #include <QPainterPath>
+#include <QThreadStorage>
 
 // Marble
 #include "GeoDataLineString.h"
@@ -26,6 +27,10 @@
 
 using namespace Marble;
 
+// The projections are shared by all viewports, so every thread
+// gets buffers of its own.
+static QThreadStorage<ProjectedLineString *> s_projectedLineStrings;
+
 AbstractProjection::AbstractProjection()
     : d_ptr( new AbstractProjectionPrivate( this ) )
 {
@@ -75,6 +80,102 @@ int AbstractProjectionPrivate::levelForResolution(qreal resolution) const {
     return m_level;
 }
 
+const ProjectedLineString &AbstractProjectionPrivate::projectLineString( const GeoDataLineString &lineString,
+                                                                         const ViewportParams *viewport ) const
+{
+    Q_Q( const AbstractProjection );
+
+    if ( !s_projectedLineStrings.hasLocalData() ) {
+        s_projectedLineStrings.setLocalData( new ProjectedLineString );
+    }
+    ProjectedLineString &projected = *s_projectedLineStrings.localData();
+
+    const int size = lineString.size();
+    const bool isLong = size > 10;
+    const int maximumDetail = levelForResolution( viewport->angularResolution() );
+    // The first node of optimized linestrings has a non-zero detail value.
+    const bool hasDetail = size > 0 && lineString.first().detail() != 0;
+
+    // Optimization for line strings with a big amount of nodes
+    projected.nodes.resize( size + 1 );
+    int *nodes = projected.nodes.data();
+    int count = 0;
+    int previous = 0;
+    for ( int i = 0; i < size; ++i ) {
+        const bool skipNode = hasDetail ? lineString.at( i ).detail() > maximumDetail
+                                        : i != 0 && isLong
+                                          && !viewport->resolves( lineString.at( previous ), lineString.at( i ) );
+        if ( !skipNode ) {
+            nodes[count++] = i;
+            previous = i;
+        }
+    }
+
+    // Linear rings require to tessellate the path from the last node to the first node
+    const bool closed = size > 0 && lineString.isClosed()
+                        && ( !hasDetail || lineString.first().detail() <= maximumDetail );
+    const int selected = count;
+    if ( closed ) {
+        nodes[count++] = 0;
+    }
+    projected.nodes.resize( count );
+
+    const qreal *lon = lineString.longitudes();
+    const qreal *lat = lineString.latitudes();
+    const qreal *altitude = lineString.altitudes();
+
+    if ( 2 * selected >= size ) {
+        // Most nodes get drawn, so project all of them straight from the
+        // arrays of the line string and drop the skipped ones afterwards
+        projected.x.resize( size + 1 );
+        projected.y.resize( size + 1 );
+        projected.globeHidesPoint.resize( size + 1 );
+        qreal *x = projected.x.data();
+        qreal *y = projected.y.data();
+        bool *globeHidesPoint = projected.globeHidesPoint.data();
+        q->projectPoints( lon, lat, altitude, size, viewport, x, y, globeHidesPoint );
+
+        // the selected nodes are ascending, so nothing gets overwritten before it is moved
+        for ( int i = 0; i < count; ++i ) {
+            x[i] = x[nodes[i]];
+            y[i] = y[nodes[i]];
+            globeHidesPoint[i] = globeHidesPoint[nodes[i]];
+        }
+        projected.x.resize( count );
+        projected.y.resize( count );
+        projected.globeHidesPoint.resize( count );
+    }
+    else {
+        // Project each run of consecutive selected nodes straight from the
+        // arrays of the line string
+        projected.x.resize( count );
+        projected.y.resize( count );
+        projected.globeHidesPoint.resize( count );
+        qreal *x = projected.x.data();
+        qreal *y = projected.y.data();
+        bool *globeHidesPoint = projected.globeHidesPoint.data();
+        int i = 0;
+        while ( i < selected ) {
+            int end = i + 1;
+            while ( end < selected && nodes[end] == nodes[end - 1] + 1 ) {
+                ++end;
+            }
+            const int first = nodes[i];
+            q->projectPoints( lon + first, lat + first, altitude + first, end - i, viewport,
+                              x + i, y + i, globeHidesPoint + i );
+            i = end;
+        }
+        // closing a ring requires the first node to be drawn
+        if ( closed ) {
+            x[selected] = x[0];
+            y[selected] = y[0];
+            globeHidesPoint[selected] = globeHidesPoint[0];
+        }
+    }
+
+    return projected;
+}
+
 qreal AbstractProjection::maxValidLat() const
 {
     return +90.0 * DEG2RAD;
@@ -173,6 +274,17 @@ bool AbstractProjection::screenCoordinates( const GeoDataCoordinates &geopoint,
     return screenCoordinates( geopoint, viewport, x, y, globeHidesPoint );
 }
 
+void AbstractProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                        int count,
+                                        const ViewportParams *viewport,
+                                        qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    for ( int i = 0; i < count; ++i ) {
+        const GeoDataCoordinates geopoint( lon[i], lat[i], altitude[i] );
+        screenCoordinates( geopoint, viewport, x[i], y[i], globeHidesPoint[i] );
+    }
+}
+
 GeoDataLatLonAltBox AbstractProjection::latLonAltBox( const QRect& screenRect,
                                                       const ViewportParams *viewport ) const
 {
@@ -188,6 +188,33 @@ class MARBLE_EXPORT AbstractProjection
                             const ViewportParams *viewport,
                             QVector<QPolygonF*> &polygons ) const = 0;
 
+    /**
+     * @brief Get the screen coordinates of many geographical points at once.
+     *
+     * @param lon       the longitudes of the points in radians
+     * @param lat       the latitudes of the points in radians
+     * @param altitude  the altitudes of the points in meters
+     * @param count     the number of points
+     * @param viewport  the viewport parameters
+     * @param x         receives the x coordinates of the points
+     * @param y         receives the y coordinates of the points
+     * @param globeHidesPoint  receives whether the points get hidden on the
+     *                  far side of the earth. The screen coordinates of
+     *                  hidden points are undefined.
+     *
+     * All arrays need to provide space for @p count elements. Contrary to
+     * screenCoordinates() the points are not checked against the screen area.
+     * The default implementation calls screenCoordinates() for each point,
+     * projections override it with a loop free of virtual calls and branches
+     * that the compiler can vectorize.
+     *
+     * @see GeoDataLineString::longitudes()
+     */
+    virtual void projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                int count,
+                                const ViewportParams *viewport,
+                                qreal *x, qreal *y, bool *globeHidesPoint ) const;
+
     /**
      * @brief Get the earth coordinates corresponding to a pixel in the map.
      * @param x      the x coordinate of the pixel
@@ -12,10 +12,27 @@
 #define MARBLE_ABSTRACTPROJECTIONPRIVATE_H
 
 
+#include <QVector>
+
 namespace Marble
 {
 
 class AbstractProjection;
+class GeoDataLineString;
+class ViewportParams;
+
+/**
+ * The nodes of a line string which get drawn at the current level of detail
+ * together with their screen coordinates. Entry i describes the node with the
+ * index nodes[i]. Closed line strings end with their first node once more.
+ */
+struct ProjectedLineString
+{
+    QVector<int> nodes;
+    QVector<qreal> x;
+    QVector<qreal> y;
+    QVector<bool> globeHidesPoint;
+};
 
 class AbstractProjectionPrivate
 {
@@ -26,6 +43,15 @@ class AbstractProjectionPrivate
 
     int levelForResolution(qreal resolution) const;
 
+    /**
+     * Selects the nodes of @p lineString which get drawn at the resolution of
+     * @p viewport and projects them with projectPoints(), reading the
+     * coordinates straight from the arrays of the line string.
+     * The returned buffers get reused by the next call from the same thread.
+     */
+    const ProjectedLineString &projectLineString( const GeoDataLineString &lineString,
+                                                  const ViewportParams *viewport ) const;
+
     qreal  m_maxLat;
     qreal  m_minLat;
     mutable qreal  m_previousResolution;
@@ -154,6 +154,23 @@ bool AzimuthalEquidistantProjection::screenCoordinates( const GeoDataCoordinates
 }
 
 
+void AzimuthalEquidistantProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                                    int count,
+                                                    const ViewportParams *viewport,
+                                                    qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    Q_UNUSED( altitude );
+
+    const auto scaleFactor = []( qreal cosC ) {
+        const qreal c = qAcos( cosC );
+        return cosC == 1 ? 1 : c / qSin( c );
+    };
+
+    AzimuthalProjectionPrivate::projectPoints( lon, lat, count, viewport,
+                                               2 * viewport->radius() / M_PI, clippingRadius(), scaleFactor,
+                                               x, y, globeHidesPoint );
+}
+
 bool AzimuthalEquidistantProjection::geoCoordinates( const int x, const int y,
                                           const ViewportParams *viewport,
                                           qreal& lon, qreal& lat,
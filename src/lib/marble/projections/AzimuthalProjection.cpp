@@ -345,10 +345,16 @@ bool AzimuthalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
     qreal horizonX = -1.0;
     qreal horizonY = -1.0;
 
+    // The nodes get selected and projected in one go. Linear rings end with
+    // the first node once more, so that the path from the last node to the
+    // first node gets tessellated as well.
+    const ProjectedLineString &projected = projectLineString( lineString, viewport );
+    const int count = projected.nodes.size();
+
     polygons.append( new QPolygonF );
+    polygons.last()->reserve( count );
 
-    GeoDataLineString::ConstIterator itCoords = lineString.constBegin();
-    GeoDataLineString::ConstIterator itPreviousCoords = lineString.constBegin();
+    int previousNode = 0;
 
     // Some projections display the earth in a way so that there is a
     // foreside and a backside.
@@ -371,141 +377,115 @@ bool AzimuthalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
     bool horizonOrphan = false;
     GeoDataCoordinates horizonOrphanCoords;
 
-    GeoDataLineString::ConstIterator itBegin = lineString.constBegin();
-    GeoDataLineString::ConstIterator itEnd = lineString.constEnd();
-
-    bool processingLastNode = false;
-
-    // We use a while loop to be able to cover linestrings as well as linear rings:
-    // Linear rings require to tessellate the path from the last node to the first node
-    // which isn't really convenient to achieve with a for loop ...
-
-    const bool isLong = lineString.size() > 10;
-    const int maximumDetail = levelForResolution(viewport->angularResolution());
-    // The first node of optimized linestrings has a non-zero detail value.
-    const bool hasDetail = itBegin->detail() != 0;
-
-    while ( itCoords != itEnd )
+    for ( int i = 0; i < count; ++i )
     {
-        // Optimization for line strings with a big amount of nodes
-        bool skipNode = (hasDetail ? itCoords->detail() > maximumDetail
-                : itCoords != itBegin && isLong && !processingLastNode &&
-                !viewport->resolves( *itPreviousCoords, *itCoords ) );
-
-        if ( !skipNode ) {
-
-            q->screenCoordinates( *itCoords, viewport, x, y, globeHidesPoint );
+        const int node = projected.nodes.at( i );
+        const GeoDataCoordinates &coords = lineString.at( node );
+        const GeoDataCoordinates &previousCoords = lineString.at( previousNode );
+
+        // The screen position of hidden nodes stays the one of the previous node
+        globeHidesPoint = projected.globeHidesPoint.at( i );
+        if ( !globeHidesPoint ) {
+            x = projected.x.at( i );
+            y = projected.y.at( i );
+        }
 
-            // Initializing variables that store the values of the previous iteration
-            if ( !processingLastNode && itCoords == itBegin ) {
-                previousGlobeHidesPoint = globeHidesPoint;
-                itPreviousCoords = itCoords;
-                previousX = x;
-                previousY = y;
-            }
+        // Initializing variables that store the values of the previous iteration
+        if ( i == 0 && node == 0 ) {
+            previousGlobeHidesPoint = globeHidesPoint;
+            previousNode = node;
+            previousX = x;
+            previousY = y;
+        }
 
-            // Check for the "horizon case" (which is present e.g. for the spherical projection
-            const bool isAtHorizon = ( globeHidesPoint || previousGlobeHidesPoint ) &&
-                                     ( globeHidesPoint !=  previousGlobeHidesPoint );
+        // Check for the "horizon case" (which is present e.g. for the spherical projection
+        const bool isAtHorizon = ( globeHidesPoint || previousGlobeHidesPoint ) &&
+                                 ( globeHidesPoint !=  previousGlobeHidesPoint );
 
-            if ( isAtHorizon ) {
-                // Handle the "horizon case"
-                horizonCoords = findHorizon( *itPreviousCoords, *itCoords, viewport, f );
+        if ( isAtHorizon ) {
+            // Handle the "horizon case"
+            horizonCoords = findHorizon( previousCoords, coords, viewport, f );
 
-                if ( lineString.isClosed() ) {
-                    if ( horizonPair ) {
-                        horizonToPolygon( viewport, horizonDisappearCoords, horizonCoords, polygons.last() );
-                        horizonPair = false;
+            if ( lineString.isClosed() ) {
+                if ( horizonPair ) {
+                    horizonToPolygon( viewport, horizonDisappearCoords, horizonCoords, polygons.last() );
+                    horizonPair = false;
+                }
+                else {
+                    if ( globeHidesPoint ) {
+                        horizonDisappearCoords = horizonCoords;
+                        horizonPair = true;
                     }
                     else {
-                        if ( globeHidesPoint ) {
-                            horizonDisappearCoords = horizonCoords;
-                            horizonPair = true;
-                        }
-                        else {
-                            horizonOrphanCoords = horizonCoords;
-                            horizonOrphan = true;
-                        }
+                        horizonOrphanCoords = horizonCoords;
+                        horizonOrphan = true;
                     }
                 }
+            }
 
-                q->screenCoordinates( horizonCoords, viewport, horizonX, horizonY );
+            q->screenCoordinates( horizonCoords, viewport, horizonX, horizonY );
 
-                // If the line appears on the visible half we need
-                // to add an interpolated point at the horizon as the previous point.
-                if ( previousGlobeHidesPoint ) {
-                    *polygons.last() << QPointF( horizonX, horizonY );
-                }
+            // If the line appears on the visible half we need
+            // to add an interpolated point at the horizon as the previous point.
+            if ( previousGlobeHidesPoint ) {
+                *polygons.last() << QPointF( horizonX, horizonY );
             }
+        }
 
-            // This if-clause contains the section that tessellates the line
-            // segments of a linestring. If you are about to learn how the code of
-            // this class works you can safely ignore this section for a start.
+        // This if-clause contains the section that tessellates the line
+        // segments of a linestring. If you are about to learn how the code of
+        // this class works you can safely ignore this section for a start.
 
-            if ( lineString.tessellate() /* && ( isVisible || previousIsVisible ) */ ) {
+        if ( lineString.tessellate() /* && ( isVisible || previousIsVisible ) */ ) {
 
-                if ( !isAtHorizon ) {
+            if ( !isAtHorizon ) {
 
-                    tessellateLineSegment( *itPreviousCoords, previousX, previousY,
-                                           *itCoords, x, y,
-                                           polygons, viewport,
-                                           f, !lineString.isClosed() );
+                tessellateLineSegment( previousCoords, previousX, previousY,
+                                       coords, x, y,
+                                       polygons, viewport,
+                                       f, !lineString.isClosed() );
 
-                }
-                else {
-                    // Connect the interpolated  point at the horizon with the
-                    // current or previous point in the line.
-                    if ( previousGlobeHidesPoint ) {
-                        tessellateLineSegment( horizonCoords, horizonX, horizonY,
-                                               *itCoords, x, y,
-                                               polygons, viewport,
-                                               f, !lineString.isClosed() );
-                    }
-                    else {
-                        tessellateLineSegment( *itPreviousCoords, previousX, previousY,
-                                               horizonCoords, horizonX, horizonY,
-                                               polygons, viewport,
-                                               f, !lineString.isClosed() );
-                    }
-                }
             }
             else {
-                if ( !globeHidesPoint ) {
-                    *polygons.last() << QPointF( x, y );
+                // Connect the interpolated  point at the horizon with the
+                // current or previous point in the line.
+                if ( previousGlobeHidesPoint ) {
+                    tessellateLineSegment( horizonCoords, horizonX, horizonY,
+                                           coords, x, y,
+                                           polygons, viewport,
+                                           f, !lineString.isClosed() );
                 }
                 else {
-                    if ( !previousGlobeHidesPoint && isAtHorizon ) {
-                        *polygons.last() << QPointF( horizonX, horizonY );
-                    }
+                    tessellateLineSegment( previousCoords, previousX, previousY,
+                                           horizonCoords, horizonX, horizonY,
+                                           polygons, viewport,
+                                           f, !lineString.isClosed() );
                 }
             }
-
-            if ( globeHidesPoint ) {
-                if (   !previousGlobeHidesPoint
-                    && !lineString.isClosed()
-                    ) {
-                    polygons.append( new QPolygonF );
+        }
+        else {
+            if ( !globeHidesPoint ) {
+                *polygons.last() << QPointF( x, y );
+            }
+            else {
+                if ( !previousGlobeHidesPoint && isAtHorizon ) {
+                    *polygons.last() << QPointF( horizonX, horizonY );
                 }
             }
-
-            previousGlobeHidesPoint = globeHidesPoint;
-            itPreviousCoords = itCoords;
-            previousX = x;
-            previousY = y;
         }
 
-        // Here we modify the condition to be able to process the
-        // first node after the last node in a LinearRing.
-
-        if ( processingLastNode ) {
-            break;
+        if ( globeHidesPoint ) {
+            if (   !previousGlobeHidesPoint
+                && !lineString.isClosed()
+                ) {
+                polygons.append( new QPolygonF );
+            }
         }
-        ++itCoords;
 
-        if ( itCoords == itEnd  && lineString.isClosed() ) {
-            itCoords = itBegin;
-            processingLastNode = true;
-        }
+        previousGlobeHidesPoint = globeHidesPoint;
+        previousNode = node;
+        previousX = x;
+        previousY = y;
     }
 
     // In case of horizon crossings, make sure that we always get a
@@ -11,6 +11,9 @@
 #define MARBLE_AZIMUTHALPROJECTIONPRIVATE_H
 
 #include "AbstractProjection_p.h"
+#include "ViewportParams.h"
+
+#include <qmath.h>
 
 
 namespace Marble
@@ -99,6 +102,45 @@ public:
     bool globeHidesPoint( const GeoDataCoordinates &coordinates,
                           const ViewportParams *viewport ) const;
 
+    /**
+     * Batch version of the screenCoordinates() implementations of the azimuthal
+     * projections that are based on the angular distance c from the center of
+     * the map. They only differ in the scale factor k( cos c ) and in the
+     * factor @p pixelScale that turns unit coordinates into pixels.
+     */
+    template <class ScaleFactor>
+    static void projectPoints( const qreal *lon, const qreal *lat, int count,
+                               const ViewportParams *viewport,
+                               qreal pixelScale, qreal clippingRadius, ScaleFactor k,
+                               qreal *x, qreal *y, bool *globeHidesPoint )
+    {
+        const qreal lambdaPrime = viewport->centerLongitude();
+        const qreal sinPhi1 = qSin( viewport->centerLatitude() );
+        const qreal cosPhi1 = qCos( viewport->centerLatitude() );
+
+        const qint64 radius = clippingRadius * viewport->radius();
+        const qreal radiusSquared = radius * radius;
+        const int halfWidth = viewport->width() / 2;
+        const int halfHeight = viewport->height() / 2;
+
+        for ( int i = 0; i < count; ++i ) {
+            const qreal deltaLambda = lon[i] - lambdaPrime;
+            const qreal sinPhi = qSin( lat[i] );
+            const qreal cosPhi = qCos( lat[i] );
+            const qreal cosDeltaLambda = qCos( deltaLambda );
+
+            const qreal cosC = sinPhi1 * sinPhi + cosPhi1 * cosPhi * cosDeltaLambda;
+            const qreal scale = k( cosC ) * pixelScale;
+
+            const qreal projectedX = ( cosPhi * qSin( deltaLambda ) ) * scale;
+            const qreal projectedY = ( cosPhi1 * sinPhi - sinPhi1 * cosPhi * cosDeltaLambda ) * scale;
+
+            x[i] = halfWidth + projectedX;
+            y[i] = halfHeight - projectedY;
+            globeHidesPoint[i] = cosC <= 0 || projectedX * projectedX + projectedY * projectedY > radiusSquared;
+        }
+    }
+
     AzimuthalProjection * const q_ptr;
 
     Q_DECLARE_PUBLIC( AzimuthalProjection )
@@ -278,84 +278,54 @@ bool CylindricalProjectionPrivate::lineStringToPolygon( const GeoDataLineString
     int mirrorCount = 0;
     qreal distance = repeatDistance( viewport );
 
-    polygons.append( new QPolygonF );
-
-    GeoDataLineString::ConstIterator itCoords = lineString.constBegin();
-    GeoDataLineString::ConstIterator itPreviousCoords = lineString.constBegin();
-
-    GeoDataLineString::ConstIterator itBegin = lineString.constBegin();
-    GeoDataLineString::ConstIterator itEnd = lineString.constEnd();
+    // The nodes get selected and projected in one go. Linear rings end with
+    // the first node once more, so that the path from the last node to the
+    // first node gets tessellated as well.
+    const ProjectedLineString &projected = projectLineString( lineString, viewport );
+    const int count = projected.nodes.size();
 
-    bool processingLastNode = false;
-
-    // We use a while loop to be able to cover linestrings as well as linear rings:
-    // Linear rings require to tessellate the path from the last node to the first node
-    // which isn't really convenient to achieve with a for loop ...
+    polygons.append( new QPolygonF );
+    polygons.last()->reserve( count );
 
-    const bool isLong = lineString.size() > 10;
-    const int maximumDetail = levelForResolution(viewport->angularResolution());
-    // The first node of optimized linestrings has a non-zero detail value.
-    const bool hasDetail = itBegin->detail() != 0;
+    int previousNode = 0;
 
     bool isStraight = lineString.latLonAltBox().height() == 0 || lineString.latLonAltBox().width() == 0;
 
-    while ( itCoords != itEnd )
+    for ( int i = 0; i < count; ++i )
     {
-        // Optimization for line strings with a big amount of nodes
-        bool skipNode = (hasDetail ? itCoords->detail() > maximumDetail
-                : itCoords != itBegin && isLong && !processingLastNode &&
-                !viewport->resolves( *itPreviousCoords, *itCoords ) );
-
-        if ( !skipNode ) {
-
-
-            Q_Q( const CylindricalProjection );
-
-            q->screenCoordinates( *itCoords, viewport, x, y );
-
-            // Initializing variables that store the values of the previous iteration
-            if ( !processingLastNode && itCoords == itBegin ) {
-                itPreviousCoords = itCoords;
-                previousX = x;
-                previousY = y;
-            }
-
-            // This if-clause contains the section that tessellates the line
-            // segments of a linestring. If you are about to learn how the code of
-            // this class works you can safely ignore this section for a start.
-
-            if ( lineString.tessellate() && !isStraight) {
-
-                mirrorCount = tessellateLineSegment( *itPreviousCoords, previousX, previousY,
-                                           *itCoords, x, y,
-                                           polygons, viewport,
-                                           f, mirrorCount, distance );
-            }
+        const int node = projected.nodes.at( i );
+        x = projected.x.at( i );
+        y = projected.y.at( i );
 
-            else {
-                // special case for polys which cross dateline but have no Tesselation Flag
-                // the expected rendering is a screen coordinates straight line between
-                // points, but in projections with repeatX things are not smooth
-                mirrorCount = crossDateLine( *itPreviousCoords, *itCoords, x, y, polygons, mirrorCount, distance );
-            }
-
-            itPreviousCoords = itCoords;
+        // Initializing variables that store the values of the previous iteration
+        if ( i == 0 && node == 0 ) {
+            previousNode = node;
             previousX = x;
             previousY = y;
         }
 
-        // Here we modify the condition to be able to process the
-        // first node after the last node in a LinearRing.
+        // This if-clause contains the section that tessellates the line
+        // segments of a linestring. If you are about to learn how the code of
+        // this class works you can safely ignore this section for a start.
+
+        if ( lineString.tessellate() && !isStraight) {
 
-        if ( processingLastNode ) {
-            break;
+            mirrorCount = tessellateLineSegment( lineString.at( previousNode ), previousX, previousY,
+                                       lineString.at( node ), x, y,
+                                       polygons, viewport,
+                                       f, mirrorCount, distance );
         }
-        ++itCoords;
 
-        if ( itCoords == itEnd  && lineString.isClosed() ) {
-            itCoords = itBegin;
-            processingLastNode = true;
+        else {
+            // special case for polys which cross dateline but have no Tesselation Flag
+            // the expected rendering is a screen coordinates straight line between
+            // points, but in projections with repeatX things are not smooth
+            mirrorCount = crossDateLine( lineString.at( previousNode ), lineString.at( node ), x, y, polygons, mirrorCount, distance );
         }
+
+        previousNode = node;
+        previousX = x;
+        previousY = y;
     }
 
     GeoDataLatLonAltBox box = lineString.latLonAltBox();
@@ -152,6 +152,27 @@ bool EquirectProjection::screenCoordinates( const GeoDataCoordinates &coordinate
 }
 
 
+void EquirectProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                        int count,
+                                        const ViewportParams *viewport,
+                                        qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    Q_UNUSED( altitude );
+
+    const qreal halfWidth = (qreal)(viewport->width()) / 2.0;
+    const qreal halfHeight = (qreal)(viewport->height()) / 2.0;
+    const qreal rad2Pixel = 2.0 * viewport->radius() / M_PI;
+
+    const qreal centerLon = viewport->centerLongitude();
+    const qreal centerLat = viewport->centerLatitude();
+
+    for ( int i = 0; i < count; ++i ) {
+        x[i] = halfWidth + rad2Pixel * ( lon[i] - centerLon );
+        y[i] = halfHeight - rad2Pixel * ( lat[i] - centerLat );
+        globeHidesPoint[i] = false;
+    }
+}
+
 bool EquirectProjection::geoCoordinates( const int x, const int y,
                                          const ViewportParams *viewport,
                                          qreal& lon, qreal& lat,
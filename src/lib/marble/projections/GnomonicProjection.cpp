@@ -151,6 +151,19 @@ bool GnomonicProjection::screenCoordinates( const GeoDataCoordinates &coordinate
 }
 
 
+void GnomonicProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                        int count,
+                                        const ViewportParams *viewport,
+                                        qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    Q_UNUSED( altitude );
+
+    AzimuthalProjectionPrivate::projectPoints( lon, lat, count, viewport,
+                                               viewport->radius() / 2, clippingRadius(),
+                                               []( qreal cosC ) { return 1 / cosC; },
+                                               x, y, globeHidesPoint );
+}
+
 bool GnomonicProjection::geoCoordinates( const int x, const int y,
                                           const ViewportParams *viewport,
                                           qreal& lon, qreal& lat,
@@ -153,6 +153,19 @@ bool LambertAzimuthalProjection::screenCoordinates( const GeoDataCoordinates &co
 }
 
 
+void LambertAzimuthalProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                                int count,
+                                                const ViewportParams *viewport,
+                                                qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    Q_UNUSED( altitude );
+
+    AzimuthalProjectionPrivate::projectPoints( lon, lat, count, viewport,
+                                               viewport->radius() / qSqrt(2), clippingRadius(),
+                                               []( qreal cosC ) { return qSqrt( 2 / ( 1 + cosC ) ); },
+                                               x, y, globeHidesPoint );
+}
+
 bool LambertAzimuthalProjection::geoCoordinates( const int x, const int y,
                                           const ViewportParams *viewport,
                                           qreal& lon, qreal& lat,
@@ -172,6 +172,32 @@ bool MercatorProjection::screenCoordinates( const GeoDataCoordinates &coordinate
 }
 
 
+void MercatorProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                        int count,
+                                        const ViewportParams *viewport,
+                                        qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    Q_UNUSED( altitude );
+
+    const qreal halfWidth = (qreal)(viewport->width()) / 2;
+    const qreal halfHeight = (qreal)(viewport->height()) / 2;
+    const qreal rad2Pixel = 2 * viewport->radius() / M_PI;
+
+    const qreal centerLon = viewport->centerLongitude();
+    const qreal centerY = gdInv( viewport->centerLatitude() );
+
+    // Points beyond the valid latitude range get placed at its border.
+    const qreal minLatitude = minLat();
+    const qreal maxLatitude = maxLat();
+
+    for ( int i = 0; i < count; ++i ) {
+        const qreal boundedLat = qBound( minLatitude, lat[i], maxLatitude );
+        x[i] = halfWidth + rad2Pixel * ( lon[i] - centerLon );
+        y[i] = halfHeight - rad2Pixel * ( gdInv( boundedLat ) - centerY );
+        globeHidesPoint[i] = false;
+    }
+}
+
 bool MercatorProjection::geoCoordinates( const int x, const int y,
                                          const ViewportParams *viewport,
                                          qreal& lon, qreal& lat,
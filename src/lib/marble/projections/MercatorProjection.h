@@ -85,6 +85,11 @@ class MercatorProjection : public CylindricalProjection
 
     using CylindricalProjection::screenCoordinates;
 
+    void projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                        int count,
+                        const ViewportParams *viewport,
+                        qreal *x, qreal *y, bool *globeHidesPoint ) const;
+
    /**
      * @brief Get the earth coordinates corresponding to a pixel in the map.
      *
@@ -26,6 +26,7 @@
 #include "AzimuthalProjection_p.h"
 
 #include <QIcon>
+#include <qmath.h>
 
 #define SAFE_DISTANCE
 
@@ -154,6 +155,43 @@ bool SphericalProjection::screenCoordinates( const GeoDataCoordinates &coordinat
 }
 
 
+void SphericalProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                         int count,
+                                         const ViewportParams *viewport,
+                                         qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    const matrix &m = viewport->planetAxisMatrix();
+
+    const qreal radius = viewport->radius();
+    const qreal halfWidth = (qreal)(viewport->width()) / 2;
+    const qreal halfHeight = (qreal)(viewport->height()) / 2;
+
+    for ( int i = 0; i < count; ++i ) {
+        // Same as Quaternion::fromSpherical() followed by rotateAroundAxis()
+        const qreal cosLat = qCos( lat[i] );
+        const qreal qx = cosLat * qSin( lon[i] );
+        const qreal qy = qSin( lat[i] );
+        const qreal qz = cosLat * qCos( lon[i] );
+
+        const qreal rotatedX = m[0][0] * qx + m[1][0] * qy + m[2][0] * qz;
+        const qreal rotatedY = m[0][1] * qx + m[1][1] * qy + m[2][1] * qz;
+        const qreal rotatedZ = m[0][2] * qx + m[1][2] * qy + m[2][2] * qz;
+
+        const qreal pixelAltitude = radius / EARTH_RADIUS * ( altitude[i] + EARTH_RADIUS );
+        const qreal earthCenteredX = pixelAltitude * rotatedX;
+        const qreal earthCenteredY = pixelAltitude * rotatedY;
+
+        x[i] = halfWidth + earthCenteredX;
+        y[i] = halfHeight - earthCenteredY;
+
+        // Points on the other side of the earth are hidden unless they are
+        // high enough (e.g. satellites) to be seen next to the globe.
+        globeHidesPoint[i] = rotatedZ < 0
+                             && ( altitude[i] < 10000
+                                  || earthCenteredX * earthCenteredX + earthCenteredY * earthCenteredY < radius * radius );
+    }
+}
+
 bool SphericalProjection::geoCoordinates( const int x, const int y,
                                           const ViewportParams *viewport,
                                           qreal& lon, qreal& lat,
@@ -83,6 +83,11 @@ class SphericalProjection : public AzimuthalProjection
 
     using AbstractProjection::screenCoordinates;
 
+    virtual void projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                int count,
+                                const ViewportParams *viewport,
+                                qreal *x, qreal *y, bool *globeHidesPoint ) const;
+
     /**
      * @brief Get the earth coordinates corresponding to a pixel in the map.
      * @param x      the x coordinate of the pixel
@@ -153,6 +153,19 @@ bool StereographicProjection::screenCoordinates( const GeoDataCoordinates &coord
 }
 
 
+void StereographicProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                             int count,
+                                             const ViewportParams *viewport,
+                                             qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    Q_UNUSED( altitude );
+
+    AzimuthalProjectionPrivate::projectPoints( lon, lat, count, viewport,
+                                               viewport->radius(), clippingRadius(),
+                                               []( qreal cosC ) { return 1 / ( 1 + cosC ); },
+                                               x, y, globeHidesPoint );
+}
+
 bool StereographicProjection::geoCoordinates( const int x, const int y,
                                           const ViewportParams *viewport,
                                           qreal& lon, qreal& lat,
@@ -183,6 +183,46 @@ bool VerticalPerspectiveProjection::screenCoordinates( const GeoDataCoordinates
 }
 
 
+void VerticalPerspectiveProjection::projectPoints( const qreal *lon, const qreal *lat, const qreal *altitude,
+                                                   int count,
+                                                   const ViewportParams *viewport,
+                                                   qreal *x, qreal *y, bool *globeHidesPoint ) const
+{
+    Q_D(const VerticalPerspectiveProjection);
+    d->calculateConstants(viewport->radius());
+    const qreal P =  d->m_P;
+    const qreal lambdaPrime = viewport->centerLongitude();
+    const qreal sinPhi1 = qSin( viewport->centerLatitude() );
+    const qreal cosPhi1 = qCos( viewport->centerLatitude() );
+
+    const qreal radius = viewport->radius();
+    const int halfWidth = viewport->width() / 2;
+    const int halfHeight = viewport->height() / 2;
+
+    for ( int i = 0; i < count; ++i ) {
+        const qreal deltaLambda = lon[i] - lambdaPrime;
+        const qreal sinPhi = qSin( lat[i] );
+        const qreal cosPhi = qCos( lat[i] );
+        const qreal cosDeltaLambda = qCos( deltaLambda );
+
+        const qreal cosC = sinPhi1 * sinPhi + cosPhi1 * cosPhi * cosDeltaLambda;
+
+        const qreal k = (P - 1) / (P - cosC); // scale factor
+        const qreal pixelAltitude = (altitude[i] + EARTH_RADIUS) * d->m_altitudeToPixel;
+        const qreal projectedX = ( cosPhi * qSin( deltaLambda ) ) * k * pixelAltitude;
+        const qreal projectedY = ( cosPhi1 * sinPhi - sinPhi1 * cosPhi * cosDeltaLambda ) * k * pixelAltitude;
+
+        x[i] = halfWidth + projectedX;
+        y[i] = halfHeight - projectedY;
+
+        // Points on the Earth's backside are hidden unless they are high
+        // enough (e.g. satellites) to be seen next to the globe.
+        globeHidesPoint[i] = cosC < 1/P
+                             && ( altitude[i] < 10000
+                                  || projectedX * projectedX + projectedY * projectedY < radius * radius );
+    }
+}
+
 bool VerticalPerspectiveProjection::geoCoordinates( const int x, const int y,
                                           const ViewportParams *viewport,
                                           qreal& lon, qreal& lat,
@@ -19,7 +19,15 @@
 #include "MarbleModel.h"
 #include "PositionTracking.h"
 
+#include <QAtomicInt>
 #include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QThreadStorage>
 #include <QTime>
 
 #include <QSqlDatabase>
@@ -30,6 +38,10 @@ namespace Marble {
 
 namespace {
 
+const int MaxResults = 50;
+
+QAtomicInt connectionCount;
+
 class PlacemarkSmallerDistance
 {
 public:
@@ -67,133 +79,223 @@ private:
 
 }
 
-OsmDatabase::OsmDatabase( const QStringList &databaseFiles ) :
-    m_databaseFiles( databaseFiles )
+/**
+  * A connection to one database file with its prepared statements. It is
+  * reopened when the file changes and belongs to the thread that created it.
+  */
+class DatabaseConnection
+{
+public:
+    explicit DatabaseConnection( const QString &databaseFile );
+
+    ~DatabaseConnection();
+
+    /** Opens the database unless it is open already, returns whether it is usable */
+    bool open();
+
+    QString databaseFile() const;
+
+    /** Whether the full text index on names is available */
+    bool hasSearchIndex() const;
+
+    /** Whether the R*Tree on coordinates is available */
+    bool hasAreaIndex() const;
+
+    /** Returns the prepared statement for @p queryString, or 0 if it cannot be prepared */
+    QSqlQuery *query( const QString &queryString );
+
+private:
+    void close();
+
+    const QString m_databaseFile;
+    const QString m_connectionName;
+    QSqlDatabase m_database;
+    QDateTime m_lastModified;
+    bool m_hasSearchIndex;
+    bool m_hasAreaIndex;
+    QHash<QString, QSqlQuery *> m_queries;
+
+    Q_DISABLE_COPY( DatabaseConnection )
+};
+
+DatabaseConnection::DatabaseConnection( const QString &databaseFile ) :
+    m_databaseFile( databaseFile ),
+    m_connectionName( QString( "marble/local-osm-search-%1" ).arg( connectionCount.fetchAndAddRelaxed( 1 ) ) ),
+    m_hasSearchIndex( false ),
+    m_hasAreaIndex( false )
 {
 }
 
-QVector<OsmPlacemark> OsmDatabase::find( const DatabaseQuery &userQuery )
+DatabaseConnection::~DatabaseConnection()
 {
-    if ( m_databaseFiles.isEmpty() ) {
-        return QVector<OsmPlacemark>();
+    close();
+}
+
+bool DatabaseConnection::open()
+{
+    const QDateTime lastModified = QFileInfo( m_databaseFile ).lastModified();
+    if ( m_database.isOpen() && lastModified == m_lastModified ) {
+        return true;
     }
 
-    QSqlDatabase database = QSqlDatabase::addDatabase( "QSQLITE", QString( "marble/local-osm-search-%1" ).arg( reinterpret_cast<size_t>( this ) ) );
+    close();
+    m_database = QSqlDatabase::addDatabase( "QSQLITE", m_connectionName );
+    m_database.setDatabaseName( m_databaseFile );
+    if ( !m_database.open() ) {
+        qWarning() << "Failed to connect to database" << m_databaseFile;
+        return false;
+    }
+    m_lastModified = lastModified;
 
-    QVector<OsmPlacemark> result;
-    QTime timer;
-    timer.start();
-    foreach( const QString &databaseFile, m_databaseFiles ) {
-        database.setDatabaseName( databaseFile );
-        if ( !database.open() ) {
-            qWarning() << "Failed to connect to database" << databaseFile;
-        }
+    QSqlQuery tables( "SELECT name FROM sqlite_master WHERE name IN ('namesSearch', 'placemarksArea')", m_database );
+    while ( tables.next() ) {
+        m_hasSearchIndex = m_hasSearchIndex || tables.value( 0 ).toString() == QLatin1String( "namesSearch" );
+        m_hasAreaIndex = m_hasAreaIndex || tables.value( 0 ).toString() == QLatin1String( "placemarksArea" );
+    }
 
-        QString regionRestriction;
-        if ( !userQuery.region().isEmpty() ) {
-            QTime regionTimer;
-            regionTimer.start();
-            // Nested set model to support region hierarchies, see http://en.wikipedia.org/wiki/Nested_set_model
-            const QString regionsQueryString = QLatin1String("SELECT lft, rgt FROM regions WHERE name LIKE '%") + userQuery.region() + QLatin1String("%';");
-            QSqlQuery regionsQuery( regionsQueryString, database );
-            if ( regionsQuery.lastError().isValid() ) {
-                qWarning() << regionsQuery.lastError() << "in" << databaseFile << "with query" << regionsQuery.lastQuery();
-            }
-            regionRestriction = " AND (";
-            int regionCount = 0;
-            while ( regionsQuery.next() ) {
-                if ( regionCount > 0 ) {
-                    regionRestriction += QLatin1String(" OR ");
-                }
-                regionRestriction += QLatin1String(" (regions.lft >= ") + regionsQuery.value( 0 ).toString() +
-                                     QLatin1String(" AND regions.lft <= ") + regionsQuery.value( 1 ).toString() + QLatin1Char(')');
-                regionCount++;
-            }
-            regionRestriction += QLatin1Char(')');
+    return true;
+}
 
-            mDebug() << Q_FUNC_INFO << "region query in" << databaseFile << "with query" << regionsQueryString
-                     << "took" << regionTimer.elapsed() << "ms for" << regionCount << "results";
+QString DatabaseConnection::databaseFile() const
+{
+    return m_databaseFile;
+}
 
-            if ( regionCount == 0 ) {
-                continue;
-            }
-        }
+bool DatabaseConnection::hasSearchIndex() const
+{
+    return m_hasSearchIndex;
+}
 
-        QString queryString;
-
-        queryString = " SELECT regions.name,"
-                " places.name, places.number,"
-                " places.category, places.lon, places.lat"
-                " FROM regions, places";
-
-        if ( userQuery.queryType() == DatabaseQuery::CategorySearch ) {
-            queryString += QLatin1String(" WHERE regions.id = places.region");
-            if( userQuery.category() == OsmPlacemark::UnknownCategory ) {
-                // search for all pois which are not street nor address
-                queryString += QLatin1String(" AND places.category <> 0 AND places.category <> 6");
-            } else {
-                // search for specific category
-                queryString += QLatin1String(" AND places.category = %1");
-                queryString = queryString.arg( (qint32) userQuery.category() );
-            }
-            if ( userQuery.position().isValid() && userQuery.region().isEmpty() ) {
-                // sort by distance
-                queryString += QLatin1String(" ORDER BY ((places.lat-%1)*(places.lat-%1)+(places.lon-%2)*(places.lon-%2))");
-                GeoDataCoordinates position = userQuery.position();
-                queryString = queryString.arg( position.latitude( GeoDataCoordinates::Degree ), 0, 'f', 8 )
-                        .arg( position.longitude( GeoDataCoordinates::Degree ), 0, 'f', 8 );
-            } else {
-                queryString += regionRestriction;
-            }
-        } else if ( userQuery.queryType() == DatabaseQuery::BroadSearch ) {
-            queryString += QLatin1String(" WHERE regions.id = places.region"
-                    " AND places.name ") + wildcardQuery(userQuery.searchTerm());
-        } else {
-            queryString += QLatin1String(" WHERE regions.id = places.region"
-                    "   AND places.name ") + wildcardQuery(userQuery.street());
-            if ( !userQuery.houseNumber().isEmpty() ) {
-                queryString += QLatin1String(" AND places.number ") + wildcardQuery(userQuery.houseNumber());
-            } else {
-                queryString += QLatin1String(" AND places.number IS NULL");
-            }
-            queryString += regionRestriction;
+bool DatabaseConnection::hasAreaIndex() const
+{
+    return m_hasAreaIndex;
+}
+
+QSqlQuery *DatabaseConnection::query( const QString &queryString )
+{
+    QSqlQuery *query = m_queries.value( queryString );
+    if ( !query ) {
+        query = new QSqlQuery( m_database );
+        query->setForwardOnly( true );
+        if ( !query->prepare( queryString ) ) {
+            qWarning() << query->lastError() << "in" << m_databaseFile << "with query" << queryString;
+            delete query;
+            return 0;
         }
+        m_queries.insert( queryString, query );
+    }
+    return query;
+}
 
-        queryString += QLatin1String(" LIMIT 50;");
+void DatabaseConnection::close()
+{
+    if ( !m_database.isValid() ) {
+        return;
+    }
 
-        /** @todo: sort/filter results from several databases */
+    qDeleteAll( m_queries );
+    m_queries.clear();
+    m_database.close();
+    m_database = QSqlDatabase();
+    QSqlDatabase::removeDatabase( m_connectionName );
+    m_hasSearchIndex = false;
+    m_hasAreaIndex = false;
+}
 
-        QSqlQuery query( database );
-        query.setForwardOnly( true );
-        QTime queryTimer;
-        queryTimer.start();
-        if ( !query.exec( queryString ) ) {
-            qWarning() << query.lastError() << "in" << databaseFile << "with query" << query.lastQuery();
-            continue;
+namespace {
+
+/** The connections of a query thread, closed when the thread finishes */
+class ConnectionPool
+{
+public:
+    ~ConnectionPool()
+    {
+        qDeleteAll( m_connections );
+    }
+
+    DatabaseConnection *connection( const QString &databaseFile )
+    {
+        DatabaseConnection *&connection = m_connections[databaseFile];
+        if ( !connection ) {
+            connection = new DatabaseConnection( databaseFile );
         }
+        return connection;
+    }
 
-        int resultCount = 0;
-        while ( query.next() ) {
-            OsmPlacemark placemark;
-            if ( userQuery.resultFormat() == DatabaseQuery::DistanceFormat ) {
-                GeoDataCoordinates coordinates( query.value(4).toFloat(), query.value(5).toFloat(), 0.0, GeoDataCoordinates::Degree );
-                placemark.setAdditionalInformation( formatDistance( coordinates, userQuery.position() ) );
-            } else {
-                placemark.setAdditionalInformation( query.value( 0 ).toString() );
-            }
-            placemark.setName( query.value(1).toString() );
-            placemark.setHouseNumber( query.value(2).toString() );
-            placemark.setCategory( (OsmPlacemark::OsmCategory) query.value(3).toInt() );
-            placemark.setLongitude( query.value(4).toFloat() );
-            placemark.setLatitude( query.value(5).toFloat() );
-
-            result.push_back( placemark );
-            resultCount++;
+private:
+    QHash<QString, DatabaseConnection *> m_connections;
+};
+
+QThreadStorage<ConnectionPool *> connectionPools;
+
+Q_GLOBAL_STATIC( QThreadPool, queryThreadPool )
+
+}
+
+class OsmDatabase::FileSearch : public QRunnable
+{
+public:
+    FileSearch( const QString &databaseFile, const DatabaseQuery &userQuery, QSemaphore &finished ) :
+        m_databaseFile( databaseFile ),
+        m_userQuery( userQuery ),
+        m_finished( finished )
+    {
+        setAutoDelete( false );
+    }
+
+    void run() override
+    {
+        if ( !connectionPools.hasLocalData() ) {
+            connectionPools.setLocalData( new ConnectionPool );
         }
+        DatabaseConnection *const connection = connectionPools.localData()->connection( m_databaseFile );
+        if ( connection->open() ) {
+            m_result = OsmDatabase::find( *connection, m_userQuery );
+        }
+        m_finished.release();
+    }
+
+    const QVector<OsmPlacemark> &result() const
+    {
+        return m_result;
+    }
 
-        mDebug() << Q_FUNC_INFO << "query in" << databaseFile << "with query" << queryString
-                 << "took" << queryTimer.elapsed() << "ms for" << resultCount << "results";
+private:
+    const QString m_databaseFile;
+    const DatabaseQuery &m_userQuery;
+    QSemaphore &m_finished;
+    QVector<OsmPlacemark> m_result;
+};
+
+OsmDatabase::OsmDatabase( const QStringList &databaseFiles ) :
+    m_databaseFiles( databaseFiles )
+{
+}
+
+QVector<OsmPlacemark> OsmDatabase::find( const DatabaseQuery &userQuery )
+{
+    if ( m_databaseFiles.isEmpty() ) {
+        return QVector<OsmPlacemark>();
+    }
+
+    QTime timer;
+    timer.start();
+
+    // the files are searched in parallel, each on a thread keeping its connections open
+    QSemaphore finished;
+    QVector<FileSearch *> searches;
+    foreach( const QString &databaseFile, m_databaseFiles ) {
+        FileSearch *const search = new FileSearch( databaseFile, userQuery, finished );
+        searches << search;
+        queryThreadPool()->start( search );
+    }
+    finished.acquire( searches.size() );
+
+    QVector<OsmPlacemark> result;
+    foreach( const FileSearch *search, searches ) {
+        result << search->result();
     }
+    qDeleteAll( searches );
 
     mDebug() << "Offline OSM search query took" << timer.elapsed() << "ms for" << result.count() << "results.";
 
@@ -208,13 +310,195 @@ QVector<OsmPlacemark> OsmDatabase::find( const DatabaseQuery &userQuery )
         qSort( result.begin(), result.end(), placemarkHigherScore );
     }
 
-    if ( result.size() > 50 ) {
-        result.remove( 50, result.size()-50 );
+    if ( result.size() > MaxResults ) {
+        result.remove( MaxResults, result.size() - MaxResults );
     }
 
     return result;
 }
 
+QVector<OsmPlacemark> OsmDatabase::find( DatabaseConnection &connection, const DatabaseQuery &userQuery )
+{
+    QStringList conditions;
+    QVariantList bindValues;
+    conditions << "regions.id = placemarks.regionId" << "names.id = placemarks.nameId";
+
+    const QString regionPattern = QLatin1Char( '%' ) + userQuery.region() + QLatin1Char( '%' );
+    if ( !userQuery.region().isEmpty() ) {
+        QTime regionTimer;
+        regionTimer.start();
+        QSqlQuery *const regionsQuery = connection.query( "SELECT 1 FROM regions WHERE name LIKE ? LIMIT 1" );
+        if ( !regionsQuery ) {
+            return QVector<OsmPlacemark>();
+        }
+        regionsQuery->bindValue( 0, regionPattern );
+        if ( !regionsQuery->exec() ) {
+            qWarning() << regionsQuery->lastError() << "in" << connection.databaseFile() << "with query" << regionsQuery->lastQuery();
+        }
+        const bool hasRegion = regionsQuery->next();
+        regionsQuery->finish();
+
+        mDebug() << Q_FUNC_INFO << "region query in" << connection.databaseFile() << "for" << userQuery.region()
+                 << "took" << regionTimer.elapsed() << "ms";
+
+        if ( !hasRegion ) {
+            return QVector<OsmPlacemark>();
+        }
+    }
+
+    // Nested set model to support region hierarchies, see http://en.wikipedia.org/wiki/Nested_set_model
+    const QString regionRestriction = "placemarks.regionId IN ("
+            " SELECT child.id FROM regions AS parent, regions AS child"
+            " WHERE parent.name LIKE ? AND child.lft BETWEEN parent.lft AND parent.rgt)";
+
+    if ( userQuery.queryType() == DatabaseQuery::CategorySearch ) {
+        if( userQuery.category() == OsmPlacemark::UnknownCategory ) {
+            // search for all pois which are not street nor address
+            conditions << "placemarks.category <> 0 AND placemarks.category <> 6";
+        } else {
+            // search for specific category
+            conditions << "placemarks.category = ?";
+            bindValues << (qint32) userQuery.category();
+        }
+        if ( userQuery.position().isValid() && userQuery.region().isEmpty() ) {
+            return findNearest( connection, conditions, bindValues, userQuery );
+        } else if ( !userQuery.region().isEmpty() ) {
+            conditions << regionRestriction;
+            bindValues << regionPattern;
+        }
+    } else if ( userQuery.queryType() == DatabaseQuery::BroadSearch ) {
+        addNameCondition( connection, userQuery.searchTerm(), conditions, bindValues );
+    } else {
+        addNameCondition( connection, userQuery.street(), conditions, bindValues );
+        if ( !userQuery.houseNumber().isEmpty() ) {
+            addCondition( "placemarks.number", userQuery.houseNumber(), conditions, bindValues );
+        } else {
+            conditions << "placemarks.number IS NULL";
+        }
+        if ( !userQuery.region().isEmpty() ) {
+            conditions << regionRestriction;
+            bindValues << regionPattern;
+        }
+    }
+
+    const QString queryString = QLatin1String( "SELECT regions.name,"
+            " names.name, placemarks.number,"
+            " placemarks.category, placemarks.lon, placemarks.lat"
+            " FROM placemarks, names, regions"
+            " WHERE " ) + conditions.join( " AND " ) + QString( " LIMIT %1" ).arg( MaxResults );
+
+    QVector<OsmPlacemark> result;
+    exec( connection, queryString, bindValues, userQuery, result );
+    return result;
+}
+
+QVector<OsmPlacemark> OsmDatabase::findNearest( DatabaseConnection &connection, const QStringList &conditions,
+                                                const QVariantList &bindValues, const DatabaseQuery &userQuery )
+{
+    const qreal longitude = userQuery.position().longitude( GeoDataCoordinates::Degree );
+    const qreal latitude = userQuery.position().latitude( GeoDataCoordinates::Degree );
+    // longitudes are scaled to the length of the position's parallel
+    const qreal scale = qMax<qreal>( cos( latitude * DEG2RAD ), 0.01 );
+
+    QString queryString = QLatin1String( "SELECT regions.name,"
+            " names.name, placemarks.number,"
+            " placemarks.category, placemarks.lon, placemarks.lat,"
+            " (placemarks.lat-?)*(placemarks.lat-?)+(placemarks.lon-?)*(placemarks.lon-?)*? AS distance" );
+
+    if ( !connection.hasAreaIndex() ) {
+        // sort all matches by distance
+        queryString += QLatin1String( " FROM placemarks, names, regions WHERE " ) + conditions.join( " AND " )
+                + QString( " ORDER BY distance LIMIT %1" ).arg( MaxResults );
+        QVector<OsmPlacemark> result;
+        exec( connection, queryString, QVariantList() << latitude << latitude << longitude << longitude << scale * scale << bindValues,
+              userQuery, result );
+        return result;
+    }
+
+    // The search box around the position grows until it holds enough matches.
+    // Any nearer ones lie within the distance of the farthest of those, which
+    // is searched once more if it reaches beyond the box. Boxes are not wrapped
+    // around the date line.
+    queryString += QLatin1String( " FROM placemarksArea, placemarks, names, regions WHERE " ) + conditions.join( " AND " )
+            + QString( " AND placemarksArea.id = placemarks.id"
+                       " AND placemarksArea.minLon <= ? AND placemarksArea.maxLon >= ?"
+                       " AND placemarksArea.minLat <= ? AND placemarksArea.maxLat >= ?"
+                       " ORDER BY distance LIMIT %1" ).arg( MaxResults );
+
+    qreal radius = 0.05;
+    forever {
+        QVariantList values;
+        values << latitude << latitude << longitude << longitude << scale * scale << bindValues;
+        values << qMin<qreal>( longitude + radius / scale, 180.0 ) << qMax<qreal>( longitude - radius / scale, -180.0 );
+        values << qMin<qreal>( latitude + radius, 90.0 ) << qMax<qreal>( latitude - radius, -90.0 );
+
+        QVector<OsmPlacemark> result;
+        qreal lastDistance = 0.0;
+        if ( !exec( connection, queryString, values, userQuery, result, &lastDistance ) ) {
+            return result;
+        }
+
+        if ( result.size() == MaxResults ) {
+            lastDistance = sqrt( lastDistance );
+            if ( lastDistance <= radius ) {
+                return result;
+            }
+            radius = lastDistance;
+        } else if ( radius >= 180.0 ) {
+            return result;
+        } else {
+            radius *= 4;
+        }
+    }
+}
+
+bool OsmDatabase::exec( DatabaseConnection &connection, const QString &queryString, const QVariantList &bindValues,
+                        const DatabaseQuery &userQuery, QVector<OsmPlacemark> &result, qreal *lastDistance )
+{
+    QSqlQuery *const query = connection.query( queryString );
+    if ( !query ) {
+        return false;
+    }
+    for ( int i = 0; i < bindValues.size(); ++i ) {
+        query->bindValue( i, bindValues.at( i ) );
+    }
+
+    QTime queryTimer;
+    queryTimer.start();
+    if ( !query->exec() ) {
+        qWarning() << query->lastError() << "in" << connection.databaseFile() << "with query" << queryString;
+        return false;
+    }
+
+    int resultCount = 0;
+    while ( query->next() ) {
+        OsmPlacemark placemark;
+        if ( userQuery.resultFormat() == DatabaseQuery::DistanceFormat ) {
+            GeoDataCoordinates coordinates( query->value(4).toFloat(), query->value(5).toFloat(), 0.0, GeoDataCoordinates::Degree );
+            placemark.setAdditionalInformation( formatDistance( coordinates, userQuery.position() ) );
+        } else {
+            placemark.setAdditionalInformation( query->value( 0 ).toString() );
+        }
+        placemark.setName( query->value(1).toString() );
+        placemark.setHouseNumber( query->value(2).toString() );
+        placemark.setCategory( (OsmPlacemark::OsmCategory) query->value(3).toInt() );
+        placemark.setLongitude( query->value(4).toFloat() );
+        placemark.setLatitude( query->value(5).toFloat() );
+        if ( lastDistance ) {
+            *lastDistance = query->value( 6 ).toReal();
+        }
+
+        result.push_back( placemark );
+        resultCount++;
+    }
+    query->finish();
+
+    mDebug() << Q_FUNC_INFO << "query in" << connection.databaseFile() << "with query" << queryString
+             << "took" << queryTimer.elapsed() << "ms for" << resultCount << "results";
+
+    return true;
+}
+
 void OsmDatabase::makeUnique( QVector<OsmPlacemark> &placemarks )
 {
     for ( int i=1; i<placemarks.size(); ++i ) {
@@ -293,14 +577,50 @@ qreal OsmDatabase::bearing( const GeoDataCoordinates &a, const GeoDataCoordinate
                        cos( lat1 ) * sin( lat2 ) - sin( lat1 ) * cos( lat2 ) * cos ( delta ) ), 2 * M_PI );
 }
 
-QString OsmDatabase::wildcardQuery( const QString &term )
+void OsmDatabase::addNameCondition( const DatabaseConnection &connection, const QString &term,
+                                    QStringList &conditions, QVariantList &bindValues )
+{
+    addCondition( "names.name", term, conditions, bindValues );
+    if ( connection.hasSearchIndex() && term.contains( QLatin1Char( '*' ) ) ) {
+        // the index narrows down the names to check against the pattern
+        const QString match = matchQuery( term );
+        if ( !match.isEmpty() ) {
+            conditions << "names.id IN (SELECT docid FROM namesSearch WHERE namesSearch MATCH ?)";
+            bindValues << match;
+        }
+    }
+}
+
+void OsmDatabase::addCondition( const QString &column, const QString &term,
+                                QStringList &conditions, QVariantList &bindValues )
 {
-    QString result = term;
-    if (term.contains(QLatin1Char('*'))) {
-        return QLatin1String(" LIKE '") + result.replace(QLatin1Char('*'), QLatin1Char('%')) + QLatin1Char('\'');
+    QString value = term;
+    if ( term.contains( QLatin1Char( '*' ) ) ) {
+        conditions << column + QLatin1String( " LIKE ?" );
+        bindValues << value.replace( QLatin1Char( '*' ), QLatin1Char( '%' ) );
     } else {
-        return QLatin1String(" = '") + result + QLatin1Char('\'');
+        conditions << column + QLatin1String( " = ?" );
+        bindValues << value;
+    }
+}
+
+QString OsmDatabase::matchQuery( const QString &term )
+{
+    // Words followed by a wildcard are prefixes. Words following one can end
+    // a longer word the index knows nothing about, so they are left out.
+    QStringList words;
+    int start = 0;
+    for ( int i = 0; i <= term.size(); ++i ) {
+        if ( i < term.size() && term.at( i ).isLetterOrNumber() ) {
+            continue;
+        }
+        if ( i > start && ( start == 0 || term.at( start - 1 ) != QLatin1Char( '*' ) ) ) {
+            const bool isPrefix = i < term.size() && term.at( i ) == QLatin1Char( '*' );
+            words << term.mid( start, i - start ).toLower() + ( isPrefix ? QLatin1String( "*" ) : QLatin1String( "" ) );
+        }
+        start = i + 1;
     }
+    return words.join( QLatin1Char( ' ' ) );
 }
 
 }
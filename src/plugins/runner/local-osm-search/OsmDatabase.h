@@ -16,12 +16,24 @@
 
 #include <QString>
 #include <QStringList>
+#include <QVariant>
+#include <QVector>
 
 namespace Marble {
 
 class DatabaseQuery;
+class DatabaseConnection;
 class GeoDataCoordinates;
 
+/**
+  * Searches the address databases written by the osm-addresses tool.
+  *
+  * The database files are queried in parallel. Each query thread keeps its
+  * connections and prepared statements open across searches. Databases with a
+  * full text index on names and an R*Tree on coordinates use them for prefix
+  * matching and for finding the placemarks nearest to a position, older ones
+  * are still searched the slow way.
+  */
 class OsmDatabase
 {
 public:
@@ -33,7 +45,29 @@ public:
     QVector<OsmPlacemark> find( const DatabaseQuery &userQuery );
 
 private:
-    static QString wildcardQuery( const QString &term );
+    class FileSearch;
+
+    /** Searches a single database file */
+    static QVector<OsmPlacemark> find( DatabaseConnection &connection, const DatabaseQuery &userQuery );
+
+    /** Searches the placemarks matching @p conditions which are nearest to the user's position */
+    static QVector<OsmPlacemark> findNearest( DatabaseConnection &connection, const QStringList &conditions,
+                                              const QVariantList &bindValues, const DatabaseQuery &userQuery );
+
+    /**
+      * Executes the prepared @p queryString and appends its placemarks to @p result.
+      * If @p lastDistance is set, it receives the distance column of the last row.
+      */
+    static bool exec( DatabaseConnection &connection, const QString &queryString, const QVariantList &bindValues,
+                      const DatabaseQuery &userQuery, QVector<OsmPlacemark> &result, qreal *lastDistance = 0 );
+
+    static void addNameCondition( const DatabaseConnection &connection, const QString &term,
+                                  QStringList &conditions, QVariantList &bindValues );
+
+    static void addCondition( const QString &column, const QString &term,
+                              QStringList &conditions, QVariantList &bindValues );
+
+    static QString matchQuery( const QString &term );
 
     static void makeUnique( QVector<OsmPlacemark> &placemarks );
 
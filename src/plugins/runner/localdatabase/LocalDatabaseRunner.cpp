@@ -12,17 +12,12 @@
 #include "LocalDatabaseRunner.h"
 
 #include "MarbleModel.h"
-#include "MarblePlacemarkModel.h"
-#include "GeoDataFeature.h"
+#include "PlacemarkNameIndex.h"
 #include "GeoDataPlacemark.h"
-#include "GeoDataCoordinates.h"
 
-#include "MarbleDebug.h"
 #include <QString>
 #include <QVector>
 
-#include <QtDebug>
-
 namespace Marble
 {
 
@@ -41,28 +36,8 @@ void LocalDatabaseRunner::search( const QString &searchTerm, const GeoDataLatLon
     QVector<GeoDataPlacemark*> vector;
 
     if (model()) {
-        const QAbstractItemModel * placemarkModel = model()->placemarkModel();
-
-        if (placemarkModel) {
-            QModelIndexList resultList;
-            QModelIndex firstIndex = placemarkModel->index( 0, 0 );
-            resultList = placemarkModel->match( firstIndex,
-                                    Qt::DisplayRole, searchTerm, -1,
-                                    Qt::MatchStartsWith );
-
-            bool const searchEverywhere = preferred.isEmpty();
-            foreach ( const QModelIndex& index, resultList ) {
-                if( !index.isValid() ) {
-                    mDebug() << "invalid index!!!";
-                    continue;
-                }
-                GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>( index.data( MarblePlacemarkModel::ObjectPointerRole )));
-                if ( placemark &&
-                     ( searchEverywhere || preferred.contains( placemark->coordinate() ) ) ) {
-                    vector.append( new GeoDataPlacemark( *placemark ));
-                }
-            }
-        }
+        // copies of the most popular and nearest matches, the name index ranks them
+        vector = model()->placemarkNameIndex()->find( searchTerm, preferred, 50 );
     }
 
     emit searchFinished( vector );
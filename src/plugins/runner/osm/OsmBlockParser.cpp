@@ -0,0 +1,60 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "OsmBlockParser.h"
+
+namespace Marble {
+
+OsmBlockParser::OsmBlockParser()
+{
+    setAutoDelete(false);
+}
+
+void OsmBlockParser::run()
+{
+    parse();
+    m_finished.release();
+}
+
+void OsmBlockParser::waitForFinished()
+{
+    m_finished.acquire();
+}
+
+bool OsmBlockParser::hasError() const
+{
+    return !m_error.isEmpty();
+}
+
+QString OsmBlockParser::errorString() const
+{
+    return m_error;
+}
+
+OsmNodes &OsmBlockParser::nodes()
+{
+    return m_nodes;
+}
+
+OsmWays &OsmBlockParser::ways()
+{
+    return m_ways;
+}
+
+OsmRelations &OsmBlockParser::relations()
+{
+    return m_relations;
+}
+
+bool OsmBlockParser::setError(const QString &error)
+{
+    m_error = error;
+    return false;
+}
+
+}
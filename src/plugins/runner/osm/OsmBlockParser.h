@@ -0,0 +1,62 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_OSMBLOCKPARSER
+#define MARBLE_OSMBLOCKPARSER
+
+#include "OsmNode.h"
+#include "OsmWay.h"
+#include "OsmRelation.h"
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QString>
+
+namespace Marble {
+
+/**
+ * A part of an OSM file parsed on a thread of its own.
+ *
+ * Blocks are parsed independently of each other and merged in file order
+ * by the OsmParser afterwards.
+ */
+class OsmBlockParser : public QRunnable
+{
+public:
+    OsmBlockParser();
+
+    void run() override;
+
+    /** Blocks until run() has finished */
+    void waitForFinished();
+
+    bool hasError() const;
+    QString errorString() const;
+
+    OsmNodes & nodes();
+    OsmWays & ways();
+    OsmRelations & relations();
+
+protected:
+    /** Parses the block, returns false and sets an error on failure */
+    virtual bool parse() = 0;
+
+    bool setError(const QString &error);
+
+    OsmNodes m_nodes;
+    OsmWays m_ways;
+    OsmRelations m_relations;
+
+private:
+    QSemaphore m_finished;
+    QString m_error;
+};
+
+}
+
+#endif
@@ -19,18 +19,48 @@
 
 #include <QXmlStreamAttributes>
 
+#include <algorithm>
+
 namespace Marble {
 
+namespace {
+
+bool lessId(const OsmNode &node, qint64 id)
+{
+    return node.osmData().id() < id;
+}
+
+bool lessNode(const OsmNode &node, const OsmNode &other)
+{
+    return node.osmData().id() < other.osmData().id();
+}
+
+}
+
+OsmNode::OsmNode() :
+    m_lon(0.0),
+    m_lat(0.0)
+{
+    // nothing to do
+}
+
 void OsmNode::parseCoordinates(const QXmlStreamAttributes &attributes)
 {
     qreal const lon = attributes.value(QLatin1String("lon")).toDouble();
     qreal const lat = attributes.value(QLatin1String("lat")).toDouble();
-    setCoordinates(GeoDataCoordinates(lon, lat, 0, GeoDataCoordinates::Degree));
+    setCoordinates(lon, lat);
 }
 
 void OsmNode::setCoordinates(const GeoDataCoordinates &coordinates)
 {
-    m_coordinates = coordinates;
+    m_lon = coordinates.longitude(GeoDataCoordinates::Degree);
+    m_lat = coordinates.latitude(GeoDataCoordinates::Degree);
+}
+
+void OsmNode::setCoordinates(qreal lon, qreal lat)
+{
+    m_lon = lon;
+    m_lat = lat;
 }
 
 void OsmNode::create(GeoDataDocument *document) const
@@ -43,7 +73,7 @@ void OsmNode::create(GeoDataDocument *document) const
 
     GeoDataPlacemark* placemark = new GeoDataPlacemark;
     placemark->setOsmData(m_osmData);
-    placemark->setCoordinate(m_coordinates);
+    placemark->setCoordinate(coordinates());
 
     if ((category == GeoDataFeature::TransportCarShare || category == GeoDataFeature::MoneyAtm)
             && m_osmData.containsTagKey(QStringLiteral("operator"))) {
@@ -96,9 +126,9 @@ int OsmNode::populationIndex(qint64 population) const
     return popidx;
 }
 
-const GeoDataCoordinates &OsmNode::coordinates() const
+GeoDataCoordinates OsmNode::coordinates() const
 {
-    return m_coordinates;
+    return GeoDataCoordinates(m_lon, m_lat, 0, GeoDataCoordinates::Degree);
 }
 
 OsmPlacemarkData &OsmNode::osmData()
@@ -111,4 +141,84 @@ const OsmPlacemarkData &OsmNode::osmData() const
     return m_osmData;
 }
 
+OsmNodes::OsmNodes() :
+    m_sorted(true)
+{
+    // nothing to do
+}
+
+OsmNode &OsmNodes::append(qint64 id)
+{
+    m_sorted = m_sorted && (m_nodes.isEmpty() || m_nodes.last().osmData().id() < id);
+    m_nodes.append(OsmNode());
+    OsmNode &node = m_nodes.last();
+    node.osmData().setId(id);
+    return node;
+}
+
+void OsmNodes::append(const OsmNodes &other)
+{
+    if (other.m_nodes.isEmpty()) {
+        return;
+    }
+
+    m_sorted = m_sorted && other.m_sorted &&
+            (m_nodes.isEmpty() || lessNode(m_nodes.last(), other.m_nodes.first()));
+    m_nodes += other.m_nodes;
+}
+
+void OsmNodes::sort()
+{
+    if (m_sorted) {
+        return;
+    }
+
+    std::stable_sort(m_nodes.begin(), m_nodes.end(), lessNode);
+
+    // keep the last node of each id like repeated insertions into a hash do
+    int count = 0;
+    for (int i = 0; i < m_nodes.size(); ++i) {
+        if (count > 0 && m_nodes[count-1].osmData().id() == m_nodes[i].osmData().id()) {
+            m_nodes[count-1] = m_nodes[i];
+        } else {
+            if (count != i) {
+                m_nodes[count] = m_nodes[i];
+            }
+            ++count;
+        }
+    }
+    m_nodes.resize(count);
+    m_sorted = true;
+}
+
+const OsmNode *OsmNodes::find(qint64 id) const
+{
+    Q_ASSERT(m_sorted);
+    auto const iter = std::lower_bound(m_nodes.constBegin(), m_nodes.constEnd(), id, lessId);
+    if (iter == m_nodes.constEnd() || iter->osmData().id() != id) {
+        return nullptr;
+    }
+    return iter;
+}
+
+int OsmNodes::size() const
+{
+    return m_nodes.size();
+}
+
+void OsmNodes::reserve(int size)
+{
+    m_nodes.reserve(size);
+}
+
+OsmNodes::const_iterator OsmNodes::begin() const
+{
+    return m_nodes.constBegin();
+}
+
+OsmNodes::const_iterator OsmNodes::end() const
+{
+    return m_nodes.constEnd();
+}
+
 }
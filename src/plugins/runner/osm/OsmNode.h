@@ -15,6 +15,7 @@
 #include <GeoDataDocument.h>
 
 #include <QString>
+#include <QVector>
 
 class QXmlStreamAttributes;
 
@@ -22,11 +23,15 @@ namespace Marble {
 
 class OsmNode {
 public:
+    OsmNode();
+
     OsmPlacemarkData & osmData();
     void parseCoordinates(const QXmlStreamAttributes &attributes);
     void setCoordinates(const GeoDataCoordinates &coordinates);
+    /** Sets the coordinates given in degrees */
+    void setCoordinates(qreal lon, qreal lat);
 
-    const GeoDataCoordinates & coordinates() const;
+    GeoDataCoordinates coordinates() const;
     const OsmPlacemarkData & osmData() const;
 
     void create(GeoDataDocument* document) const;
@@ -35,10 +40,47 @@ private:
     int populationIndex(qint64 population) const;
 
     OsmPlacemarkData m_osmData;
-    GeoDataCoordinates m_coordinates;
+    // in degrees, much smaller than a GeoDataCoordinates with its private data
+    qreal m_lon;
+    qreal m_lat;
 };
 
-typedef QHash<qint64,OsmNode> OsmNodes;
+/**
+ * The nodes of a file ordered by their id.
+ *
+ * OSM files list their nodes sorted by id, so appending them usually keeps
+ * the order and nodes are found by a binary search in a dense array instead
+ * of a hash with an allocation per node.
+ */
+class OsmNodes
+{
+public:
+    typedef QVector<OsmNode>::const_iterator const_iterator;
+
+    OsmNodes();
+
+    /** Appends a node with the given id and returns it for filling in */
+    OsmNode & append(qint64 id);
+    void append(const OsmNodes &other);
+
+    /**
+     * Sorts the nodes by id if needed. Of several nodes with the same id only
+     * the last one is kept. Must be called before looking up nodes.
+     */
+    void sort();
+
+    /** Returns the node with the given id or a null pointer if there is none */
+    const OsmNode * find(qint64 id) const;
+
+    int size() const;
+    void reserve(int size);
+    const_iterator begin() const;
+    const_iterator end() const;
+
+private:
+    QVector<OsmNode> m_nodes;
+    bool m_sorted;
+};
 
 }
 
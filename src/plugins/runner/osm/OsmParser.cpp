@@ -19,13 +19,18 @@
 #include "GeoDataPoint.h"
 #include "GeoDataTypes.h"
 #include "GeoDataStyle.h"
+#include "MarbleDebug.h"
 #include <MarbleZipReader.h>
 #include "o5mreader.h"
+#include "OsmPbfBlockParser.h"
+#include "OsmXmlBlockParser.h"
 
 #include <QFile>
 #include <QFileInfo>
 #include <QBuffer>
 #include <QSet>
+#include <QThreadPool>
+#include <QXmlStreamReader>
 
 namespace Marble {
 
@@ -34,6 +39,8 @@ GeoDataDocument *OsmParser::parse(const QString &filename, QString &error)
     QFileInfo const fileInfo(filename);
     if (fileInfo.completeSuffix() == QLatin1String("o5m")) {
         return parseO5m(filename, error);
+    } else if (fileInfo.suffix() == QLatin1String("pbf")) {
+        return parsePbf(filename, error);
     } else {
         return parseXml(filename, error);
     }
@@ -45,7 +52,7 @@ GeoDataDocument* OsmParser::parseO5m(const QString &filename, QString &error)
     O5mreaderDataset data;
     O5mreaderIterateRet outerState, innerState;
     char *key, *value;
-    // share string data on the heap at least for this file
+    // share role strings on the heap at least for this file, tags are shared by OsmPlacemarkData
     QSet<QString> stringPool;
 
     OsmNodes nodes;
@@ -63,14 +70,10 @@ GeoDataDocument* OsmParser::parseO5m(const QString &filename, QString &error)
         switch (data.type) {
         case O5MREADER_DS_NODE:
         {
-            OsmNode& node = nodes[data.id];
-            node.osmData().setId(data.id);
-            node.setCoordinates(GeoDataCoordinates(data.lon*1.0e-7, data.lat*1.0e-7,
-                                                   0.0, GeoDataCoordinates::Degree));
+            OsmNode& node = nodes.append(data.id);
+            node.setCoordinates(data.lon*1.0e-7, data.lat*1.0e-7);
             while ((innerState = o5mreader_iterateTags(reader, &key, &value)) == O5MREADER_ITERATE_RET_NEXT) {
-                const QString keyString = *stringPool.insert(QString::fromUtf8(key));
-                const QString valueString = *stringPool.insert(QString::fromUtf8(value));
-                node.osmData().addTag(keyString, valueString);
+                node.osmData().addTag(QString::fromUtf8(key), QString::fromUtf8(value));
             }
         }
             break;
@@ -83,9 +86,7 @@ GeoDataDocument* OsmParser::parseO5m(const QString &filename, QString &error)
                 way.addReference(nodeId);
             }
             while ((innerState = o5mreader_iterateTags(reader, &key, &value)) == O5MREADER_ITERATE_RET_NEXT) {
-                const QString keyString = *stringPool.insert(QString::fromUtf8(key));
-                const QString valueString = *stringPool.insert(QString::fromUtf8(value));
-                way.osmData().addTag(keyString, valueString);
+                way.osmData().addTag(QString::fromUtf8(key), QString::fromUtf8(value));
             }
         }
             break;
@@ -101,9 +102,7 @@ GeoDataDocument* OsmParser::parseO5m(const QString &filename, QString &error)
                 relation.addMember(refId, roleString, relationTypes[type]);
             }
             while ((innerState = o5mreader_iterateTags(reader, &key, &value)) == O5MREADER_ITERATE_RET_NEXT) {
-                const QString keyString = *stringPool.insert(QString::fromUtf8(key));
-                const QString valueString = *stringPool.insert(QString::fromUtf8(value));
-                relation.osmData().addTag(keyString, valueString);
+                relation.osmData().addTag(QString::fromUtf8(key), QString::fromUtf8(value));
             }
         }
             break;
@@ -118,9 +117,10 @@ GeoDataDocument* OsmParser::parseO5m(const QString &filename, QString &error)
 
 GeoDataDocument* OsmParser::parseXml(const QString &filename, QString &error)
 {
-    QXmlStreamReader parser;
     QFile file;
-    QBuffer buffer;
+    QByteArray data;
+    const char *begin = nullptr;
+    qint64 size = 0;
     QFileInfo fileInfo(filename);
     if (fileInfo.completeSuffix() == QLatin1String("osm.zip")) {
         MarbleZipReader zipReader(filename);
@@ -129,28 +129,167 @@ GeoDataDocument* OsmParser::parseXml(const QString &filename, QString &error)
             error = QStringLiteral("Unexpected number of files (%1) in %2").arg(fileNumber).arg(filename);
             return nullptr;
         }
-        QByteArray const data = zipReader.fileData(zipReader.fileInfoList().first().filePath);
-        buffer.setData(data);
-        buffer.open(QBuffer::ReadOnly);
-        parser.setDevice(&buffer);
+        data = zipReader.fileData(zipReader.fileInfoList().first().filePath);
+        begin = data.constData();
+        size = data.size();
     } else {
         file.setFileName(filename);
         if (!file.open(QFile::ReadOnly)) {
             error = QStringLiteral("Cannot open file %1").arg(filename);
             return nullptr;
         }
-        parser.setDevice(&file);
+        size = file.size();
+        begin = reinterpret_cast<const char *>(file.map(0, size));
+        if (!begin && size > 0) {
+            data = file.readAll();
+            begin = data.constData();
+            size = data.size();
+        }
+    }
+
+    OsmNodes nodes;
+    OsmWays ways;
+    OsmRelations relations;
+    if (!parseXmlBlocks(begin, size, nodes, ways, relations)) {
+        QByteArray const content = QByteArray::fromRawData(begin, size);
+        QBuffer buffer;
+        buffer.setData(content);
+        buffer.open(QBuffer::ReadOnly);
+        nodes = OsmNodes();
+        ways.clear();
+        relations.clear();
+        if (!parseXmlStream(&buffer, nodes, ways, relations, error)) {
+            return nullptr;
+        }
+    }
+
+    return createDocument(nodes, ways, relations);
+}
+
+bool OsmParser::parseXmlBlocks(const char *data, qint64 size, OsmNodes &nodes, OsmWays &ways, OsmRelations &relations)
+{
+    // Only UTF-8 is read in blocks, UTF-16 files start with a byte order mark.
+    if (size < 2 || uchar(data[0]) == 0xfe || uchar(data[0]) == 0xff) {
+        return false;
+    }
+
+    QVector<OsmBlockParser *> blocks;
+    const char *const end = data + size;
+    for (const char *position = data; position != end; ) {
+        const char *const blockEnd = OsmXmlBlockParser::blockEnd(position, end, BlockSize);
+        blocks << new OsmXmlBlockParser(position, blockEnd, position == data, blockEnd == end);
+        position = blockEnd;
     }
 
+    QString error;
+    if (!parseBlocks(blocks, nodes, ways, relations, error)) {
+        mDebug() << "Falling back to the XML stream reader:" << error;
+        return false;
+    }
+    return true;
+}
+
+GeoDataDocument *OsmParser::parsePbf(const QString &filename, QString &error)
+{
+    QFile file(filename);
+    if (!file.open(QFile::ReadOnly)) {
+        error = QStringLiteral("Cannot open file %1").arg(filename);
+        return nullptr;
+    }
+
+    QByteArray data;
+    qint64 size = file.size();
+    const char *begin = reinterpret_cast<const char *>(file.map(0, size));
+    if (!begin) {
+        data = file.readAll();
+        begin = data.constData();
+        size = data.size();
+    }
+
+    const char *const end = begin + size;
+    OsmPbfBlockParser::FileBlock fileBlock;
+    const char *position = OsmPbfBlockParser::nextFileBlock(begin, end, fileBlock);
+    if (!position || fileBlock.type != "OSMHeader") {
+        error = QStringLiteral("Not an OSM PBF file: %1").arg(filename);
+        return nullptr;
+    }
+    if (!OsmPbfBlockParser::checkHeader(fileBlock, error)) {
+        return nullptr;
+    }
+
+    QVector<OsmBlockParser *> blocks;
+    while (position != end) {
+        position = OsmPbfBlockParser::nextFileBlock(position, end, fileBlock);
+        if (!position) {
+            qDeleteAll(blocks);
+            error = QStringLiteral("Invalid file block in %1").arg(filename);
+            return nullptr;
+        }
+        // other types of blocks are skipped as the format demands
+        if (fileBlock.type == "OSMData") {
+            blocks << new OsmPbfBlockParser(fileBlock.begin, fileBlock.end);
+        }
+    }
+
+    OsmNodes nodes;
+    OsmWays ways;
+    OsmRelations relations;
+    if (!parseBlocks(blocks, nodes, ways, relations, error)) {
+        return nullptr;
+    }
+    return createDocument(nodes, ways, relations);
+}
+
+bool OsmParser::parseBlocks(QVector<OsmBlockParser *> blocks, OsmNodes &nodes, OsmWays &ways, OsmRelations &relations, QString &error)
+{
+    // Blocks are parsed in parallel and merged in file order as soon as they
+    // are done. Limiting the number of blocks in flight limits the memory
+    // used by parsed but unmerged blocks.
+    QThreadPool threadPool;
+    int const maxBlocks = 2 * threadPool.maxThreadCount();
+    int started = 0;
+    bool success = true;
+
+    for (int i = 0; i < blocks.size() && success; ++i) {
+        for (; started < blocks.size() && started < i + maxBlocks; ++started) {
+            threadPool.start(blocks[started]);
+        }
+
+        OsmBlockParser *const block = blocks[i];
+        block->waitForFinished();
+        if (block->hasError()) {
+            error = block->errorString();
+            success = false;
+            break;
+        }
+
+        nodes.append(block->nodes());
+        OsmWays const &blockWays = block->ways();
+        for (auto iter = blockWays.constBegin(); iter != blockWays.constEnd(); ++iter) {
+            ways.insert(iter.key(), iter.value());
+        }
+        OsmRelations const &blockRelations = block->relations();
+        for (auto iter = blockRelations.constBegin(); iter != blockRelations.constEnd(); ++iter) {
+            relations.insert(iter.key(), iter.value());
+        }
+
+        // free the merged block early
+        delete block;
+        blocks[i] = nullptr;
+    }
+
+    threadPool.waitForDone();
+    qDeleteAll(blocks);
+    return success;
+}
+
+bool OsmParser::parseXmlStream(QIODevice *device, OsmNodes &nodes, OsmWays &ways, OsmRelations &relations, QString &error)
+{
+    QXmlStreamReader parser(device);
+
     OsmPlacemarkData* osmData(0);
     QString parentTag;
     qint64 parentId(0);
-    // share string data on the heap at least for this file
-    QSet<QString> stringPool;
-
-    OsmNodes m_nodes;
-    OsmWays m_ways;
-    OsmRelations m_relations;
 
     while (!parser.atEnd()) {
         parser.readNext();
@@ -164,35 +303,35 @@ GeoDataDocument* OsmParser::parseXml(const QString &filename, QString &error)
             parentId = parser.attributes().value(QLatin1String("id")).toLongLong();
 
             if (tagName == osm::osmTag_node) {
-                m_nodes[parentId].osmData() = OsmPlacemarkData::fromParserAttributes(parser.attributes());
-                m_nodes[parentId].parseCoordinates(parser.attributes());
-                osmData = &m_nodes[parentId].osmData();
+                OsmNode &node = nodes.append(parentId);
+                node.osmData() = OsmPlacemarkData::fromParserAttributes(parser.attributes());
+                node.parseCoordinates(parser.attributes());
+                osmData = &node.osmData();
             } else if (tagName == osm::osmTag_way) {
-                m_ways[parentId].osmData() = OsmPlacemarkData::fromParserAttributes(parser.attributes());
-                osmData = &m_ways[parentId].osmData();
+                ways[parentId].osmData() = OsmPlacemarkData::fromParserAttributes(parser.attributes());
+                osmData = &ways[parentId].osmData();
             } else {
                 Q_ASSERT(tagName == osm::osmTag_relation);
-                m_relations[parentId].osmData() = OsmPlacemarkData::fromParserAttributes(parser.attributes());
-                osmData = &m_relations[parentId].osmData();
+                relations[parentId].osmData() = OsmPlacemarkData::fromParserAttributes(parser.attributes());
+                osmData = &relations[parentId].osmData();
             }
         } else if (tagName == osm::osmTag_tag) {
             const QXmlStreamAttributes &attributes = parser.attributes();
-            const QString keyString = *stringPool.insert(attributes.value(QLatin1String("k")).toString());
-            const QString valueString = *stringPool.insert(attributes.value(QLatin1String("v")).toString());
-            osmData->addTag(keyString, valueString);
+            osmData->addTag(attributes.value(QLatin1String("k")).toString(),
+                            attributes.value(QLatin1String("v")).toString());
         } else if (tagName == osm::osmTag_nd && parentTag == osm::osmTag_way) {
-            m_ways[parentId].addReference(parser.attributes().value(QLatin1String("ref")).toLongLong());
+            ways[parentId].addReference(parser.attributes().value(QLatin1String("ref")).toLongLong());
         } else if (tagName == osm::osmTag_member && parentTag == osm::osmTag_relation) {
-            m_relations[parentId].parseMember(parser.attributes());
+            relations[parentId].parseMember(parser.attributes());
         } // other tags like osm, bounds ignored
     }
 
     if (parser.hasError()) {
         error = parser.errorString();
-        return nullptr;
+        return false;
     }
 
-    return createDocument(m_nodes, m_ways, m_relations);
+    return true;
 }
 
 GeoDataDocument *OsmParser::createDocument(OsmNodes &nodes, OsmWays &ways, OsmRelations &relations)
@@ -207,6 +346,8 @@ GeoDataDocument *OsmParser::createDocument(OsmNodes &nodes, OsmWays &ways, OsmRe
     backgroundStyle->setId(QStringLiteral("background"));
     document->addStyle( backgroundStyle );
 
+    nodes.sort();
+
     QSet<qint64> usedNodes, usedWays;
     foreach(OsmRelation const &relation, relations) {
         relation.create(document, ways, nodes, usedNodes, usedWays);
@@ -219,16 +360,13 @@ GeoDataDocument *OsmParser::createDocument(OsmNodes &nodes, OsmWays &ways, OsmRe
         way.create(document, nodes, usedNodes);
     }
 
-    foreach(qint64 id, usedNodes) {
-        if (nodes[id].osmData().isEmpty()) {
-            nodes.remove(id);
+    for (OsmNode const &node: nodes) {
+        // nodes without tags were only needed for the geometry of ways
+        if (!node.osmData().isEmpty() || !usedNodes.contains(node.osmData().id())) {
+            node.create(document);
         }
     }
 
-    foreach(OsmNode const &node, nodes) {
-        node.create(document);
-    }
-
     return document;
 }
 
@@ -19,10 +19,14 @@
 #include "OsmRelation.h"
 
 #include <QString>
+#include <QVector>
+
+class QIODevice;
 
 namespace Marble {
 
 class GeoDataDocument;
+class OsmBlockParser;
 
 class OsmParser
 {
@@ -30,8 +34,19 @@ public:
     static GeoDataDocument* parse(const QString &filename, QString &error);
 
 private:
+    enum {
+        // bytes of XML parsed by a thread at once
+        BlockSize = 4 << 20
+    };
+
     static GeoDataDocument* parseXml(const QString &filename, QString &error);
     static GeoDataDocument* parseO5m(const QString &filename, QString &error);
+    static GeoDataDocument* parsePbf(const QString &filename, QString &error);
+    static bool parseXmlBlocks(const char *data, qint64 size, OsmNodes &nodes, OsmWays &ways, OsmRelations &relations);
+    static bool parseXmlStream(QIODevice *device, OsmNodes &nodes, OsmWays &ways, OsmRelations &relations, QString &error);
+
+    /** Parses the blocks of a file in parallel and merges them, takes ownership of the blocks */
+    static bool parseBlocks(QVector<OsmBlockParser *> blocks, OsmNodes &nodes, OsmWays &ways, OsmRelations &relations, QString &error);
     static GeoDataDocument *createDocument(OsmNodes &nodes, OsmWays &way, OsmRelations &relations);
 };
 
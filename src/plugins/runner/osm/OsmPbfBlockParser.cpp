@@ -0,0 +1,503 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "OsmPbfBlockParser.h"
+#include "OsmElementDictionary.h"
+
+#include <QtEndian>
+
+namespace Marble {
+
+/**
+ * Reads the fields of a protocol buffer message one after another.
+ */
+class PbfMessage
+{
+public:
+    PbfMessage() :
+        PbfMessage(nullptr, nullptr)
+    {
+    }
+
+    PbfMessage(const char *begin, const char *end) :
+        m_position(reinterpret_cast<const uchar *>(begin)),
+        m_end(reinterpret_cast<const uchar *>(end)),
+        m_field(0),
+        m_wireType(0),
+        m_error(false)
+    {
+    }
+
+    /** Moves on to the next field, returns false at the end or on errors */
+    bool next()
+    {
+        if (atEnd()) {
+            return false;
+        }
+        quint64 const key = varint();
+        m_field = key >> 3;
+        m_wireType = key & 0x7;
+        return !m_error;
+    }
+
+    int field() const
+    {
+        return m_field;
+    }
+
+    bool atEnd() const
+    {
+        return m_position == m_end || m_error;
+    }
+
+    bool hasError() const
+    {
+        return m_error;
+    }
+
+    quint64 varint()
+    {
+        quint64 result = 0;
+        for (int shift = 0; shift < 64 && m_position != m_end; shift += 7) {
+            uchar const byte = *m_position++;
+            result |= quint64(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return result;
+            }
+        }
+        m_error = true;
+        return 0;
+    }
+
+    static qint64 zigzag(quint64 value)
+    {
+        return qint64(value >> 1) ^ -qint64(value & 1);
+    }
+
+    /** Returns the content of a length delimited field */
+    PbfMessage bytes()
+    {
+        quint64 const size = varint();
+        if (m_error || size > quint64(m_end - m_position)) {
+            m_error = true;
+            return PbfMessage();
+        }
+        const char *const begin = reinterpret_cast<const char *>(m_position);
+        m_position += size;
+        return PbfMessage(begin, begin + size);
+    }
+
+    /** Appends the values of a repeated varint field, packed or not */
+    void appendVarints(QVector<quint64> &values)
+    {
+        if (m_wireType != 2) {
+            values.append(varint());
+            return;
+        }
+        PbfMessage packed = bytes();
+        while (!packed.atEnd()) {
+            values.append(packed.varint());
+        }
+        m_error = m_error || packed.hasError();
+    }
+
+    void skip()
+    {
+        switch (m_wireType) {
+        case 0: varint(); break;
+        case 1: advance(8); break;
+        case 2: bytes(); break;
+        case 5: advance(4); break;
+        default: m_error = true; break;
+        }
+    }
+
+    const char * data() const
+    {
+        return reinterpret_cast<const char *>(m_position);
+    }
+
+    int size() const
+    {
+        return m_end - m_position;
+    }
+
+    QByteArray toByteArray() const
+    {
+        return QByteArray(data(), size());
+    }
+
+private:
+    void advance(int size)
+    {
+        if (m_end - m_position < size) {
+            m_error = true;
+        } else {
+            m_position += size;
+        }
+    }
+
+    const uchar *m_position;
+    const uchar *m_end;
+    int m_field;
+    int m_wireType;
+    bool m_error;
+};
+
+OsmPbfBlockParser::OsmPbfBlockParser(const char *begin, const char *end) :
+    m_begin(begin),
+    m_end(end),
+    m_granularity(100),
+    m_latOffset(0),
+    m_lonOffset(0)
+{
+    // nothing to do
+}
+
+const char *OsmPbfBlockParser::nextFileBlock(const char *position, const char *end, FileBlock &block)
+{
+    if (end - position < 4) {
+        return nullptr;
+    }
+    quint32 const headerSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(position));
+    position += 4;
+    if (headerSize > quint64(end - position)) {
+        return nullptr;
+    }
+
+    PbfMessage header(position, position + headerSize);
+    qint64 dataSize = -1;
+    block.type.clear();
+    while (header.next()) {
+        switch (header.field()) {
+        case 1: block.type = header.bytes().toByteArray(); break;
+        case 3: dataSize = header.varint(); break;
+        default: header.skip(); break;
+        }
+    }
+    position += headerSize;
+
+    if (header.hasError() || dataSize < 0 || dataSize > end - position) {
+        return nullptr;
+    }
+    block.begin = position;
+    block.end = position + dataSize;
+    return block.end;
+}
+
+bool OsmPbfBlockParser::checkHeader(const FileBlock &block, QString &error)
+{
+    QByteArray data;
+    if (!uncompress(block.begin, block.end, data, error)) {
+        return false;
+    }
+
+    PbfMessage header(data.constData(), data.constData() + data.size());
+    while (header.next()) {
+        if (header.field() == 4) {
+            QByteArray const feature = header.bytes().toByteArray();
+            if (feature != "OsmSchema-V0.6" && feature != "DenseNodes") {
+                error = QStringLiteral("Unsupported feature %1").arg(QString::fromUtf8(feature));
+                return false;
+            }
+        } else {
+            header.skip();
+        }
+    }
+
+    if (header.hasError()) {
+        error = QStringLiteral("Invalid header block");
+        return false;
+    }
+    return true;
+}
+
+bool OsmPbfBlockParser::uncompress(const char *begin, const char *end, QByteArray &data, QString &error)
+{
+    PbfMessage blob(begin, end);
+    PbfMessage raw;
+    PbfMessage compressed;
+    bool hasRaw = false;
+    bool isCompressed = false;
+    quint64 rawSize = 0;
+    while (blob.next()) {
+        switch (blob.field()) {
+        case 1: raw = blob.bytes(); hasRaw = true; break;
+        case 2: rawSize = blob.varint(); break;
+        case 3: compressed = blob.bytes(); isCompressed = true; break;
+        case 4:
+            error = QStringLiteral("LZMA compressed blocks are not supported");
+            return false;
+        default: blob.skip(); break;
+        }
+    }
+
+    if (blob.hasError()) {
+        error = QStringLiteral("Invalid blob");
+        return false;
+    }
+
+    if (hasRaw) {
+        data = raw.toByteArray();
+        return true;
+    }
+
+    if (!isCompressed || rawSize == 0 || rawSize > 0x7fffffff) {
+        error = QStringLiteral("Blob contains no data");
+        return false;
+    }
+
+    // qUncompress expects zlib data preceded by the uncompressed size
+    QByteArray input;
+    input.reserve(4 + compressed.size());
+    input.resize(4);
+    qToBigEndian<quint32>(rawSize, reinterpret_cast<uchar *>(input.data()));
+    input.append(compressed.data(), compressed.size());
+    data = qUncompress(input);
+    if (quint64(data.size()) != rawSize) {
+        error = QStringLiteral("Failed to uncompress blob");
+        return false;
+    }
+    return true;
+}
+
+bool OsmPbfBlockParser::parse()
+{
+    QByteArray data;
+    QString error;
+    if (!uncompress(m_begin, m_end, data, error)) {
+        return setError(error);
+    }
+
+    PbfMessage block(data.constData(), data.constData() + data.size());
+    QVector<PbfMessage> groups;
+    while (block.next()) {
+        switch (block.field()) {
+        case 1:
+            if (!parseStringTable(block.bytes())) {
+                return setError(QStringLiteral("Invalid string table"));
+            }
+            break;
+        case 2: groups << block.bytes(); break;
+        case 17: m_granularity = block.varint(); break;
+        case 19: m_latOffset = block.varint(); break;
+        case 20: m_lonOffset = block.varint(); break;
+        default: block.skip(); break;
+        }
+    }
+
+    if (block.hasError()) {
+        return setError(QStringLiteral("Invalid primitive block"));
+    }
+
+    // the coordinate offsets and granularity follow the groups in the block
+    foreach (const PbfMessage &group, groups) {
+        if (!parseGroup(group)) {
+            return setError(QStringLiteral("Invalid primitive group"));
+        }
+    }
+    return true;
+}
+
+bool OsmPbfBlockParser::parseStringTable(PbfMessage message)
+{
+    while (message.next()) {
+        if (message.field() == 1) {
+            PbfMessage const string = message.bytes();
+            m_strings << QString::fromUtf8(string.data(), string.size());
+        } else {
+            message.skip();
+        }
+    }
+    return !message.hasError();
+}
+
+bool OsmPbfBlockParser::parseGroup(PbfMessage message)
+{
+    while (message.next()) {
+        bool success = true;
+        switch (message.field()) {
+        case 1: success = parseNode(message.bytes()); break;
+        case 2: success = parseDenseNodes(message.bytes()); break;
+        case 3: success = parseWay(message.bytes()); break;
+        case 4: success = parseRelation(message.bytes()); break;
+        default: message.skip(); break;
+        }
+        if (!success) {
+            return false;
+        }
+    }
+    return !message.hasError();
+}
+
+bool OsmPbfBlockParser::parseNode(PbfMessage message)
+{
+    qint64 id = 0;
+    qint64 lat = 0;
+    qint64 lon = 0;
+    m_keys.resize(0);
+    m_values.resize(0);
+    while (message.next()) {
+        switch (message.field()) {
+        case 1: id = PbfMessage::zigzag(message.varint()); break;
+        case 2: message.appendVarints(m_keys); break;
+        case 3: message.appendVarints(m_values); break;
+        case 8: lat = PbfMessage::zigzag(message.varint()); break;
+        case 9: lon = PbfMessage::zigzag(message.varint()); break;
+        default: message.skip(); break;
+        }
+    }
+    if (message.hasError()) {
+        return false;
+    }
+
+    OsmNode &node = m_nodes.append(id);
+    node.setCoordinates(toDegree(m_lonOffset, lon), toDegree(m_latOffset, lat));
+    return addTags(node.osmData());
+}
+
+bool OsmPbfBlockParser::parseDenseNodes(PbfMessage message)
+{
+    m_ids.resize(0);
+    m_lats.resize(0);
+    m_lons.resize(0);
+    // the tags of all nodes, each key value list terminated by a zero
+    QVector<quint64> &keysValues = m_keys;
+    keysValues.resize(0);
+    while (message.next()) {
+        switch (message.field()) {
+        case 1: message.appendVarints(m_ids); break;
+        case 8: message.appendVarints(m_lats); break;
+        case 9: message.appendVarints(m_lons); break;
+        case 10: message.appendVarints(keysValues); break;
+        default: message.skip(); break;
+        }
+    }
+    if (message.hasError() || m_lats.size() != m_ids.size() || m_lons.size() != m_ids.size()) {
+        return false;
+    }
+
+    m_nodes.reserve(m_nodes.size() + m_ids.size());
+    qint64 id = 0;
+    qint64 lat = 0;
+    qint64 lon = 0;
+    int tag = 0;
+    int const stringCount = m_strings.size();
+    for (int i = 0; i < m_ids.size(); ++i) {
+        id += PbfMessage::zigzag(m_ids[i]);
+        lat += PbfMessage::zigzag(m_lats[i]);
+        lon += PbfMessage::zigzag(m_lons[i]);
+        OsmNode &node = m_nodes.append(id);
+        node.setCoordinates(toDegree(m_lonOffset, lon), toDegree(m_latOffset, lat));
+
+        for (; tag < keysValues.size() && keysValues[tag] != 0; tag += 2) {
+            if (tag + 1 >= keysValues.size() || keysValues[tag] >= quint64(stringCount) || keysValues[tag+1] >= quint64(stringCount)) {
+                return false;
+            }
+            node.osmData().addTag(m_strings[keysValues[tag]], m_strings[keysValues[tag+1]]);
+        }
+        ++tag;
+    }
+    return true;
+}
+
+bool OsmPbfBlockParser::parseWay(PbfMessage message)
+{
+    qint64 id = 0;
+    m_keys.resize(0);
+    m_values.resize(0);
+    m_ids.resize(0);
+    while (message.next()) {
+        switch (message.field()) {
+        case 1: id = message.varint(); break;
+        case 2: message.appendVarints(m_keys); break;
+        case 3: message.appendVarints(m_values); break;
+        case 8: message.appendVarints(m_ids); break;
+        default: message.skip(); break;
+        }
+    }
+    if (message.hasError()) {
+        return false;
+    }
+
+    OsmWay &way = m_ways[id];
+    way = OsmWay();
+    way.osmData().setId(id);
+    qint64 reference = 0;
+    foreach (quint64 delta, m_ids) {
+        reference += PbfMessage::zigzag(delta);
+        way.addReference(reference);
+    }
+    return addTags(way.osmData());
+}
+
+bool OsmPbfBlockParser::parseRelation(PbfMessage message)
+{
+    static QString const memberTypes[] = {
+        QString::fromLatin1(osm::osmTag_node),
+        QString::fromLatin1(osm::osmTag_way),
+        QString::fromLatin1(osm::osmTag_relation)
+    };
+
+    qint64 id = 0;
+    m_keys.resize(0);
+    m_values.resize(0);
+    QVector<quint64> &roles = m_lats;
+    roles.resize(0);
+    m_ids.resize(0);
+    m_types.resize(0);
+    while (message.next()) {
+        switch (message.field()) {
+        case 1: id = message.varint(); break;
+        case 2: message.appendVarints(m_keys); break;
+        case 3: message.appendVarints(m_values); break;
+        case 8: message.appendVarints(roles); break;
+        case 9: message.appendVarints(m_ids); break;
+        case 10: message.appendVarints(m_types); break;
+        default: message.skip(); break;
+        }
+    }
+    if (message.hasError() || roles.size() != m_ids.size() || m_types.size() != m_ids.size()) {
+        return false;
+    }
+
+    OsmRelation &relation = m_relations[id];
+    relation = OsmRelation();
+    relation.osmData().setId(id);
+    qint64 reference = 0;
+    for (int i = 0; i < m_ids.size(); ++i) {
+        reference += PbfMessage::zigzag(m_ids[i]);
+        if (roles[i] >= quint64(m_strings.size()) || m_types[i] > 2) {
+            return false;
+        }
+        relation.addMember(reference, m_strings[roles[i]], memberTypes[m_types[i]]);
+    }
+    return addTags(relation.osmData());
+}
+
+bool OsmPbfBlockParser::addTags(OsmPlacemarkData &osmData)
+{
+    if (m_keys.size() != m_values.size()) {
+        return false;
+    }
+    for (int i = 0; i < m_keys.size(); ++i) {
+        if (m_keys[i] >= quint64(m_strings.size()) || m_values[i] >= quint64(m_strings.size())) {
+            return false;
+        }
+        osmData.addTag(m_strings[m_keys[i]], m_strings[m_values[i]]);
+    }
+    return true;
+}
+
+qreal OsmPbfBlockParser::toDegree(qint64 offset, qint64 value) const
+{
+    // coordinates are given in nanodegrees
+    return 1.0e-9 * (offset + m_granularity * value);
+}
+
+}
@@ -0,0 +1,94 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_OSMPBFBLOCKPARSER
+#define MARBLE_OSMPBFBLOCKPARSER
+
+#include "OsmBlockParser.h"
+
+#include <QByteArray>
+#include <QVector>
+
+namespace Marble {
+
+class PbfMessage;
+
+/**
+ * Parses a block of an OSM PBF file.
+ *
+ * A PBF file is a sequence of file blocks, each a compressed blob holding a
+ * primitive block of up to some ten thousand nodes, ways or relations with a
+ * string table of its own. Blobs are decoded independently of each other.
+ *
+ * The protocol buffer messages are decoded by hand, so neither protobuf nor a
+ * compiler for its schema is needed; zlib comes along with QtCore. Like the
+ * o5m reader, ids, coordinates, tags, node references and members are read,
+ * but no metadata.
+ */
+class OsmPbfBlockParser : public OsmBlockParser
+{
+public:
+    struct FileBlock
+    {
+        QByteArray type;
+        // the blob
+        const char *begin;
+        const char *end;
+    };
+
+    /** @p begin and @p end enclose the blob of an OSMData file block */
+    OsmPbfBlockParser(const char *begin, const char *end);
+
+    /**
+     * Reads the file block at @p position into @p block. Returns the position
+     * of the next one or a null pointer if the file is broken.
+     */
+    static const char * nextFileBlock(const char *position, const char *end, FileBlock &block);
+
+    /**
+     * Returns whether all features required by the OSMHeader @p block are
+     * supported, otherwise sets @p error.
+     */
+    static bool checkHeader(const FileBlock &block, QString &error);
+
+protected:
+    bool parse() override;
+
+private:
+    static bool uncompress(const char *begin, const char *end, QByteArray &data, QString &error);
+
+    bool parseStringTable(PbfMessage message);
+    bool parseGroup(PbfMessage message);
+    bool parseNode(PbfMessage message);
+    bool parseDenseNodes(PbfMessage message);
+    bool parseWay(PbfMessage message);
+    bool parseRelation(PbfMessage message);
+    bool addTags(OsmPlacemarkData &osmData);
+
+    qreal toDegree(qint64 offset, qint64 value) const;
+
+    const char *const m_begin;
+    const char *const m_end;
+
+    QVector<QString> m_strings;
+    qint64 m_granularity;
+    qint64 m_latOffset;
+    qint64 m_lonOffset;
+
+    // buffers for the repeated fields, reused for all entities
+    QVector<quint64> m_keys;
+    QVector<quint64> m_values;
+    QVector<quint64> m_ids;
+    QVector<quint64> m_lats;
+    QVector<quint64> m_lons;
+    QVector<quint64> m_types;
+};
+
+}
+
+#endif
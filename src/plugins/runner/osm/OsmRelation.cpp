@@ -100,7 +100,9 @@ void OsmRelation::create(GeoDataDocument *document, OsmWays &ways, const OsmNode
         } // else we keep it
 
         foreach(qint64 nodeId, ways[wayId].references()) {
-            ways[wayId].osmData().addNodeReference(nodes[nodeId].coordinates(), nodes[nodeId].osmData());
+            if (OsmNode const * node = nodes.find(nodeId)) {
+                ways[wayId].osmData().addNodeReference(node->coordinates(), node->osmData());
+            }
         }
     }
 
@@ -118,7 +120,9 @@ void OsmRelation::create(GeoDataDocument *document, OsmWays &ways, const OsmNode
             usedWays << wayId;
         }
         foreach(qint64 nodeId, ways[wayId].references()) {
-            ways[wayId].osmData().addNodeReference(nodes[nodeId].coordinates(), nodes[nodeId].osmData());
+            if (OsmNode const * node = nodes.find(nodeId)) {
+                ways[wayId].osmData().addNodeReference(node->coordinates(), node->osmData());
+            }
         }
         osmData.addMemberReference(index, ways[wayId].osmData());
         ++index;
@@ -178,11 +182,12 @@ QList<GeoDataLinearRing> OsmRelation::rings(const QStringList &roles, const OsmW
             continue;
         }
         foreach(qint64 id, way.references()) {
-            if (!nodes.contains(id)) {
+            OsmNode const * node = nodes.find(id);
+            if (!node) {
                 // A node is missing. Return nothing.
                 return QList<GeoDataLinearRing>();
             }
-            ring << nodes[id].coordinates();
+            ring << node->coordinates();
         }
         Q_ASSERT(ways.contains(wayId));
         currentWays << wayId;
@@ -207,12 +212,13 @@ QList<GeoDataLinearRing> OsmRelation::rings(const QStringList &roles, const OsmW
                         QVector<qint64> v = nextWay.references();
                         while( !v.isEmpty() ) {
                             qint64 id = isReversed ? v.takeLast() : v.takeFirst();
-                            if (!nodes.contains(id)) {
+                            OsmNode const * node = nodes.find(id);
+                            if (!node) {
                                 // A node is missing. Return nothing.
                                 return QList<GeoDataLinearRing>();
                             }
                             if ( id != lastReference ) {
-                                ring << nodes[id].coordinates();
+                                ring << node->coordinates();
                                 currentNodes << id;
                             }
                         }
@@ -38,15 +38,15 @@ void OsmWay::create(GeoDataDocument *document, const OsmNodes &nodes, QSet<qint6
         placemark->setGeometry(linearRing);
 
         foreach(qint64 nodeId, m_references) {
-            auto const nodeIter = nodes.constFind(nodeId);
-            if (nodeIter == nodes.constEnd()) {
+            OsmNode const * node = nodes.find(nodeId);
+            if (!node) {
                 delete placemark;
                 return;
             }
 
-            OsmNode const & node = nodeIter.value();
-            placemark->osmData().addNodeReference(node.coordinates(), node.osmData());
-            linearRing->append(node.coordinates());
+            GeoDataCoordinates const coordinates = node->coordinates();
+            placemark->osmData().addNodeReference(coordinates, node->osmData());
+            linearRing->append(coordinates);
             usedNodes << nodeId;
         }
 
@@ -56,15 +56,15 @@ void OsmWay::create(GeoDataDocument *document, const OsmNodes &nodes, QSet<qint6
         placemark->setGeometry(lineString);
 
         foreach(qint64 nodeId, m_references) {
-            auto const nodeIter = nodes.constFind(nodeId);
-            if (nodeIter == nodes.constEnd()) {
+            OsmNode const * node = nodes.find(nodeId);
+            if (!node) {
                 delete placemark;
                 return;
             }
 
-            OsmNode const & node = nodeIter.value();
-            placemark->osmData().addNodeReference(node.coordinates(), node.osmData());
-            lineString->append(node.coordinates());
+            GeoDataCoordinates const coordinates = node->coordinates();
+            placemark->osmData().addNodeReference(coordinates, node->osmData());
+            lineString->append(coordinates);
             usedNodes << nodeId;
         }
 
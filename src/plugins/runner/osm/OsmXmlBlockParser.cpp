@@ -0,0 +1,512 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "OsmXmlBlockParser.h"
+#include "OsmElementDictionary.h"
+
+#include <QByteArray>
+
+#include <cstring>
+
+namespace Marble {
+
+namespace {
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+// Compares data of the given size to a null terminated literal
+bool is(const char *data, int size, const char *literal)
+{
+    return qstrncmp(data, literal, size) == 0 && literal[size] == '\0';
+}
+
+const char *find(const char *begin, const char *end, const char *pattern)
+{
+    int const size = qstrlen(pattern);
+    for (const char *position = begin; end - position >= size; ++position) {
+        position = static_cast<const char *>(memchr(position, pattern[0], end - position));
+        if (!position || end - position < size) {
+            return nullptr;
+        }
+        if (memcmp(position, pattern, size) == 0) {
+            return position;
+        }
+    }
+    return nullptr;
+}
+
+// Returns whether position points to the start tag of a node, way or relation
+bool isElementStart(const char *position, const char *end)
+{
+    Q_ASSERT(*position == '<');
+    const char *const names[] = { osm::osmTag_node, osm::osmTag_way, osm::osmTag_relation };
+    for (const char *name: names) {
+        int const size = qstrlen(name);
+        if (end - position > size + 1 && memcmp(position + 1, name, size) == 0) {
+            char const next = position[size + 1];
+            if (isSpace(next) || next == '>' || next == '/') {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+}
+
+OsmXmlBlockParser::OsmXmlBlockParser(const char *begin, const char *end, bool isFirstBlock, bool isLastBlock) :
+    m_begin(begin),
+    m_end(end),
+    m_isFirstBlock(isFirstBlock),
+    m_isLastBlock(isLastBlock),
+    m_hasRoot(false),
+    m_osmData(nullptr),
+    m_way(nullptr),
+    m_relation(nullptr)
+{
+    // nothing to do
+}
+
+const char *OsmXmlBlockParser::blockEnd(const char *begin, const char *end, int size)
+{
+    if (end - begin <= size) {
+        return end;
+    }
+
+    // A literal '<' cannot appear in attribute values, so outside of comments
+    // every '<node', '<way' and '<relation' starts such an element. Comments
+    // split in half make the parser fail and fall back.
+    for (const char *position = begin + size; position != end; ++position) {
+        position = static_cast<const char *>(memchr(position, '<', end - position));
+        if (!position) {
+            return end;
+        }
+        if (isElementStart(position, end)) {
+            return position;
+        }
+    }
+    return end;
+}
+
+bool OsmXmlBlockParser::parse()
+{
+    const char *position = m_begin;
+    Attributes attributes;
+
+    // Blocks other than the first one start within the osm root element.
+    // The elements opened in the block have to be closed in it as well.
+    int outerDepth = m_isFirstBlock ? 0 : 1;
+    QVarLengthArray<Element, 8> elements;
+    bool rootClosed = false;
+
+    while (true) {
+        position = static_cast<const char *>(memchr(position, '<', m_end - position));
+        if (!position) {
+            if (m_isFirstBlock && !m_hasRoot) {
+                return setError(QStringLiteral("Not an OSM file"));
+            }
+            if (outerDepth + elements.size() != (m_isLastBlock ? 0 : 1)) {
+                return setError(m_isLastBlock ? QStringLiteral("Unexpected end of file")
+                                              : QStringLiteral("Unbalanced elements in block"));
+            }
+            return true;
+        }
+        if (++position == m_end) {
+            return setError(QStringLiteral("Unexpected end of file"));
+        }
+
+        if (*position == '/') {
+            const char *const name = ++position;
+            position = static_cast<const char *>(memchr(position, '>', m_end - position));
+            if (!position) {
+                return setError(QStringLiteral("Unterminated end tag"));
+            }
+            const char *nameEnd = name;
+            while (nameEnd != position && !isSpace(*nameEnd)) {
+                ++nameEnd;
+            }
+            int const nameSize = nameEnd - name;
+            if (!elements.isEmpty()) {
+                const Element &element = elements.last();
+                if (element.nameSize != nameSize || memcmp(element.name, name, nameSize) != 0) {
+                    return setError(QStringLiteral("Mismatched end tag"));
+                }
+                elements.removeLast();
+            } else if (outerDepth == 1 && is(name, nameSize, osm::osmTag_osm)) {
+                outerDepth = 0;
+            } else {
+                return setError(QStringLiteral("Mismatched end tag"));
+            }
+            rootClosed = outerDepth + elements.size() == 0;
+            continue;
+        }
+
+        if (*position == '?') {
+            const char *const end = find(position, m_end, "?>");
+            if (!end) {
+                return setError(QStringLiteral("Unterminated processing instruction"));
+            }
+            if (!parseProcessingInstruction(position + 1, end)) {
+                return false;
+            }
+            position = end;
+            continue;
+        }
+
+        if (*position == '!') {
+            if (m_end - position < 3 || memcmp(position, "!--", 3) != 0) {
+                return setError(QStringLiteral("Unsupported markup"));
+            }
+            const char *const end = find(position + 3, m_end, "-->");
+            if (!end) {
+                return setError(QStringLiteral("Unterminated comment"));
+            }
+            position = end;
+            continue;
+        }
+
+        const char *const name = position;
+        while (position != m_end && !isSpace(*position) && *position != '>' && *position != '/') {
+            ++position;
+        }
+        int const nameSize = position - name;
+        if (nameSize == 0) {
+            return setError(QStringLiteral("Missing element name"));
+        }
+        if (outerDepth + elements.size() == 0) {
+            if (rootClosed) {
+                return setError(QStringLiteral("Content after the root element"));
+            }
+            if (!is(name, nameSize, osm::osmTag_osm)) {
+                return setError(QStringLiteral("Not an OSM file"));
+            }
+        }
+
+        attributes.clear();
+        bool isEmpty = false;
+        while (true) {
+            while (position != m_end && isSpace(*position)) {
+                ++position;
+            }
+            if (position == m_end) {
+                return setError(QStringLiteral("Unterminated start tag"));
+            }
+            if (*position == '>') {
+                break;
+            }
+            if (*position == '/') {
+                if (++position == m_end || *position != '>') {
+                    return setError(QStringLiteral("Expected '>' after '/'"));
+                }
+                isEmpty = true;
+                break;
+            }
+
+            Attribute attribute;
+            attribute.name = position;
+            while (position != m_end && *position != '=' && !isSpace(*position)) {
+                ++position;
+            }
+            attribute.nameSize = position - attribute.name;
+            while (position != m_end && isSpace(*position)) {
+                ++position;
+            }
+            if (position == m_end || *position != '=') {
+                return setError(QStringLiteral("Expected '=' after attribute name"));
+            }
+            ++position;
+            while (position != m_end && isSpace(*position)) {
+                ++position;
+            }
+            if (position == m_end || (*position != '"' && *position != '\'')) {
+                return setError(QStringLiteral("Expected quoted attribute value"));
+            }
+            char const quote = *position;
+            attribute.value = ++position;
+            position = static_cast<const char *>(memchr(position, quote, m_end - position));
+            if (!position) {
+                return setError(QStringLiteral("Unterminated attribute value"));
+            }
+            attribute.valueSize = position - attribute.value;
+            ++position;
+            attributes.append(attribute);
+        }
+
+        handleElement(name, nameSize, attributes, isEmpty);
+        if (!isEmpty) {
+            Element const element = { name, nameSize };
+            elements.append(element);
+        } else if (outerDepth + elements.size() == 0) {
+            rootClosed = true;
+        }
+    }
+}
+
+bool OsmXmlBlockParser::parseProcessingInstruction(const char *begin, const char *end)
+{
+    if (end - begin < 4 || memcmp(begin, "xml", 3) != 0 || !isSpace(begin[3])) {
+        return true;
+    }
+
+    const char *position = find(begin, end, "encoding");
+    if (!position) {
+        return true;
+    }
+    position = static_cast<const char *>(memchr(position, '=', end - position));
+    while (position && ++position != end && isSpace(*position)) {
+        // skip whitespace
+    }
+    if (!position || position == end) {
+        return setError(QStringLiteral("Invalid XML declaration"));
+    }
+    char const quote = *position;
+    const char *const encoding = position + 1;
+    const char *const encodingEnd = static_cast<const char *>(memchr(encoding, quote, end - encoding));
+    if (!encodingEnd) {
+        return setError(QStringLiteral("Invalid XML declaration"));
+    }
+
+    int const size = encodingEnd - encoding;
+    if (size != 5 || qstrnicmp(encoding, "UTF-8", size) != 0) {
+        return setError(QStringLiteral("Unsupported encoding %1").arg(QString::fromLatin1(encoding, size)));
+    }
+    return true;
+}
+
+void OsmXmlBlockParser::handleElement(const char *name, int nameSize, const Attributes &attributes, bool isEmpty)
+{
+    if (is(name, nameSize, osm::osmTag_tag)) {
+        if (!m_osmData) {
+            return;
+        }
+        QString key;
+        QString value;
+        for (const Attribute &attribute: attributes) {
+            if (is(attribute.name, attribute.nameSize, "k")) {
+                key = text(attribute.value, attribute.valueSize);
+            } else if (is(attribute.name, attribute.nameSize, "v")) {
+                value = text(attribute.value, attribute.valueSize);
+            }
+        }
+        m_osmData->addTag(key, value);
+    } else if (is(name, nameSize, osm::osmTag_nd)) {
+        if (!m_way) {
+            return;
+        }
+        for (const Attribute &attribute: attributes) {
+            if (is(attribute.name, attribute.nameSize, "ref")) {
+                m_way->addReference(toNumber(attribute.value, attribute.valueSize));
+            }
+        }
+    } else if (is(name, nameSize, osm::osmTag_member)) {
+        if (!m_relation) {
+            return;
+        }
+        static QString const nodeType = QString::fromLatin1(osm::osmTag_node);
+        static QString const wayType = QString::fromLatin1(osm::osmTag_way);
+        static QString const relationType = QString::fromLatin1(osm::osmTag_relation);
+        qint64 reference = 0;
+        QString role;
+        QString type;
+        for (const Attribute &attribute: attributes) {
+            if (is(attribute.name, attribute.nameSize, "ref")) {
+                reference = toNumber(attribute.value, attribute.valueSize);
+            } else if (is(attribute.name, attribute.nameSize, "role")) {
+                role = text(attribute.value, attribute.valueSize);
+            } else if (is(attribute.name, attribute.nameSize, "type")) {
+                type = is(attribute.value, attribute.valueSize, osm::osmTag_node) ? nodeType :
+                       is(attribute.value, attribute.valueSize, osm::osmTag_way) ? wayType :
+                       is(attribute.value, attribute.valueSize, osm::osmTag_relation) ? relationType :
+                       text(attribute.value, attribute.valueSize);
+            }
+        }
+        m_relation->addMember(reference, role, type);
+    } else if (is(name, nameSize, osm::osmTag_node)) {
+        qint64 id = 0;
+        qreal lon = 0.0;
+        qreal lat = 0.0;
+        for (const Attribute &attribute: attributes) {
+            if (is(attribute.name, attribute.nameSize, "id")) {
+                id = toNumber(attribute.value, attribute.valueSize);
+            } else if (is(attribute.name, attribute.nameSize, "lon")) {
+                lon = toDecimal(attribute.value, attribute.valueSize);
+            } else if (is(attribute.name, attribute.nameSize, "lat")) {
+                lat = toDecimal(attribute.value, attribute.valueSize);
+            }
+        }
+        OsmNode &node = m_nodes.append(id);
+        node.setCoordinates(lon, lat);
+        setMetadata(node.osmData(), attributes);
+        m_osmData = isEmpty ? nullptr : &node.osmData();
+        m_way = nullptr;
+        m_relation = nullptr;
+    } else if (is(name, nameSize, osm::osmTag_way)) {
+        qint64 id = 0;
+        for (const Attribute &attribute: attributes) {
+            if (is(attribute.name, attribute.nameSize, "id")) {
+                id = toNumber(attribute.value, attribute.valueSize);
+            }
+        }
+        OsmWay &way = m_ways[id];
+        way = OsmWay();
+        way.osmData().setId(id);
+        setMetadata(way.osmData(), attributes);
+        m_osmData = isEmpty ? nullptr : &way.osmData();
+        m_way = isEmpty ? nullptr : &way;
+        m_relation = nullptr;
+    } else if (is(name, nameSize, osm::osmTag_relation)) {
+        qint64 id = 0;
+        for (const Attribute &attribute: attributes) {
+            if (is(attribute.name, attribute.nameSize, "id")) {
+                id = toNumber(attribute.value, attribute.valueSize);
+            }
+        }
+        OsmRelation &relation = m_relations[id];
+        relation = OsmRelation();
+        relation.osmData().setId(id);
+        setMetadata(relation.osmData(), attributes);
+        m_osmData = isEmpty ? nullptr : &relation.osmData();
+        m_way = nullptr;
+        m_relation = isEmpty ? nullptr : &relation;
+    } else if (is(name, nameSize, osm::osmTag_osm)) {
+        m_hasRoot = true;
+    } // other elements like bounds ignored
+}
+
+void OsmXmlBlockParser::setMetadata(OsmPlacemarkData &osmData, const Attributes &attributes) const
+{
+    for (const Attribute &attribute: attributes) {
+        const char *const name = attribute.name;
+        int const size = attribute.nameSize;
+        if (is(name, size, "version")) {
+            osmData.setVersion(text(attribute.value, attribute.valueSize));
+        } else if (is(name, size, "changeset")) {
+            osmData.setChangeset(text(attribute.value, attribute.valueSize));
+        } else if (is(name, size, "user")) {
+            osmData.setUser(text(attribute.value, attribute.valueSize));
+        } else if (is(name, size, "uid")) {
+            osmData.setUid(text(attribute.value, attribute.valueSize));
+        } else if (is(name, size, "visible")) {
+            osmData.setVisible(text(attribute.value, attribute.valueSize));
+        } else if (is(name, size, "timestamp")) {
+            osmData.setTimestamp(text(attribute.value, attribute.valueSize));
+        } else if (is(name, size, "action")) {
+            osmData.setAction(text(attribute.value, attribute.valueSize));
+        }
+    }
+}
+
+QString OsmXmlBlockParser::text(const char *data, int size)
+{
+    bool plain = true;
+    for (int i = 0; i < size && plain; ++i) {
+        plain = data[i] != '&' && uchar(data[i]) >= ' ';
+    }
+    if (plain) {
+        return QString::fromUtf8(data, size);
+    }
+
+    QByteArray result;
+    result.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        char const c = data[i];
+        if (isSpace(c)) {
+            // attribute values are normalized
+            result += ' ';
+            continue;
+        }
+        const char *const semicolon = c == '&' ? static_cast<const char *>(memchr(data + i, ';', size - i)) : nullptr;
+        if (!semicolon) {
+            result += c;
+            continue;
+        }
+
+        const char *const entity = data + i + 1;
+        int const entitySize = semicolon - entity;
+        if (is(entity, entitySize, "amp")) {
+            result += '&';
+        } else if (is(entity, entitySize, "lt")) {
+            result += '<';
+        } else if (is(entity, entitySize, "gt")) {
+            result += '>';
+        } else if (is(entity, entitySize, "quot")) {
+            result += '"';
+        } else if (is(entity, entitySize, "apos")) {
+            result += '\'';
+        } else if (entitySize > 1 && entity[0] == '#') {
+            bool ok;
+            uint const code = entity[1] == 'x' ?
+                        QByteArray(entity + 2, entitySize - 2).toUInt(&ok, 16) :
+                        QByteArray(entity + 1, entitySize - 1).toUInt(&ok, 10);
+            if (!ok) {
+                result += c;
+                continue;
+            }
+            result += QString::fromUcs4(&code, 1).toUtf8();
+        } else {
+            result += c;
+            continue;
+        }
+        i += entitySize + 1;
+    }
+    return QString::fromUtf8(result);
+}
+
+qint64 OsmXmlBlockParser::toNumber(const char *data, int size)
+{
+    bool const negative = size > 0 && data[0] == '-';
+    qint64 result = 0;
+    for (int i = negative ? 1 : 0; i < size; ++i) {
+        int const digit = data[i] - '0';
+        if (digit < 0 || digit > 9) {
+            return 0;
+        }
+        result = 10 * result + digit;
+    }
+    return negative ? -result : result;
+}
+
+qreal OsmXmlBlockParser::toDecimal(const char *data, int size)
+{
+    // Coordinates have seven decimal places in general. As long as the digits
+    // fit into the mantissa, a single division is exact up to rounding like
+    // the complete conversion, which is needed for exponents and long numbers.
+    static const qreal powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+                                    1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+    bool const negative = size > 0 && data[0] == '-';
+    qint64 mantissa = 0;
+    int digits = 0;
+    int decimals = -1;
+    for (int i = negative ? 1 : 0; i < size; ++i) {
+        char const c = data[i];
+        if (c >= '0' && c <= '9') {
+            mantissa = 10 * mantissa + c - '0';
+            ++digits;
+            if (decimals >= 0) {
+                ++decimals;
+            }
+        } else if (c == '.' && decimals < 0) {
+            decimals = 0;
+        } else {
+            digits = 16;
+            break;
+        }
+    }
+
+    if (digits == 0 || digits > 15) {
+        return QByteArray(data, size).toDouble();
+    }
+    qreal const result = decimals > 0 ? mantissa / powers[decimals] : mantissa;
+    return negative ? -result : result;
+}
+
+}
@@ -0,0 +1,91 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_OSMXMLBLOCKPARSER
+#define MARBLE_OSMXMLBLOCKPARSER
+
+#include "OsmBlockParser.h"
+
+#include <QVarLengthArray>
+
+namespace Marble {
+
+/**
+ * Parses a block of an OSM XML file.
+ *
+ * An OSM file is a flat list of nodes, ways and relations. Every block starts
+ * with one of those elements and ends before another one or at the end of the
+ * file, so blocks can be parsed independently and merged in file order.
+ *
+ * Only the subset of XML written for OSM files is understood: elements with
+ * attributes, character references, comments and processing instructions.
+ * Anything else, like CDATA sections, a DOCTYPE or a declared encoding other
+ * than UTF-8, is an error and the caller is expected to fall back to a
+ * complete XML parser.
+ */
+class OsmXmlBlockParser : public OsmBlockParser
+{
+public:
+    /**
+     * The first block of a file must contain the osm root element, otherwise
+     * it is no OSM file at all. The last block must close it, otherwise the
+     * file is truncated. All blocks in between must close the elements they
+     * open.
+     */
+    OsmXmlBlockParser(const char *begin, const char *end, bool isFirstBlock = false, bool isLastBlock = false);
+
+    /**
+     * Returns the end of the block starting at @p begin which is about
+     * @p size bytes long: the start of the next node, way or relation
+     * element following that size, or @p end.
+     */
+    static const char * blockEnd(const char *begin, const char *end, int size);
+
+protected:
+    bool parse() override;
+
+private:
+    struct Attribute
+    {
+        const char *name;
+        int nameSize;
+        const char *value;
+        int valueSize;
+    };
+
+    typedef QVarLengthArray<Attribute, 16> Attributes;
+
+    struct Element
+    {
+        const char *name;
+        int nameSize;
+    };
+
+    bool parseProcessingInstruction(const char *begin, const char *end);
+    void handleElement(const char *name, int nameSize, const Attributes &attributes, bool isEmpty);
+    void setMetadata(OsmPlacemarkData &osmData, const Attributes &attributes) const;
+
+    static QString text(const char *data, int size);
+    static qint64 toNumber(const char *data, int size);
+    static qreal toDecimal(const char *data, int size);
+
+    const char *const m_begin;
+    const char *const m_end;
+    const bool m_isFirstBlock;
+    const bool m_isLastBlock;
+    bool m_hasRoot;
+
+    // the element tags, node references and members belong to
+    OsmPlacemarkData *m_osmData;
+    OsmWay *m_way;
+    OsmRelation *m_relation;
+};
+
+}
+
+#endif
@@ -0,0 +1,271 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "blendings/BlendingAlgorithms.h"
+#include "TextureTile.h"
+
+#include <QImage>
+#include <QSharedPointer>
+#include <QTest>
+
+Q_DECLARE_METATYPE( QSharedPointer<Marble::Blending> )
+
+namespace Marble
+{
+
+/**
+ * Compares the blendings with the per pixel implementation they replaced,
+ * which is kept here as a reference and as a baseline for the benchmarks.
+ */
+class BlendingAlgorithmsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void independentChannel_data();
+    void independentChannel();
+    void grayscale_data();
+    void grayscale();
+    void clouds();
+
+    void benchmarkIndependentChannel_data();
+    void benchmarkIndependentChannel();
+    void benchmarkClouds_data();
+    void benchmarkClouds();
+
+private:
+    typedef qreal ( *ChannelFunction )( qreal, qreal );
+
+    static void referenceIndependentChannel( QImage *bottom, const QImage &top, ChannelFunction blendChannel );
+    static void referenceGrayscale( QImage *bottom, const QImage &top );
+    static void referenceClouds( QImage *bottom, const QImage &top );
+
+    static qreal multiply( qreal bottom, qreal top ) { return bottom * top; }
+    static qreal overlay( qreal bottom, qreal top )
+    {
+        return bottom < 0.5 ? 2.0 * bottom * top : 1.0 - 2.0 * ( 1.0 - bottom ) * ( 1.0 - top );
+    }
+    static qreal softLight( qreal bottom, qreal top )
+    {
+        return pow( bottom, pow( 2.0, ( 2.0 * ( 0.5 - top ) ) ) );
+    }
+    static qreal pinLight( qreal bottom, qreal top )
+    {
+        return qMax( qreal( 0.0 ), qMax( qreal( 2.0 + top - 1.0 ), qMin( bottom, qreal( 2.0 * top ) ) ) );
+    }
+
+    static QImage randomImage( QImage::Format format );
+
+    QImage m_bottom;
+    QImage m_top;
+};
+
+void BlendingAlgorithmsTest::initTestCase()
+{
+    qsrand( 42 );
+    m_bottom = randomImage( QImage::Format_ARGB32_Premultiplied );
+    m_top = randomImage( QImage::Format_ARGB32 );
+}
+
+QImage BlendingAlgorithmsTest::randomImage( QImage::Format format )
+{
+    QImage image( 256, 256, format );
+    for ( int y = 0; y < image.height(); ++y ) {
+        for ( int x = 0; x < image.width(); ++x ) {
+            image.setPixel( x, y, qRgba( qrand() % 256, qrand() % 256, qrand() % 256, 255 ) );
+        }
+    }
+    return image;
+}
+
+void BlendingAlgorithmsTest::referenceIndependentChannel( QImage *bottom, const QImage &top, ChannelFunction blendChannel )
+{
+    QImage const topImagePremult = top.convertToFormat( QImage::Format_ARGB32_Premultiplied );
+    for ( int y = 0; y < bottom->height(); ++y ) {
+        for ( int x = 0; x < bottom->width(); ++x ) {
+            QRgb const bottomPixel = bottom->pixel( x, y );
+            QRgb const topPixel = topImagePremult.pixel( x, y );
+            qreal const resultRed = blendChannel( qRed( bottomPixel ) / 255.0, qRed( topPixel ) / 255.0 );
+            qreal const resultGreen = blendChannel( qGreen( bottomPixel ) / 255.0, qGreen( topPixel ) / 255.0 );
+            qreal const resultBlue = blendChannel( qBlue( bottomPixel ) / 255.0, qBlue( topPixel ) / 255.0 );
+            bottom->setPixel( x, y, qRgb( resultRed * 255.0, resultGreen * 255.0, resultBlue * 255.0 ) );
+        }
+    }
+}
+
+void BlendingAlgorithmsTest::referenceGrayscale( QImage *bottom, const QImage &top )
+{
+    QImage const topImagePremult = top.convertToFormat( QImage::Format_ARGB32_Premultiplied );
+    for ( int y = 0; y < bottom->height(); ++y ) {
+        for ( int x = 0; x < bottom->width(); ++x ) {
+            int const gray = qGray( topImagePremult.pixel( x, y ) );
+            bottom->setPixel( x, y, qRgb( gray, gray, gray ) );
+        }
+    }
+}
+
+void BlendingAlgorithmsTest::referenceClouds( QImage *bottom, const QImage &top )
+{
+    for ( int y = 0; y < bottom->height(); ++y ) {
+        for ( int x = 0; x < bottom->width(); ++x ) {
+            qreal const c = qRed( top.pixel( x, y ) ) / 255.0;
+            QRgb const bottomPixel = bottom->pixel( x, y );
+            int const bottomRed = qRed( bottomPixel );
+            int const bottomGreen = qGreen( bottomPixel );
+            int const bottomBlue = qBlue( bottomPixel );
+            bottom->setPixel( x, y, qRgb( ( int )( bottomRed + ( 255 - bottomRed ) * c ),
+                                          ( int )( bottomGreen + ( 255 - bottomGreen ) * c ),
+                                          ( int )( bottomBlue + ( 255 - bottomBlue ) * c ) ) );
+        }
+    }
+}
+
+void BlendingAlgorithmsTest::independentChannel_data()
+{
+    QTest::addColumn<QSharedPointer<Blending> >( "blending" );
+    QTest::addColumn<void *>( "channelFunction" );
+
+    QTest::newRow( "Multiply" ) << QSharedPointer<Blending>( new MultiplyBlending )
+                                << reinterpret_cast<void *>( &multiply );
+    QTest::newRow( "Overlay" ) << QSharedPointer<Blending>( new OverlayBlending )
+                               << reinterpret_cast<void *>( &overlay );
+    QTest::newRow( "SoftLight" ) << QSharedPointer<Blending>( new SoftLightBlending )
+                                 << reinterpret_cast<void *>( &softLight );
+    // results beyond 1.0 wrap around as they used to
+    QTest::newRow( "PinLight" ) << QSharedPointer<Blending>( new PinLightBlending )
+                                << reinterpret_cast<void *>( &pinLight );
+}
+
+void BlendingAlgorithmsTest::independentChannel()
+{
+    QFETCH( QSharedPointer<Blending>, blending );
+    QFETCH( void *, channelFunction );
+
+    const TextureTile top( TileId(), m_top, blending.data() );
+
+    QImage expected = m_bottom.copy();
+    referenceIndependentChannel( &expected, m_top, reinterpret_cast<ChannelFunction>( channelFunction ) );
+
+    QImage result = m_bottom.copy();
+    blending->blend( &result, &top );
+
+    QCOMPARE( result, expected );
+}
+
+void BlendingAlgorithmsTest::grayscale_data()
+{
+    QTest::addColumn<QImage>( "topImage" );
+
+    QImage translucent = m_top.copy();
+    for ( int y = 0; y < translucent.height(); ++y ) {
+        for ( int x = 0; x < translucent.width(); ++x ) {
+            QRgb const pixel = translucent.pixel( x, y );
+            translucent.setPixel( x, y, qRgba( qRed( pixel ), qGreen( pixel ), qBlue( pixel ), ( x + y ) % 256 ) );
+        }
+    }
+
+    // the top image is read directly unless it has some other format
+    QTest::newRow( "ARGB32" ) << m_top;
+    QTest::newRow( "ARGB32 translucent" ) << translucent;
+    QTest::newRow( "ARGB32_Premultiplied" ) << translucent.convertToFormat( QImage::Format_ARGB32_Premultiplied );
+    QTest::newRow( "RGB32" ) << m_top.convertToFormat( QImage::Format_RGB32 );
+    QTest::newRow( "Indexed8" ) << translucent.convertToFormat( QImage::Format_Indexed8 );
+    QTest::newRow( "RGB888" ) << m_top.convertToFormat( QImage::Format_RGB888 );
+}
+
+void BlendingAlgorithmsTest::grayscale()
+{
+    QFETCH( QImage, topImage );
+
+    GrayscaleBlending blending;
+    const TextureTile top( TileId(), topImage, &blending );
+
+    QImage expected = m_bottom.copy();
+    referenceGrayscale( &expected, topImage );
+
+    QImage result = m_bottom.copy();
+    blending.blend( &result, &top );
+
+    QCOMPARE( result, expected );
+}
+
+void BlendingAlgorithmsTest::clouds()
+{
+    // cloud tiles usually are 8 bit gray images
+    const QImage cloudsImage = m_top.convertToFormat( QImage::Format_Indexed8 );
+
+    CloudsBlending blending;
+    const TextureTile top( TileId(), cloudsImage, &blending );
+
+    QImage expected = m_bottom.copy();
+    referenceClouds( &expected, cloudsImage );
+
+    QImage result = m_bottom.copy();
+    blending.blend( &result, &top );
+
+    QCOMPARE( result, expected );
+}
+
+void BlendingAlgorithmsTest::benchmarkIndependentChannel_data()
+{
+    QTest::addColumn<bool>( "reference" );
+
+    QTest::newRow( "reference" ) << true;
+    QTest::newRow( "scanlines" ) << false;
+}
+
+void BlendingAlgorithmsTest::benchmarkIndependentChannel()
+{
+    QFETCH( bool, reference );
+
+    OverlayBlending blending;
+    const TextureTile top( TileId(), m_top, &blending );
+    QImage result = m_bottom.copy();
+
+    if ( reference ) {
+        QBENCHMARK {
+            referenceIndependentChannel( &result, m_top, &overlay );
+        }
+    } else {
+        QBENCHMARK {
+            blending.blend( &result, &top );
+        }
+    }
+}
+
+void BlendingAlgorithmsTest::benchmarkClouds_data()
+{
+    benchmarkIndependentChannel_data();
+}
+
+void BlendingAlgorithmsTest::benchmarkClouds()
+{
+    QFETCH( bool, reference );
+
+    CloudsBlending blending;
+    const TextureTile top( TileId(), m_top, &blending );
+    QImage result = m_bottom.copy();
+
+    if ( reference ) {
+        QBENCHMARK {
+            referenceClouds( &result, m_top );
+        }
+    } else {
+        QBENCHMARK {
+            blending.blend( &result, &top );
+        }
+    }
+}
+
+}
+
+QTEST_MAIN( Marble::BlendingAlgorithmsTest )
+
+#include "BlendingAlgorithmsTest.moc"
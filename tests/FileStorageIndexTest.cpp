@@ -0,0 +1,104 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "FileStorageIndex.h"
+
+#include "TestUtils.h"
+
+#include <QTemporaryDir>
+
+namespace Marble
+{
+
+class FileStorageIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void isEvictable_data();
+    void isEvictable();
+    void totalSize();
+    void leastRecentlyUsed();
+};
+
+void FileStorageIndexTest::isEvictable_data()
+{
+    QTest::addColumn<QString>( "fileName" );
+    QTest::addColumn<bool>( "evictable" );
+
+    addRow() << "maps/earth/openstreetmap/12/2143/1406.png" << true;
+    addRow() << "maps/earth/srtm/7/000042/000042_000101.jpg" << true;
+    addRow() << "maps/earth/openstreetmap/4/5/6.png" << false;
+    addRow() << "maps/earth/vectorosm/13/4280/2826.o5m" << true;
+    addRow() << "maps/earth/vectorosm/13/4280/2826.o5m.mvtc" << true;
+    addRow() << "maps/earth/vectorosm/1/0/0.o5m" << false;
+    addRow() << "maps/earth/openstreetmap/openstreetmap.dgml" << false;
+    addRow() << "/tmp/maps/earth/openstreetmap/12/2143/1406.png" << false;
+}
+
+void FileStorageIndexTest::isEvictable()
+{
+    QFETCH( QString, fileName );
+    QFETCH( bool, evictable );
+
+    QCOMPARE( FileStorageIndex::isEvictable( fileName ), evictable );
+}
+
+void FileStorageIndexTest::totalSize()
+{
+    QTemporaryDir dir;
+    QVERIFY( dir.isValid() );
+    FileStorageIndex *index = FileStorageIndex::index( dir.path() );
+    QCOMPARE( FileStorageIndex::index( dir.path() + "/" ), index );
+
+    QCOMPARE( index->totalSize(), qint64( 0 ) );
+    index->recordUpdate( "maps/earth/osm/12/2143/1406.png", 1000 );
+    index->recordUpdate( "maps/earth/osm/12/2143/1407.png", 500 );
+    index->recordUpdate( "maps/earth/osm/osm.dgml", 300 );
+    QCOMPARE( index->totalSize(), qint64( 1500 ) );
+
+    // replacing a tile only counts the difference
+    index->recordUpdate( "maps/earth/osm/12/2143/1406.png", 800 );
+    QCOMPARE( index->totalSize(), qint64( 1300 ) );
+
+    index->clear();
+    QCOMPARE( index->totalSize(), qint64( 0 ) );
+    QVERIFY( index->leastRecentlyUsed( 10 ).isEmpty() );
+}
+
+void FileStorageIndexTest::leastRecentlyUsed()
+{
+    QTemporaryDir dir;
+    QVERIFY( dir.isValid() );
+    FileStorageIndex *index = FileStorageIndex::index( dir.path() );
+
+    index->recordUpdate( "maps/earth/osm/12/0/1.png", 10, 1000 );
+    index->recordUpdate( "maps/earth/osm/12/0/2.png", 20, 2000 );
+    index->recordUpdate( "maps/earth/osm/12/0/3.png", 30, 3000 );
+    index->flush();
+    index->recordAccess( "maps/earth/osm/12/0/1.png" );
+    index->recordAccess( "maps/earth/osm/12/0/4.png" );
+
+    QVector<FileStorageIndex::Entry> entries = index->leastRecentlyUsed( 2 );
+    QCOMPARE( entries.size(), 2 );
+    QCOMPARE( entries[0].fileName, QString( "maps/earth/osm/12/0/2.png" ) );
+    QCOMPARE( entries[0].size, qint64( 20 ) );
+    QCOMPARE( entries[1].fileName, QString( "maps/earth/osm/12/0/3.png" ) );
+
+    index->remove( entries );
+    QCOMPARE( index->totalSize(), qint64( 10 ) );
+    entries = index->leastRecentlyUsed( 10 );
+    QCOMPARE( entries.size(), 1 );
+    QCOMPARE( entries[0].fileName, QString( "maps/earth/osm/12/0/1.png" ) );
+}
+
+}
+
+QTEST_MAIN( Marble::FileStorageIndexTest )
+
+#include "FileStorageIndexTest.moc"
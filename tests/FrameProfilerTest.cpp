@@ -0,0 +1,236 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "FrameProfiler.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+#include <QThread>
+
+namespace Marble
+{
+
+class ScopeThread : public QThread
+{
+protected:
+    void run()
+    {
+        FrameProfiler::Scope scope( "worker" );
+    }
+};
+
+class FrameProfilerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void disabled();
+    void nestedScopes();
+    void counters();
+    void ringBuffer();
+    void maps();
+    void threads();
+    void chromeTrace();
+};
+
+void FrameProfilerTest::init()
+{
+    FrameProfiler::instance()->setCapacity( 120 );
+    FrameProfiler::instance()->clear();
+    FrameProfiler::instance()->setEnabled( true );
+}
+
+void FrameProfilerTest::cleanup()
+{
+    FrameProfiler::instance()->setEnabled( false );
+}
+
+void FrameProfilerTest::disabled()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+    profiler->setEnabled( false );
+
+    profiler->beginFrame();
+    {
+        FrameProfiler::Scope scope( "outer" );
+        profiler->addCounter( "things" );
+        QTest::qSleep( 1 );
+        QVERIFY( scope.elapsed() > 0 );
+    }
+    profiler->endFrame();
+
+    QVERIFY( profiler->frames().isEmpty() );
+}
+
+void FrameProfilerTest::nestedScopes()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+
+    {
+        // outside of a frame
+        FrameProfiler::Scope scope( "ignored" );
+    }
+
+    profiler->beginFrame();
+    {
+        FrameProfiler::Scope outer( "outer" );
+        {
+            FrameProfiler::Scope inner( QString( "inner" ) );
+            QTest::qSleep( 2 );
+        }
+    }
+    profiler->endFrame();
+
+    const QVector<FrameProfiler::Frame> frames = profiler->frames();
+    QCOMPARE( frames.size(), 1 );
+    const FrameProfiler::Frame &frame = frames.first();
+    QCOMPARE( frame.events.size(), 2 );
+
+    // scopes are recorded when they end
+    const FrameProfiler::Event &inner = frame.events[0];
+    const FrameProfiler::Event &outer = frame.events[1];
+    QCOMPARE( inner.name, QString( "inner" ) );
+    QCOMPARE( inner.depth, 1 );
+    QCOMPARE( outer.name, QString( "outer" ) );
+    QCOMPARE( outer.depth, 0 );
+    QCOMPARE( inner.thread, outer.thread );
+
+    QVERIFY( inner.duration >= 2000000 );
+    QVERIFY( outer.start <= inner.start );
+    QVERIFY( outer.start + outer.duration >= inner.start + inner.duration );
+    QVERIFY( frame.start <= outer.start );
+    QVERIFY( frame.start + frame.duration >= outer.start + outer.duration );
+}
+
+void FrameProfilerTest::counters()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+
+    profiler->beginFrame();
+    profiler->addCounter( "tiles loaded" );
+    profiler->addCounter( "tiles loaded", 2 );
+    profiler->addCounter( "labels placed", 7 );
+    profiler->endFrame();
+
+    profiler->beginFrame();
+    profiler->endFrame();
+
+    const QVector<FrameProfiler::Frame> frames = profiler->frames();
+    QCOMPARE( frames.size(), 2 );
+    QCOMPARE( frames[0].counters.value( "tiles loaded" ), qint64( 3 ) );
+    QCOMPARE( frames[0].counters.value( "labels placed" ), qint64( 7 ) );
+    QVERIFY( frames[1].counters.isEmpty() );
+    QCOMPARE( frames[1].number, frames[0].number + 1 );
+}
+
+void FrameProfilerTest::ringBuffer()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+    profiler->setCapacity( 3 );
+
+    for ( int i = 0; i < 5; ++i ) {
+        profiler->beginFrame();
+        profiler->addCounter( "frame", i );
+        profiler->endFrame();
+    }
+
+    QVector<FrameProfiler::Frame> frames = profiler->frames();
+    QCOMPARE( frames.size(), 3 );
+    QCOMPARE( frames[0].counters.value( "frame" ), qint64( 2 ) );
+    QCOMPARE( frames[1].counters.value( "frame" ), qint64( 3 ) );
+    QCOMPARE( frames[2].counters.value( "frame" ), qint64( 4 ) );
+
+    profiler->setCapacity( 2 );
+    frames = profiler->frames();
+    QCOMPARE( frames.size(), 2 );
+    QCOMPARE( frames[0].counters.value( "frame" ), qint64( 3 ) );
+    QCOMPARE( frames[1].counters.value( "frame" ), qint64( 4 ) );
+}
+
+void FrameProfilerTest::maps()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+    int map;
+    int overviewMap;
+
+    // the overview map gets rendered within the frame of the map
+    profiler->beginFrame( &map );
+    profiler->addCounter( "map" );
+    profiler->beginFrame( &overviewMap );
+    profiler->addCounter( "overview map" );
+    profiler->endFrame( &overviewMap );
+    profiler->addCounter( "map" );
+    profiler->endFrame( &map );
+
+    const QVector<FrameProfiler::Frame> frames = profiler->frames();
+    QCOMPARE( frames.size(), 2 );
+    QCOMPARE( frames[0].counters.size(), 1 );
+    QCOMPARE( frames[0].counters.value( "overview map" ), qint64( 1 ) );
+    QCOMPARE( frames[1].counters.size(), 1 );
+    QCOMPARE( frames[1].counters.value( "map" ), qint64( 2 ) );
+    QVERIFY( frames[1].start <= frames[0].start );
+}
+
+void FrameProfilerTest::threads()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+
+    profiler->beginFrame();
+    ScopeThread first;
+    first.start();
+    QVERIFY( first.wait() );
+    ScopeThread second;
+    second.start();
+    QVERIFY( second.wait() );
+    profiler->endFrame();
+
+    const QVector<FrameProfiler::Frame> frames = profiler->frames();
+    QCOMPARE( frames.size(), 1 );
+    QCOMPARE( frames[0].events.size(), 2 );
+    QVERIFY( frames[0].events[0].thread != frames[0].thread );
+    // the id of the first thread gets reused
+    QCOMPARE( frames[0].events[1].thread, frames[0].events[0].thread );
+}
+
+void FrameProfilerTest::chromeTrace()
+{
+    FrameProfiler *const profiler = FrameProfiler::instance();
+
+    profiler->beginFrame();
+    {
+        FrameProfiler::Scope scope( "TextureLayer: map texture" );
+        profiler->addCounter( "tiles loaded", 4 );
+    }
+    profiler->endFrame();
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson( profiler->chromeTrace(), &error );
+    QCOMPARE( error.error, QJsonParseError::NoError );
+
+    const QJsonArray events = document.object().value( "traceEvents" ).toArray();
+    QCOMPARE( events.size(), 3 );
+
+    QCOMPARE( events[0].toObject().value( "ph" ).toString(), QString( "X" ) );
+    QCOMPARE( events[1].toObject().value( "name" ).toString(), QString( "TextureLayer: map texture" ) );
+    QCOMPARE( events[1].toObject().value( "ph" ).toString(), QString( "X" ) );
+    QVERIFY( events[1].toObject().value( "dur" ).toDouble() >= 0.0 );
+    QCOMPARE( events[2].toObject().value( "name" ).toString(), QString( "tiles loaded" ) );
+    QCOMPARE( events[2].toObject().value( "ph" ).toString(), QString( "C" ) );
+    QCOMPARE( events[2].toObject().value( "args" ).toObject().value( "value" ).toInt(), 4 );
+}
+
+}
+
+QTEST_MAIN( Marble::FrameProfilerTest )
+
+#include "FrameProfilerTest.moc"
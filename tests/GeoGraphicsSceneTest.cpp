@@ -0,0 +1,163 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "GeoGraphicsScene.h"
+
+#include "GeoDataLatLonAltBox.h"
+#include "GeoDataPlacemark.h"
+#include "GeoGraphicsItem.h"
+#include "MarbleGlobal.h"
+
+#include <QSet>
+#include <QTest>
+
+namespace Marble
+{
+
+class TestItem : public GeoGraphicsItem
+{
+public:
+    TestItem( const GeoDataFeature *feature, const GeoDataLatLonAltBox &box, int minZoomLevel ) :
+        GeoGraphicsItem( feature )
+    {
+        setLatLonAltBox( box );
+        setMinZoomLevel( minZoomLevel );
+    }
+
+    void paint( GeoPainter *, const ViewportParams *, const QString & ) {}
+};
+
+class GeoGraphicsSceneTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void items_data();
+    void items();
+
+    void removeItem();
+    void dateLine();
+
+private:
+    static GeoDataLatLonAltBox box( qreal west, qreal south, qreal east, qreal north );
+    QSet<GeoGraphicsItem *> expectedItems( const GeoDataLatLonBox &box, int zoomLevel ) const;
+
+    GeoGraphicsScene m_scene;
+    QList<GeoDataPlacemark *> m_placemarks;
+    QList<GeoGraphicsItem *> m_items;
+};
+
+GeoDataLatLonAltBox GeoGraphicsSceneTest::box( qreal west, qreal south, qreal east, qreal north )
+{
+    return GeoDataLatLonAltBox( GeoDataLatLonBox( north, south, east, west, GeoDataCoordinates::Degree ) );
+}
+
+QSet<GeoGraphicsItem *> GeoGraphicsSceneTest::expectedItems( const GeoDataLatLonBox &box, int zoomLevel ) const
+{
+    QSet<GeoGraphicsItem *> result;
+    foreach ( GeoGraphicsItem *item, m_items ) {
+        if ( item->minZoomLevel() <= zoomLevel && item->visible() && item->latLonAltBox().intersects( box ) ) {
+            result << item;
+        }
+    }
+    return result;
+}
+
+void GeoGraphicsSceneTest::initTestCase()
+{
+    // A deterministic mix of small and large boxes all over the world
+    qsrand( 42 );
+    for ( int i = 0; i < 5000; ++i ) {
+        const qreal west = qrand() % 3500 / 10.0 - 180.0;
+        const qreal south = qrand() % 1700 / 10.0 - 85.0;
+        const qreal width = i % 50 == 0 ? qrand() % 900 / 10.0 : qrand() % 20 / 10.0;
+        const qreal height = i % 50 == 0 ? qrand() % 300 / 10.0 : qrand() % 20 / 10.0;
+
+        GeoDataPlacemark *placemark = new GeoDataPlacemark;
+        GeoGraphicsItem *item = new TestItem( placemark, box( west, south, qMin<qreal>( west + width, 180.0 ),
+                                                              qMin<qreal>( south + height, 90.0 ) ),
+                                              i % 18 );
+        if ( i % 97 == 0 ) {
+            item->setVisible( false );
+        }
+
+        m_placemarks << placemark;
+        m_items << item;
+        m_scene.addItem( item );
+    }
+}
+
+void GeoGraphicsSceneTest::cleanupTestCase()
+{
+    m_scene.clear();
+    qDeleteAll( m_placemarks );
+}
+
+void GeoGraphicsSceneTest::items_data()
+{
+    QTest::addColumn<GeoDataLatLonBox>( "box" );
+    QTest::addColumn<int>( "zoomLevel" );
+
+    QTest::newRow( "world" ) << GeoDataLatLonBox( box( -180, -90, 180, 90 ) ) << 17;
+    QTest::newRow( "world, low zoom" ) << GeoDataLatLonBox( box( -180, -90, 180, 90 ) ) << 3;
+    QTest::newRow( "europe" ) << GeoDataLatLonBox( box( -10, 35, 30, 60 ) ) << 10;
+    QTest::newRow( "small" ) << GeoDataLatLonBox( box( 13.3, 52.4, 13.5, 52.6 ) ) << 17;
+    QTest::newRow( "date line" ) << GeoDataLatLonBox( box( 170, -20, -170, 20 ) ) << 12;
+}
+
+void GeoGraphicsSceneTest::items()
+{
+    QFETCH( GeoDataLatLonBox, box );
+    QFETCH( int, zoomLevel );
+
+    const QList<GeoGraphicsItem *> items = m_scene.items( box, zoomLevel );
+
+    QCOMPARE( items.toSet().size(), items.size() );
+    QCOMPARE( items.toSet(), expectedItems( box, zoomLevel ) );
+}
+
+void GeoGraphicsSceneTest::removeItem()
+{
+    const GeoDataLatLonBox world = box( -180, -90, 180, 90 );
+
+    for ( int i = 0; i < 2000; ++i ) {
+        m_scene.removeItem( m_placemarks[i] );
+    }
+    m_items = m_items.mid( 2000 );
+
+    QCOMPARE( m_scene.items( world, 17 ).toSet(), expectedItems( world, 17 ) );
+    QCOMPARE( m_scene.items( world, 5 ).toSet(), expectedItems( world, 5 ) );
+}
+
+void GeoGraphicsSceneTest::dateLine()
+{
+    GeoDataPlacemark placemark;
+    // crosses the date line, i.e. west > east
+    GeoGraphicsItem *item = new TestItem( &placemark, box( 175, -5, -175, 5 ), 0 );
+    m_scene.addItem( item );
+    m_items << item;
+
+    QVERIFY( m_scene.items( box( 176, -1, 178, 1 ), 0 ).contains( item ) );
+    QVERIFY( m_scene.items( box( -178, -1, -176, 1 ), 0 ).contains( item ) );
+    QVERIFY( !m_scene.items( box( 0, -1, 10, 1 ), 0 ).contains( item ) );
+    QCOMPARE( m_scene.items( box( -180, -90, 180, 90 ), 0 ).count( item ), 1 );
+    QCOMPARE( m_scene.items( box( 170, -10, -170, 10 ), 0 ).count( item ), 1 );
+
+    m_scene.removeItem( &placemark );
+    m_items.removeAll( item );
+    QVERIFY( !m_scene.items( box( -180, -90, 180, 90 ), 0 ).contains( item ) );
+}
+
+}
+
+QTEST_MAIN( Marble::GeoGraphicsSceneTest )
+
+#include "GeoGraphicsSceneTest.moc"
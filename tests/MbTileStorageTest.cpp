@@ -0,0 +1,134 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "MbTileStorage.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace Marble
+{
+
+class MbTileStorageTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void parseTileFileName_data();
+    void parseTileFileName();
+    void invalidTileFileName_data();
+    void invalidTileFileName();
+    void storeAndRead();
+    void removeTiles();
+};
+
+void MbTileStorageTest::parseTileFileName_data()
+{
+    QTest::addColumn<QString>( "fileName" );
+    QTest::addColumn<QString>( "themePath" );
+    QTest::addColumn<int>( "zoomLevel" );
+    QTest::addColumn<int>( "column" );
+    QTest::addColumn<int>( "row" );
+
+    QTest::newRow( "OpenStreetMap" ) << "maps/earth/openstreetmap/12/2143/1406.png"
+                                     << "maps/earth/openstreetmap" << 12 << 2143 << 1406;
+    QTest::newRow( "Marble" ) << "maps/earth/srtm/7/000042/000042_000101.jpg"
+                              << "maps/earth/srtm" << 7 << 101 << 42;
+    QTest::newRow( "absolute" ) << "/home/user/tiles/3/5/2.png"
+                                << "/home/user/tiles" << 3 << 5 << 2;
+}
+
+void MbTileStorageTest::parseTileFileName()
+{
+    QFETCH( QString, fileName );
+    QFETCH( QString, themePath );
+    QFETCH( int, zoomLevel );
+    QFETCH( int, column );
+    QFETCH( int, row );
+
+    QString actualThemePath;
+    int actualZoomLevel, actualColumn, actualRow;
+    QVERIFY( MbTileStorage::parseTileFileName( fileName, actualThemePath, actualZoomLevel, actualColumn, actualRow ) );
+    QCOMPARE( actualThemePath, themePath );
+    QCOMPARE( actualZoomLevel, zoomLevel );
+    QCOMPARE( actualColumn, column );
+    QCOMPARE( actualRow, row );
+}
+
+void MbTileStorageTest::invalidTileFileName_data()
+{
+    QTest::addColumn<QString>( "fileName" );
+
+    QTest::newRow( "too short" ) << "12/2143/1406.png";
+    QTest::newRow( "legend" ) << "maps/earth/srtm/legend/legend.html";
+    QTest::newRow( "row mismatch" ) << "maps/earth/srtm/7/000042/000043_000101.jpg";
+}
+
+void MbTileStorageTest::invalidTileFileName()
+{
+    QFETCH( QString, fileName );
+
+    QString themePath;
+    int zoomLevel, column, row;
+    QVERIFY( !MbTileStorage::parseTileFileName( fileName, themePath, zoomLevel, column, row ) );
+}
+
+void MbTileStorageTest::storeAndRead()
+{
+    QTemporaryDir dir;
+    QVERIFY( dir.isValid() );
+    const QString fileName = MbTileStorage::packFileName( dir.path() + "/maps/earth/osm" );
+
+    QVERIFY( !MbTileStorage::storage( fileName ) );
+    MbTileStorage *storage = MbTileStorage::storage( fileName, true );
+    QVERIFY( storage );
+    QCOMPARE( MbTileStorage::storage( fileName ), storage );
+
+    qint64 sizeDelta = 0;
+    QVERIFY( storage->storeTile( 8, 133, 85, QByteArray( "first" ), &sizeDelta ) );
+    QCOMPARE( sizeDelta, qint64( 5 ) );
+    QVERIFY( storage->storeTile( 8, 133, 85, QByteArray( "second" ), &sizeDelta ) );
+    QCOMPARE( sizeDelta, qint64( 1 ) );
+    QVERIFY( storage->storeTile( 8, 134, 85, QByteArray( "neighbor" ) ) );
+
+    QDateTime lastModified;
+    QCOMPARE( storage->tileData( 8, 133, 85, &lastModified ), QByteArray( "second" ) );
+    QVERIFY( lastModified.isValid() );
+    QVERIFY( lastModified.secsTo( QDateTime::currentDateTime() ) < 60 );
+    QVERIFY( storage->containsTile( 8, 134, 85 ) );
+    QVERIFY( !storage->containsTile( 8, 135, 85 ) );
+    QVERIFY( !storage->containsTile( 9, 133, 85 ) );
+    QVERIFY( storage->tileData( 9, 133, 85 ).isEmpty() );
+
+    // tiles stored after a missing block has been cached are found
+    QVERIFY( storage->storeTile( 8, 135, 85, QByteArray( "late" ) ) );
+    QCOMPARE( storage->tileData( 8, 135, 85 ), QByteArray( "late" ) );
+}
+
+void MbTileStorageTest::removeTiles()
+{
+    QTemporaryDir dir;
+    QVERIFY( dir.isValid() );
+    MbTileStorage *storage = MbTileStorage::storage( MbTileStorage::packFileName( dir.path() ), true );
+    QVERIFY( storage );
+
+    QVERIFY( storage->storeTile( 4, 1, 1, QByteArray( "base" ) ) );
+    QVERIFY( storage->storeTile( 5, 2, 2, QByteArray( "12345" ) ) );
+    QVERIFY( storage->storeTile( 6, 4, 4, QByteArray( "123" ) ) );
+
+    QCOMPARE( storage->removeTiles( 5 ), qint64( 8 ) );
+    QVERIFY( storage->containsTile( 4, 1, 1 ) );
+    QVERIFY( !storage->containsTile( 5, 2, 2 ) );
+    QVERIFY( !storage->containsTile( 6, 4, 4 ) );
+}
+
+}
+
+QTEST_MAIN( Marble::MbTileStorageTest )
+
+#include "MbTileStorageTest.moc"
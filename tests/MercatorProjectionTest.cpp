@@ -27,6 +27,8 @@ private Q_SLOTS:
     void screenCoordinatesOfCenter();
 
     void setInvalidRadius();
+
+    void projectPoints();
 };
 
 void MercatorProjectionTest::screenCoordinatesValidLat_data()
@@ -214,6 +216,37 @@ void MercatorProjectionTest::setInvalidRadius()
     viewport.geoCoordinates( 23, 42, lon, lat );
 }
 
+void MercatorProjectionTest::projectPoints()
+{
+    ViewportParams viewport;
+    viewport.setProjection( Mercator );
+    viewport.setRadius( 360 / 4 );
+    viewport.centerOn( 20 * DEG2RAD, 30 * DEG2RAD );
+    viewport.setSize( QSize( 360, 361 ) );
+
+    // includes points beyond the valid latitude range
+    const qreal lon[] = { 0.0, -1.0, 2.5, -3.1, 0.3 };
+    const qreal lat[] = { 0.0, 0.7, -1.2, 1.5, -1.55 };
+    const qreal altitude[] = { 0.0, 0.0, 1000.0, 0.0, 0.0 };
+    const int count = 5;
+
+    qreal x[count];
+    qreal y[count];
+    bool globeHidesPoint[count];
+    viewport.currentProjection()->projectPoints( lon, lat, altitude, count, &viewport, x, y, globeHidesPoint );
+
+    for ( int i = 0; i < count; ++i ) {
+        qreal expectedX;
+        qreal expectedY;
+        bool expectedGlobeHidesPoint = true;
+        viewport.screenCoordinates( GeoDataCoordinates( lon[i], lat[i], altitude[i] ), expectedX, expectedY, expectedGlobeHidesPoint );
+
+        QFUZZYCOMPARE( x[i], expectedX, 1e-9 );
+        QFUZZYCOMPARE( y[i], expectedY, 1e-9 );
+        QCOMPARE( globeHidesPoint[i], expectedGlobeHidesPoint );
+    }
+}
+
 }
 
 QTEST_MAIN( Marble::MercatorProjectionTest )
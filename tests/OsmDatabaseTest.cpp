@@ -0,0 +1,180 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "OsmDatabase.h"
+
+#include "DatabaseQuery.h"
+#include "GeoDataLatLonBox.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace Marble
+{
+
+class OsmDatabaseTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void find_data();
+    void find();
+    void findNearest_data();
+    void findNearest();
+
+private:
+    // the schema written by osm-addresses, with or without the search indices
+    static void createDatabase( const QString &fileName, bool indexed, qreal longitude );
+
+    static QVector<OsmPlacemark> find( const QStringList &databaseFiles, const QString &searchTerm,
+                                       const GeoDataLatLonBox &preferred = GeoDataLatLonBox() );
+
+    QTemporaryDir m_directory;
+};
+
+void OsmDatabaseTest::createDatabase( const QString &fileName, bool indexed, qreal longitude )
+{
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase( "QSQLITE", fileName );
+        database.setDatabaseName( fileName );
+        QVERIFY( database.open() );
+
+        QSqlQuery query( database );
+        QVERIFY( query.exec( "CREATE TABLE placemarks ( id INTEGER PRIMARY KEY, regionId INTEGER, nameId INTEGER,"
+                             " number VARCHAR(8), category INTEGER, lon FLOAT(8), lat FLOAT(8) )" ) );
+        QVERIFY( query.exec( "CREATE TABLE names ( id INTEGER PRIMARY KEY, name VARCHAR(50) )" ) );
+        QVERIFY( query.exec( "CREATE TABLE regions ( id INTEGER PRIMARY KEY, parent INTEGER NOT NULL,"
+                             " lft INTEGER NOT NULL, rgt INTEGER NOT NULL, name VARCHAR(50), lon FLOAT(8), lat FLOAT(8) )" ) );
+
+        QVERIFY( query.exec( "INSERT INTO regions VALUES (1, 0, 1, 4, 'Berlin', 13.4, 52.5),"
+                             " (2, 1, 2, 3, 'Mitte', 13.4, 52.5), (3, 0, 5, 6, 'Hamburg', 10.0, 53.5)" ) );
+        QVERIFY( query.exec( "INSERT INTO names VALUES (1, 'Unter den Linden'), (2, 'Müllerstraße'),"
+                             " (3, 'Alexanderplatz'), (4, 'Hotel')" ) );
+
+        // addresses in Mitte, a row of hotels along the parallel
+        QVERIFY( query.prepare( "INSERT INTO placemarks (regionId, nameId, number, category, lon, lat) VALUES (?, ?, ?, ?, ?, ?)" ) );
+        const QVariantList addresses = QVariantList() << 1 << 2 << 3;
+        foreach ( const QVariant &nameId, addresses ) {
+            query.addBindValue( 2 );
+            query.addBindValue( nameId );
+            query.addBindValue( "5" );
+            query.addBindValue( int( OsmPlacemark::Address ) );
+            query.addBindValue( longitude + 0.001 * nameId.toInt() );
+            query.addBindValue( 52.5 );
+            QVERIFY( query.exec() );
+        }
+        for ( int i = 0; i < 120; ++i ) {
+            query.addBindValue( 2 );
+            query.addBindValue( 4 );
+            query.addBindValue( QVariant( QVariant::String ) );
+            query.addBindValue( int( OsmPlacemark::AccomodationHotel ) );
+            query.addBindValue( longitude + 0.01 * i );
+            query.addBindValue( 52.5 );
+            QVERIFY( query.exec() );
+        }
+
+        if ( indexed ) {
+            QVERIFY( query.exec( "CREATE VIRTUAL TABLE namesSearch USING fts4( content=\"\", name, tokenize=unicode61, prefix=\"2,3\" )" ) );
+            QVERIFY( query.exec( "CREATE VIRTUAL TABLE placemarksArea USING rtree( id, minLon, maxLon, minLat, maxLat )" ) );
+            QVERIFY( query.exec( "INSERT INTO namesSearch (docid, name) SELECT id, name FROM names" ) );
+            QVERIFY( query.exec( "INSERT INTO placemarksArea (id, minLon, maxLon, minLat, maxLat)"
+                                 " SELECT id, lon, lon, lat, lat FROM placemarks" ) );
+        }
+    }
+    QSqlDatabase::removeDatabase( fileName );
+}
+
+QVector<OsmPlacemark> OsmDatabaseTest::find( const QStringList &databaseFiles, const QString &searchTerm,
+                                             const GeoDataLatLonBox &preferred )
+{
+    OsmDatabase database( databaseFiles );
+    return database.find( DatabaseQuery( 0, searchTerm, preferred ) );
+}
+
+void OsmDatabaseTest::initTestCase()
+{
+    QVERIFY( m_directory.isValid() );
+    createDatabase( m_directory.path() + "/indexed.sqlite", true, 13.4 );
+    createDatabase( m_directory.path() + "/plain.sqlite", false, 13.4 );
+    createDatabase( m_directory.path() + "/other.sqlite", true, 10.0 );
+}
+
+void OsmDatabaseTest::find_data()
+{
+    QTest::addColumn<QString>( "databaseFile" );
+    QTest::addColumn<QString>( "searchTerm" );
+    QTest::addColumn<QStringList>( "names" );
+
+    foreach ( const QString &databaseFile, QStringList() << "indexed.sqlite" << "plain.sqlite" ) {
+        QTest::newRow( qPrintable( databaseFile + ": exact" ) ) << databaseFile << "Alexanderplatz" << ( QStringList() << "Alexanderplatz" );
+        QTest::newRow( qPrintable( databaseFile + ": prefix" ) ) << databaseFile << QString::fromUtf8( "Mül*" ) << ( QStringList() << QString::fromUtf8( "Müllerstraße" ) );
+        QTest::newRow( qPrintable( databaseFile + ": word prefix" ) ) << databaseFile << "Unter d*" << ( QStringList() << "Unter den Linden" );
+        QTest::newRow( qPrintable( databaseFile + ": suffix" ) ) << databaseFile << "*platz" << ( QStringList() << "Alexanderplatz" );
+        QTest::newRow( qPrintable( databaseFile + ": infix" ) ) << databaseFile << "*xand*" << ( QStringList() << "Alexanderplatz" );
+        QTest::newRow( qPrintable( databaseFile + ": inner word" ) ) << databaseFile << "Linden*" << QStringList();
+        QTest::newRow( qPrintable( databaseFile + ": address" ) ) << databaseFile << "Unter den Linden 5, Berlin" << ( QStringList() << "Unter den Linden" );
+        QTest::newRow( qPrintable( databaseFile + ": other region" ) ) << databaseFile << "Unter den Linden 5, Hamburg" << QStringList();
+        QTest::newRow( qPrintable( databaseFile + ": other number" ) ) << databaseFile << "Unter den Linden 7, Berlin" << QStringList();
+        QTest::newRow( qPrintable( databaseFile + ": quotes" ) ) << databaseFile << "Alexander' OR '1'='1" << QStringList();
+    }
+}
+
+void OsmDatabaseTest::find()
+{
+    QFETCH( QString, databaseFile );
+    QFETCH( QString, searchTerm );
+    QFETCH( QStringList, names );
+
+    const QVector<OsmPlacemark> placemarks = find( QStringList() << m_directory.path() + '/' + databaseFile, searchTerm );
+
+    QStringList foundNames;
+    foreach ( const OsmPlacemark &placemark, placemarks ) {
+        foundNames << placemark.name();
+    }
+    foundNames.sort();
+    QCOMPARE( foundNames, names );
+}
+
+void OsmDatabaseTest::findNearest_data()
+{
+    QTest::addColumn<QStringList>( "databaseFiles" );
+
+    QTest::newRow( "indexed" ) << ( QStringList() << m_directory.path() + "/indexed.sqlite" );
+    QTest::newRow( "plain" ) << ( QStringList() << m_directory.path() + "/plain.sqlite" );
+    QTest::newRow( "several files" ) << ( QStringList() << m_directory.path() + "/indexed.sqlite"
+                                                        << m_directory.path() + "/other.sqlite" );
+}
+
+void OsmDatabaseTest::findNearest()
+{
+    QFETCH( QStringList, databaseFiles );
+
+    // the hotels run from 13.4 to 14.59 degrees, the 50 nearest ones of 14.0
+    // are within 0.25 degrees
+    const GeoDataLatLonBox preferred( 52.6, 52.4, 14.1, 13.9, GeoDataCoordinates::Degree );
+    const QVector<OsmPlacemark> placemarks = find( databaseFiles, "hotel", preferred );
+
+    QCOMPARE( placemarks.size(), 50 );
+    qreal lastDistance = 0.0;
+    foreach ( const OsmPlacemark &placemark, placemarks ) {
+        QCOMPARE( placemark.category(), OsmPlacemark::AccomodationHotel );
+        const qreal distance = qAbs( placemark.longitude() - 14.0 );
+        QVERIFY( distance <= 0.25 + 1e-4 );
+        QVERIFY( distance >= lastDistance - 1e-4 );
+        lastDistance = distance;
+    }
+}
+
+}
+
+QTEST_MAIN( Marble::OsmDatabaseTest )
+
+#include "OsmDatabaseTest.moc"
@@ -0,0 +1,226 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "OsmPbfBlockParser.h"
+
+#include <QtEndian>
+#include <QTest>
+
+namespace Marble
+{
+
+class OsmPbfBlockParserTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void parse_data();
+    void parse();
+    void brokenBlock();
+    void fileBlocks();
+    void unsupportedFeature();
+
+private:
+    // a minimal protocol buffer encoder for the test data
+    static QByteArray varint( quint64 value );
+    static QByteArray varintField( int field, quint64 value );
+    static QByteArray bytesField( int field, const QByteArray &bytes );
+    static QByteArray packedField( int field, const QVector<qint64> &values, bool zigzag );
+
+    static QByteArray primitiveBlock();
+    static QByteArray rawBlob( const QByteArray &data );
+    static QByteArray zlibBlob( const QByteArray &data );
+    static QByteArray fileBlock( const QByteArray &type, const QByteArray &blob );
+    static QByteArray headerBlock( const QByteArray &feature );
+};
+
+QByteArray OsmPbfBlockParserTest::varint( quint64 value )
+{
+    QByteArray result;
+    do {
+        const uchar byte = value & 0x7f;
+        value >>= 7;
+        result += char( value ? byte | 0x80 : byte );
+    } while ( value );
+    return result;
+}
+
+QByteArray OsmPbfBlockParserTest::varintField( int field, quint64 value )
+{
+    return varint( field << 3 ) + varint( value );
+}
+
+QByteArray OsmPbfBlockParserTest::bytesField( int field, const QByteArray &bytes )
+{
+    return varint( field << 3 | 2 ) + varint( bytes.size() ) + bytes;
+}
+
+QByteArray OsmPbfBlockParserTest::packedField( int field, const QVector<qint64> &values, bool zigzag )
+{
+    QByteArray packed;
+    foreach ( qint64 value, values ) {
+        packed += varint( zigzag ? ( quint64( value ) << 1 ) ^ quint64( value >> 63 ) : quint64( value ) );
+    }
+    return bytesField( field, packed );
+}
+
+QByteArray OsmPbfBlockParserTest::primitiveBlock()
+{
+    QByteArray strings;
+    foreach ( const char *string, QVector<const char *>() << "" << "name" << "Alexanderplatz" << "highway"
+                                                          << "primary" << "outer" << "type" << "multipolygon" ) {
+        strings += bytesField( 1, string );
+    }
+
+    // nodes 100, 101 and 103, the first one named
+    const QByteArray dense = packedField( 1, QVector<qint64>() << 100 << 1 << 2, true )
+                             + packedField( 8, QVector<qint64>() << 525200000 << 1000 << -2000, true )
+                             + packedField( 9, QVector<qint64>() << 134100000 << -1000 << 500, true )
+                             + packedField( 10, QVector<qint64>() << 1 << 2 << 0 << 0 << 0, false );
+
+    const QByteArray way = varintField( 1, 200 )
+                           + packedField( 2, QVector<qint64>() << 3, false )
+                           + packedField( 3, QVector<qint64>() << 4, false )
+                           + packedField( 8, QVector<qint64>() << 100 << 1 << 2, true );
+
+    const QByteArray relation = varintField( 1, 300 )
+                                + packedField( 2, QVector<qint64>() << 6, false )
+                                + packedField( 3, QVector<qint64>() << 7, false )
+                                + packedField( 8, QVector<qint64>() << 5, false )
+                                + packedField( 9, QVector<qint64>() << 200, true )
+                                + packedField( 10, QVector<qint64>() << 1, false );
+
+    return bytesField( 1, strings )
+           + bytesField( 2, bytesField( 2, dense ) )
+           + bytesField( 2, bytesField( 3, way ) )
+           + bytesField( 2, bytesField( 4, relation ) )
+           + varintField( 17, 100 );
+}
+
+QByteArray OsmPbfBlockParserTest::rawBlob( const QByteArray &data )
+{
+    return bytesField( 1, data ) + varintField( 2, data.size() );
+}
+
+QByteArray OsmPbfBlockParserTest::zlibBlob( const QByteArray &data )
+{
+    // qCompress prepends the uncompressed size to the zlib data
+    return varintField( 2, data.size() ) + bytesField( 3, qCompress( data ).mid( 4 ) );
+}
+
+QByteArray OsmPbfBlockParserTest::fileBlock( const QByteArray &type, const QByteArray &blob )
+{
+    const QByteArray header = bytesField( 1, type ) + varintField( 3, blob.size() );
+    QByteArray size( 4, '\0' );
+    qToBigEndian<quint32>( header.size(), reinterpret_cast<uchar *>( size.data() ) );
+    return size + header + blob;
+}
+
+QByteArray OsmPbfBlockParserTest::headerBlock( const QByteArray &feature )
+{
+    return bytesField( 4, "OsmSchema-V0.6" ) + bytesField( 4, feature );
+}
+
+void OsmPbfBlockParserTest::parse_data()
+{
+    QTest::addColumn<QByteArray>( "blob" );
+
+    QTest::newRow( "raw" ) << rawBlob( primitiveBlock() );
+    QTest::newRow( "zlib" ) << zlibBlob( primitiveBlock() );
+}
+
+void OsmPbfBlockParserTest::parse()
+{
+    QFETCH( QByteArray, blob );
+
+    OsmPbfBlockParser parser( blob.constData(), blob.constData() + blob.size() );
+    parser.run();
+    parser.waitForFinished();
+    QVERIFY2( !parser.hasError(), qPrintable( parser.errorString() ) );
+
+    OsmNodes &nodes = parser.nodes();
+    nodes.sort();
+    QCOMPARE( nodes.size(), 3 );
+
+    const OsmNode *first = nodes.find( 100 );
+    QVERIFY( first );
+    QCOMPARE( first->coordinates().latitude( GeoDataCoordinates::Degree ), 52.52 );
+    QCOMPARE( first->coordinates().longitude( GeoDataCoordinates::Degree ), 13.41 );
+    QCOMPARE( first->osmData().tagValue( "name" ), QString( "Alexanderplatz" ) );
+
+    const OsmNode *second = nodes.find( 101 );
+    QVERIFY( second );
+    QCOMPARE( second->coordinates().latitude( GeoDataCoordinates::Degree ), 52.5201 );
+    QCOMPARE( second->coordinates().longitude( GeoDataCoordinates::Degree ), 13.4099 );
+    QVERIFY( second->osmData().isEmpty() );
+
+    const OsmNode *third = nodes.find( 103 );
+    QVERIFY( third );
+    QCOMPARE( third->coordinates().latitude( GeoDataCoordinates::Degree ), 52.5199 );
+    QCOMPARE( third->coordinates().longitude( GeoDataCoordinates::Degree ), 13.41 - 0.0001 + 0.00005 );
+
+    QCOMPARE( parser.ways().size(), 1 );
+    const OsmWay &way = parser.ways()[200];
+    QCOMPARE( way.references(), QVector<qint64>() << 100 << 101 << 103 );
+    QCOMPARE( way.osmData().tagValue( "highway" ), QString( "primary" ) );
+
+    QCOMPARE( parser.relations().size(), 1 );
+    QVERIFY( parser.relations()[300].osmData().containsTag( "type", "multipolygon" ) );
+}
+
+void OsmPbfBlockParserTest::brokenBlock()
+{
+    // cut off in the middle of the primitive groups
+    const QByteArray blob = rawBlob( primitiveBlock().left( 40 ) );
+
+    OsmPbfBlockParser parser( blob.constData(), blob.constData() + blob.size() );
+    parser.run();
+    parser.waitForFinished();
+    QVERIFY( parser.hasError() );
+}
+
+void OsmPbfBlockParserTest::fileBlocks()
+{
+    const QByteArray header = rawBlob( headerBlock( "DenseNodes" ) );
+    const QByteArray data = zlibBlob( primitiveBlock() );
+    const QByteArray file = fileBlock( "OSMHeader", header ) + fileBlock( "OSMData", data );
+    const char *const end = file.constData() + file.size();
+
+    OsmPbfBlockParser::FileBlock block;
+    const char *position = OsmPbfBlockParser::nextFileBlock( file.constData(), end, block );
+    QVERIFY( position );
+    QCOMPARE( block.type, QByteArray( "OSMHeader" ) );
+    QCOMPARE( QByteArray( block.begin, block.end - block.begin ), header );
+    QString error;
+    QVERIFY( OsmPbfBlockParser::checkHeader( block, error ) );
+
+    position = OsmPbfBlockParser::nextFileBlock( position, end, block );
+    QVERIFY( position == end );
+    QCOMPARE( block.type, QByteArray( "OSMData" ) );
+    QCOMPARE( QByteArray( block.begin, block.end - block.begin ), data );
+
+    // a truncated file
+    const char *const dataBlock = file.constData() + fileBlock( "OSMHeader", header ).size();
+    QVERIFY( !OsmPbfBlockParser::nextFileBlock( dataBlock, end - 10, block ) );
+}
+
+void OsmPbfBlockParserTest::unsupportedFeature()
+{
+    const QByteArray header = zlibBlob( headerBlock( "HistoricalInformation" ) );
+    const OsmPbfBlockParser::FileBlock block = { "OSMHeader", header.constData(), header.constData() + header.size() };
+
+    QString error;
+    QVERIFY( !OsmPbfBlockParser::checkHeader( block, error ) );
+    QVERIFY( error.contains( "HistoricalInformation" ) );
+}
+
+}
+
+QTEST_MAIN( Marble::OsmPbfBlockParserTest )
+
+#include "OsmPbfBlockParserTest.moc"
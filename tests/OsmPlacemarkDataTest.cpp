@@ -0,0 +1,163 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "osm/OsmPlacemarkData.h"
+
+#include "GeoDataCoordinates.h"
+
+#include <QTest>
+
+namespace Marble
+{
+
+class OsmPlacemarkDataTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void tags();
+    void tagOrder();
+    void metadata_data();
+    void metadata();
+    void implicitSharing();
+    void isEmpty();
+};
+
+void OsmPlacemarkDataTest::tags()
+{
+    OsmPlacemarkData data;
+    QCOMPARE( data.tagsBegin(), data.tagsEnd() );
+    QCOMPARE( data.tagValue( "highway" ), QString() );
+
+    data.addTag( "highway", "residential" );
+    data.addTag( "name", "Marble Street" );
+    QCOMPARE( data.tagValue( "highway" ), QString( "residential" ) );
+    QVERIFY( data.containsTagKey( "name" ) );
+    QVERIFY( data.containsTag( "name", "Marble Street" ) );
+    QVERIFY( !data.containsTag( "name", "Marble" ) );
+    QVERIFY( !data.containsTagKey( "oneway" ) );
+
+    // adding a tag again replaces its value
+    data.addTag( "highway", "service" );
+    QCOMPARE( data.tagValue( "highway" ), QString( "service" ) );
+    QCOMPARE( std::distance( data.tagsBegin(), data.tagsEnd() ), qptrdiff( 2 ) );
+
+    data.removeTag( "highway" );
+    QVERIFY( !data.containsTagKey( "highway" ) );
+    QCOMPARE( data.tagValue( "name" ), QString( "Marble Street" ) );
+    data.removeTag( "highway" );
+    QCOMPARE( std::distance( data.tagsBegin(), data.tagsEnd() ), qptrdiff( 1 ) );
+}
+
+void OsmPlacemarkDataTest::tagOrder()
+{
+    const QStringList keys = QStringList() << "building" << "addr:street" << "addr:housenumber" << "roof:shape";
+
+    OsmPlacemarkData data;
+    foreach ( const QString &key, keys ) {
+        data.addTag( key, key.toUpper() );
+    }
+
+    QStringList result;
+    for ( auto iter = data.tagsBegin(), end = data.tagsEnd(); iter != end; ++iter ) {
+        QCOMPARE( iter.value(), iter.key().toUpper() );
+        result << iter.key();
+    }
+    QCOMPARE( result, keys );
+}
+
+void OsmPlacemarkDataTest::metadata_data()
+{
+    QTest::addColumn<QString>( "version" );
+    QTest::addColumn<QString>( "changeset" );
+    QTest::addColumn<QString>( "uid" );
+    QTest::addColumn<QString>( "visible" );
+    QTest::addColumn<QString>( "timestamp" );
+
+    QTest::newRow( "complete" ) << "3" << "38475612" << "123456" << "true" << "2016-03-20T15:30:00Z";
+    QTest::newRow( "invisible" ) << "1" << "1" << "0" << "false" << "2007-01-01T00:00:00Z";
+    QTest::newRow( "unset" ) << "" << "" << "" << "" << "";
+}
+
+void OsmPlacemarkDataTest::metadata()
+{
+    QFETCH( QString, version );
+    QFETCH( QString, changeset );
+    QFETCH( QString, uid );
+    QFETCH( QString, visible );
+    QFETCH( QString, timestamp );
+
+    OsmPlacemarkData data;
+    data.setId( 42 );
+    data.setVersion( version );
+    data.setChangeset( changeset );
+    data.setUid( uid );
+    data.setVisible( visible );
+    data.setTimestamp( timestamp );
+    data.setUser( "marble" );
+    data.setAction( "modify" );
+
+    QCOMPARE( data.id(), qint64( 42 ) );
+    QCOMPARE( data.version(), version );
+    QCOMPARE( data.changeset(), changeset );
+    QCOMPARE( data.uid(), uid );
+    QCOMPARE( data.isVisible(), visible );
+    QCOMPARE( data.timestamp(), timestamp );
+    QCOMPARE( data.user(), QString( "marble" ) );
+    QCOMPARE( data.action(), QString( "modify" ) );
+}
+
+void OsmPlacemarkDataTest::implicitSharing()
+{
+    const GeoDataCoordinates coordinates( 13.4, 52.5, 0, GeoDataCoordinates::Degree );
+
+    OsmPlacemarkData node;
+    node.setId( 7 );
+    node.addTag( "barrier", "gate" );
+
+    OsmPlacemarkData way;
+    way.setId( 1 );
+    way.addTag( "highway", "track" );
+    way.addNodeReference( coordinates, node );
+
+    OsmPlacemarkData copy = way;
+    copy.addTag( "highway", "path" );
+    copy.nodeReference( coordinates ).addTag( "barrier", "stile" );
+
+    QCOMPARE( way.tagValue( "highway" ), QString( "track" ) );
+    QCOMPARE( way.nodeReference( coordinates ).tagValue( "barrier" ), QString( "gate" ) );
+    QCOMPARE( copy.tagValue( "highway" ), QString( "path" ) );
+    QCOMPARE( copy.nodeReference( coordinates ).tagValue( "barrier" ), QString( "stile" ) );
+    QCOMPARE( copy.nodeReference( coordinates ).id(), qint64( 7 ) );
+}
+
+void OsmPlacemarkDataTest::isEmpty()
+{
+    OsmPlacemarkData data;
+    QVERIFY( data.isNull() );
+    QVERIFY( data.isEmpty() );
+
+    data.setId( 1 );
+    data.setVersion( QString() );
+    QVERIFY( !data.isNull() );
+    QVERIFY( data.isEmpty() );
+
+    data.addRelation( 2, "outer" );
+    QVERIFY( !data.isEmpty() );
+    data.removeRelation( 2 );
+    QVERIFY( data.isEmpty() );
+
+    data.setVersion( "1" );
+    QVERIFY( !data.isEmpty() );
+}
+
+}
+
+QTEST_MAIN( Marble::OsmPlacemarkDataTest )
+
+#include "OsmPlacemarkDataTest.moc"
@@ -0,0 +1,218 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "OsmXmlBlockParser.h"
+
+#include <QTest>
+
+namespace Marble
+{
+
+class OsmXmlBlockParserTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void parse();
+    void blocks();
+    void truncated();
+    void unsupported_data();
+    void unsupported();
+    void sortNodes();
+
+private:
+    static QByteArray node( qint64 id );
+};
+
+QByteArray OsmXmlBlockParserTest::node( qint64 id )
+{
+    return QByteArray( "  <node id=\"" ) + QByteArray::number( id ) + "\" lat=\"52.5\" lon=\"13.4\"/>\n";
+}
+
+void OsmXmlBlockParserTest::parse()
+{
+    const QByteArray data =
+        "<?xml version='1.0' encoding='UTF-8'?>\n"
+        "<osm version=\"0.6\" generator=\"test\">\n"
+        "  <bounds minlat=\"52.0\" minlon=\"13.0\" maxlat=\"53.0\" maxlon=\"14.0\"/>\n"
+        "  <!-- <node id=\"99\"/> is commented out -->\n"
+        "  <node id=\"1\" lat=\"52.5163\" lon=\"13.3777\" version=\"3\" user=\"M&amp;M\" visible=\"true\">\n"
+        "    <tag k=\"name\" v=\"Brandenburger Tor\"/>\n"
+        "    <tag k=\"note\" v=\"&lt;&#228;&#xe4;&gt;&quot;&apos;\"/>\n"
+        "  </node>\n"
+        "  <node id=\"2\" lat=\"-33.8568\" lon=\"151.2153\"/>\n"
+        "  <node id='-3' lat='1e-3' lon='0'/>\n"
+        "  <way id=\"10\">\n"
+        "    <nd ref=\"1\"/>\n"
+        "    <nd ref=\"2\"/>\n"
+        "    <tag k=\"highway\" v=\"residential\"/>\n"
+        "  </way>\n"
+        "  <relation id=\"20\">\n"
+        "    <member type=\"way\" ref=\"10\" role=\"outer\"/>\n"
+        "    <tag k=\"type\" v=\"multipolygon\"/>\n"
+        "  </relation>\n"
+        "</osm>\n";
+
+    OsmXmlBlockParser parser( data.constData(), data.constData() + data.size(), true, true );
+    parser.run();
+    parser.waitForFinished();
+    QVERIFY2( !parser.hasError(), qPrintable( parser.errorString() ) );
+
+    OsmNodes &nodes = parser.nodes();
+    nodes.sort();
+    QCOMPARE( nodes.size(), 3 );
+    QVERIFY( !nodes.find( 99 ) );
+
+    const OsmNode *first = nodes.find( 1 );
+    QVERIFY( first );
+    QCOMPARE( first->coordinates().latitude( GeoDataCoordinates::Degree ), 52.5163 );
+    QCOMPARE( first->coordinates().longitude( GeoDataCoordinates::Degree ), 13.3777 );
+    QCOMPARE( first->osmData().version(), QString( "3" ) );
+    QCOMPARE( first->osmData().user(), QString( "M&M" ) );
+    QCOMPARE( first->osmData().isVisible(), QString( "true" ) );
+    QCOMPARE( first->osmData().tagValue( "name" ), QString( "Brandenburger Tor" ) );
+    QCOMPARE( first->osmData().tagValue( "note" ), QString::fromUtf8( "<\xc3\xa4\xc3\xa4>\"'" ) );
+
+    const OsmNode *second = nodes.find( 2 );
+    QVERIFY( second );
+    QCOMPARE( second->coordinates().latitude( GeoDataCoordinates::Degree ), -33.8568 );
+    QCOMPARE( second->coordinates().longitude( GeoDataCoordinates::Degree ), 151.2153 );
+    QVERIFY( second->osmData().isEmpty() );
+
+    const OsmNode *third = nodes.find( -3 );
+    QVERIFY( third );
+    QCOMPARE( third->coordinates().latitude( GeoDataCoordinates::Degree ), 0.001 );
+
+    QCOMPARE( parser.ways().size(), 1 );
+    const OsmWay &way = parser.ways()[10];
+    QCOMPARE( way.references(), QVector<qint64>() << 1 << 2 );
+    QCOMPARE( way.osmData().tagValue( "highway" ), QString( "residential" ) );
+
+    QCOMPARE( parser.relations().size(), 1 );
+    QVERIFY( parser.relations()[20].osmData().containsTag( "type", "multipolygon" ) );
+}
+
+void OsmXmlBlockParserTest::blocks()
+{
+    QByteArray data = "<?xml version=\"1.0\"?>\n<osm version=\"0.6\">\n";
+    for ( int id = 1; id <= 1000; ++id ) {
+        data += node( id );
+    }
+    data += "  <way id=\"1\">\n    <nd ref=\"1\"/>\n    <nd ref=\"1000\"/>\n  </way>\n";
+    data += "</osm>\n";
+
+    const char *const end = data.constData() + data.size();
+    const char *position = data.constData();
+    OsmNodes nodes;
+    int wayCount = 0;
+    int blockCount = 0;
+    while ( position != end ) {
+        const char *const blockEnd = OsmXmlBlockParser::blockEnd( position, end, 1000 );
+        QVERIFY( blockEnd > position );
+        QVERIFY( blockEnd == end || QByteArray( blockEnd, 5 ) == "<node" || QByteArray( blockEnd, 4 ) == "<way" );
+
+        OsmXmlBlockParser parser( position, blockEnd, blockCount == 0, blockEnd == end );
+        parser.run();
+        parser.waitForFinished();
+        QVERIFY2( !parser.hasError(), qPrintable( parser.errorString() ) );
+
+        nodes.append( parser.nodes() );
+        wayCount += parser.ways().size();
+        ++blockCount;
+        position = blockEnd;
+    }
+
+    QVERIFY( blockCount > 10 );
+    QCOMPARE( wayCount, 1 );
+    nodes.sort();
+    QCOMPARE( nodes.size(), 1000 );
+    for ( int id = 1; id <= 1000; ++id ) {
+        QVERIFY( nodes.find( id ) );
+    }
+}
+
+void OsmXmlBlockParserTest::truncated()
+{
+    QByteArray data = "<?xml version=\"1.0\"?>\n<osm version=\"0.6\">\n";
+    for ( int id = 1; id <= 100; ++id ) {
+        data += node( id );
+    }
+    data += "  <way id=\"1\">\n    <nd ref=\"1\"/>\n    <nd ref=\"100\"/>\n";
+
+    const char *const end = data.constData() + data.size();
+    const char *position = data.constData();
+    bool hasError = false;
+    while ( position != end ) {
+        const char *const blockEnd = OsmXmlBlockParser::blockEnd( position, end, 1000 );
+        OsmXmlBlockParser parser( position, blockEnd, position == data.constData(), blockEnd == end );
+        parser.run();
+        parser.waitForFinished();
+
+        // only the last block misses the end tags of the way and of the root
+        QCOMPARE( parser.hasError(), blockEnd == end );
+        hasError = hasError || parser.hasError();
+        position = blockEnd;
+    }
+    QVERIFY( hasError );
+}
+
+void OsmXmlBlockParserTest::unsupported_data()
+{
+    QTest::addColumn<QByteArray>( "data" );
+
+    QTest::newRow( "encoding" ) << QByteArray( "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n<osm/>" );
+    QTest::newRow( "cdata" ) << QByteArray( "<osm><![CDATA[<node id=\"1\"/>]]></osm>" );
+    QTest::newRow( "doctype" ) << QByteArray( "<!DOCTYPE osm>\n<osm/>" );
+    QTest::newRow( "unterminated comment" ) << QByteArray( "<osm><!-- <node id=\"1\"/>" );
+    QTest::newRow( "unterminated tag" ) << QByteArray( "<osm><node id=\"1\"" );
+    QTest::newRow( "unquoted attribute" ) << QByteArray( "<osm><node id=1/></osm>" );
+    QTest::newRow( "no osm file" ) << QByteArray( "<?xml version=\"1.0\"?>\n<kml/>" );
+    QTest::newRow( "unclosed element" ) << QByteArray( "<osm><node id=\"1\"><tag k=\"a\" v=\"b\"/>" );
+    QTest::newRow( "unclosed root" ) << QByteArray( "<osm><node id=\"1\"/>" );
+    QTest::newRow( "mismatched end tag" ) << QByteArray( "<osm><way id=\"1\"></node></osm>" );
+    QTest::newRow( "second root" ) << QByteArray( "<osm></osm><osm></osm>" );
+}
+
+void OsmXmlBlockParserTest::unsupported()
+{
+    QFETCH( QByteArray, data );
+
+    OsmXmlBlockParser parser( data.constData(), data.constData() + data.size(), true, true );
+    parser.run();
+    parser.waitForFinished();
+    QVERIFY( parser.hasError() );
+}
+
+void OsmXmlBlockParserTest::sortNodes()
+{
+    OsmNodes nodes;
+    nodes.append( 5 ).setCoordinates( 5.0, 0.0 );
+    nodes.append( 2 ).setCoordinates( 2.0, 0.0 );
+    nodes.append( 5 ).setCoordinates( 6.0, 0.0 );
+    nodes.append( 1 ).setCoordinates( 1.0, 0.0 );
+    nodes.sort();
+
+    QCOMPARE( nodes.size(), 3 );
+    qint64 previous = 0;
+    for ( const OsmNode &node: nodes ) {
+        QVERIFY( node.osmData().id() > previous );
+        previous = node.osmData().id();
+    }
+
+    // the last node with an id replaces the earlier ones
+    QVERIFY( nodes.find( 5 ) );
+    QCOMPARE( nodes.find( 5 )->coordinates().longitude( GeoDataCoordinates::Degree ), 6.0 );
+    QVERIFY( !nodes.find( 3 ) );
+    QVERIFY( !nodes.find( 6 ) );
+}
+
+}
+
+QTEST_MAIN( Marble::OsmXmlBlockParserTest )
+
+#include "OsmXmlBlockParserTest.moc"
@@ -0,0 +1,131 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PlacemarkGlyphAtlas.h"
+
+#include <QImage>
+#include <QTest>
+
+namespace Marble
+{
+
+class PlacemarkGlyphAtlasTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void insertAndLookup();
+    void packing();
+    void eviction();
+    void oversizedGlyph();
+
+private:
+    static QImage image( int width, int height, const QColor &color );
+};
+
+QImage PlacemarkGlyphAtlasTest::image( int width, int height, const QColor &color )
+{
+    QImage result( width, height, QImage::Format_ARGB32_Premultiplied );
+    result.fill( color );
+    return result;
+}
+
+void PlacemarkGlyphAtlasTest::insertAndLookup()
+{
+    PlacemarkGlyphAtlas atlas( 64, 2 );
+    atlas.beginFrame();
+
+    QVERIFY( !atlas.glyph( "a" ).isValid() );
+
+    const PlacemarkGlyphAtlas::Glyph glyph = atlas.insert( "a", image( 10, 5, Qt::red ) );
+    QVERIFY( glyph.isValid() );
+    QCOMPARE( glyph.rect.size(), QSize( 10, 5 ) );
+    QCOMPARE( atlas.pageCount(), 1 );
+
+    const PlacemarkGlyphAtlas::Glyph found = atlas.glyph( "a" );
+    QCOMPARE( found.page, glyph.page );
+    QCOMPARE( found.rect, glyph.rect );
+    QVERIFY( atlas.use( found ) );
+
+    const QImage page = atlas.page( glyph.page ).toImage();
+    QCOMPARE( QColor( page.pixel( glyph.rect.center() ) ), QColor( Qt::red ) );
+
+    // inserting the same key again keeps the stored glyph
+    QCOMPARE( atlas.insert( "a", image( 10, 5, Qt::blue ) ).rect, glyph.rect );
+}
+
+void PlacemarkGlyphAtlasTest::packing()
+{
+    PlacemarkGlyphAtlas atlas( 64, 2 );
+    atlas.beginFrame();
+
+    QVector<QRect> rects;
+    for ( int i = 0; i < 20; ++i ) {
+        const PlacemarkGlyphAtlas::Glyph glyph = atlas.insert( QString::number( i ), image( 12, 8 + i % 3, Qt::green ) );
+        QVERIFY( glyph.isValid() );
+        QCOMPARE( glyph.page, 0 );
+        QVERIFY( QRect( 0, 0, 64, 64 ).contains( glyph.rect ) );
+        foreach ( const QRect &rect, rects ) {
+            QVERIFY( !rect.intersects( glyph.rect ) );
+        }
+        rects << glyph.rect;
+    }
+    QCOMPARE( atlas.pageCount(), 1 );
+}
+
+void PlacemarkGlyphAtlasTest::eviction()
+{
+    PlacemarkGlyphAtlas atlas( 64, 2 );
+
+    // every glyph fills a page of its own
+    atlas.beginFrame();
+    const PlacemarkGlyphAtlas::Glyph first = atlas.insert( "first", image( 60, 60, Qt::red ) );
+    atlas.beginFrame();
+    const PlacemarkGlyphAtlas::Glyph second = atlas.insert( "second", image( 60, 60, Qt::green ) );
+    QCOMPARE( atlas.pageCount(), 2 );
+
+    // the least recently used page makes room for new glyphs
+    atlas.beginFrame();
+    QVERIFY( atlas.use( second ) );
+    const PlacemarkGlyphAtlas::Glyph third = atlas.insert( "third", image( 60, 60, Qt::blue ) );
+    QVERIFY( third.isValid() );
+    QCOMPARE( atlas.pageCount(), 2 );
+    QVERIFY( !atlas.use( first ) );
+    QVERIFY( !atlas.glyph( "first" ).isValid() );
+    QVERIFY( atlas.use( second ) );
+
+    // pages used in the current frame are kept until the next one
+    const PlacemarkGlyphAtlas::Glyph fourth = atlas.insert( "fourth", image( 60, 60, Qt::white ) );
+    QVERIFY( fourth.isValid() );
+    QCOMPARE( atlas.pageCount(), 3 );
+    QVERIFY( atlas.use( second ) );
+    QVERIFY( atlas.use( third ) );
+
+    // and the atlas shrinks back to its limit at the start of the next one
+    atlas.beginFrame();
+    QCOMPARE( atlas.pageCount(), 2 );
+    QVERIFY( !atlas.use( third ) );
+    QVERIFY( atlas.use( fourth ) );
+}
+
+void PlacemarkGlyphAtlasTest::oversizedGlyph()
+{
+    PlacemarkGlyphAtlas atlas( 64, 2 );
+    atlas.beginFrame();
+
+    const PlacemarkGlyphAtlas::Glyph glyph = atlas.insert( "wide", image( 200, 10, Qt::red ) );
+    QVERIFY( glyph.isValid() );
+    QCOMPARE( glyph.rect.size(), QSize( 200, 10 ) );
+    QVERIFY( atlas.page( glyph.page ).width() >= 200 );
+}
+
+}
+
+QTEST_MAIN( Marble::PlacemarkGlyphAtlasTest )
+
+#include "PlacemarkGlyphAtlasTest.moc"
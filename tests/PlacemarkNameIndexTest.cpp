@@ -0,0 +1,246 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PlacemarkNameIndex.h"
+
+#include "GeoDataDocument.h"
+#include "GeoDataLatLonBox.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataTreeModel.h"
+#include "MarbleModel.h"
+#include "MarblePlacemarkModel.h"
+
+#include <QStandardItemModel>
+#include <QTest>
+
+namespace Marble
+{
+
+class PlacemarkNameIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanup();
+    void normalized_data();
+    void normalized();
+    void find_data();
+    void find();
+    void ranking();
+    void preferred();
+    void limit();
+    void removeRows();
+    void rename();
+    void marbleModel();
+
+private:
+    GeoDataPlacemark *addPlacemark( const QString &name, qreal lon = 0.0, qreal lat = 0.0,
+                                    int zoomLevel = 1, qint64 popularity = 0 );
+    // the copies found by the index, deleted by cleanup()
+    QVector<GeoDataPlacemark *> find( const PlacemarkNameIndex *index, const QString &prefix,
+                                      const GeoDataLatLonBox &preferred, int limit );
+    QStringList names( const QVector<GeoDataPlacemark *> &placemarks ) const;
+
+    QStandardItemModel m_model;
+    QVector<GeoDataPlacemark *> m_placemarks;
+    QVector<GeoDataPlacemark *> m_copies;
+};
+
+GeoDataPlacemark *PlacemarkNameIndexTest::addPlacemark( const QString &name, qreal lon, qreal lat,
+                                                        int zoomLevel, qint64 popularity )
+{
+    GeoDataPlacemark *placemark = new GeoDataPlacemark( name );
+    placemark->setCoordinate( lon, lat, 0.0, GeoDataCoordinates::Degree );
+    placemark->setZoomLevel( zoomLevel );
+    placemark->setPopularity( popularity );
+    m_placemarks << placemark;
+
+    QStandardItem *item = new QStandardItem( name );
+    item->setData( qVariantFromValue( static_cast<GeoDataObject *>( placemark ) ), MarblePlacemarkModel::ObjectPointerRole );
+    m_model.appendRow( item );
+    return placemark;
+}
+
+QVector<GeoDataPlacemark *> PlacemarkNameIndexTest::find( const PlacemarkNameIndex *index, const QString &prefix,
+                                                          const GeoDataLatLonBox &preferred, int limit )
+{
+    const QVector<GeoDataPlacemark *> placemarks = index->find( prefix, preferred, limit );
+    m_copies << placemarks;
+    return placemarks;
+}
+
+QStringList PlacemarkNameIndexTest::names( const QVector<GeoDataPlacemark *> &placemarks ) const
+{
+    QStringList result;
+    foreach ( const GeoDataPlacemark *placemark, placemarks ) {
+        result << placemark->name();
+    }
+    return result;
+}
+
+void PlacemarkNameIndexTest::cleanup()
+{
+    m_model.clear();
+    qDeleteAll( m_placemarks );
+    m_placemarks.clear();
+    qDeleteAll( m_copies );
+    m_copies.clear();
+}
+
+void PlacemarkNameIndexTest::normalized_data()
+{
+    QTest::addColumn<QString>( "name" );
+    QTest::addColumn<QString>( "expected" );
+
+    QTest::newRow( "plain" ) << "berlin" << "berlin";
+    QTest::newRow( "case" ) << "BeRLiN" << "berlin";
+    QTest::newRow( "umlaut" ) << QString::fromUtf8( "Zürich" ) << "zurich";
+    QTest::newRow( "decomposed" ) << QString::fromUtf8( "Zu\xcc\x88rich" ) << "zurich";
+    QTest::newRow( "acute" ) << QString::fromUtf8( "Łódź" ) << "lodz";
+    QTest::newRow( "stroke" ) << QString::fromUtf8( "ØRESUND" ) << "oresund";
+}
+
+void PlacemarkNameIndexTest::normalized()
+{
+    QFETCH( QString, name );
+    QFETCH( QString, expected );
+
+    QCOMPARE( PlacemarkNameIndex::normalized( name ), expected );
+}
+
+void PlacemarkNameIndexTest::find_data()
+{
+    QTest::addColumn<QString>( "prefix" );
+    QTest::addColumn<QStringList>( "expected" );
+
+    QTest::newRow( "two" ) << "zu" << ( QStringList() << "Zug" << QString::fromUtf8( "Zürich" ) );
+    QTest::newRow( "diacritics" ) << QString::fromUtf8( "ZÜR" ) << ( QStringList() << QString::fromUtf8( "Zürich" ) );
+    QTest::newRow( "whole name" ) << "bern" << ( QStringList() << "Bern" );
+    QTest::newRow( "not in the middle" ) << "rich" << QStringList();
+    QTest::newRow( "after the last" ) << "zz" << QStringList();
+    QTest::newRow( "before the first" ) << "aa" << QStringList();
+    QTest::newRow( "empty" ) << "" << QStringList();
+}
+
+void PlacemarkNameIndexTest::find()
+{
+    QFETCH( QString, prefix );
+    QFETCH( QStringList, expected );
+
+    addPlacemark( QString::fromUtf8( "Zürich" ) );
+    addPlacemark( "Berlin" );
+    addPlacemark( "Zug" );
+    addPlacemark( "Bern" );
+    addPlacemark( QString() );
+    const PlacemarkNameIndex index( &m_model );
+    QCOMPARE( index.size(), 4 );
+
+    QCOMPARE( names( find( &index, prefix, GeoDataLatLonBox(), 10 ) ), expected );
+}
+
+void PlacemarkNameIndexTest::ranking()
+{
+    // hamlet, town, city and river, told apart by their longitude
+    addPlacemark( "Springfield", 0.0, 0.0, 9, 1000 );
+    addPlacemark( "Springfield", 1.0, 0.0, 5, 100 );
+    addPlacemark( "Springfield", 2.0, 0.0, 5, 5000 );
+    addPlacemark( "Spring River", 3.0, 0.0, 5, 100 );
+    const PlacemarkNameIndex index( &m_model );
+
+    QList<int> longitudes;
+    foreach ( const GeoDataPlacemark *placemark, find( &index, "spring", GeoDataLatLonBox(), 10 ) ) {
+        longitudes << qRound( placemark->coordinate().longitude( GeoDataCoordinates::Degree ) );
+    }
+    QCOMPARE( longitudes, QList<int>() << 2 << 3 << 1 << 0 );
+}
+
+void PlacemarkNameIndexTest::preferred()
+{
+    addPlacemark( "Far", 10.0, 10.0 );
+    addPlacemark( "Near", 0.1, 0.1 );
+    addPlacemark( "Nearer", 0.01, 0.0 );
+    addPlacemark( "Outside", 50.0, 0.0 );
+    const PlacemarkNameIndex index( &m_model );
+
+    const GeoDataLatLonBox box( 20.0, -20.0, 20.0, -20.0, GeoDataCoordinates::Degree );
+    QCOMPARE( names( find( &index, "n", box, 10 ) ), QStringList() << "Nearer" << "Near" );
+    QCOMPARE( names( find( &index, "", box, 10 ) ), QStringList() );
+    QCOMPARE( find( &index, "o", box, 10 ).size(), 0 );
+    QCOMPARE( find( &index, "o", GeoDataLatLonBox(), 10 ).size(), 1 );
+}
+
+void PlacemarkNameIndexTest::limit()
+{
+    for ( int i = 0; i < 100; ++i ) {
+        addPlacemark( QString( "Place %1" ).arg( i, 2, 10, QLatin1Char( '0' ) ) );
+    }
+    const PlacemarkNameIndex index( &m_model );
+
+    QCOMPARE( find( &index, "place", GeoDataLatLonBox(), 100 ).size(), 100 );
+    // equally popular placemarks come in the order of their names
+    QCOMPARE( names( find( &index, "place", GeoDataLatLonBox(), 3 ) ), QStringList() << "Place 00" << "Place 01" << "Place 02" );
+    QCOMPARE( find( &index, "place", GeoDataLatLonBox(), 0 ).size(), 0 );
+}
+
+void PlacemarkNameIndexTest::removeRows()
+{
+    addPlacemark( "Aachen" );
+    const PlacemarkNameIndex index( &m_model );
+    addPlacemark( "Augsburg" );
+    addPlacemark( "Amsterdam" );
+    QCOMPARE( index.size(), 3 );
+
+    m_model.removeRows( 0, 2 );
+    QCOMPARE( index.size(), 1 );
+    QCOMPARE( names( find( &index, "a", GeoDataLatLonBox(), 10 ) ), QStringList() << "Amsterdam" );
+
+    m_model.clear();
+    QCOMPARE( index.size(), 0 );
+}
+
+void PlacemarkNameIndexTest::rename()
+{
+    GeoDataPlacemark *const placemark = addPlacemark( "Chemnitz" );
+    addPlacemark( "Cottbus" );
+    const PlacemarkNameIndex index( &m_model );
+
+    placemark->setName( "Karl-Marx-Stadt" );
+    m_model.setData( m_model.index( 0, 0 ), placemark->name() );
+
+    QCOMPARE( index.size(), 2 );
+    QCOMPARE( names( find( &index, "c", GeoDataLatLonBox(), 10 ) ), QStringList() << "Cottbus" );
+    QCOMPARE( names( find( &index, "karl", GeoDataLatLonBox(), 10 ) ), QStringList() << "Karl-Marx-Stadt" );
+}
+
+void PlacemarkNameIndexTest::marbleModel()
+{
+    MarbleModel model;
+    const int size = model.placemarkNameIndex()->size();
+
+    GeoDataDocument *document = new GeoDataDocument;
+    GeoDataPlacemark *placemark = new GeoDataPlacemark( QString::fromUtf8( "Qaanaaq Ümännaq" ) );
+    document->append( placemark );
+    model.treeModel()->addDocument( document );
+
+    QCOMPARE( model.placemarkNameIndex()->size(), size + 1 );
+    const QVector<GeoDataPlacemark *> placemarks = find( model.placemarkNameIndex(), "qaanaaq u", GeoDataLatLonBox(), 10 );
+    QCOMPARE( names( placemarks ), QStringList() << placemark->name() );
+    QVERIFY( placemarks.first() != placemark );
+
+    model.treeModel()->removeDocument( document );
+    QCOMPARE( model.placemarkNameIndex()->size(), size );
+    delete document;
+    // the copies outlive the placemarks of the model
+    QCOMPARE( names( placemarks ), QStringList() << QString::fromUtf8( "Qaanaaq Ümännaq" ) );
+}
+
+}
+
+QTEST_MAIN( Marble::PlacemarkNameIndexTest )
+
+#include "PlacemarkNameIndexTest.moc"
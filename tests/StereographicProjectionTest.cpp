@@ -23,6 +23,8 @@ class StereographicProjectionTest : public QObject
 private Q_SLOTS:
     void screenCoordinatesOfCenter_data();
     void screenCoordinatesOfCenter();
+
+    void projectPoints();
 };
 
 void StereographicProjectionTest::screenCoordinatesOfCenter_data()
@@ -58,6 +60,39 @@ void StereographicProjectionTest::screenCoordinatesOfCenter()
     }
 }
 
+void StereographicProjectionTest::projectPoints()
+{
+    ViewportParams viewport;
+    viewport.setProjection( Stereographic );
+    viewport.setRadius( 180 );
+    viewport.setSize( QSize( 400, 300 ) );
+    viewport.centerOn( 10 * DEG2RAD, 40 * DEG2RAD );
+
+    // includes points on the far side of the globe
+    const qreal lon[] = { 0.2, -0.5, 1.0, -2.9, 3.0 };
+    const qreal lat[] = { 0.7, 0.1, 1.2, -0.8, 0.0 };
+    const qreal altitude[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    const int count = 5;
+
+    qreal x[count];
+    qreal y[count];
+    bool globeHidesPoint[count];
+    viewport.currentProjection()->projectPoints( lon, lat, altitude, count, &viewport, x, y, globeHidesPoint );
+
+    for ( int i = 0; i < count; ++i ) {
+        qreal expectedX;
+        qreal expectedY;
+        bool expectedGlobeHidesPoint = false;
+        viewport.screenCoordinates( GeoDataCoordinates( lon[i], lat[i], altitude[i] ), expectedX, expectedY, expectedGlobeHidesPoint );
+
+        QCOMPARE( globeHidesPoint[i], expectedGlobeHidesPoint );
+        if ( !expectedGlobeHidesPoint ) {
+            QFUZZYCOMPARE( x[i], expectedX, 1e-9 );
+            QFUZZYCOMPARE( y[i], expectedY, 1e-9 );
+        }
+    }
+}
+
 }
 
 QTEST_MAIN( Marble::StereographicProjectionTest )
@@ -0,0 +1,224 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "SunShadingMap.h"
+
+#include "MarbleClock.h"
+#include "MarbleGlobal.h"
+#include "MarbleMath.h"
+#include "Planet.h"
+#include "PlanetFactory.h"
+#include "SunLocator.h"
+#include "TileId.h"
+#include "TileLoaderHelper.h"
+
+#include <QImage>
+#include <QTest>
+
+namespace Marble
+{
+
+class SunShadingMapTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    SunShadingMapTest();
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void coverage_data();
+    void coverage();
+    void shade();
+    void shadeComposite();
+
+private:
+    // the exact brightness of the pixel (x, y) of the tile id
+    qreal brightness( const TileId &id, int x, int y ) const;
+    TileId twilightTile( int level ) const;
+
+    static QImage randomImage();
+    static int maximumDifference( const QImage &image1, const QImage &image2 );
+
+    static const int levelZeroColumns = 2;
+    static const int levelZeroRows = 1;
+    static const int tileSize = 256;
+
+    const Planet m_planet;
+    MarbleClock m_clock;
+    SunLocator m_sunLocator;
+};
+
+SunShadingMapTest::SunShadingMapTest() :
+    m_planet( PlanetFactory::construct( "earth" ) ),
+    m_clock(),
+    m_sunLocator( &m_clock, &m_planet )
+{
+}
+
+void SunShadingMapTest::initTestCase()
+{
+    qsrand( 42 );
+    m_clock.setDateTime( QDateTime( QDate( 2016, 3, 20 ), QTime( 15, 30 ), Qt::UTC ) );
+    m_sunLocator.update();
+}
+
+qreal SunShadingMapTest::brightness( const TileId &id, int x, int y ) const
+{
+    const qreal globalWidth = tileSize * TileLoaderHelper::levelToColumn( levelZeroColumns, id.zoomLevel() );
+    const qreal globalHeight = tileSize * TileLoaderHelper::levelToRow( levelZeroRows, id.zoomLevel() );
+    const qreal lon = 2 * M_PI * ( id.x() * tileSize + x ) / globalWidth - M_PI;
+    const qreal lat = 0.5 * M_PI - M_PI * ( id.y() * tileSize + y ) / globalHeight;
+
+    return m_sunLocator.shading( distanceSphere( lon, lat, DEG2RAD * m_sunLocator.getLon(),
+                                                 DEG2RAD * m_sunLocator.getLat() ) );
+}
+
+TileId SunShadingMapTest::twilightTile( int level ) const
+{
+    const int columns = TileLoaderHelper::levelToColumn( levelZeroColumns, level );
+    const int rows = TileLoaderHelper::levelToRow( levelZeroRows, level );
+    for ( int y = 0; y < rows; ++y ) {
+        for ( int x = 0; x < columns; ++x ) {
+            const TileId id( 0, level, x, y );
+            const qreal center = brightness( id, tileSize / 2, tileSize / 2 );
+            if ( center > 0.2 && center < 0.8 ) {
+                return id;
+            }
+        }
+    }
+    return TileId();
+}
+
+QImage SunShadingMapTest::randomImage()
+{
+    QImage image( tileSize, tileSize, QImage::Format_ARGB32_Premultiplied );
+    for ( int y = 0; y < image.height(); ++y ) {
+        for ( int x = 0; x < image.width(); ++x ) {
+            image.setPixel( x, y, qRgb( qrand() % 256, qrand() % 256, qrand() % 256 ) );
+        }
+    }
+    return image;
+}
+
+int SunShadingMapTest::maximumDifference( const QImage &image1, const QImage &image2 )
+{
+    int result = 0;
+    for ( int y = 0; y < image1.height(); ++y ) {
+        for ( int x = 0; x < image1.width(); ++x ) {
+            const QRgb pixel1 = image1.pixel( x, y );
+            const QRgb pixel2 = image2.pixel( x, y );
+            result = qMax( result, qAbs( qRed( pixel1 ) - qRed( pixel2 ) ) );
+            result = qMax( result, qAbs( qGreen( pixel1 ) - qGreen( pixel2 ) ) );
+            result = qMax( result, qAbs( qBlue( pixel1 ) - qBlue( pixel2 ) ) );
+        }
+    }
+    return result;
+}
+
+void SunShadingMapTest::coverage_data()
+{
+    QTest::addColumn<int>( "level" );
+
+    QTest::newRow( "level 1" ) << 1;
+    QTest::newRow( "level 3" ) << 3;
+    QTest::newRow( "level 5" ) << 5;
+}
+
+void SunShadingMapTest::coverage()
+{
+    QFETCH( int, level );
+
+    const int columns = TileLoaderHelper::levelToColumn( levelZeroColumns, level );
+    const int rows = TileLoaderHelper::levelToRow( levelZeroRows, level );
+
+    int daylight = 0;
+    int darkness = 0;
+    for ( int y = 0; y < rows; ++y ) {
+        for ( int x = 0; x < columns; ++x ) {
+            const TileId id( 0, level, x, y );
+            const SunShadingMap::Coverage coverage = SunShadingMap::coverage( &m_sunLocator, m_sunLocator.getLon(), m_sunLocator.getLat(),
+                                                                              id, levelZeroColumns, levelZeroRows );
+            if ( coverage == SunShadingMap::Twilight ) {
+                continue;
+            }
+
+            // the classification must hold for every pixel of the tile
+            const qreal expected = coverage == SunShadingMap::Daylight ? 1.0 : 0.0;
+            for ( int py = 0; py < tileSize; py += 15 ) {
+                for ( int px = 0; px < tileSize; px += 15 ) {
+                    QCOMPARE( brightness( id, px, py ), expected );
+                }
+            }
+
+            daylight += coverage == SunShadingMap::Daylight;
+            darkness += coverage == SunShadingMap::Darkness;
+        }
+    }
+
+    // most tiles get along without looking at any pixel
+    QVERIFY( daylight > 0 );
+    QVERIFY( darkness > 0 );
+}
+
+void SunShadingMapTest::shade()
+{
+    const TileId id = twilightTile( 3 );
+    QVERIFY( id.zoomLevel() == 3 );
+
+    const QImage image = randomImage();
+
+    QImage expected = image;
+    for ( int y = 0; y < tileSize; ++y ) {
+        for ( int x = 0; x < tileSize; ++x ) {
+            QRgb pixel = expected.pixel( x, y );
+            m_sunLocator.shadePixel( pixel, brightness( id, x, y ) );
+            expected.setPixel( x, y, pixel );
+        }
+    }
+
+    const SunShadingMap shadingMap( &m_sunLocator, id, image.size(), levelZeroColumns, levelZeroRows );
+    QCOMPARE( shadingMap.coverage(), SunShadingMap::Twilight );
+
+    QImage result = image;
+    shadingMap.shade( &result );
+
+    QVERIFY( maximumDifference( result, expected ) <= 6 );
+}
+
+void SunShadingMapTest::shadeComposite()
+{
+    const TileId id = twilightTile( 3 );
+    QVERIFY( id.zoomLevel() == 3 );
+
+    const QImage dayImage = randomImage();
+    const QImage nightImage = randomImage();
+
+    QImage expected = dayImage;
+    for ( int y = 0; y < tileSize; ++y ) {
+        for ( int x = 0; x < tileSize; ++x ) {
+            QRgb pixel = expected.pixel( x, y );
+            m_sunLocator.shadePixelComposite( pixel, nightImage.pixel( x, y ), brightness( id, x, y ) );
+            expected.setPixel( x, y, pixel );
+        }
+    }
+
+    const SunShadingMap shadingMap( &m_sunLocator, id, dayImage.size(), levelZeroColumns, levelZeroRows );
+
+    QImage result = dayImage;
+    shadingMap.shadeComposite( &result, nightImage );
+
+    QVERIFY( maximumDifference( result, expected ) <= 6 );
+}
+
+}
+
+QTEST_MAIN( Marble::SunShadingMapTest )
+
+#include "SunShadingMapTest.moc"
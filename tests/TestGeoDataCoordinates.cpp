@@ -12,6 +12,7 @@
 #include "MarbleGlobal.h"
 #include "MarbleWidget.h"
 #include "GeoDataCoordinates.h"
+#include "Quaternion.h"
 #include "TestUtils.h"
 
 #include <QLocale>
@@ -39,6 +40,7 @@ private Q_SLOTS:
     void testAltitude();
     void testOperatorAssignment();
     void testDetail();
+    void testQuaternion();
     void testIsPole_data();
     void testIsPole();
     void testNotation();
@@ -336,6 +338,24 @@ void TestGeoDataCoordinates::testDetail()
     QCOMPARE(coordinates1.detail(), detailnumber);
 }
 
+/*
+ * test quaternion() which is calculated from longitude and latitude
+ */
+void TestGeoDataCoordinates::testQuaternion()
+{
+    GeoDataCoordinates coordinates1(30, 45, 0, GeoDataCoordinates::Degree);
+    GeoDataCoordinates coordinates2(coordinates1);
+    coordinates2.setLongitude(-60, GeoDataCoordinates::Degree);
+
+    const Quaternion expected1 = Quaternion::fromSpherical(30 * DEG2RAD, 45 * DEG2RAD);
+    const Quaternion expected2 = Quaternion::fromSpherical(-60 * DEG2RAD, 45 * DEG2RAD);
+
+    for (int i = 0; i < 4; ++i) {
+        QFUZZYCOMPARE(coordinates1.quaternion().v[i], expected1.v[i], 1e-12);
+        QFUZZYCOMPARE(coordinates2.quaternion().v[i], expected2.v[i], 1e-12);
+    }
+}
+
 /*
  * test setDefaultNotation() and defaultNotation
  */
@@ -26,6 +26,10 @@ private Q_SLOTS:
     void deleteAndDetachTest1();
     void deleteAndDetachTest2();
     void deleteAndDetachTest3();
+    void lineStringArraysTest();
+
+private:
+    static void compareArrays( const GeoDataLineString &line );
 };
 
 void TestGeoDataGeometry::downcastPointTest_data()
@@ -85,6 +89,57 @@ void TestGeoDataGeometry::deleteAndDetachTest3()
     line2 << GeoDataCoordinates();
 }
 
+void TestGeoDataGeometry::compareArrays( const GeoDataLineString &line )
+{
+    const qreal *lon = line.longitudes();
+    const qreal *lat = line.latitudes();
+    const qreal *altitude = line.altitudes();
+    for ( int i = 0; i < line.size(); ++i ) {
+        QCOMPARE( lon[i], line.at( i ).longitude() );
+        QCOMPARE( lat[i], line.at( i ).latitude() );
+        QCOMPARE( altitude[i], line.at( i ).altitude() );
+    }
+}
+
+void TestGeoDataGeometry::lineStringArraysTest()
+{
+    GeoDataLineString line1;
+    line1 << GeoDataCoordinates( 0.1, 0.2, 10 ) << GeoDataCoordinates( 0.3, 0.4, 20 );
+    line1.append( GeoDataCoordinates( 0.5, 0.6, 30 ) );
+    line1.insert( 1, GeoDataCoordinates( 0.7, 0.8, 40 ) );
+    compareArrays( line1 );
+
+    // a copy shares the arrays until one of them gets modified
+    GeoDataLineString line2 = line1;
+    line2.remove( 0 );
+    line2.reverse();
+    compareArrays( line1 );
+    compareArrays( line2 );
+    QCOMPARE( line1.size(), 4 );
+    QCOMPARE( line2.size(), 3 );
+
+    line2.erase( line2.begin() + 1 );
+    compareArrays( line2 );
+
+    // writable nodes get picked up by the next access
+    line2.at( 0 ) = GeoDataCoordinates( 0.9, 1.0, 50 );
+    line2.last().setLongitude( -0.5 );
+    compareArrays( line2 );
+    QCOMPARE( line2.longitudes()[0], qreal( 0.9 ) );
+
+    line2 << GeoDataCoordinates( 1.1, 1.2, 60 );
+    compareArrays( line2 );
+
+    line2.clear();
+    QCOMPARE( line2.size(), 0 );
+    line2 << GeoDataCoordinates( 1.3, 1.4, 70 );
+    compareArrays( line2 );
+
+    // optimizing only assigns detail levels
+    const GeoDataLineString line3 = line1.optimized();
+    compareArrays( line3 );
+}
+
 QTEST_MAIN( TestGeoDataGeometry )
 #include "TestGeoDataGeometry.moc"
 
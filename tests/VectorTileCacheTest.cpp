@@ -0,0 +1,236 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "VectorTileCache.h"
+
+#include "GeoDataDocument.h"
+#include "GeoDataFolder.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPolygon.h"
+#include "GeoDataPolyStyle.h"
+#include "GeoDataStyle.h"
+#include "GeoDataTypes.h"
+#include "OsmPlacemarkData.h"
+#include "TestUtils.h"
+
+#include <QByteArray>
+
+namespace Marble
+{
+
+class VectorTileCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void roundTrip();
+    void unsupportedDocument();
+    void corruptData();
+
+private:
+    static GeoDataDocument *createDocument();
+    static void compareLineStrings( const GeoDataLineString &actual, const GeoDataLineString &expected );
+};
+
+GeoDataDocument *VectorTileCacheTest::createDocument()
+{
+    GeoDataDocument *document = new GeoDataDocument;
+
+    GeoDataPolyStyle polyStyle;
+    polyStyle.setFill( true );
+    polyStyle.setOutline( false );
+    polyStyle.setColor( QColor( "#f1eee8" ) );
+    GeoDataStyle::Ptr style( new GeoDataStyle );
+    style->setPolyStyle( polyStyle );
+    style->setId( "background" );
+    document->addStyle( style );
+
+    GeoDataPlacemark *city = new GeoDataPlacemark( "Karlsruhe" );
+    city->setCoordinate( GeoDataCoordinates( 8.4037, 49.0069, 0, GeoDataCoordinates::Degree ) );
+    city->setVisualCategory( GeoDataFeature::PlaceCity );
+    city->setZoomLevel( 6 );
+    city->setPopularity( 300000 );
+    city->setPopulation( 300000 );
+    city->osmData().setId( 240114842 );
+    city->osmData().addTag( "name", "Karlsruhe" );
+    city->osmData().addTag( "place", "city" );
+    document->append( city );
+
+    GeoDataPlacemark *road = new GeoDataPlacemark( "Kaiserstraße" );
+    GeoDataLineString *lineString = new GeoDataLineString;
+    *lineString << GeoDataCoordinates( 8.3960, 49.0092, 0, GeoDataCoordinates::Degree, 3 )
+                << GeoDataCoordinates( 8.4012, 49.0095, 0, GeoDataCoordinates::Degree, 17 )
+                << GeoDataCoordinates( 8.4103, 49.0101, 0, GeoDataCoordinates::Degree, 3 );
+    road->setGeometry( lineString );
+    road->setVisualCategory( GeoDataFeature::HighwayPedestrian );
+    road->osmData().setId( 4045181 );
+    road->osmData().addTag( "highway", "pedestrian" );
+    road->osmData().addTag( "name", "Kaiserstraße" );
+    document->append( road );
+
+    GeoDataPlacemark *building = new GeoDataPlacemark;
+    GeoDataLinearRing *ring = new GeoDataLinearRing;
+    *ring << GeoDataCoordinates( 8.4001, 49.0081, 0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 8.4005, 49.0081, 0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 8.4005, 49.0084, 0, GeoDataCoordinates::Degree );
+    building->setGeometry( ring );
+    building->setVisualCategory( GeoDataFeature::Building );
+    building->setVisible( true );
+    building->osmData().setId( 23421 );
+    building->osmData().addTag( "building", "yes" );
+    OsmPlacemarkData entrance;
+    entrance.setId( 1234 );
+    entrance.addTag( "addr:housenumber", "42" );
+    building->osmData().addNodeReference( ring->at( 1 ), entrance );
+    OsmPlacemarkData untagged;
+    untagged.setId( 1235 );
+    building->osmData().addNodeReference( ring->at( 2 ), untagged );
+    document->append( building );
+
+    GeoDataPlacemark *park = new GeoDataPlacemark( "Schlossgarten" );
+    GeoDataLinearRing outer;
+    outer << GeoDataCoordinates( -0.001, -0.001, 0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 0.001, -0.001, 0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 0.001, 0.001, 0, GeoDataCoordinates::Degree );
+    GeoDataLinearRing inner;
+    inner << GeoDataCoordinates( 0.0001, -0.0001, 0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 0.0002, -0.0001, 0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 0.0002, 0.0001, 0, GeoDataCoordinates::Degree );
+    GeoDataPolygon *polygon = new GeoDataPolygon;
+    polygon->setOuterBoundary( outer );
+    polygon->appendInnerBoundary( inner );
+    park->setGeometry( polygon );
+    park->setVisualCategory( GeoDataFeature::LeisurePark );
+    park->osmData().setId( -17 );
+    park->osmData().addTag( "leisure", "park" );
+    OsmPlacemarkData outerWay;
+    outerWay.setId( 55 );
+    outerWay.addTag( "barrier", "fence" );
+    park->osmData().addMemberReference( -1, outerWay );
+    document->append( park );
+
+    return document;
+}
+
+void VectorTileCacheTest::compareLineStrings( const GeoDataLineString &actual, const GeoDataLineString &expected )
+{
+    QCOMPARE( actual.size(), expected.size() );
+    for ( int i = 0; i < expected.size(); ++i ) {
+        QFUZZYCOMPARE( actual.at( i ).longitude(), expected.at( i ).longitude(), 1e-9 );
+        QFUZZYCOMPARE( actual.at( i ).latitude(), expected.at( i ).latitude(), 1e-9 );
+        QCOMPARE( actual.at( i ).detail(), expected.at( i ).detail() );
+    }
+}
+
+void VectorTileCacheTest::roundTrip()
+{
+    QScopedPointer<GeoDataDocument> original( createDocument() );
+
+    QByteArray data;
+    QVERIFY( VectorTileCache::write( *original, data ) );
+
+    QScopedPointer<GeoDataDocument> document( VectorTileCache::read( reinterpret_cast<const uchar *>( data.constData() ), data.size() ) );
+    QVERIFY( document );
+
+    QCOMPARE( document->styles().size(), 1 );
+    QCOMPARE( document->styles().first()->id(), QString( "background" ) );
+    QCOMPARE( document->styles().first()->polyStyle().color(), QColor( "#f1eee8" ) );
+    QCOMPARE( document->styles().first()->polyStyle().fill(), true );
+    QCOMPARE( document->styles().first()->polyStyle().outline(), false );
+
+    const QVector<GeoDataPlacemark *> placemarks = document->placemarkList();
+    QCOMPARE( placemarks.size(), 4 );
+
+    const GeoDataPlacemark *city = placemarks[0];
+    QCOMPARE( city->name(), QString( "Karlsruhe" ) );
+    QCOMPARE( city->visualCategory(), GeoDataFeature::PlaceCity );
+    QCOMPARE( city->zoomLevel(), 6 );
+    QCOMPARE( city->popularity(), qint64( 300000 ) );
+    QCOMPARE( city->population(), qint64( 300000 ) );
+    QCOMPARE( city->osmData().id(), qint64( 240114842 ) );
+    QCOMPARE( city->osmData().tagValue( "place" ), QString( "city" ) );
+    QCOMPARE( city->geometry()->nodeType(), GeoDataTypes::GeoDataPointType );
+    QFUZZYCOMPARE( city->coordinate().longitude( GeoDataCoordinates::Degree ), 8.4037, 1e-7 );
+    QFUZZYCOMPARE( city->coordinate().latitude( GeoDataCoordinates::Degree ), 49.0069, 1e-7 );
+
+    const GeoDataPlacemark *road = placemarks[1];
+    QCOMPARE( road->name(), QString( "Kaiserstraße" ) );
+    QCOMPARE( road->visualCategory(), GeoDataFeature::HighwayPedestrian );
+    QCOMPARE( road->geometry()->nodeType(), GeoDataTypes::GeoDataLineStringType );
+    compareLineStrings( *static_cast<const GeoDataLineString *>( road->geometry() ),
+                        *static_cast<const GeoDataLineString *>( original->placemarkList()[1]->geometry() ) );
+
+    const GeoDataPlacemark *building = placemarks[2];
+    QCOMPARE( building->geometry()->nodeType(), GeoDataTypes::GeoDataLinearRingType );
+    const GeoDataLinearRing *ring = static_cast<const GeoDataLinearRing *>( building->geometry() );
+    compareLineStrings( *ring, *static_cast<const GeoDataLinearRing *>( original->placemarkList()[2]->geometry() ) );
+    QVERIFY( building->osmData().containsNodeReference( ring->at( 1 ) ) );
+    QCOMPARE( building->osmData().nodeReference( ring->at( 1 ) ).tagValue( "addr:housenumber" ), QString( "42" ) );
+    QCOMPARE( building->osmData().nodeReference( ring->at( 1 ) ).id(), qint64( 1234 ) );
+    // nodes without tags are not stored
+    QVERIFY( !building->osmData().containsNodeReference( ring->at( 2 ) ) );
+
+    const GeoDataPlacemark *park = placemarks[3];
+    QCOMPARE( park->osmData().id(), qint64( -17 ) );
+    QCOMPARE( park->geometry()->nodeType(), GeoDataTypes::GeoDataPolygonType );
+    const GeoDataPolygon *polygon = static_cast<const GeoDataPolygon *>( park->geometry() );
+    const GeoDataPolygon *originalPolygon = static_cast<const GeoDataPolygon *>( original->placemarkList()[3]->geometry() );
+    compareLineStrings( polygon->outerBoundary(), originalPolygon->outerBoundary() );
+    QCOMPARE( polygon->innerBoundaries().size(), 1 );
+    compareLineStrings( polygon->innerBoundaries().first(), originalPolygon->innerBoundaries().first() );
+    QVERIFY( park->osmData().containsMemberReference( -1 ) );
+    QCOMPARE( park->osmData().memberReference( -1 ).tagValue( "barrier" ), QString( "fence" ) );
+}
+
+void VectorTileCacheTest::unsupportedDocument()
+{
+    GeoDataDocument document;
+    document.append( new GeoDataFolder );
+
+    QByteArray data;
+    QVERIFY( !VectorTileCache::write( document, data ) );
+
+    GeoDataDocument elevated;
+    GeoDataPlacemark *peak = new GeoDataPlacemark;
+    peak->setCoordinate( GeoDataCoordinates( 0.1, 0.2, 4000 ) );
+    elevated.append( peak );
+    QVERIFY( !VectorTileCache::write( elevated, data ) );
+
+    GeoDataDocument elevatedNode;
+    GeoDataPlacemark *hut = new GeoDataPlacemark;
+    hut->setCoordinate( GeoDataCoordinates( 0.1, 0.2 ) );
+    OsmPlacemarkData summit;
+    summit.addTag( "natural", "peak" );
+    hut->osmData().addNodeReference( GeoDataCoordinates( 0.1, 0.2, 4000 ), summit );
+    elevatedNode.append( hut );
+    QVERIFY( !VectorTileCache::write( elevatedNode, data ) );
+}
+
+void VectorTileCacheTest::corruptData()
+{
+    QScopedPointer<GeoDataDocument> original( createDocument() );
+
+    QByteArray data;
+    QVERIFY( VectorTileCache::write( *original, data ) );
+
+    // any truncation has to be detected
+    for ( int size = 0; size < data.size(); ++size ) {
+        QScopedPointer<GeoDataDocument> document( VectorTileCache::read( reinterpret_cast<const uchar *>( data.constData() ), size ) );
+        QVERIFY( !document );
+    }
+
+    data[0] = 'X';
+    QVERIFY( !VectorTileCache::read( reinterpret_cast<const uchar *>( data.constData() ), data.size() ) );
+}
+
+}
+
+QTEST_MAIN( Marble::VectorTileCacheTest )
+
+#include "VectorTileCacheTest.moc"
@@ -0,0 +1,115 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "RenderRequest.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtMath>
+
+namespace Marble {
+
+RenderRequest::RenderRequest() :
+    lon(0.0),
+    lat(0.0),
+    radius(radiusForZoom(2)),
+    size(512, 512),
+    mapThemeId(QStringLiteral("earth/openstreetmap/openstreetmap.dgml")),
+    projection(Mercator),
+    quality(-1)
+{
+}
+
+RenderRequest RenderRequest::fromJson(const QByteArray &line, const RenderRequest &defaults, QString *error)
+{
+    RenderRequest request = defaults;
+    request.output.clear();
+
+    QJsonParseError parseError;
+    QJsonDocument const document = QJsonDocument::fromJson(line, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        *error = QStringLiteral("Invalid JSON: %1").arg(parseError.errorString());
+        return request;
+    }
+
+    QJsonObject const object = document.object();
+    request.id = object.value(QStringLiteral("id")).toVariant().toString();
+    request.lon = object.value(QStringLiteral("lon")).toDouble(defaults.lon);
+    request.lat = object.value(QStringLiteral("lat")).toDouble(defaults.lat);
+    if (object.contains(QStringLiteral("radius"))) {
+        request.radius = object.value(QStringLiteral("radius")).toInt(defaults.radius);
+    } else if (object.contains(QStringLiteral("zoom"))) {
+        request.radius = radiusForZoom(object.value(QStringLiteral("zoom")).toDouble());
+    }
+    request.size.setWidth(object.value(QStringLiteral("width")).toInt(defaults.size.width()));
+    request.size.setHeight(object.value(QStringLiteral("height")).toInt(defaults.size.height()));
+    request.mapThemeId = object.value(QStringLiteral("theme")).toString(defaults.mapThemeId);
+    if (object.contains(QStringLiteral("projection"))
+            && !parseProjection(object.value(QStringLiteral("projection")).toString(), request.projection)) {
+        *error = QStringLiteral("Unknown projection %1").arg(object.value(QStringLiteral("projection")).toString());
+        return request;
+    }
+    request.format = object.value(QStringLiteral("format")).toString(QString::fromLatin1(defaults.format)).toLatin1();
+    request.quality = object.value(QStringLiteral("quality")).toInt(defaults.quality);
+
+    QString const output = object.value(QStringLiteral("output")).toString();
+    if (output.isEmpty()) {
+        *error = QStringLiteral("No output file given");
+        return request;
+    }
+    if (request.size.isEmpty() || request.size.width() > 16384 || request.size.height() > 16384) {
+        *error = QStringLiteral("Invalid image size %1x%2").arg(request.size.width()).arg(request.size.height());
+        return request;
+    }
+    if (request.radius <= 0) {
+        *error = QStringLiteral("Invalid radius %1").arg(request.radius);
+        return request;
+    }
+
+    request.output = output;
+    return request;
+}
+
+bool RenderRequest::parseProjection(const QString &name, Projection &projection)
+{
+    QString const key = name.toLower();
+    if (key == QLatin1String("spherical") || key == QLatin1String("globe")) {
+        projection = Spherical;
+    } else if (key == QLatin1String("equirectangular") || key == QLatin1String("flat")) {
+        projection = Equirectangular;
+    } else if (key == QLatin1String("mercator")) {
+        projection = Mercator;
+    } else if (key == QLatin1String("gnomonic")) {
+        projection = Gnomonic;
+    } else if (key == QLatin1String("stereographic")) {
+        projection = Stereographic;
+    } else if (key == QLatin1String("lambert")) {
+        projection = LambertAzimuthal;
+    } else if (key == QLatin1String("azimuthal")) {
+        projection = AzimuthalEquidistant;
+    } else if (key == QLatin1String("perspective")) {
+        projection = VerticalPerspective;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int RenderRequest::radiusForZoom(qreal zoom)
+{
+    // The flat maps are four radii wide, the OpenStreetMap world is 256 pixels
+    // wide at zoom level 0.
+    return qRound(64.0 * qPow(2.0, qBound<qreal>(0.0, zoom, 20.0)));
+}
+
+bool RenderRequest::isValid() const
+{
+    return !output.isEmpty();
+}
+
+}
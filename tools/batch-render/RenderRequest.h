@@ -0,0 +1,66 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_RENDERREQUEST_H
+#define MARBLE_RENDERREQUEST_H
+
+#include <MarbleGlobal.h>
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QPointer>
+#include <QSize>
+#include <QString>
+
+namespace Marble {
+
+/**
+ * A single map image to render, read from one line of JSON like
+ *
+ * {"id": "berlin", "lon": 13.4, "lat": 52.5, "zoom": 11, "width": 512, "height": 512,
+ *  "theme": "earth/openstreetmap/openstreetmap.dgml", "projection": "mercator",
+ *  "output": "berlin.png", "quality": 90}
+ *
+ * Values not given are taken from the defaults passed to fromJson().
+ */
+class RenderRequest
+{
+public:
+    RenderRequest();
+
+    /**
+     * Parses @p line. Returns a request without an output file and sets
+     * @p error if the line can't be parsed.
+     */
+    static RenderRequest fromJson(const QByteArray &line, const RenderRequest &defaults, QString *error);
+
+    static bool parseProjection(const QString &name, Projection &projection);
+
+    /// The radius of the globe for the OpenStreetMap zoom level @p zoom
+    static int radiusForZoom(qreal zoom);
+
+    bool isValid() const;
+
+    QString id;
+    qreal lon;  // degrees
+    qreal lat;  // degrees
+    int radius;
+    QSize size;
+    QString mapThemeId;
+    Projection projection;
+    QString output;
+    QByteArray format;  // empty to guess it from the output file name
+    int quality;        // -1 for the default of the image format
+
+    // where the result gets reported to, null once the client is gone
+    QPointer<QIODevice> replyDevice;
+};
+
+}
+
+#endif
@@ -0,0 +1,270 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "RenderService.h"
+
+#include "RenderWorker.h"
+
+#include <MarbleModel.h>
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace Marble {
+
+namespace {
+
+// number of latencies the percentiles are computed from
+const int MaximumLatencyCount = 10000;
+
+}
+
+RenderService::RenderService(MarbleModel *model, int workerCount, int timeout, bool showOverlays, QObject *parent) :
+    QObject(parent),
+    m_model(model),
+    m_rendered(0),
+    m_incomplete(0),
+    m_failed(0)
+{
+    for (int i = 0; i < workerCount; ++i) {
+        RenderWorker *const worker = new RenderWorker(m_model, timeout, showOverlays, this);
+        connect(worker, SIGNAL(finished(Marble::RenderRequest,Marble::RenderResult)),
+                this, SLOT(finishRequest(Marble::RenderRequest,Marble::RenderResult)));
+        m_workers << worker;
+    }
+
+    m_standardOutput.open(stdout, QIODevice::WriteOnly);
+
+    connect(&m_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+    connect(&m_statisticsTimer, SIGNAL(timeout()), this, SLOT(printStatistics()));
+
+    m_uptime.start();
+}
+
+void RenderService::setDefaults(const RenderRequest &defaults)
+{
+    m_defaults = defaults;
+}
+
+bool RenderService::listen(const QString &socketName)
+{
+    QLocalServer::removeServer(socketName);
+    return m_server.listen(socketName);
+}
+
+QString RenderService::errorString() const
+{
+    return m_server.errorString();
+}
+
+void RenderService::setStatisticsInterval(int seconds)
+{
+    if (seconds > 0) {
+        m_statisticsTimer.start(1000 * seconds);
+    } else {
+        m_statisticsTimer.stop();
+    }
+}
+
+QJsonObject RenderService::statistics() const
+{
+    QVector<qint64> latencies = m_latencies;
+    std::sort(latencies.begin(), latencies.end());
+    auto const percentile = [&latencies](int percent) {
+        return latencies.isEmpty() ? qint64(0) : latencies[(latencies.size() - 1) * percent / 100];
+    };
+
+    qint64 total = 0;
+    for (qint64 latency: latencies) {
+        total += latency;
+    }
+
+    qreal const seconds = m_uptime.elapsed() / 1000.0;
+
+    QJsonObject result;
+    result[QStringLiteral("rendered")] = m_rendered;
+    result[QStringLiteral("incomplete")] = m_incomplete;
+    result[QStringLiteral("failed")] = m_failed;
+    result[QStringLiteral("queued")] = m_queue.size();
+    result[QStringLiteral("imagesPerSecond")] = seconds > 0 ? m_rendered / seconds : 0.0;
+    result[QStringLiteral("meanMs")] = latencies.isEmpty() ? 0.0 : qreal(total) / latencies.size();
+    result[QStringLiteral("p50Ms")] = percentile(50);
+    result[QStringLiteral("p95Ms")] = percentile(95);
+    result[QStringLiteral("maxMs")] = latencies.isEmpty() ? qint64(0) : latencies.last();
+    return result;
+}
+
+bool RenderService::isIdle() const
+{
+    if (!m_queue.isEmpty()) {
+        return false;
+    }
+    for (const RenderWorker *worker: m_workers) {
+        if (worker->isBusy()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RenderService::addStandardInputRequest(const QByteArray &line)
+{
+    addRequest(line, &m_standardOutput);
+}
+
+void RenderService::addRequest(const QByteArray &line, QIODevice *replyDevice)
+{
+    // {"command": "statistics"} asks for the numbers instead of an image
+    QJsonObject const command = QJsonDocument::fromJson(line).object();
+    if (command.value(QStringLiteral("command")).toString() == QLatin1String("statistics")) {
+        reply(replyDevice, statistics());
+        return;
+    }
+
+    QString error;
+    RenderRequest request = RenderRequest::fromJson(line, m_defaults, &error);
+    request.replyDevice = replyDevice;
+    if (!request.isValid()) {
+        fail(request, error);
+        return;
+    }
+
+    m_queue.enqueue(request);
+    dispatch();
+}
+
+void RenderService::printStatistics()
+{
+    fprintf(stderr, "%s\n", QJsonDocument(statistics()).toJson(QJsonDocument::Compact).constData());
+}
+
+void RenderService::acceptConnection()
+{
+    while (QLocalSocket *const socket = m_server.nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readConnection()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void RenderService::readConnection()
+{
+    QLocalSocket *const socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket) {
+        return;
+    }
+
+    while (socket->canReadLine()) {
+        QByteArray const line = socket->readLine().trimmed();
+        if (!line.isEmpty()) {
+            addRequest(line, socket);
+        }
+    }
+}
+
+void RenderService::finishRequest(const RenderRequest &request, const RenderResult &result)
+{
+    if (result.success) {
+        ++m_rendered;
+        if (!result.complete) {
+            ++m_incomplete;
+        }
+        if (m_latencies.size() >= MaximumLatencyCount) {
+            m_latencies.remove(0, MaximumLatencyCount / 10);
+        }
+        m_latencies << result.elapsed;
+    } else {
+        ++m_failed;
+    }
+
+    QJsonObject answer;
+    answer[QStringLiteral("id")] = request.id;
+    answer[QStringLiteral("output")] = request.output;
+    answer[QStringLiteral("status")] = result.success ? QStringLiteral("ok") : QStringLiteral("error");
+    if (!result.success) {
+        answer[QStringLiteral("error")] = result.error;
+    }
+    answer[QStringLiteral("complete")] = result.complete;
+    answer[QStringLiteral("ms")] = result.elapsed;
+    answer[QStringLiteral("paints")] = result.paintCount;
+    reply(request.replyDevice, answer);
+
+    dispatch();
+}
+
+void RenderService::dispatch()
+{
+    while (!m_queue.isEmpty()) {
+        if (m_queue.head().mapThemeId != m_model->mapThemeId()) {
+            // the map theme is shared by all workers
+            for (const RenderWorker *worker: m_workers) {
+                if (worker->isBusy()) {
+                    return;
+                }
+            }
+
+            m_model->setMapThemeId(m_queue.head().mapThemeId);
+            if (m_queue.head().mapThemeId != m_model->mapThemeId()) {
+                const RenderRequest request = m_queue.dequeue();
+                fail(request, QStringLiteral("Unknown map theme %1").arg(request.mapThemeId));
+                continue;
+            }
+        }
+
+        RenderWorker *idleWorker = nullptr;
+        for (RenderWorker *worker: m_workers) {
+            if (!worker->isBusy()) {
+                idleWorker = worker;
+                break;
+            }
+        }
+        if (!idleWorker) {
+            return;
+        }
+
+        idleWorker->render(m_queue.dequeue());
+    }
+
+    if (isIdle()) {
+        emit idle();
+    }
+}
+
+void RenderService::reply(QIODevice *replyDevice, const QJsonObject &reply)
+{
+    if (!replyDevice) {
+        // the client disconnected in the meantime
+        return;
+    }
+
+    replyDevice->write(QJsonDocument(reply).toJson(QJsonDocument::Compact));
+    replyDevice->write("\n");
+    if (replyDevice == &m_standardOutput) {
+        m_standardOutput.flush();
+    }
+}
+
+void RenderService::fail(const RenderRequest &request, const QString &error)
+{
+    ++m_failed;
+
+    QJsonObject answer;
+    answer[QStringLiteral("id")] = request.id;
+    answer[QStringLiteral("status")] = QStringLiteral("error");
+    answer[QStringLiteral("error")] = error;
+    reply(request.replyDevice, answer);
+
+    if (isIdle()) {
+        emit idle();
+    }
+}
+
+}
@@ -0,0 +1,96 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_RENDERSERVICE_H
+#define MARBLE_RENDERSERVICE_H
+
+#include "RenderRequest.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QLocalServer>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QVector>
+
+class QJsonObject;
+
+namespace Marble {
+
+class MarbleModel;
+class RenderResult;
+class RenderWorker;
+
+/**
+ * Distributes render requests read from the standard input or a local
+ * socket to a pool of workers sharing one MarbleModel.
+ *
+ * The model holds a single map theme at a time, so requests for another
+ * theme wait until all running requests are done. Every request is
+ * answered with one line of JSON on the device it was read from.
+ */
+class RenderService : public QObject
+{
+    Q_OBJECT
+
+public:
+    RenderService(MarbleModel *model, int workerCount, int timeout, bool showOverlays, QObject *parent = nullptr);
+
+    void setDefaults(const RenderRequest &defaults);
+
+    bool listen(const QString &socketName);
+    QString errorString() const;
+
+    /// Reports the throughput every @p seconds on the standard error, 0 to turn it off
+    void setStatisticsInterval(int seconds);
+
+    QJsonObject statistics() const;
+
+    bool isIdle() const;
+
+public Q_SLOTS:
+    /// Handles the request in @p line, answering on @p replyDevice
+    void addRequest(const QByteArray &line, QIODevice *replyDevice);
+    void addStandardInputRequest(const QByteArray &line);
+
+    void printStatistics();
+
+Q_SIGNALS:
+    /// All requests received so far have been answered.
+    void idle();
+
+private Q_SLOTS:
+    void acceptConnection();
+    void readConnection();
+    void finishRequest(const Marble::RenderRequest &request, const Marble::RenderResult &result);
+
+private:
+    void dispatch();
+    void reply(QIODevice *replyDevice, const QJsonObject &reply);
+    void fail(const RenderRequest &request, const QString &error);
+
+    MarbleModel *const m_model;
+    QList<RenderWorker *> m_workers;
+    QQueue<RenderRequest> m_queue;
+    RenderRequest m_defaults;
+    QLocalServer m_server;
+    QFile m_standardOutput;
+    QTimer m_statisticsTimer;
+
+    QElapsedTimer m_uptime;
+    int m_rendered;
+    int m_incomplete;
+    int m_failed;
+    QVector<qint64> m_latencies;  // milliseconds, of the rendered images
+};
+
+}
+
+#endif
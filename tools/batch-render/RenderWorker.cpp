@@ -0,0 +1,128 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "RenderWorker.h"
+
+#include <GeoPainter.h>
+#include <MarbleModel.h>
+#include <ViewportParams.h>
+
+#include <QImageWriter>
+
+namespace Marble {
+
+RenderWorker::RenderWorker(MarbleModel *model, int timeout, bool showOverlays, QObject *parent) :
+    QObject(parent),
+    m_map(model),
+    m_busy(false)
+{
+    m_map.setViewContext(Still);
+    if (!showOverlays) {
+        m_map.setShowOverviewMap(false);
+        m_map.setShowScaleBar(false);
+        m_map.setShowCompass(false);
+    }
+
+    // Tiles tend to arrive in bursts, paint once for each of them.
+    m_repaintTimer.setSingleShot(true);
+    m_repaintTimer.setInterval(20);
+    connect(&m_repaintTimer, SIGNAL(timeout()), this, SLOT(paint()));
+    connect(&m_map, SIGNAL(repaintNeeded(QRegion)), &m_repaintTimer, SLOT(start()));
+
+    m_timeoutTimer.setSingleShot(true);
+    m_timeoutTimer.setInterval(timeout);
+    connect(&m_timeoutTimer, SIGNAL(timeout()), this, SLOT(abort()));
+}
+
+bool RenderWorker::isBusy() const
+{
+    return m_busy;
+}
+
+void RenderWorker::render(const RenderRequest &request)
+{
+    Q_ASSERT(!m_busy);
+
+    m_busy = true;
+    m_request = request;
+    m_result = RenderResult();
+    m_elapsed.start();
+
+    m_map.setSize(request.size);
+    m_map.setProjection(request.projection);
+    m_map.centerOn(request.lon, request.lat);
+    m_map.setRadius(request.radius);
+
+    if (m_image.size() != request.size) {
+        m_image = QImage(request.size, QImage::Format_ARGB32_Premultiplied);
+    }
+
+    m_timeoutTimer.start();
+    m_repaintTimer.start();
+}
+
+void RenderWorker::paint()
+{
+    if (!m_busy) {
+        return;
+    }
+
+    m_image.fill(Qt::transparent);
+    {
+        GeoPainter painter(&m_image, m_map.viewport(), m_map.mapQuality());
+        m_map.paint(painter, QRect(QPoint(0, 0), m_image.size()));
+    }
+    ++m_result.paintCount;
+
+    switch (m_map.renderStatus()) {
+    case Complete:
+        finish(true);
+        break;
+    case Incomplete:
+        // some data failed to load, waiting won't help
+        finish(false);
+        break;
+    case WaitingForUpdate:
+    case WaitingForData:
+        break;
+    }
+}
+
+void RenderWorker::abort()
+{
+    if (m_busy) {
+        m_repaintTimer.stop();
+        paint();
+        if (m_busy) {
+            finish(false);
+        }
+    }
+}
+
+void RenderWorker::finish(bool complete)
+{
+    m_repaintTimer.stop();
+    m_timeoutTimer.stop();
+
+    QImageWriter writer(m_request.output, m_request.format);
+    if (m_request.quality >= 0) {
+        writer.setQuality(m_request.quality);
+    }
+
+    m_result.complete = complete;
+    m_result.success = writer.write(m_image);
+    if (!m_result.success) {
+        m_result.error = writer.errorString();
+    }
+    m_result.elapsed = m_elapsed.elapsed();
+    m_busy = false;
+
+    emit finished(m_request, m_result);
+}
+
+}
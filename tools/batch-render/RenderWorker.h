@@ -0,0 +1,79 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_RENDERWORKER_H
+#define MARBLE_RENDERWORKER_H
+
+#include "RenderRequest.h"
+
+#include <MarbleMap.h>
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QObject>
+#include <QTimer>
+
+namespace Marble {
+
+class MarbleModel;
+
+class RenderResult
+{
+public:
+    RenderResult() : success(false), complete(false), elapsed(0), paintCount(0) {}
+
+    bool success;
+    // false if the image was saved before all tiles arrived
+    bool complete;
+    QString error;
+    qint64 elapsed;  // milliseconds
+    int paintCount;
+};
+
+/**
+ * Renders requests one after another with a MarbleMap of its own.
+ *
+ * The map gets painted again whenever it asks for a repaint, until all
+ * data is there or the timeout expires. The tiles and documents loaded by
+ * the model are shared with all the other workers, the texture tiles
+ * already decoded by the map are kept for the next request.
+ */
+class RenderWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    RenderWorker(MarbleModel *model, int timeout, bool showOverlays, QObject *parent = nullptr);
+
+    bool isBusy() const;
+
+    void render(const RenderRequest &request);
+
+Q_SIGNALS:
+    void finished(const Marble::RenderRequest &request, const Marble::RenderResult &result);
+
+private Q_SLOTS:
+    void paint();
+    void abort();
+
+private:
+    void finish(bool complete);
+
+    MarbleMap m_map;
+    QImage m_image;
+    RenderRequest m_request;
+    RenderResult m_result;
+    QElapsedTimer m_elapsed;
+    QTimer m_repaintTimer;
+    QTimer m_timeoutTimer;
+    bool m_busy;
+};
+
+}
+
+#endif
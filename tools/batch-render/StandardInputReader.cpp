@@ -0,0 +1,39 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "StandardInputReader.h"
+
+#include <QFile>
+
+#include <cstdio>
+
+namespace Marble {
+
+StandardInputReader::StandardInputReader(QObject *parent) :
+    QThread(parent)
+{
+}
+
+void StandardInputReader::run()
+{
+    QFile input;
+    if (input.open(stdin, QIODevice::ReadOnly)) {
+        // readLine() keeps the newline, so only the end of the input
+        // yields an empty line
+        for (QByteArray line = input.readLine(); !line.isEmpty(); line = input.readLine()) {
+            line = line.trimmed();
+            if (!line.isEmpty()) {
+                emit lineRead(line);
+            }
+        }
+    }
+
+    emit endOfInput();
+}
+
+}
@@ -0,0 +1,38 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_STANDARDINPUTREADER_H
+#define MARBLE_STANDARDINPUTREADER_H
+
+#include <QByteArray>
+#include <QThread>
+
+namespace Marble {
+
+/**
+ * Reads the standard input line by line without blocking the event loop,
+ * which isn't possible with QFile or QSocketNotifier on every platform.
+ */
+class StandardInputReader : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit StandardInputReader(QObject *parent = nullptr);
+
+Q_SIGNALS:
+    void lineRead(const QByteArray &line);
+    void endOfInput();
+
+protected:
+    void run() override;
+};
+
+}
+
+#endif
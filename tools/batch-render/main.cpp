@@ -0,0 +1,118 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "RenderRequest.h"
+#include "RenderService.h"
+#include "StandardInputReader.h"
+
+#include <MarbleModel.h>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QThread>
+
+using namespace Marble;
+
+int main(int argc, char** argv)
+{
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("batch-render");
+    QCoreApplication::setApplicationVersion("0.1");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders map images for requests read line by line as JSON objects "
+                                     "from the standard input or a local socket, e.g.\n"
+                                     "{\"id\": \"berlin\", \"lon\": 13.4, \"lat\": 52.5, \"zoom\": 11, \"width\": 512, \"height\": 512, "
+                                     "\"theme\": \"earth/openstreetmap/openstreetmap.dgml\", \"projection\": \"mercator\", "
+                                     "\"output\": \"berlin.png\", \"quality\": 90}\n"
+                                     "Each request is answered with a line of JSON. {\"command\": \"statistics\"} "
+                                     "returns the throughput so far.\n"
+                                     "Run with QT_QPA_PLATFORM=offscreen on machines without a display.");
+    auto const helpOption = parser.addHelpOption();
+    auto const versionOption = parser.addVersionOption();
+    parser.addOptions({
+                          {{"s", "socket"}, "Listen on the local socket <name> instead of reading the standard input", "name"},
+                          {{"j", "workers"}, "Render up to <workers> images at a time", "workers", QString::number(QThread::idealThreadCount())},
+                          {"timeout", "Save the image after <timeout> milliseconds even if data is still missing", "timeout", "30000"},
+                          {"theme", "Default map theme", "theme", "earth/openstreetmap/openstreetmap.dgml"},
+                          {"projection", "Default projection: spherical, equirectangular, mercator, gnomonic, stereographic, lambert, azimuthal or perspective", "projection", "mercator"},
+                          {"size", "Default image size", "WxH", "512x512"},
+                          {"format", "Default image format, guessed from the output file name if empty", "format"},
+                          {"quality", "Default image quality from 0 to 100, -1 for the default of the format", "quality", "-1"},
+                          {"overlays", "Show the compass, the scale bar and the overview map"},
+                          {"statistics", "Report the throughput every <seconds> on the standard error", "seconds", "0"},
+                      });
+
+    if (!parser.parse(QCoreApplication::arguments())) {
+        qDebug() << parser.errorText();
+        parser.showHelp(2);
+    } else if (parser.isSet(helpOption)) {
+        parser.showHelp(0);
+    } else if (parser.isSet(versionOption)) {
+        parser.showVersion();
+        return 0;
+    }
+
+    RenderRequest defaults;
+    defaults.mapThemeId = parser.value("theme");
+    if (!RenderRequest::parseProjection(parser.value("projection"), defaults.projection)) {
+        qDebug() << "Unknown projection" << parser.value("projection");
+        return 3;
+    }
+    QStringList const size = parser.value("size").split(QLatin1Char('x'));
+    if (size.size() != 2 || size[0].toInt() <= 0 || size[1].toInt() <= 0) {
+        qDebug() << "Cannot parse image size. Expecting format 'WxH', e.g. '512x512'.";
+        return 3;
+    }
+    defaults.size = QSize(size[0].toInt(), size[1].toInt());
+    defaults.format = parser.value("format").toLatin1();
+    defaults.quality = parser.value("quality").toInt();
+
+    int const workerCount = qMax(1, parser.value("workers").toInt());
+
+    // The model is loaded once and shared by all requests, which is where
+    // most of the startup time of a map goes.
+    MarbleModel model;
+    model.setMapThemeId(defaults.mapThemeId);
+
+    RenderService service(&model, workerCount, parser.value("timeout").toInt(), parser.isSet("overlays"));
+    service.setDefaults(defaults);
+    service.setStatisticsInterval(parser.value("statistics").toInt());
+
+    StandardInputReader reader;
+    if (parser.isSet("socket")) {
+        if (!service.listen(parser.value("socket"))) {
+            qDebug() << "Cannot listen on" << parser.value("socket") << ":" << service.errorString();
+            return 4;
+        }
+    } else {
+        QObject::connect(&reader, SIGNAL(lineRead(QByteArray)), &service, SLOT(addStandardInputRequest(QByteArray)));
+
+        // quit once the last request is answered
+        QObject::connect(&reader, &StandardInputReader::endOfInput, &service, [&service]() {
+            if (service.isIdle()) {
+                QCoreApplication::quit();
+            } else {
+                QObject::connect(&service, SIGNAL(idle()), qApp, SLOT(quit()));
+            }
+        });
+        reader.start();
+    }
+
+    int const result = app.exec();
+
+    service.printStatistics();
+    if (reader.isRunning()) {
+        // blocked reading the standard input
+        reader.terminate();
+        reader.wait();
+    }
+
+    return result;
+}
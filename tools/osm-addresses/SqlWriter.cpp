@@ -30,6 +30,7 @@ SqlWriter::SqlWriter( const QString &filename, QObject* parent ) :
 
     execQuery( "DROP TABLE IF EXISTS placemarks;" );
     execQuery( "CREATE TABLE placemarks ("
+               " id INTEGER PRIMARY KEY,"
                " regionId INTEGER,"
                " nameId INTEGER,"
                " number VARCHAR(8),"
@@ -49,6 +50,19 @@ SqlWriter::SqlWriter( const QString &filename, QObject* parent ) :
                " name VARCHAR(50),"
                " lon FLOAT(8),"
                " lat FLOAT(8) )" );
+    // Prefix matching of name words and the search around a position are
+    // answered by these indices, see OsmDatabase. Both are filled at the end.
+    execQuery( "DROP TABLE IF EXISTS namesSearch" );
+    execQuery( "CREATE VIRTUAL TABLE namesSearch USING fts4("
+               " content=\"\","
+               " name,"
+               " tokenize=unicode61,"
+               " prefix=\"2,3\" )" );
+    execQuery( "DROP TABLE IF EXISTS placemarksArea" );
+    execQuery( "CREATE VIRTUAL TABLE placemarksArea USING rtree("
+               " id,"
+               " minLon, maxLon,"
+               " minLat, maxLat )" );
     execQuery( "DROP VIEW IF EXISTS places" );
     execQuery( "CREATE VIEW places AS "
                " SELECT"
@@ -66,10 +80,15 @@ SqlWriter::SqlWriter( const QString &filename, QObject* parent ) :
 
 SqlWriter::~SqlWriter()
 {
+    execQuery( "INSERT INTO namesSearch (docid, name) SELECT id, name FROM names" );
+    execQuery( "INSERT INTO placemarksArea (id, minLon, maxLon, minLat, maxLat)"
+               " SELECT id, lon, lon, lat, lat FROM placemarks" );
     execQuery( "END TRANSACTION" );
     execQuery( "CREATE INDEX namesIndex ON names(name)" );
     execQuery( "CREATE INDEX placemarksIndex ON placemarks(regionId,nameId,category)" );
+    execQuery( "CREATE INDEX placemarksNameIndex ON placemarks(nameId)" );
     execQuery( "CREATE INDEX regionsIndex ON regions(name,parent,lft,rgt)" );
+    execQuery( "CREATE INDEX regionsNestingIndex ON regions(lft)" );
 }
 
 void SqlWriter::addOsmRegion( const OsmRegion &region )
@@ -0,0 +1,71 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+// Converts vector tiles (e.g. .o5m files) into the binary cache files
+// which TileLoader loads instead of parsing the tiles
+
+#include <GeoDataDocument.h>
+#include <ParsingRunnerManager.h>
+#include <PluginManager.h>
+#include <VectorTileCache.h>
+
+#include <QApplication>
+#include <QDebug>
+#include <QDirIterator>
+#include <QFileInfo>
+
+using namespace Marble;
+
+int main(int argc, char** argv)
+{
+    QApplication app(argc,argv);
+
+    QStringList inputs = app.arguments().mid( 1 );
+    bool const force = inputs.removeAll( "-f" ) > 0;
+    if ( inputs.isEmpty() ) {
+        qDebug( " Syntax: vectortile2cache [-f] tile-file-or-directory..." );
+        qDebug( " Directories are searched recursively for .o5m and .osm files." );
+        qDebug( " Up to date cache files are skipped unless -f is given." );
+        return 1;
+    }
+
+    QStringList fileNames;
+    foreach ( const QString &input, inputs ) {
+        if ( QFileInfo( input ).isDir() ) {
+            QDirIterator iter( input, QStringList() << "*.o5m" << "*.osm", QDir::Files, QDirIterator::Subdirectories );
+            while ( iter.hasNext() ) {
+                fileNames << iter.next();
+            }
+        } else {
+            fileNames << input;
+        }
+    }
+
+    ParsingRunnerManager manager( new PluginManager );
+    int converted = 0;
+    int failed = 0;
+    foreach ( const QString &fileName, fileNames ) {
+        QString const cacheFileName = VectorTileCache::cacheFileName( fileName );
+        QFileInfo const cacheInfo( cacheFileName );
+        if ( !force && cacheInfo.exists() && cacheInfo.lastModified() >= QFileInfo( fileName ).lastModified() ) {
+            continue;
+        }
+
+        GeoDataDocument* document = manager.openFile( fileName );
+        if ( document && VectorTileCache::save( *document, cacheFileName ) ) {
+            ++converted;
+        } else {
+            qDebug() << "Could not convert" << fileName;
+            ++failed;
+        }
+        delete document;
+    }
+
+    qDebug() << "Converted" << converted << "of" << fileNames.size() << "tiles," << failed << "failed";
+    return failed > 0 ? 2 : 0;
+}